@@ -43,10 +43,14 @@
 #define CODEC2_MODE_700B 7
 #define CODEC2_MODE_700C 8
 
+#include <stddef.h>
+
 struct CODEC2;
 
 struct CODEC2 *  codec2_create(int mode);
 void codec2_destroy(struct CODEC2 *codec2_state);
+size_t codec2_size(int mode);
+struct CODEC2 *  codec2_create_arena(int mode, void *mem, size_t size);
 void codec2_encode(struct CODEC2 *codec2_state, unsigned char * bits, short speech_in[]);
 void codec2_decode(struct CODEC2 *codec2_state, short speech_out[], const unsigned char *bits);
 void codec2_decode_ber(struct CODEC2 *codec2_state, short speech_out[], const unsigned char *bits, float ber_est);
@@ -60,6 +64,47 @@ void codec2_set_natural_or_gray(struct CODEC2 *codec2_state, int gray);
 void codec2_set_softdec(struct CODEC2 *c2, float *softdec);
 float codec2_get_energy(struct CODEC2 *codec2_state, const unsigned char *bits);
 
+/* one frame on each of many channels per call, see codec2_batch.c */
+
+struct CODEC2_BATCH;
+
+struct CODEC2_BATCH *codec2_batch_create(int threads);
+void codec2_batch_destroy(struct CODEC2_BATCH *batch);
+int  codec2_encode_batch(struct CODEC2_BATCH *batch, struct CODEC2 *codec2_state[], unsigned char *bits[], short *speech_in[], int n);
+int  codec2_decode_batch(struct CODEC2_BATCH *batch, struct CODEC2 *codec2_state[], short *speech_out[], const unsigned char *bits[], int n);
+
+/* per stage timing, gathered when built with CODEC2_PROFILE, see
+   codec2_profile.c */
+
+#define CODEC2_PROFILE_DFT          0
+#define CODEC2_PROFILE_NLP          1
+#define CODEC2_PROFILE_TWO_STAGE    2
+#define CODEC2_PROFILE_EST_AMPS     3
+#define CODEC2_PROFILE_EST_VOICING  4
+#define CODEC2_PROFILE_QUANTISE     5     /* rest of encode, mostly LSP and energy quantisation */
+#define CODEC2_PROFILE_DEQUANTISE   6     /* rest of decode, mostly dequantisation and LPC to amps */
+#define CODEC2_PROFILE_PHASE_SYNTH  7
+#define CODEC2_PROFILE_POSTFILTER   8
+#define CODEC2_PROFILE_SYNTH        9
+#define CODEC2_PROFILE_ENCODE      10     /* whole codec2_encode() call                         */
+#define CODEC2_PROFILE_DECODE      11     /* whole codec2_decode() call                         */
+#define CODEC2_PROFILE_STAGES      12
+#define CODEC2_PROFILE_BINS        32
+
+struct codec2_profile_stage {
+    const char        *name;
+    unsigned long      calls;
+    unsigned long long ns;                          /* total time in this stage        */
+    unsigned long      hist[CODEC2_PROFILE_BINS];   /* calls taking 2^b to 2^(b+1)-1 ns */
+};
+
+struct codec2_profile {
+    struct codec2_profile_stage stage[CODEC2_PROFILE_STAGES];
+};
+
+int  codec2_get_profile(struct CODEC2 *codec2_state, struct codec2_profile *profile);
+void codec2_reset_profile(struct CODEC2 *codec2_state);
+
 
 #endif
 
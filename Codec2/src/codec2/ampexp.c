@@ -33,6 +33,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "codec2_math.h"
 #include "ampexp.h"
 #include "fdmdv_internal.h"
 
@@ -222,7 +223,7 @@ struct AEXP *amp_experiment_create() {
 	    aexp->indexes[j][i] = 0;
 	aexp->mag[i] = 1.0;
 	aexp->model[i].Wo = TWO_PI*100.0/8000.0;
-	aexp->model[i].L = floor(PI/aexp->model[i].Wo);
+	aexp->model[i].L = c2_floor(PI/aexp->model[i].Wo);
 	for(m=1; m<=MAX_AMP; m++)
 	    aexp->model[i].A[m] = 10.0;
 	aexp->model_uq[i] = aexp->model[i];
@@ -244,10 +245,10 @@ void amp_experiment_destroy(struct AEXP *aexp) {
 	printf("snr: %4.2f dB\n", aexp->snr/aexp->snr_n);
     if (aexp->var != 0.0)
 	printf("var...: %4.3f  std dev...: %4.3f (%d amplitude samples)\n",
-	       aexp->var/aexp->var_n, sqrt(aexp->var/aexp->var_n), aexp->var_n);
+	       aexp->var/aexp->var_n, c2_sqrt(aexp->var/aexp->var_n), aexp->var_n);
     if (aexp->vq_var != 0.0)
 	printf("vq var: %4.3f  std dev...: %4.3f (%d amplitude samples)\n",
-	       aexp->vq_var/aexp->vq_var_n, sqrt(aexp->vq_var/aexp->vq_var_n), aexp->vq_var_n);
+	       aexp->vq_var/aexp->vq_var_n, c2_sqrt(aexp->vq_var/aexp->vq_var_n), aexp->vq_var_n);
     free(aexp);
 }
 
@@ -272,12 +273,12 @@ static void add_quant_noise(struct AEXP *aexp, MODEL *model, int start, int end,
     float noise_sam_dB;
     float noise_sam_lin;
 
-    x_dB = sqrt(3.0) * sigma_dB;
+    x_dB = c2_sqrt(3.0) * sigma_dB;
 
     for(m=start; m<=end; m++) {
 	noise_sam_dB = x_dB*(1.0 - 2.0*rand()/RAND_MAX);
 	//printf("%f\n", noise_sam_dB);
-	noise_sam_lin = pow(10.0, noise_sam_dB/20.0);
+	noise_sam_lin = c2_pow(10.0, noise_sam_dB/20.0);
 	model->A[m] *= noise_sam_lin;
 	aexp->var += noise_sam_dB*noise_sam_dB;
 	aexp->var_n++;
@@ -306,25 +307,25 @@ static float frame_energy(MODEL *model, float *enormdB) {
     e = 0.0;
     for(m=1; m<=model->L; m++)
 	e += model->A[m]*model->A[m];
-    edB = 10*log10(e);
+    edB = 10*c2_log10(e);
 
     #define VER_E0
 
     #ifdef VER_E0
-    *enormdB = 10*log10(e/model->L); /* make high and low pitches have similar amps */
+    *enormdB = 10*c2_log10(e/model->L); /* make high and low pitches have similar amps */
     #endif
 
     #ifdef VER_E1
     e = 0.0;
     for(m=1; m<=model->L; m++)
-	e += 10*log10(model->A[m]*model->A[m]);
+	e += 10*c2_log10(model->A[m]*model->A[m]);
     *enormdB = e;
     #endif
 
     #ifdef VER_E2
     e = 0.0;
     for(m=1; m<=model->L; m++)
-	e += 10*log10(model->A[m]*model->A[m]);
+	e += 10*c2_log10(model->A[m]*model->A[m]);
     *enormdB = e/model->L;
     #endif
     //printf("%f\n", enormdB);
@@ -340,7 +341,7 @@ static void print_sparse_amp_error(struct AEXP *aexp, MODEL *model, float edB_th
 
     edB = frame_energy(model, &enormdB);
     //printf("%f\n", enormdB);
-    dWo = fabs((aexp->model_uq[2].Wo - aexp->model_uq[1].Wo)/aexp->model_uq[2].Wo);
+    dWo = c2_fabs((aexp->model_uq[2].Wo - aexp->model_uq[1].Wo)/aexp->model_uq[2].Wo);
 
     if ((edB > edB_thresh) && (dWo < 0.1)) {
 	for(m=0; m<MAX_AMP; m++) {
@@ -349,7 +350,7 @@ static void print_sparse_amp_error(struct AEXP *aexp, MODEL *model, float edB_th
 
 	for(m=1; m<=model->L; m++) {
 	    assert(model->A[m] > 0.0);
-	    error = 20.0*log10(model->A[m]) - enormdB;
+	    error = 20.0*c2_log10(model->A[m]) - enormdB;
 
 	    index = MAX_AMP*m*model->Wo/PI;
 	    assert(index < MAX_AMP);
@@ -428,7 +429,7 @@ static void print_sparse_pred_error(struct AEXP *aexp, MODEL *model, float mag_t
     mag = 0.0;
     for(m=1; m<=model->L; m++)
 	mag += model->A[m]*model->A[m];
-    mag = 10*log10(mag/model->L);
+    mag = 10*c2_log10(mag/model->L);
 
     if (mag > mag_thresh) {
 	for(m=0; m<MAX_AMP; m++) {
@@ -437,7 +438,7 @@ static void print_sparse_pred_error(struct AEXP *aexp, MODEL *model, float mag_t
 
 	for(m=1; m<=model->L; m++) {
 	    assert(model->A[m] > 0.0);
-	    error = PRED_COEFF*20.0*log10(aexp->A_prev[m]) - 20.0*log10(model->A[m]);
+	    error = PRED_COEFF*20.0*c2_log10(aexp->A_prev[m]) - 20.0*c2_log10(model->A[m]);
 	    //error = 20.0*log10(model->A[m]) - mag;
 
 	    index = MAX_AMP*m*model->Wo/PI;
@@ -473,7 +474,7 @@ static void sparse_vq_pred_error(struct AEXP *aexp,
 
     for(m=1; m<=model->L; m++) {
  	assert(model->A[m] > 0.0);
-	error = PRED_COEFF*20.0*log10(aexp->A_prev[m]) - 20.0*log10(model->A[m]);
+	error = PRED_COEFF*20.0*c2_log10(aexp->A_prev[m]) - 20.0*c2_log10(model->A[m]);
 
 	index = MAX_AMP*m*model->Wo/PI;
 	assert(index < MAX_AMP);
@@ -504,7 +505,7 @@ static void sparse_vq_pred_error(struct AEXP *aexp,
     if (edB > -100.0)
 	for(m=0; m<MAX_AMP; m++) {
 	    if (sparse_pe_in[m] != 0.0)
-		aexp->vq_var += pow(sparse_pe_out[m] - sparse_pe_in[m], 2.0);
+		aexp->vq_var += c2_pow(sparse_pe_out[m] - sparse_pe_in[m], 2.0);
 	}
 
     /* transform quantised amps back */
@@ -512,10 +513,10 @@ static void sparse_vq_pred_error(struct AEXP *aexp,
     for(m=1; m<=model->L; m++) {
 	index = MAX_AMP*m*model->Wo/PI;
 	assert(index < MAX_AMP);
-	amp_dB = PRED_COEFF*20.0*log10(aexp->A_prev[m]) - sparse_pe_out[index];
+	amp_dB = PRED_COEFF*20.0*c2_log10(aexp->A_prev[m]) - sparse_pe_out[index];
 	//printf("in: %f  out: %f\n", sparse_pe_in[index], sparse_pe_out[index]);
 	//printf("amp_dB: %f A[m] (dB) %f\n", amp_dB, 20.0*log10(model->A[m]));
-	model->A[m] = pow(10.0, amp_dB/20.0);
+	model->A[m] = c2_pow(10.0, amp_dB/20.0);
     }
     //exit(0);
 }
@@ -552,12 +553,12 @@ static void sparse_vq_amp(struct AEXP *aexp, MODEL *model)
 
     for(m=1; m<=model->L; m++) {
  	assert(model->A[m] > 0.0);
-	error = 20.0*log10(model->A[m]) - enormdB;
+	error = 20.0*c2_log10(model->A[m]) - enormdB;
 
 	index = MAX_AMP*m*model->Wo/PI;
 	assert(index < MAX_AMP);
 	sparse_pe_in[index] = error;
-	weights[index] = pow(model->A[m],0.8);
+	weights[index] = c2_pow(model->A[m],0.8);
     }
 
     /* vector quantise */
@@ -588,7 +589,7 @@ static void sparse_vq_amp(struct AEXP *aexp, MODEL *model)
 
     for(m=0; m<MAX_AMP; m++) {
 	if (sparse_pe_in[m] != 0.0)
-	    aexp->vq_var += pow(sparse_pe_out[m] - sparse_pe_in[m], 2.0);
+	    aexp->vq_var += c2_pow(sparse_pe_out[m] - sparse_pe_in[m], 2.0);
     }
 
     /* transform quantised amps back */
@@ -597,7 +598,7 @@ static void sparse_vq_amp(struct AEXP *aexp, MODEL *model)
 	index = MAX_AMP*m*model->Wo/PI;
 	assert(index < MAX_AMP);
 	amp_dB = sparse_pe_out[index] + enormdB;
-	model->A[m] = pow(10.0, amp_dB/20.0);
+	model->A[m] = c2_pow(10.0, amp_dB/20.0);
     }
     //exit(0);
 }
@@ -613,12 +614,12 @@ static void update_snr_calc(struct AEXP *aexp, MODEL *m1, MODEL *m2)
     signal = 0.0; noise = 1E-32;
     for(m=1; m<=m1->L; m++) {
 	signal += m1->A[m]*m1->A[m];
-	noise  += pow(m1->A[m] - m2->A[m], 2.0);
+	noise  += c2_pow(m1->A[m] - m2->A[m], 2.0);
 	//printf("%f %f\n", before[m], model->phi[m]);
     }
-    signal_dB = 10*log10(signal);
+    signal_dB = 10*c2_log10(signal);
     if (signal_dB > -100.0) {
-	aexp->snr += 10.0*log10(signal/noise);
+	aexp->snr += 10.0*c2_log10(signal/noise);
 	aexp->snr_n++;
     }
 }
@@ -713,7 +714,7 @@ static void gain_shape_sparse_vq_amp(struct AEXP *aexp, MODEL *model)
 
 	index = MAX_AMP*m*model->Wo/PI;
 	assert(index < MAX_AMP);
-	sparse_pe_in[index] = 20.0*log10(model->A[m]);
+	sparse_pe_in[index] = 20.0*c2_log10(model->A[m]);
 	weights[index] = model->A[m];
     }
 
@@ -730,7 +731,7 @@ static void gain_shape_sparse_vq_amp(struct AEXP *aexp, MODEL *model)
 
     for(m=0; m<MAX_AMP; m++) {
 	if (sparse_pe_in[m] != 0.0)
-	    aexp->vq_var += pow(sparse_pe_out[m] - sparse_pe_in[m], 2.0);
+	    aexp->vq_var += c2_pow(sparse_pe_out[m] - sparse_pe_in[m], 2.0);
     }
 
     /* transform quantised amps back */
@@ -739,7 +740,7 @@ static void gain_shape_sparse_vq_amp(struct AEXP *aexp, MODEL *model)
 	index = MAX_AMP*m*model->Wo/PI;
 	assert(index < MAX_AMP);
 	amp_dB = sparse_pe_out[index];
-	model->A[m] = pow(10.0, amp_dB/20.0);
+	model->A[m] = c2_pow(10.0, amp_dB/20.0);
     }
     //exit(0);
 }
@@ -793,7 +794,7 @@ static void vq_interp(struct AEXP *aexp, MODEL *model, int on)
 
 	    index = MAX_AMP*m*model->Wo/PI;
 	    assert(index < MAX_AMP);
-	    sparse_pe_in[index] = 20.0*log10(model->A[m]);
+	    sparse_pe_in[index] = 20.0*c2_log10(model->A[m]);
 	}
 
 	/* this can be used for when just testing partial interpolation */
@@ -814,7 +815,7 @@ static void vq_interp(struct AEXP *aexp, MODEL *model, int on)
 	    assert(index < MAX_AMP);
 	    amp_dB = sparse_pe_out[index];
 	    //printf("  %4.2f", 10.0*log10(model->A[m]));
-	    model->A[m] = pow(10.0, amp_dB/20.0);
+	    model->A[m] = c2_pow(10.0, amp_dB/20.0);
 	    //printf("  %4.2f\n", 10.0*log10(model->A[m]));
 	}
 
@@ -829,8 +830,8 @@ static void vq_interp(struct AEXP *aexp, MODEL *model, int on)
 		amp_dB += 0.5*(aexp->mag[2] + vq->cb[vq->k * aexp->indexes[2] + index]);
 		//printf("  %4.2f", 10.0*log10(model->A[m]));
 		//amp_dB = 10;
-		model->A[m] = pow(10.0, amp_dB/20.0);
-		printf("  %4.2f\n", 10.0*log10(model->A[m]));
+		model->A[m] = c2_pow(10.0, amp_dB/20.0);
+		printf("  %4.2f\n", 10.0*c2_log10(model->A[m]));
 	    }
 	}
 
@@ -880,7 +881,7 @@ void smooth_samples(struct AEXP *aexp, MODEL *model, int mode)
 
 	index = MAX_AMP*m*model->Wo/PI;
 	assert(index < MAX_AMP);
-	sparse_pe_out[index] = sparse_pe_in[index] = 20.0*log10(model->A[m]) - enormdB;
+	sparse_pe_out[index] = sparse_pe_in[index] = 20.0*c2_log10(model->A[m]) - enormdB;
     }
 
     /* now combine samples at high frequencies to reduce dimension */
@@ -903,7 +904,7 @@ void smooth_samples(struct AEXP *aexp, MODEL *model, int mode)
 	if (nav) {
 	    av /= nav;
 	    smoothed[v] = av;
-	    weights[v] = pow(10.0,av/20.0);
+	    weights[v] = c2_pow(10.0,av/20.0);
 	    //weights[v] = 1.0;
 	}
 	else
@@ -943,7 +944,7 @@ void smooth_samples(struct AEXP *aexp, MODEL *model, int mode)
 	assert(index < MAX_AMP);
 	amp_dB = sparse_pe_out[index] + enormdB;
 	//printf("%d %4.2f %4.2f\n", m, 10.0*log10(model->A[m]), amp_dB);
-	model->A[m] = pow(10.0, amp_dB/20.0);
+	model->A[m] = c2_pow(10.0, amp_dB/20.0);
     }
 
 }
@@ -1009,9 +1010,9 @@ void smooth_amp(struct AEXP *aexp, MODEL *model) {
 
 	    printf("L %d m %d f %4.f b %d\n", model->L, m, f, b);
 
-	    printf(" %d: %4.3f -> ", m, 20*log10(model->A[m]));
-	    model->A[m] = sqrt(av[b]/nav[b]);
-	    printf("%4.3f\n", 20*log10(model->A[m]));
+	    printf(" %d: %4.3f -> ", m, 20*c2_log10(model->A[m]));
+	    model->A[m] = c2_sqrt(av[b]/nav[b]);
+	    printf("%4.3f\n", 20*c2_log10(model->A[m]));
 	}
     }
     printf("\n");
@@ -32,6 +32,7 @@
 #include <string.h>
 #include <math.h>
 
+#include "codec2_math.h"
 #include "defines.h"
 #include "codec2_fft.h"
 #include "sine.h"
@@ -48,6 +49,7 @@
 #include "machdep.h"
 #include "bpf.h"
 #include "bpfb.h"
+#include "codec2_arena.h"
 
 /*---------------------------------------------------------------------------*\
 
@@ -105,7 +107,7 @@ struct CODEC2 * codec2_create(int mode)
         return NULL;
     }  
 
-    c2 = (struct CODEC2*)malloc(sizeof(struct CODEC2));
+    c2 = (struct CODEC2*)codec2_malloc(sizeof(struct CODEC2));
     if (c2 == NULL)
 	return NULL;
 
@@ -118,19 +120,19 @@ struct CODEC2 * codec2_create(int mode)
     int n_samp = c2->n_samp = c2->c2const.n_samp;
     int m_pitch = c2->m_pitch = c2->c2const.m_pitch;
 
-    c2->Pn = (float*)malloc(2*n_samp*sizeof(float));
+    c2->Pn = (float*)codec2_malloc(2*n_samp*sizeof(float));
     if (c2->Pn == NULL) {
 	return NULL;
     }
-    c2->Sn_ = (float*)malloc(2*n_samp*sizeof(float));
+    c2->Sn_ = (float*)codec2_malloc(2*n_samp*sizeof(float));
     if (c2->Sn_ == NULL) {
 	return NULL;
     }
-    c2->w = (float*)malloc(m_pitch*sizeof(float));
+    c2->w = (float*)codec2_malloc(m_pitch*sizeof(float));
     if (c2->w == NULL) {
 	return NULL;
     }
-    c2->Sn = (float*)malloc(m_pitch*sizeof(float));
+    c2->Sn = (float*)codec2_malloc(m_pitch*sizeof(float));
     if (c2->Sn == NULL) {
 	return NULL;
     }
@@ -177,14 +179,19 @@ struct CODEC2 * codec2_create(int mode)
     c2->xq_dec[0] = c2->xq_dec[1] = 0.0;
 
     c2->smoothing = 0;
+    c2->rand_next = 1;
 
-    c2->bpf_buf = (float*)malloc(sizeof(float)*(BPF_N+4*c2->n_samp));
+    c2->bpf_buf = (float*)codec2_malloc(sizeof(float)*(BPF_N+4*c2->n_samp));
     assert(c2->bpf_buf != NULL);
     for(i=0; i<BPF_N+4*c2->n_samp; i++)
         c2->bpf_buf[i] = 0.0;
 
     c2->softdec = NULL;
 
+#ifdef CODEC2_PROFILE
+    codec2_reset_profile(c2);
+#endif
+
     return c2;
 }
 
@@ -201,16 +208,65 @@ struct CODEC2 * codec2_create(int mode)
 void codec2_destroy(struct CODEC2 *c2)
 {
     assert(c2 != NULL);
-    free(c2->bpf_buf);
+    codec2_free(c2->bpf_buf);
     nlp_destroy(c2->nlp);
     codec2_fft_free(c2->fft_fwd_cfg);
     codec2_fftr_free(c2->fftr_fwd_cfg);
     codec2_fftr_free(c2->fftr_inv_cfg);
-    free(c2->Pn);
-    free(c2->Sn);
-    free(c2->w);
-    free(c2->Sn_);
-    free(c2);
+    codec2_free(c2->Pn);
+    codec2_free(c2->Sn);
+    codec2_free(c2->w);
+    codec2_free(c2->Sn_);
+    codec2_free(c2);
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: codec2_size
+  DATE CREATED: Oct 2026
+
+  Returns the size of the block codec2_create_arena() needs for mode,
+  or 0 if the mode isn't supported.  Measured by creating a heap
+  instance, so call it at start up rather than in real time code.
+
+\*---------------------------------------------------------------------------*/
+
+size_t codec2_size(int mode)
+{
+    struct CODEC2_ARENA arena;
+    struct CODEC2      *c2;
+
+    codec2_arena_begin(&arena, NULL, 0);
+    c2 = codec2_create(mode);
+    codec2_arena_end(&arena, c2);
+    if (c2 == NULL)
+	return 0;
+    codec2_destroy(c2);
+
+    return arena.used + CODEC2_ARENA_ALIGN;
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: codec2_create_arena
+  DATE CREATED: Oct 2026
+
+  As codec2_create(), but all states are placed in the size bytes at
+  mem, which must be at least codec2_size(mode).  No heap is used.
+  codec2_destroy() releases mem for reuse, it frees nothing.
+
+\*---------------------------------------------------------------------------*/
+
+struct CODEC2 *codec2_create_arena(int mode, void *mem, size_t size)
+{
+    struct CODEC2_ARENA arena;
+    struct CODEC2      *c2;
+
+    codec2_arena_begin(&arena, mem, size);
+    c2 = codec2_create(mode);
+    codec2_arena_end(&arena, c2);
+
+    return c2;
 }
 
 /*---------------------------------------------------------------------------*\
@@ -278,9 +334,13 @@ int codec2_samples_per_frame(struct CODEC2 *c2) {
 
 void codec2_encode(struct CODEC2 *c2, unsigned char *bits, short speech[])
 {
+    C2_PROFILE_VAR(start);
+
     assert(c2 != NULL);
     assert((c2->mode >= CODEC2_MODE_3200) && (c2->mode <= CODEC2_MODE_700B));
 
+    C2_PROFILE_BEGIN(c2, start);
+
     if (c2->mode == CODEC2_MODE_3200)
 	codec2_encode_3200(c2, bits, speech);
     if (c2->mode == CODEC2_MODE_2400)
@@ -299,6 +359,8 @@ void codec2_encode(struct CODEC2 *c2, unsigned char *bits, short speech[])
     if (c2->mode == CODEC2_MODE_700B)
 	codec2_encode_700b(c2, bits, speech);
 #endif
+
+    C2_PROFILE_END(c2, start, CODEC2_PROFILE_ENCODE, CODEC2_PROFILE_QUANTISE);
 }
 
 void codec2_decode(struct CODEC2 *c2, short speech[], const unsigned char *bits)
@@ -308,9 +370,18 @@ void codec2_decode(struct CODEC2 *c2, short speech[], const unsigned char *bits)
 
 void codec2_decode_ber(struct CODEC2 *c2, short speech[], const unsigned char *bits, float ber_est)
 {
+    C2_PROFILE_VAR(start);
+
     assert(c2 != NULL);
     assert((c2->mode >= CODEC2_MODE_3200) && (c2->mode <= CODEC2_MODE_700B));
 
+    C2_PROFILE_BEGIN(c2, start);
+
+    /* each decoder has its own random phases, so output doesn't depend
+       on how decodes of other channels are interleaved with it */
+
+    codec2_rand_swap(&c2->rand_next);
+
     if (c2->mode == CODEC2_MODE_3200)
 	codec2_decode_3200(c2, speech, bits);
     if (c2->mode == CODEC2_MODE_2400)
@@ -329,6 +400,10 @@ void codec2_decode_ber(struct CODEC2 *c2, short speech[], const unsigned char *b
     if (c2->mode == CODEC2_MODE_700B)
  	codec2_decode_700b(c2, speech, bits);
 #endif
+
+    codec2_rand_swap(&c2->rand_next);
+
+    C2_PROFILE_END(c2, start, CODEC2_PROFILE_DECODE, CODEC2_PROFILE_DEQUANTISE);
 }
 
 
@@ -1428,7 +1503,7 @@ void codec2_encode_700(struct CODEC2 *c2, unsigned char * bits, short speech[])
 
     for(i=0; i<LPC_ORD_LOW; i++) {
         f = (4000.0/PI)*lsps[i];
-        mel[i] = floor(2595.0*log10(1.0 + f/700.0) + 0.5);
+        mel[i] = c2_floor(2595.0*c2_log10(1.0 + f/700.0) + 0.5);
     }
     encode_mels_scalar(indexes, mel, LPC_ORD_LOW);
 
@@ -1493,7 +1568,7 @@ void codec2_decode_700(struct CODEC2 *c2, short speech[], const unsigned char *
 
     decode_mels_scalar(mel, indexes, LPC_ORD_LOW);
     for(i=0; i<LPC_ORD_LOW; i++) {
-        f_ = 700.0*( pow(10.0, (float)mel[i]/2595.0) - 1.0);
+        f_ = 700.0*( c2_pow(10.0, (float)mel[i]/2595.0) - 1.0);
         lsps[3][i] = f_*(PI/4000.0);
         //printf("lsps[3][%d]  %f\n", i, lsps[3][i]);
     }
@@ -1640,7 +1715,7 @@ void codec2_encode_700b(struct CODEC2 *c2, unsigned char * bits, short speech[])
 
     for(i=0; i<LPC_ORD_LOW; i++) {
         f = (4000.0/PI)*lsps[i];
-        mel[i] = floor(2595.0*log10(1.0 + f/700.0) + 0.5);
+        mel[i] = c2_floor(2595.0*c2_log10(1.0 + f/700.0) + 0.5);
     }
     lspmelvq_mbest_encode(indexes, mel, mel_, LPC_ORD_LOW, 5);
 
@@ -1715,7 +1790,7 @@ void codec2_decode_700b(struct CODEC2 *c2, short speech[], const unsigned char *
     }
 
     for(i=0; i<LPC_ORD_LOW; i++) {
-        f_ = 700.0*( pow(10.0, (float)mel[i]/2595.0) - 1.0);
+        f_ = 700.0*( c2_pow(10.0, (float)mel[i]/2595.0) - 1.0);
         lsps[3][i] = f_*(PI/4000.0);
         //printf("lsps[3][%d]  %f\n", i, lsps[3][i]);
     }
@@ -1844,12 +1919,14 @@ void synthesise_one_frame(struct CODEC2 *c2, short speech[], MODEL *model, COMP
 {
     int     i;
     PROFILE_VAR(phase_start, pf_start, synth_start);
+    C2_PROFILE_VAR(t);
 
     #ifdef DUMP
     dump_quantised_model(model);
     #endif
 
     PROFILE_SAMPLE(phase_start);
+    C2_PROFILE_SAMPLE(t);
 
     /* LPC based phase synthesis */
     COMP H[MAX_AMP+1];
@@ -1857,14 +1934,17 @@ void synthesise_one_frame(struct CODEC2 *c2, short speech[], MODEL *model, COMP
     phase_synth_zero_order(c2->n_samp, model, &c2->ex_phase, H);
 
     PROFILE_SAMPLE_AND_LOG(pf_start, phase_start, "    phase_synth");
+    C2_PROFILE_LOG(c2, t, CODEC2_PROFILE_PHASE_SYNTH);
 
     postfilter(model, &c2->bg_est);
 
     PROFILE_SAMPLE_AND_LOG(synth_start, pf_start, "    postfilter");
+    C2_PROFILE_LOG(c2, t, CODEC2_PROFILE_POSTFILTER);
 
     synthesise(c2->n_samp, c2->fftr_inv_cfg, c2->Sn_, model, c2->Pn, 1);
 
     PROFILE_SAMPLE_AND_LOG2(synth_start, "    synth");
+    C2_PROFILE_LOG(c2, t, CODEC2_PROFILE_SYNTH);
 
     ear_protection(c2->Sn_, c2->n_samp);
 
@@ -1896,6 +1976,7 @@ void analyse_one_frame(struct CODEC2 *c2, MODEL *model, short speech[])
     float   pitch;
     int     i;
     PROFILE_VAR(dft_start, nlp_start, model_start, two_stage, estamps);
+    C2_PROFILE_VAR(t);
     int     n_samp = c2->n_samp;
     int     m_pitch = c2->m_pitch;
 
@@ -1907,13 +1988,16 @@ void analyse_one_frame(struct CODEC2 *c2, MODEL *model, short speech[])
       c2->Sn[i+m_pitch-n_samp] = speech[i];
 
     PROFILE_SAMPLE(dft_start);
+    C2_PROFILE_SAMPLE(t);
     dft_speech(&c2->c2const, c2->fft_fwd_cfg, Sw, c2->Sn, c2->w);
     PROFILE_SAMPLE_AND_LOG(nlp_start, dft_start, "    dft_speech");
+    C2_PROFILE_LOG(c2, t, CODEC2_PROFILE_DFT);
 
     /* Estimate pitch */
 
     nlp(c2->nlp, c2->Sn, n_samp, &pitch, Sw, c2->W, &c2->prev_f0_enc);
     PROFILE_SAMPLE_AND_LOG(model_start, nlp_start, "    nlp");
+    C2_PROFILE_LOG(c2, t, CODEC2_PROFILE_NLP);
 
     model->Wo = TWO_PI/pitch;
     model->L = PI/model->Wo;
@@ -1922,10 +2006,13 @@ void analyse_one_frame(struct CODEC2 *c2, MODEL *model, short speech[])
 
     two_stage_pitch_refinement(&c2->c2const, model, Sw);
     PROFILE_SAMPLE_AND_LOG(two_stage, model_start, "    two_stage");
+    C2_PROFILE_LOG(c2, t, CODEC2_PROFILE_TWO_STAGE);
     estimate_amplitudes(model, Sw, c2->W, 0);
     PROFILE_SAMPLE_AND_LOG(estamps, two_stage, "    est_amps");
+    C2_PROFILE_LOG(c2, t, CODEC2_PROFILE_EST_AMPS);
     est_voicing_mbe(&c2->c2const, model, Sw, c2->W);
     PROFILE_SAMPLE_AND_LOG2(estamps, "    est_voicing");
+    C2_PROFILE_LOG(c2, t, CODEC2_PROFILE_EST_VOICING);
     #ifdef DUMP
     dump_model(model);
     #endif
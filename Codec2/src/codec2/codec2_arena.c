@@ -0,0 +1,175 @@
+/*---------------------------------------------------------------------------*\
+
+  FILE........: codec2_arena.c
+  DATE CREATED: Oct 2026
+
+  Allocator used by the codec and modem constructors.  The xxx_size()
+  and xxx_create_arena() functions run the usual constructor between
+  codec2_arena_begin() and codec2_arena_end(), so each codec2_malloc()
+  it makes is carved from the caller's block, or measured.
+
+  Live arenas are remembered, so codec2_free() of memory inside one is
+  a no-op and the usual destroy functions work on arena instances.
+  The instance itself is always the first block carved from its arena;
+  freeing it releases the arena, after which the caller may reuse the
+  memory.
+
+  The arena being carved is per thread in builds with worker threads
+  (CODEC2_BATCH_THREADS or FREEDV_PIPELINE_THREADS), so allocations
+  made meanwhile on other threads still come from the heap.  The table
+  of live arenas is shared and updated with atomics, so an instance may
+  be destroyed on any thread.
+
+\*---------------------------------------------------------------------------*/
+
+/*
+  All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 2.1, as
+  published by the Free Software Foundation.  This program is
+  distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+  License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "codec2_arena.h"
+
+#define ARENA_ROUND(n) (((n) + CODEC2_ARENA_ALIGN - 1) & ~(size_t)(CODEC2_ARENA_ALIGN - 1))
+
+#if defined(CODEC2_BATCH_THREADS) || defined(FREEDV_PIPELINE_THREADS)
+#define ARENA_THREAD __thread
+#else
+#define ARENA_THREAD
+#endif
+
+/* a slot is claimed before its size is written and only published
+   once it is, and arena_find() checks the base again after reading the
+   size, so a base is never paired with the size of another arena */
+
+#define ARENA_CLAIMED ((unsigned char *)1)
+
+static ARENA_THREAD struct CODEC2_ARENA *current;     /* arena between begin and end */
+static unsigned char       *live_base[CODEC2_MAX_ARENAS];
+static size_t               live_size[CODEC2_MAX_ARENAS];
+
+static int arena_find(const void *ptr) {
+    const unsigned char *p = (const unsigned char *)ptr;
+    unsigned char       *base;
+    size_t               size;
+    int i;
+
+    for(i=0; i<CODEC2_MAX_ARENAS; i++) {
+	do {
+	    base = __atomic_load_n(&live_base[i], __ATOMIC_ACQUIRE);
+	    size = __atomic_load_n(&live_size[i], __ATOMIC_ACQUIRE);
+	} while (base != __atomic_load_n(&live_base[i], __ATOMIC_ACQUIRE));
+	if ((base != NULL) && (base != ARENA_CLAIMED) && (p >= base) && (p < base + size))
+	    return i;
+    }
+    return -1;
+}
+
+void codec2_arena_begin(struct CODEC2_ARENA *arena, void *mem, size_t size) {
+    uintptr_t      skip;
+    unsigned char *free_slot;
+    int            i;
+
+    assert(current == NULL);
+
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+
+    /* round the block in to the arena alignment, and give up on it if
+       there are no free slots to track it */
+
+    if (mem != NULL) {
+	skip = (CODEC2_ARENA_ALIGN - ((uintptr_t)mem % CODEC2_ARENA_ALIGN)) % CODEC2_ARENA_ALIGN;
+	for(i=0; (i<CODEC2_MAX_ARENAS) && (size > skip); i++) {
+	    free_slot = NULL;
+	    if (__atomic_compare_exchange_n(&live_base[i], &free_slot, ARENA_CLAIMED, 0,
+					    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		break;
+	}
+	if ((i < CODEC2_MAX_ARENAS) && (size > skip)) {
+	    arena->base = (unsigned char *)mem + skip;
+	    arena->size = size - skip;
+	    __atomic_store_n(&live_size[i], arena->size, __ATOMIC_RELEASE);
+	    __atomic_store_n(&live_base[i], arena->base, __ATOMIC_RELEASE);
+	}
+	else
+	    arena->size = 1;        /* fail every allocation */
+    }
+
+    current = arena;
+}
+
+/* instance is the constructor's result, if NULL the arena is released */
+
+void codec2_arena_end(struct CODEC2_ARENA *arena, void *instance) {
+    int i;
+
+    assert(current == arena);
+    current = NULL;
+
+    if ((arena->base != NULL) && (instance == NULL)) {
+	i = arena_find(arena->base);
+	assert(i >= 0);
+	__atomic_store_n(&live_base[i], NULL, __ATOMIC_RELEASE);
+    }
+}
+
+void *codec2_malloc(size_t size) {
+    size_t n = ARENA_ROUND(size);
+    void  *p;
+
+    if (current == NULL)
+	return malloc(size);
+
+    if (current->size == 0) {
+	/* measuring */
+	p = malloc(size);
+	if (p != NULL)
+	    current->used += n;
+	return p;
+    }
+
+    if ((current->base == NULL) || (n > current->size - current->used))
+	return NULL;
+    p = current->base + current->used;
+    current->used += n;
+    return p;
+}
+
+void *codec2_calloc(size_t nmemb, size_t size) {
+    void *p;
+
+    if ((size != 0) && (nmemb > (size_t)-1/size))
+	return NULL;
+    p = codec2_malloc(nmemb*size);
+    if (p != NULL)
+	memset(p, 0, nmemb*size);
+    return p;
+}
+
+void codec2_free(void *ptr) {
+    int i;
+
+    if (ptr == NULL)
+	return;
+    i = arena_find(ptr);
+    if (i < 0)
+	free(ptr);
+    else if ((ptr == __atomic_load_n(&live_base[i], __ATOMIC_ACQUIRE)) && (current == NULL))
+	__atomic_store_n(&live_base[i], NULL, __ATOMIC_RELEASE);
+}
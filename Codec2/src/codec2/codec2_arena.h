@@ -0,0 +1,52 @@
+/*---------------------------------------------------------------------------*\
+
+  FILE........: codec2_arena.h
+  DATE CREATED: Oct 2026
+
+  Allocator used by the codec and modem constructors, so an instance
+  can be placed in one caller supplied block of memory rather than on
+  the heap.
+
+\*---------------------------------------------------------------------------*/
+
+/*
+  All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 2.1, as
+  published by the Free Software Foundation.  This program is
+  distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+  License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __CODEC2_ARENA__
+#define __CODEC2_ARENA__
+
+#include <stddef.h>
+
+#define CODEC2_ARENA_ALIGN 16       /* alignment of each block carved from an arena */
+#define CODEC2_MAX_ARENAS  16       /* arena instances that may be live at once     */
+
+struct CODEC2_ARENA {
+    unsigned char *base;            /* caller's memory, NULL when measuring         */
+    size_t         size;
+    size_t         used;            /* bytes handed out, or needed when measuring   */
+};
+
+/* Between begin and end every codec2_malloc() is served from the
+   arena.  With mem == NULL allocations come from the heap as usual,
+   and arena->used counts the bytes an arena would need. */
+
+void  codec2_arena_begin(struct CODEC2_ARENA *arena, void *mem, size_t size);
+void  codec2_arena_end(struct CODEC2_ARENA *arena, void *instance);
+
+void *codec2_malloc(size_t size);
+void *codec2_calloc(size_t nmemb, size_t size);
+void  codec2_free(void *ptr);
+
+#endif
@@ -0,0 +1,497 @@
+/*---------------------------------------------------------------------------*\
+
+  FILE........: codec2_batch.c
+  DATE CREATED: Oct 2026
+
+  Encodes or decodes one frame on each of many independent Codec 2
+  channels per call, e.g. for a repeater hub.  Output is bit exact
+  with calling codec2_encode() or codec2_decode() on each channel.
+
+  On one core a batch runs at the same speed as that serial loop,
+  grouping the channels by mode measured no faster.  Any gain comes
+  from building with CODEC2_BATCH_THREADS (needs pthreads, so not for
+  the Cortex M4), where a batch can own a pool of worker threads that
+  take runs of CODEC2_BATCH_CHUNK channels, on a host with cores to
+  spare.
+
+  To check batches against the serial loop and time them:
+
+    src$ gcc -O2 -DCODEC2_BATCH_UNITTEST [-DCODEC2_BATCH_THREADS] -I. -Icodec2 \
+             $(find codec2 -name '*.c') -o batch -lm -lpthread && ./batch 2>/dev/null
+
+\*---------------------------------------------------------------------------*/
+
+/*
+  All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 2.1, as
+  published by the Free Software Foundation.  This program is
+  distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+  License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <stdlib.h>
+
+#ifdef CODEC2_BATCH_THREADS
+#include <pthread.h>
+#endif
+
+#include "defines.h"
+#include "codec2.h"
+#include "codec2_internal.h"
+
+#define CODEC2_BATCH_MODES 9        /* CODEC2_MODE_3200 .. CODEC2_MODE_700C */
+#define CODEC2_BATCH_CHUNK 4        /* channels claimed by a worker at a time */
+
+#define BATCH_ENCODE 0
+#define BATCH_DECODE 1
+
+struct CODEC2_BATCH {
+    int             *order;         /* channel indexes grouped by mode       */
+    int              norder;        /* allocated length of order[]           */
+
+    /* current job */
+
+    int              op;
+    struct CODEC2  **c2;
+    unsigned char  **bits;
+    short          **speech;
+    int              n;
+
+#ifdef CODEC2_BATCH_THREADS
+    int              nthreads;
+    pthread_t       *threads;
+    pthread_mutex_t  lock;
+    pthread_cond_t   start;         /* signalled when a job is posted        */
+    pthread_cond_t   done;          /* signalled when the last worker ends   */
+    int              job;           /* incremented for each job posted       */
+    int              next;          /* next position in order[] to claim     */
+    int              busy;          /* workers still on the current job      */
+    int              quit;
+#endif
+};
+
+static void batch_run(struct CODEC2_BATCH *b, int i) {
+    int ch = b->order[i];
+
+    if (b->op == BATCH_ENCODE)
+	codec2_encode(b->c2[ch], b->bits[ch], b->speech[ch]);
+    else
+	codec2_decode(b->c2[ch], b->speech[ch], b->bits[ch]);
+}
+
+/* counting sort of the channels by mode, stable so channels of the same
+   mode keep their order */
+
+static int batch_order(struct CODEC2_BATCH *b, struct CODEC2 *c2[], int n) {
+    int count[CODEC2_BATCH_MODES+1];
+    int i, mode;
+
+    if (n > b->norder) {
+	int *order = (int*)realloc(b->order, sizeof(int)*n);
+	if (order == NULL)
+	    return -1;
+	b->order = order;
+	b->norder = n;
+    }
+
+    for(mode=0; mode<=CODEC2_BATCH_MODES; mode++)
+	count[mode] = 0;
+    for(i=0; i<n; i++) {
+	assert(c2[i] != NULL);
+	assert((c2[i]->mode >= 0) && (c2[i]->mode < CODEC2_BATCH_MODES));
+	count[c2[i]->mode+1]++;
+    }
+    for(mode=1; mode<=CODEC2_BATCH_MODES; mode++)
+	count[mode] += count[mode-1];
+    for(i=0; i<n; i++)
+	b->order[count[c2[i]->mode]++] = i;
+
+    return 0;
+}
+
+#ifdef CODEC2_BATCH_THREADS
+
+/* claims and runs chunks of the current job until none are left, called
+   with the lock held and returns with it held */
+
+static void batch_work(struct CODEC2_BATCH *b) {
+    int i, end;
+
+    while(b->next < b->n) {
+	i = b->next;
+	end = i + CODEC2_BATCH_CHUNK;
+	if (end > b->n)
+	    end = b->n;
+	b->next = end;
+
+	pthread_mutex_unlock(&b->lock);
+	for(; i<end; i++)
+	    batch_run(b, i);
+	pthread_mutex_lock(&b->lock);
+    }
+}
+
+static void *batch_worker(void *arg) {
+    struct CODEC2_BATCH *b = (struct CODEC2_BATCH *)arg;
+    int job = 0;
+
+    pthread_mutex_lock(&b->lock);
+    for(;;) {
+	while(!b->quit && b->job == job)
+	    pthread_cond_wait(&b->start, &b->lock);
+	if (b->quit)
+	    break;
+	job = b->job;
+	batch_work(b);
+	if (--b->busy == 0)
+	    pthread_cond_signal(&b->done);
+    }
+    pthread_mutex_unlock(&b->lock);
+
+    return NULL;
+}
+
+#endif
+
+static void batch_process(struct CODEC2_BATCH *b, int op, struct CODEC2 *c2[],
+			  unsigned char *bits[], short *speech[], int n)
+{
+    int i;
+
+    b->op = op;
+    b->c2 = c2;
+    b->bits = bits;
+    b->speech = speech;
+    b->n = n;
+
+#ifdef CODEC2_BATCH_THREADS
+    if (b->nthreads > 0 && n > CODEC2_BATCH_CHUNK) {
+	pthread_mutex_lock(&b->lock);
+	b->next = 0;
+	b->busy = b->nthreads;
+	b->job++;
+	pthread_cond_broadcast(&b->start);
+
+	/* the calling thread works on the batch too */
+
+	batch_work(b);
+	while(b->busy > 0)
+	    pthread_cond_wait(&b->done, &b->lock);
+	pthread_mutex_unlock(&b->lock);
+	return;
+    }
+#endif
+
+    for(i=0; i<n; i++)
+	batch_run(b, i);
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: codec2_batch_create
+
+  Creates the state used by codec2_encode_batch() and
+  codec2_decode_batch().  threads is the number of worker threads in
+  addition to the calling thread, and is ignored unless built with
+  CODEC2_BATCH_THREADS.  Returns NULL on failure.
+
+\*---------------------------------------------------------------------------*/
+
+struct CODEC2_BATCH *codec2_batch_create(int threads) {
+    struct CODEC2_BATCH *b;
+
+    b = (struct CODEC2_BATCH *)calloc(1, sizeof(struct CODEC2_BATCH));
+    if (b == NULL)
+	return NULL;
+
+#ifdef CODEC2_BATCH_THREADS
+    int i;
+
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->start, NULL);
+    pthread_cond_init(&b->done, NULL);
+    if (threads > 0) {
+	b->threads = (pthread_t*)malloc(sizeof(pthread_t)*threads);
+	if (b->threads == NULL) {
+	    codec2_batch_destroy(b);
+	    return NULL;
+	}
+	for(i=0; i<threads; i++) {
+	    if (pthread_create(&b->threads[i], NULL, batch_worker, b) != 0)
+		break;
+	    b->nthreads++;
+	}
+    }
+#else
+    (void)threads;
+#endif
+
+    return b;
+}
+
+void codec2_batch_destroy(struct CODEC2_BATCH *b) {
+    assert(b != NULL);
+
+#ifdef CODEC2_BATCH_THREADS
+    int i;
+
+    pthread_mutex_lock(&b->lock);
+    b->quit = 1;
+    pthread_cond_broadcast(&b->start);
+    pthread_mutex_unlock(&b->lock);
+    for(i=0; i<b->nthreads; i++)
+	pthread_join(b->threads[i], NULL);
+    free(b->threads);
+    pthread_cond_destroy(&b->done);
+    pthread_cond_destroy(&b->start);
+    pthread_mutex_destroy(&b->lock);
+#endif
+
+    free(b->order);
+    free(b);
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: codec2_encode_batch
+
+  Encodes one frame of speech[i] into bits[i] for each of the n
+  channels c2[i], same as calling codec2_encode() on each.  Each
+  channel may have its own mode, but a channel must appear only once
+  per batch.  Returns 0, or -1 if out of memory.
+
+\*---------------------------------------------------------------------------*/
+
+int codec2_encode_batch(struct CODEC2_BATCH *b, struct CODEC2 *c2[],
+			unsigned char *bits[], short *speech[], int n)
+{
+    assert(b != NULL);
+
+    if (batch_order(b, c2, n) != 0)
+	return -1;
+    batch_process(b, BATCH_ENCODE, c2, bits, speech, n);
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: codec2_decode_batch
+
+  Decodes bits[i] into one frame of speech[i] for each of the n
+  channels c2[i], same as calling codec2_decode() on each.  Returns 0,
+  or -1 if out of memory.
+
+\*---------------------------------------------------------------------------*/
+
+int codec2_decode_batch(struct CODEC2_BATCH *b, struct CODEC2 *c2[],
+			short *speech[], const unsigned char *bits[], int n)
+{
+    assert(b != NULL);
+
+    if (batch_order(b, c2, n) != 0)
+	return -1;
+    batch_process(b, BATCH_DECODE, c2, (unsigned char **)bits, speech, n);
+
+    return 0;
+}
+
+#ifdef CODEC2_BATCH_UNITTEST
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define TEST_CHANNELS 48
+#define TEST_FRAMES   50
+#define TEST_THREADS  3
+#define TEST_REPS     5
+
+/* Checks batch encode and decode are byte identical to calling
+   codec2_encode() and codec2_decode() on each channel in turn, with
+   channels of all modes interleaved, and times the three.  Decode
+   bits come from each channel's own encoder. */
+
+static double test_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1E6 + t.tv_nsec/1E3;
+}
+
+struct test_set {
+    struct CODEC2 *enc[TEST_CHANNELS], *dec[TEST_CHANNELS];
+    unsigned char *bits[TEST_CHANNELS];
+    short         *speech[TEST_CHANNELS], *out[TEST_CHANNELS];
+};
+
+static void test_open(struct test_set *t) {
+    int ch;
+
+    for(ch=0; ch<TEST_CHANNELS; ch++) {
+	t->enc[ch] = codec2_create(ch % (CODEC2_MODE_700B+1));
+	t->dec[ch] = codec2_create(ch % (CODEC2_MODE_700B+1));
+	assert((t->enc[ch] != NULL) && (t->dec[ch] != NULL));
+	t->bits[ch] = (unsigned char*)malloc((codec2_bits_per_frame(t->enc[ch])+7)/8);
+	t->speech[ch] = (short*)malloc(sizeof(short)*codec2_samples_per_frame(t->enc[ch]));
+	t->out[ch] = (short*)malloc(sizeof(short)*codec2_samples_per_frame(t->enc[ch]));
+    }
+}
+
+static void test_close(struct test_set *t) {
+    int ch;
+
+    for(ch=0; ch<TEST_CHANNELS; ch++) {
+	codec2_destroy(t->enc[ch]);
+	codec2_destroy(t->dec[ch]);
+	free(t->bits[ch]);
+	free(t->speech[ch]);
+	free(t->out[ch]);
+    }
+}
+
+/* a different voiced sound on each channel, so they don't all take the
+   same path through the quantisers */
+
+static void test_speech(struct test_set *t, int f) {
+    int ch, i, n;
+
+    for(ch=0; ch<TEST_CHANNELS; ch++) {
+	n = codec2_samples_per_frame(t->enc[ch]);
+	for(i=0; i<n; i++) {
+	    long j = (long)f*n + i;
+	    t->speech[ch][i] = 3000.0*sinf(2.0*M_PI*(100.0 + 3*ch + 20.0*sinf(j*1E-3))*j/8000.0)
+		             + 1500.0*sinf(2.0*M_PI*(500.0 + 17*ch)*j/8000.0) + (rand() % 400) - 200;
+	}
+    }
+}
+
+/* runs TEST_FRAMES frames on every channel, b == NULL for the serial
+   loop, returns us spent in encode and decode */
+
+static double test_run(struct test_set *t, struct CODEC2_BATCH *b,
+		       unsigned char ***bits, short ***out)
+{
+    double us = 0.0, t0;
+    int    f, ch;
+
+    srand(1);
+    for(f=0; f<TEST_FRAMES; f++) {
+	test_speech(t, f);
+	t0 = test_us();
+	if (b == NULL) {
+	    for(ch=0; ch<TEST_CHANNELS; ch++)
+		codec2_encode(t->enc[ch], t->bits[ch], t->speech[ch]);
+	    for(ch=0; ch<TEST_CHANNELS; ch++)
+		codec2_decode(t->dec[ch], t->out[ch], t->bits[ch]);
+	} else {
+	    codec2_encode_batch(b, t->enc, t->bits, t->speech, TEST_CHANNELS);
+	    codec2_decode_batch(b, t->dec, t->out, (const unsigned char **)t->bits, TEST_CHANNELS);
+	}
+	us += test_us() - t0;
+	for(ch=0; ch<TEST_CHANNELS; ch++) {
+	    memcpy(bits[f][ch], t->bits[ch], (codec2_bits_per_frame(t->enc[ch])+7)/8);
+	    memcpy(out[f][ch], t->out[ch], sizeof(short)*codec2_samples_per_frame(t->enc[ch]));
+	}
+    }
+
+    return us;
+}
+
+static unsigned char ***test_bits(void) {
+    unsigned char ***p = (unsigned char ***)malloc(sizeof(unsigned char **)*TEST_FRAMES);
+    int f, ch;
+
+    for(f=0; f<TEST_FRAMES; f++) {
+	p[f] = (unsigned char **)malloc(sizeof(unsigned char *)*TEST_CHANNELS);
+	for(ch=0; ch<TEST_CHANNELS; ch++)
+	    p[f][ch] = (unsigned char *)calloc(8, 1);
+    }
+    return p;
+}
+
+static short ***test_out(void) {
+    short ***p = (short ***)malloc(sizeof(short **)*TEST_FRAMES);
+    int f, ch;
+
+    for(f=0; f<TEST_FRAMES; f++) {
+	p[f] = (short **)malloc(sizeof(short *)*TEST_CHANNELS);
+	for(ch=0; ch<TEST_CHANNELS; ch++)
+	    p[f][ch] = (short *)calloc(320, sizeof(short));
+    }
+    return p;
+}
+
+int main(void) {
+    unsigned char ***ref_bits = test_bits(), ***bits = test_bits();
+    short         ***ref_out = test_out(), ***out = test_out();
+    struct CODEC2_BATCH *b[2];
+    struct test_set  t;
+    double           us[3], t1;
+    int              nb, i, rep, f, ch, diffs[2] = {0, 0}, bad = 0;
+
+    /* with and without the worker pool when there is one, best of
+       TEST_REPS runs each, taken in turn so they see the same load */
+
+    b[0] = codec2_batch_create(0);
+#ifdef CODEC2_BATCH_THREADS
+    b[1] = codec2_batch_create(TEST_THREADS);
+    nb = 2;
+#else
+    b[1] = NULL;
+    nb = 1;
+#endif
+    us[0] = us[1] = us[2] = 1E30;
+    for(rep=0; rep<TEST_REPS; rep++) {
+	test_open(&t);
+	t1 = test_run(&t, NULL, ref_bits, ref_out);
+	test_close(&t);
+	if (t1 < us[0])
+	    us[0] = t1;
+	for(i=0; i<nb; i++) {
+	    assert(b[i] != NULL);
+	    test_open(&t);
+	    t1 = test_run(&t, b[i], bits, out);
+	    test_close(&t);
+	    if (t1 < us[i+1])
+		us[i+1] = t1;
+	    for(f=0; f<TEST_FRAMES; f++)
+		for(ch=0; ch<TEST_CHANNELS; ch++)
+		    diffs[i] += memcmp(bits[f][ch], ref_bits[f][ch], 8) ||
+			        memcmp(out[f][ch], ref_out[f][ch], 320*sizeof(short));
+	}
+    }
+
+    printf("%d channels, %d frames, modes 3200..700B interleaved\n", TEST_CHANNELS, TEST_FRAMES);
+    printf("  serial loop          %8.1f us/frame\n", us[0]/TEST_FRAMES);
+    for(i=0; i<nb; i++) {
+	printf("  batch, %d workers     %8.1f us/frame %5.2fx  %s\n", i ? TEST_THREADS : 0,
+	       us[i+1]/TEST_FRAMES, us[0]/us[i+1], diffs[i] ? "differs" : "bit exact");
+	bad += diffs[i];
+	codec2_batch_destroy(b[i]);
+    }
+
+    for(f=0; f<TEST_FRAMES; f++) {
+	for(ch=0; ch<TEST_CHANNELS; ch++) {
+	    free(ref_bits[f][ch]); free(bits[f][ch]);
+	    free(ref_out[f][ch]); free(out[f][ch]);
+	}
+	free(ref_bits[f]); free(bits[f]); free(ref_out[f]); free(out[f]);
+    }
+    free(ref_bits); free(bits); free(ref_out); free(out);
+
+    if (bad) {
+	printf("Bad!\n");
+	exit(1);
+    }
+    printf("Everything checks out\n");
+    return 0;
+}
+#endif
@@ -37,7 +37,10 @@
                                                          value to get an integer
                                                          oversampling rate */
 
+#include <stddef.h>
+
 #include "comp.h"
+#include "nco.h"
 #include "modem_stats.h"
 
 struct COHPSK;
@@ -46,6 +49,8 @@ extern const int test_bits_coh[];
 
 struct COHPSK *cohpsk_create(void);
 void cohpsk_destroy(struct COHPSK *coh);
+size_t cohpsk_size(void);
+struct COHPSK *cohpsk_create_arena(void *mem, size_t size);
 void cohpsk_mod(struct COHPSK *cohpsk, COMP tx_fdm[], int tx_bits[], int nbits);
 void cohpsk_clip(COMP tx_fdm[]);
 void cohpsk_demod(struct COHPSK *cohpsk, float rx_bits[], int *sync, COMP rx_fdm[], int *nin_frame);
@@ -58,11 +63,14 @@ int cohpsk_error_pattern_size(void);
 void cohpsk_set_frame(struct COHPSK *coh, int frame);
 void fdmdv_freq_shift_coh(COMP rx_fdm_fcorr[], COMP rx_fdm[], float foff, float Fs,
                           COMP *foff_phase_rect, int nin);
+void fdmdv_freq_shift_coh_nco(COMP rx_fdm_fcorr[], COMP rx_fdm[], float foff, float Fs,
+                              struct NCO *foff_phase, int nin);
 
 /* used for accessing upper and lower bits before diversity combination */
 
 float *cohpsk_get_rx_bits_lower(struct COHPSK *coh);
 float *cohpsk_get_rx_bits_upper(struct COHPSK *coh);
 void cohpsk_set_carrier_ampl(struct COHPSK *coh, int c, float ampl);
+int cohpsk_set_channelizer(struct COHPSK *coh, int enable);
 
 #endif
@@ -55,7 +55,10 @@ extern "C" {
 #define CODEC2_WIN32SUPPORT
 #endif
 
+#include <stddef.h>
+
 #include "comp.h"
+#include "nco.h"
 #include "modem_stats.h"
 
 #define FDMDV_NC                      14  /* default number of data carriers                                */
@@ -79,10 +82,13 @@ struct FDMDV;
 
 struct FDMDV * fdmdv_create(int Nc);
 void           fdmdv_destroy(struct FDMDV *fdmdv_state);
+size_t         fdmdv_size(int Nc);
+struct FDMDV * fdmdv_create_arena(int Nc, void *mem, size_t size);
 void           fdmdv_use_old_qpsk_mapping(struct FDMDV *fdmdv_state);
 int            fdmdv_bits_per_frame(struct FDMDV *fdmdv_state);
 float          fdmdv_get_fsep(struct FDMDV *fdmdv_state);
 void           fdmdv_set_fsep(struct FDMDV *fdmdv_state, float fsep);
+int            fdmdv_set_channelizer(struct FDMDV *fdmdv_state, int enable);
 
 void           fdmdv_mod(struct FDMDV *fdmdv_state, COMP tx_fdm[], int tx_bits[], int *sync_bit);
 void           fdmdv_demod(struct FDMDV *fdmdv_state, int rx_bits[], int *reliable_sync_bit, COMP rx_fdm[], int *nin);
@@ -99,6 +105,7 @@ void           fdmdv_16_to_8(float out8k[], float in16k[], int n);
 void           fdmdv_16_to_8_short(short out8k[], short in16k[], int n);
 
 void           fdmdv_freq_shift(COMP rx_fdm_fcorr[], COMP rx_fdm[], float foff, COMP *foff_phase_rect, int nin);
+void           fdmdv_freq_shift_nco(COMP rx_fdm_fcorr[], COMP rx_fdm[], float foff, struct NCO *foff_phase, int nin);
 
 /* debug/development function(s) */
 
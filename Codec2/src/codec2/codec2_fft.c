@@ -6,6 +6,7 @@
  */
 
 #include "codec2_fft.h"
+#include "codec2_arena.h"
 #ifdef USE_KISS_FFT
 #include "_kiss_fft_guts.h"
 
@@ -19,12 +20,12 @@ const arm_cfft_instance_f32* fft_init_cache[FFT_INIT_CACHE_SIZE];
 static const arm_cfft_instance_f32* arm_fft_instance2ram(const arm_cfft_instance_f32* in)
 {
 
-    arm_cfft_instance_f32* out = malloc(sizeof(arm_cfft_instance_f32));
+    arm_cfft_instance_f32* out = codec2_malloc(sizeof(arm_cfft_instance_f32));
 
     if (out) {
         memcpy(out,in,sizeof(arm_cfft_instance_f32));
-        out->pBitRevTable = malloc(out->bitRevLength * sizeof(uint16_t));
-        out->pTwiddle = malloc(out->fftLen * sizeof(float32_t));
+        out->pBitRevTable = codec2_malloc(out->bitRevLength * sizeof(uint16_t));
+        out->pTwiddle = codec2_malloc(out->fftLen * sizeof(float32_t));
         memcpy((void*)out->pBitRevTable,in->pBitRevTable,out->bitRevLength * sizeof(uint16_t));
         memcpy((void*)out->pTwiddle,in->pTwiddle,out->fftLen * sizeof(float32_t));
     }
@@ -62,8 +63,10 @@ void codec2_fft_free(codec2_fft_cfg cfg)
 {
 #ifdef USE_KISS_FFT
     KISS_FFT_FREE(cfg);
+#elif defined(USE_SIMD_FFT)
+    simd_fft_free(cfg);
 #else
-    free(cfg);
+    codec2_free(cfg);
 #endif
 }
 
@@ -72,8 +75,11 @@ codec2_fft_cfg codec2_fft_alloc(int nfft, int inverse_fft, void* mem, size_t* le
     codec2_fft_cfg retval;
 #ifdef USE_KISS_FFT
     retval = kiss_fft_alloc(nfft, inverse_fft, mem, lenmem);
+#elif defined(USE_SIMD_FFT)
+    // plans always come from codec2_malloc(), mem and lenmem are ignored
+    retval = simd_fft_alloc(nfft, inverse_fft);
 #else
-    retval = malloc(sizeof(codec2_fft_struct));
+    retval = codec2_malloc(sizeof(codec2_fft_struct));
     retval->inverse  = inverse_fft;
     switch(nfft)
     {
@@ -102,10 +108,12 @@ codec2_fftr_cfg codec2_fftr_alloc(int nfft, int inverse_fft, void* mem, size_t*
     codec2_fftr_cfg retval;
 #ifdef USE_KISS_FFT
     retval = kiss_fftr_alloc(nfft, inverse_fft, mem, lenmem);
+#elif defined(USE_SIMD_FFT)
+    retval = simd_fftr_alloc(nfft, inverse_fft);
 #else
-    retval = malloc(sizeof(codec2_fftr_struct));
+    retval = codec2_malloc(sizeof(codec2_fftr_struct));
     retval->inverse  = inverse_fft;
-    retval->instance = malloc(sizeof(arm_rfft_fast_instance_f32));
+    retval->instance = codec2_malloc(sizeof(arm_rfft_fast_instance_f32));
     arm_rfft_fast_init_f32(retval->instance,nfft);
     // memcpy(&retval->instance->Sint,arm_fft_cache_get(&retval->instance->Sint),sizeof(arm_cfft_instance_f32));
 #endif
@@ -115,9 +123,11 @@ void codec2_fftr_free(codec2_fftr_cfg cfg)
 {
 #ifdef USE_KISS_FFT
     KISS_FFT_FREE(cfg);
+#elif defined(USE_SIMD_FFT)
+    simd_fftr_free(cfg);
 #else
-    free(cfg->instance);
-    free(cfg);
+    codec2_free(cfg->instance);
+    codec2_free(cfg);
 #endif
 }
 
@@ -144,6 +154,9 @@ void codec2_fft_inplace(codec2_fft_cfg cfg, codec2_fft_cpx* inout)
     {
         kiss_fft(cfg, (kiss_fft_cpx*)inout, (kiss_fft_cpx*)inout);
     }
+#elif defined(USE_SIMD_FFT)
+    // the plan has its own work buffer, so runs in place without a copy
+    simd_fft(cfg, inout, inout);
 #else
     arm_cfft_f32(cfg->instance,(float*)inout,cfg->inverse,1);
     if (cfg->inverse)
@@ -24,7 +24,8 @@
 #include "defines.h"
 #include "comp.h"
 
-#ifndef ARM_MATH_CM4
+// define USE_SIMD_FFT for the planned SSE2/NEON FFTs of simd_fft.c
+#if !defined(ARM_MATH_CM4) && !defined(USE_SIMD_FFT)
     #define USE_KISS_FFT
 #endif
 // #define USE_KISS_FFT
@@ -38,6 +39,11 @@ typedef COMP    codec2_fft_cpx;
     typedef kiss_fftr_cfg codec2_fftr_cfg;
     typedef kiss_fft_cfg codec2_fft_cfg;
     typedef kiss_fft_scalar codec2_fft_scalar;
+#elif defined(USE_SIMD_FFT)
+    #include "simd_fft.h"
+    typedef simd_fftr_cfg codec2_fftr_cfg;
+    typedef simd_fft_cfg codec2_fft_cfg;
+    typedef float codec2_fft_scalar;
 #else
   typedef float32_t codec2_fft_scalar;
   typedef struct {
@@ -61,6 +67,8 @@ static inline void codec2_fftr(codec2_fftr_cfg cfg, codec2_fft_scalar* in, codec
 
 #ifdef USE_KISS_FFT
       kiss_fftr(cfg, in, (kiss_fft_cpx*)out);
+#elif defined(USE_SIMD_FFT)
+      simd_fftr(cfg, in, out);
 #else
     arm_rfft_fast_f32(cfg->instance,in,(float*)out,cfg->inverse);
     out->imag = 0; // remove out[FFT_ENC/2]->real stored in out[0].imag
@@ -71,6 +79,8 @@ static inline void codec2_fftri(codec2_fftr_cfg cfg, codec2_fft_cpx* in, codec2_
 {
 #ifdef USE_KISS_FFT
       kiss_fftri(cfg, (kiss_fft_cpx*)in, out);
+#elif defined(USE_SIMD_FFT)
+      simd_fftri(cfg, in, out);
 #else
     arm_rfft_fast_f32(cfg->instance,(float*)in,out,cfg->inverse);
     // arm_scale_f32(out,cfg->instance->fftLenRFFT,out,cfg->instance->fftLenRFFT);
@@ -89,6 +99,8 @@ static inline void codec2_fft(codec2_fft_cfg cfg, codec2_fft_cpx* in, codec2_fft
 
 #ifdef USE_KISS_FFT
       kiss_fft(cfg, (kiss_fft_cpx*)in, (kiss_fft_cpx*)out);
+#elif defined(USE_SIMD_FFT)
+      simd_fft(cfg, in, out);
 #else
     memcpy(out,in,cfg->instance->fftLen*2*sizeof(float));
     arm_cfft_f32(cfg->instance,(float*)out,cfg->inverse,0);
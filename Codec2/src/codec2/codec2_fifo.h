@@ -36,6 +36,9 @@
 extern "C" {
 #endif
 
+/* Safe for one thread writing while another reads, with no locks.
+   More than one writer or reader needs a lock around each side. */
+
 struct FIFO;
 
 struct FIFO *fifo_create(int nshort);
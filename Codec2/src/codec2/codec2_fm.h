@@ -38,9 +38,9 @@ struct FM {
     COMP  *rx_bb;
     COMP   rx_bb_filt_prev;
     float *rx_dem_mem;
-    float  tx_phase;
+    float  tx_phase;         /* modulator phase, rads               */
     int    nsam;
-    COMP   lo_phase;
+    COMP   lo_phase;         /* demod local oscillator phasor       */
 };
 
 struct FM *fm_create(int nsam);
@@ -31,6 +31,11 @@
 
 #include "codec2_fft.h"
 
+#ifdef CODEC2_PROFILE
+#include <stdint.h>
+#include "codec2.h"
+#endif
+
 struct CODEC2 {
     int           mode;
     C2CONST       c2const;
@@ -65,6 +70,8 @@ struct CODEC2 {
     float         xq_enc[2];               /* joint pitch and energy VQ states          */
     float         xq_dec[2];
 
+    unsigned long rand_next;               /* decoder's random phase generator state    */
+
     int           smoothing;               /* enable smoothing for channels with errors */
     float        *softdec;                 /* optional soft decn bits from demod        */
 
@@ -74,8 +81,37 @@ struct CODEC2 {
     int            voicing_left;
     codec2_fft_cfg phase_fft_fwd_cfg;
     codec2_fft_cfg phase_fft_inv_cfg;      
+
+#ifdef CODEC2_PROFILE
+    struct codec2_profile prof;            /* per stage timing                          */
+    uint64_t      prof_inner;              /* ns in named stages this encode/decode     */
+#endif
 };
 
+/* Per stage timing for codec2_get_profile(), compiled out unless
+   CODEC2_PROFILE is defined.  BEGIN starts a whole encode or decode,
+   LOG charges the time since t to stage and restarts t, END charges
+   the whole call to total and the part no LOG claimed to rest. */
+
+#ifdef CODEC2_PROFILE
+#define C2_PROFILE_VAR(...)                  uint64_t __VA_ARGS__
+#define C2_PROFILE_SAMPLE(t)                 t = codec2_profile_clock()
+#define C2_PROFILE_BEGIN(c2, t)              t = codec2_profile_begin(c2)
+#define C2_PROFILE_LOG(c2, t, stage)         t = codec2_profile_log(c2, stage, t)
+#define C2_PROFILE_END(c2, t, total, rest)   codec2_profile_end(c2, total, rest, t)
+
+uint64_t codec2_profile_clock(void);
+uint64_t codec2_profile_begin(struct CODEC2 *c2);
+uint64_t codec2_profile_log(struct CODEC2 *c2, int stage, uint64_t start);
+void     codec2_profile_end(struct CODEC2 *c2, int total, int rest, uint64_t start);
+#else
+#define C2_PROFILE_VAR(...)
+#define C2_PROFILE_SAMPLE(t)
+#define C2_PROFILE_BEGIN(c2, t)
+#define C2_PROFILE_LOG(c2, t, stage)
+#define C2_PROFILE_END(c2, t, total, rest)
+#endif
+
 // test and debug
 void analyse_one_frame(struct CODEC2 *c2, MODEL *model, short speech[]);
 void synthesise_one_frame(struct CODEC2 *c2, short speech[], MODEL *model,
@@ -0,0 +1,176 @@
+/*---------------------------------------------------------------------------*\
+
+  FILE........: codec2_math.h
+  DATE CREATED: Oct 2026
+
+  Numeric build profiles for the DSP sources, include after <math.h>.
+
+  -DCODEC2_FLOAT32 keeps every DSP path in single precision.  The
+  DSP code calls libm through c2_sqrt(), c2_pow() etc., which are the
+  float versions in this profile, and (with gcc) unsuffixed constants
+  like 0.5 and M_PI are float, so nothing is promoted to double, which
+  the M4F FPU can only do in software.
+  Build with -Wdouble-promotion to check.  Init code that wants double
+  on purpose (nco_angle(), the FFT twiddles) doesn't include this file.
+
+  -DCODEC2_FIXED_POINT swaps the inner loops of lpc, lsp, sine and
+  postfilter for Q15/Q31 versions, for parts without an FPU.  The
+  interfaces stay float, values are block scaled into Q15 on the way
+  in and accumulate in 64 bits.  interp stays in float, it does too
+  little per frame to pay for the conversions.  The float block scaling
+  at every interface is a real cost: on a host with an FPU the Q15
+  kernels are no faster than float (postfilter is 2 to 4 times slower),
+  and they have not been timed on a part without one, so there are no
+  numbers yet showing this profile pays off anywhere.
+
+  To check those kernels against reference vectors in every profile,
+  and time them (the test's main() is in lsp.c):
+
+     src$ for p in "" -DCODEC2_FLOAT32 -DCODEC2_FIXED_POINT "-DCODEC2_FLOAT32 -DCODEC2_FIXED_POINT"; do
+              gcc -O2 -DCODEC2_MATH_UNITTEST $p -I. -Icodec2 $(find codec2 -name '*.c') \
+                  -o c2math -lm && ./c2math || break; done
+
+\*---------------------------------------------------------------------------*/
+
+/*
+  All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 2.1, as
+  published by the Free Software Foundation.  This program is
+  distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+  License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __CODEC2_MATH__
+#define __CODEC2_MATH__
+
+#include <math.h>
+
+#ifdef CODEC2_FLOAT32
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize ("single-precision-constant")
+#endif
+
+/* libm calls made by the DSP code, in the precision of the profile */
+
+#define c2_sqrt(x)     sqrtf(x)
+#define c2_pow(x,y)    powf(x,y)
+#define c2_exp(x)      expf(x)
+#define c2_log(x)      logf(x)
+#define c2_log10(x)    log10f(x)
+#define c2_log2(x)     log2f(x)
+#define c2_sin(x)      sinf(x)
+#define c2_cos(x)      cosf(x)
+#define c2_tan(x)      tanf(x)
+#define c2_asin(x)     asinf(x)
+#define c2_acos(x)     acosf(x)
+#define c2_atan(x)     atanf(x)
+#define c2_atan2(y,x)  atan2f(y,x)
+#define c2_floor(x)    floorf(x)
+#define c2_ceil(x)     ceilf(x)
+#define c2_round(x)    roundf(x)
+#define c2_fabs(x)     fabsf(x)
+#define c2_fmod(x,y)   fmodf(x,y)
+
+#else
+
+#define c2_sqrt(x)     sqrt(x)
+#define c2_pow(x,y)    pow(x,y)
+#define c2_exp(x)      exp(x)
+#define c2_log(x)      log(x)
+#define c2_log10(x)    log10(x)
+#define c2_log2(x)     log2(x)
+#define c2_sin(x)      sin(x)
+#define c2_cos(x)      cos(x)
+#define c2_tan(x)      tan(x)
+#define c2_asin(x)     asin(x)
+#define c2_acos(x)     acos(x)
+#define c2_atan(x)     atan(x)
+#define c2_atan2(y,x)  atan2(y,x)
+#define c2_floor(x)    floor(x)
+#define c2_ceil(x)     ceil(x)
+#define c2_round(x)    round(x)
+#define c2_fabs(x)     fabs(x)
+#define c2_fmod(x,y)   fmod(x,y)
+
+#endif
+
+#ifdef CODEC2_FIXED_POINT
+
+#include <stdint.h>
+
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+/* constants, |x| < 1 */
+
+#define Q15(x)      ((q15_t)((x)*32768.0f))
+#define Q31(x)      ((q31_t)((x)*2147483648.0f))
+
+static inline q15_t q15_mul(q15_t a, q15_t b) {
+    return (q15_t)(((int32_t)a*b) >> 15);
+}
+
+static inline q31_t q31_mul(q31_t a, q31_t b) {
+    return (q31_t)(((int64_t)a*b) >> 31);
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: q15_block
+  DATE CREATED: Oct 2026
+
+  Block floating point, converts n floats to Q15 with one exponent
+  chosen so the largest magnitude fills 15 bits.  Returns e such that
+  x[i] = q[i]*2^e, rounded to 1 part in 2^16 of the largest value.
+
+\*---------------------------------------------------------------------------*/
+
+static inline int q15_block(q15_t q[], const float x[], int n) {
+    float   max, scale;
+    int32_t r;
+    int     e, i;
+
+    max = 0.0f;
+    for(i=0; i<n; i++)
+        if (fabsf(x[i]) > max)
+            max = fabsf(x[i]);
+    if (max == 0.0f) {
+        for(i=0; i<n; i++)
+            q[i] = 0;
+        return 0;
+    }
+
+    frexpf(max, &e);                    /* max = m*2^e, 0.5 <= m < 1 */
+    e -= 15;
+    scale = ldexpf(1.0f, -e);
+    for(i=0; i<n; i++) {
+        r = (int32_t)(x[i]*scale + ((x[i] < 0.0f) ? -0.5f : 0.5f));
+        q[i] = (q15_t)((r > 32767) ? 32767 : r);
+    }
+
+    return e;
+}
+
+/* sum of a[i]*b[i], a Q30 result when both are Q15 */
+
+static inline int64_t q15_dot(const q15_t a[], const q15_t b[], int n) {
+    int64_t acc = 0;
+    int     i;
+
+    for(i=0; i<n; i++)
+        acc += (int32_t)a[i]*b[i];
+
+    return acc;
+}
+
+#endif
+
+#endif
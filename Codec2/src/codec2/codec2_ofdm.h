@@ -35,6 +35,7 @@ extern "C" {
 /* Includes */
     
 #include <complex.h>
+#include <stddef.h>
 #include <stdbool.h>
     
 #include "comp.h"
@@ -47,11 +48,14 @@ struct OFDM;
 
 struct OFDM *ofdm_create(void);
 void ofdm_destroy(struct OFDM *);
+size_t ofdm_size(void);
+struct OFDM *ofdm_create_arena(void *mem, size_t size);
 void ofdm_mod(struct OFDM *, COMP *, const int *);
 void ofdm_demod(struct OFDM *, int *, COMP *);
 int ofdm_get_nin(struct OFDM *);
 int ofdm_get_samples_per_frame(void);
 int ofdm_get_max_samples_per_frame(void);
+int ofdm_acquire(struct OFDM *, COMP *, int, float, float *);
 
 /* option setters */
 
@@ -0,0 +1,232 @@
+/*---------------------------------------------------------------------------*\
+
+  FILE........: codec2_profile.c
+  DATE CREATED: Oct 2026
+
+  Per stage timing of the Codec 2 encoder and decoder, read with
+  codec2_get_profile().  Unlike the PROFILE macros in machdep.h, which
+  need the STM32 cycle counter, this uses the host's monotonic clock.
+  Each instance keeps, per stage, the number of calls, the total ns and
+  a log2 histogram of call times.
+
+  Nothing is gathered unless the library is built with -DCODEC2_PROFILE,
+  without it codec2_get_profile() returns 0 and all counts are zero.
+
+  To benchmark every mode on a long 8 kHz 16 bit raw file:
+
+     src$ gcc -O2 -DCODEC2_PROFILE -DCODEC2_PROFILE_BENCH -I. -Icodec2 \
+              $(find codec2 -name '*.c') -o c2bench -lm && ./c2bench speech.raw
+
+\*---------------------------------------------------------------------------*/
+
+/*
+  All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 2.1, as
+  published by the Free Software Foundation.  This program is
+  distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+  License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+
+#include "defines.h"
+#include "codec2.h"
+#include "codec2_internal.h"
+
+static const char *stage_names[CODEC2_PROFILE_STAGES] = {
+    "dft_speech",
+    "nlp",
+    "two_stage",
+    "est_amps",
+    "est_voicing",
+    "quantise",
+    "dequantise",
+    "phase_synth",
+    "postfilter",
+    "synth",
+    "encode",
+    "decode"
+};
+
+#ifdef CODEC2_PROFILE
+
+uint64_t codec2_profile_clock(void) {
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+#else
+    return (uint64_t)clock()*(1000000000/CLOCKS_PER_SEC);
+#endif
+}
+
+static void profile_add(struct codec2_profile_stage *s, uint64_t ns) {
+    int b;
+
+    for(b=0; (b < CODEC2_PROFILE_BINS-1) && (ns >> (b+1)); b++)
+        ;
+    s->calls++;
+    s->ns += ns;
+    s->hist[b]++;
+}
+
+uint64_t codec2_profile_begin(struct CODEC2 *c2) {
+    c2->prof_inner = 0;
+    return codec2_profile_clock();
+}
+
+uint64_t codec2_profile_log(struct CODEC2 *c2, int stage, uint64_t start) {
+    uint64_t now = codec2_profile_clock();
+
+    profile_add(&c2->prof.stage[stage], now - start);
+    c2->prof_inner += now - start;
+    return now;
+}
+
+void codec2_profile_end(struct CODEC2 *c2, int total, int rest, uint64_t start) {
+    uint64_t ns = codec2_profile_clock() - start;
+
+    profile_add(&c2->prof.stage[total], ns);
+    profile_add(&c2->prof.stage[rest], ns > c2->prof_inner ? ns - c2->prof_inner : 0);
+}
+
+#endif
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: codec2_get_profile
+  DATE CREATED: Oct 2026
+
+  Copies the stage timings gathered since codec2_create() or the last
+  codec2_reset_profile().  Returns 1, or 0 if the library was built
+  without CODEC2_PROFILE, when only the stage names are filled in.
+
+\*---------------------------------------------------------------------------*/
+
+int codec2_get_profile(struct CODEC2 *c2, struct codec2_profile *profile) {
+    int i;
+
+    assert(c2 != NULL);
+
+#ifdef CODEC2_PROFILE
+    *profile = c2->prof;
+#else
+    memset(profile, 0, sizeof(struct codec2_profile));
+#endif
+    for(i=0; i<CODEC2_PROFILE_STAGES; i++)
+        profile->stage[i].name = stage_names[i];
+
+#ifdef CODEC2_PROFILE
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void codec2_reset_profile(struct CODEC2 *c2) {
+    assert(c2 != NULL);
+#ifdef CODEC2_PROFILE
+    memset(&c2->prof, 0, sizeof(c2->prof));
+    c2->prof_inner = 0;
+#endif
+}
+
+#ifdef CODEC2_PROFILE_BENCH
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *mode_names[] = {"3200", "2400", "1600", "1400", "1300", "1200", "700", "700B"};
+
+/* upper bound in us of the histogram bin holding fraction q of the calls */
+
+static float quantile_us(const struct codec2_profile_stage *s, float q) {
+    unsigned long n = 0;
+    int b;
+
+    for(b=0; b<CODEC2_PROFILE_BINS; b++) {
+        n += s->hist[b];
+        if (n >= q*s->calls)
+            break;
+    }
+    return (float)((uint64_t)2 << b)/1000.0;
+}
+
+int main(int argc, char *argv[]) {
+    struct CODEC2        *c2;
+    struct codec2_profile prof;
+    FILE                 *fin;
+    short                *speech, out[320];
+    unsigned char         bits[8];
+    uint64_t              whole;
+    long                  nsam, f, nframes;
+    int                   mode, i, n, nbyte;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s InputRawSpeechFile\n", argv[0]);
+        exit(1);
+    }
+    if ((fin = fopen(argv[1], "rb")) == NULL) {
+        fprintf(stderr, "Error opening %s\n", argv[1]);
+        exit(1);
+    }
+    fseek(fin, 0, SEEK_END);
+    nsam = ftell(fin)/sizeof(short);
+    fseek(fin, 0, SEEK_SET);
+    speech = (short*)malloc(nsam*sizeof(short));
+    assert(speech != NULL);
+    nsam = fread(speech, sizeof(short), nsam, fin);
+    fclose(fin);
+
+    printf("%s: %.1f s of speech\n", argv[1], nsam/8000.0);
+
+    for(mode=CODEC2_MODE_3200; mode<=CODEC2_MODE_700B; mode++) {
+        c2 = codec2_create(mode);
+        n = codec2_samples_per_frame(c2);
+        nbyte = (codec2_bits_per_frame(c2) + 7)/8;
+        nframes = nsam/n;
+        assert((n <= 320) && (nbyte <= (int)sizeof(bits)));
+
+        for(f=0; f<nframes; f++) {
+            codec2_encode(c2, bits, &speech[f*n]);
+            codec2_decode(c2, out, bits);
+        }
+        codec2_get_profile(c2, &prof);
+
+        printf("\nmode %s, %ld frames, encode %.1fx decode %.1fx real time\n",
+               mode_names[mode], nframes,
+               1E9*nsam/8000.0/(prof.stage[CODEC2_PROFILE_ENCODE].ns + 1),
+               1E9*nsam/8000.0/(prof.stage[CODEC2_PROFILE_DECODE].ns + 1));
+        printf("  %-12s %8s %10s %9s %9s %9s %6s\n",
+               "stage", "calls", "total ms", "mean us", "p50 us", "p99 us", "%");
+        for(i=0; i<CODEC2_PROFILE_STAGES; i++) {
+            struct codec2_profile_stage *s = &prof.stage[i];
+
+            /* percentages are of the encode or decode the stage is part of */
+            if ((i <= CODEC2_PROFILE_QUANTISE) || (i == CODEC2_PROFILE_ENCODE))
+                whole = prof.stage[CODEC2_PROFILE_ENCODE].ns;
+            else
+                whole = prof.stage[CODEC2_PROFILE_DECODE].ns;
+            if (s->calls == 0)
+                continue;
+            printf("  %-12s %8lu %10.2f %9.2f %9.2f %9.2f %6.1f\n", s->name, s->calls,
+                   s->ns/1E6, s->ns/1E3/s->calls, quantile_us(s, 0.5), quantile_us(s, 0.99),
+                   100.0*s->ns/(whole + 1));
+        }
+
+        codec2_destroy(c2);
+    }
+
+    free(speech);
+    return 0;
+}
+#endif
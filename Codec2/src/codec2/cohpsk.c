@@ -6,6 +6,13 @@
 
   Functions that implement a coherent PSK FDM modem.
 
+  To check downconvert_and_rx_filter_coh() against fdm_downconvert_coh()
+  and rx_filter_coh() on the same input, and time both:
+
+     src$ gcc -O2 -DCOHPSK_CHANNELIZER_UNITTEST -Icodec2 codec2/cohpsk.c codec2/fdmdv.c \
+              codec2/nco.c codec2/linreg.c codec2/codec2_fft.c codec2/kiss_fft.c \
+              codec2/kiss_fftr.c codec2/codec2_arena.c -o cohpsk_chan -lm && ./cohpsk_chan
+
 \*---------------------------------------------------------------------------*/
 
 /*
@@ -37,6 +44,7 @@
 #include <string.h>
 #include <math.h>
 
+#include "codec2_math.h"
 #include "codec2_cohpsk.h"
 #include "cohpsk_defs.h"
 #include "cohpsk_internal.h"
@@ -47,6 +55,7 @@
 #include "linreg.h"
 #include "rn_coh.h"
 #include "test_bits_coh.h"
+#include "codec2_arena.h"
 
 static COMP qpsk_mod[] = {
     { 1.0, 0.0},
@@ -93,7 +102,7 @@ struct COHPSK *cohpsk_create(void)
     assert(COHPSK_NSYM == NSYM);  /* as we want to use the tx sym mem on fdmdv */
     assert(COHPSK_NT == NT);
 
-    coh = (struct COHPSK*)malloc(sizeof(struct COHPSK));
+    coh = (struct COHPSK*)codec2_malloc(sizeof(struct COHPSK));
     if (coh == NULL)
         return NULL;
 
@@ -134,16 +143,15 @@ struct COHPSK *cohpsk_create(void)
     fdmdv = fdmdv_create(COHPSK_NC*ND - 1);
     fdmdv->fsep = COHPSK_RS*(1.0 + COHPSK_EXCESS_BW);
     for(c=0; c<COHPSK_NC*ND; c++) {
-	fdmdv->phase_tx[c].real = 1.0;
- 	fdmdv->phase_tx[c].imag = 0.0;
-
         /* note non-linear carrier spacing to help PAPR, works v well in conjunction with CLIP */
 
-        freq_hz = fdmdv->fsep*( -(COHPSK_NC*ND)/2 - 0.5 + pow(c + 1.0, 0.98) );
+        freq_hz = fdmdv->fsep*( -(COHPSK_NC*ND)/2 - 0.5 + c2_pow(c + 1.0, 0.98) );
 
 	fdmdv->freq[c].real = cosf(2.0*M_PI*freq_hz/COHPSK_FS);
  	fdmdv->freq[c].imag = sinf(2.0*M_PI*freq_hz/COHPSK_FS);
  	fdmdv->freq_pol[c]  = 2.0*M_PI*freq_hz/COHPSK_FS;
+	nco_init(&fdmdv->phase_tx[c], fdmdv->freq_pol[c], 0.0);
+	nco_init(&fdmdv->phase_rx[c], fdmdv->freq_pol[c], 0.0);
 
         //printf("c: %d %f %f\n",c,freq_hz,fdmdv->freq_pol[c]);
         for(i=0; i<COHPSK_NFILTER; i++) {
@@ -155,9 +163,8 @@ struct COHPSK *cohpsk_create(void)
 
         coh->carrier_ampl[c] = 1.0;
     }
-    fdmdv->fbb_rect.real     = cosf(2.0*PI*FDMDV_FCENTRE/COHPSK_FS);
-    fdmdv->fbb_rect.imag     = sinf(2.0*PI*FDMDV_FCENTRE/COHPSK_FS);
     fdmdv->fbb_pol           = 2.0*PI*FDMDV_FCENTRE/COHPSK_FS;
+    nco_set_freq(&fdmdv->fbb_phase_tx, fdmdv->fbb_pol);
 
     coh->fdmdv = fdmdv;
 
@@ -171,6 +178,7 @@ struct COHPSK *cohpsk_create(void)
     }
 
     coh->verbose = 0;
+    coh->rx_hist = NULL;
 
     /* disable optional logging by default */
 
@@ -206,7 +214,48 @@ void cohpsk_destroy(struct COHPSK *coh)
 {
     fdmdv_destroy(coh->fdmdv);
     assert(coh != NULL);
-    free(coh);
+    if (coh->rx_hist)
+        codec2_free(coh->rx_hist);
+    codec2_free(coh);
+}
+
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: cohpsk_size / cohpsk_create_arena
+  DATE CREATED: Oct 2026
+
+  As cohpsk_create(), but the modem states are placed in the size bytes at
+  mem, at least cohpsk_size() long, with no heap use.  cohpsk_destroy()
+  releases mem for reuse.
+
+\*---------------------------------------------------------------------------*/
+
+size_t cohpsk_size(void)
+{
+    struct CODEC2_ARENA arena;
+    struct COHPSK *coh;
+
+    codec2_arena_begin(&arena, NULL, 0);
+    coh = cohpsk_create();
+    codec2_arena_end(&arena, coh);
+    if (coh == NULL)
+	return 0;
+    cohpsk_destroy(coh);
+
+    return arena.used + CODEC2_ARENA_ALIGN;
+}
+
+struct COHPSK *cohpsk_create_arena(void *mem, size_t size)
+{
+    struct CODEC2_ARENA arena;
+    struct COHPSK *coh;
+
+    codec2_arena_begin(&arena, mem, size);
+    coh = cohpsk_create();
+    codec2_arena_end(&arena, coh);
+
+    return coh;
 }
 
 
@@ -326,7 +375,7 @@ void qpsk_symbols_to_bits(struct COHPSK *coh, float rx_bits[], COMP ct_symb_buf[
         for(r=0; r<NSYMROW; r++) {
             x1 = (float)(r+NPILOTSFRAME);
             yfit = cadd(fcmult(x1,m),b);
-            coh->phi_[r][c] = atan2(yfit.imag, yfit.real);
+            coh->phi_[r][c] = c2_atan2(yfit.imag, yfit.real);
         }
 
         /* amplitude estimation */
@@ -424,16 +473,14 @@ void qpsk_symbols_to_bits(struct COHPSK *coh, float rx_bits[], COMP ct_symb_buf[
 
 void tx_filter_and_upconvert_coh(COMP tx_fdm[], int Nc, COMP tx_symbols[],
                                  COMP tx_filter_memory[COHPSK_NC*ND][COHPSK_NSYM],
-                                 COMP phase_tx[], COMP freq[],
-                                 COMP *fbb_phase, COMP fbb_rect)
+                                 struct NCO phase_tx[], struct NCO *fbb_phase)
 {
     int     c;
     int     i,j,k;
     float   acc;
     COMP    gain;
-    COMP    tx_baseband;
+    COMP    tx_baseband[COHPSK_M];
     COMP  two = {2.0, 0.0};
-    float mag;
 
     gain.real = sqrtf(2.0)/2.0;
     gain.imag = 0.0;
@@ -461,31 +508,25 @@ void tx_filter_and_upconvert_coh(COMP tx_fdm[], int Nc, COMP tx_symbols[],
 	    acc = 0.0;
 	    for(j=0,k=COHPSK_M-i-1; j<COHPSK_NSYM; j++,k+=COHPSK_M)
 		acc += COHPSK_M * tx_filter_memory[c][j].real * gt_alpha5_root_coh[k];
-	    tx_baseband.real = acc;
+	    tx_baseband[i].real = acc;
 
 	    /* filter imag sample of symbol for carrier c */
 
 	    acc = 0.0;
 	    for(j=0,k=COHPSK_M-i-1; j<COHPSK_NSYM; j++,k+=COHPSK_M)
 		acc += COHPSK_M * tx_filter_memory[c][j].imag * gt_alpha5_root_coh[k];
-	    tx_baseband.imag = acc;
-            //printf("%d %d %f %f\n", c, i, tx_baseband.real, tx_baseband.imag);
+	    tx_baseband[i].imag = acc;
+            //printf("%d %d %f %f\n", c, i, tx_baseband[i].real, tx_baseband[i].imag);
+	}
 
-            /* freq shift and sum */
+        /* freq shift and sum */
 
-	    phase_tx[c] = cmult(phase_tx[c], freq[c]);
-	    tx_fdm[i] = cadd(tx_fdm[i], cmult(tx_baseband, phase_tx[c]));
-            //printf("%d %d %f %f\n", c, i, phase_tx[c].real, phase_tx[c].imag);
-	}
-        //exit(0);
+        nco_mix_acc(&phase_tx[c], tx_fdm, tx_baseband, COHPSK_M);
     }
 
     /* shift whole thing up to carrier freq */
 
-    for (i=0; i<COHPSK_M; i++) {
-	*fbb_phase = cmult(*fbb_phase, fbb_rect);
-	tx_fdm[i] = cmult(tx_fdm[i], *fbb_phase);
-    }
+    nco_mix(fbb_phase, tx_fdm, tx_fdm, COHPSK_M);
 
     /*
       Scale such that total Carrier power C of real(tx_fdm) = Nc.  This
@@ -497,18 +538,6 @@ void tx_filter_and_upconvert_coh(COMP tx_fdm[], int Nc, COMP tx_symbols[],
     for (i=0; i<COHPSK_M; i++)
 	tx_fdm[i] = cmult(two, tx_fdm[i]);
 
-    /* normalise digital oscillators as the magnitude can drift over time */
-
-    for (c=0; c<Nc; c++) {
-        mag = cabsolute(phase_tx[c]);
-	phase_tx[c].real /= mag;
-	phase_tx[c].imag /= mag;
-    }
-
-    mag = cabsolute(*fbb_phase);
-    fbb_phase->real /= mag;
-    fbb_phase->imag /= mag;
-
     /* shift memory, inserting zeros at end */
 
     for(i=0; i<COHPSK_NSYM-1; i++)
@@ -688,7 +717,7 @@ void cohpsk_mod(struct COHPSK *coh, COMP tx_fdm[], int tx_bits[], int nbits)
         for(c=0; c<COHPSK_NC*ND; c++)
             tx_onesym[c] = fcmult(coh->carrier_ampl[c], tx_symb[r][c]);
         tx_filter_and_upconvert_coh(&tx_fdm[r*COHPSK_M], COHPSK_NC*ND , tx_onesym, fdmdv->tx_filter_memory,
-                                    fdmdv->phase_tx, fdmdv->freq, &fdmdv->fbb_phase_tx, fdmdv->fbb_rect);
+                                    fdmdv->phase_tx, &fdmdv->fbb_phase_tx);
     }
 }
 
@@ -732,10 +761,9 @@ void cohpsk_clip(COMP tx_fdm[])
 
 \*---------------------------------------------------------------------------*/
 
-void fdm_downconvert_coh(COMP rx_baseband[COHPSK_NC][COHPSK_M+COHPSK_M/P], int Nc, COMP rx_fdm[], COMP phase_rx[], COMP freq[], int nin)
+void fdm_downconvert_coh(COMP rx_baseband[COHPSK_NC][COHPSK_M+COHPSK_M/P], int Nc, COMP rx_fdm[], struct NCO phase_rx[], int nin)
 {
-    int   i,c;
-    float mag;
+    int   c;
 
     /* maximum number of input samples to demod */
 
@@ -744,18 +772,7 @@ void fdm_downconvert_coh(COMP rx_baseband[COHPSK_NC][COHPSK_M+COHPSK_M/P], int N
     /* downconvert */
 
     for (c=0; c<Nc; c++)
-	for (i=0; i<nin; i++) {
-	    phase_rx[c] = cmult(phase_rx[c], freq[c]);
-	    rx_baseband[c][i] = cmult(rx_fdm[i], cconj(phase_rx[c]));
-	}
-
-    /* normalise digital oscilators as the magnitude can drift over time */
-
-    for (c=0; c<Nc; c++) {
-        mag = cabsolute(phase_rx[c]);
-	phase_rx[c].real /= mag;
-	phase_rx[c].imag /= mag;
-    }
+	nco_mix_conj(&phase_rx[c], rx_baseband[c], rx_fdm, nin);
 }
 
 
@@ -807,6 +824,72 @@ void rx_filter_coh(COMP rx_filt[COHPSK_NC+1][P+1], int Nc, COMP rx_baseband[COHP
 }
 
 
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: downconvert_and_rx_filter_coh()
+  DATE CREATED: Oct 2026
+
+  fdm_downconvert_coh() then rx_filter_coh() in one pass, with bit
+  exact results.  The filter memory is kept in rx_hist[] with the
+  carriers interleaved, real then imag rows of COHPSK_RX_NCH per sample,
+  so the inner filter loop runs across carriers (and vectorises) while
+  each carrier is still summed in tap order.  The memory is shifted
+  once per call rather than once per output.  If rx_baseband is not
+  NULL the downconverted samples are copied there, for logging.
+
+  The carriers aren't evenly spaced (see cohpsk_create()), so unlike
+  fdmdv's channelize_and_rx_filter() there is no DFT bank to share.
+
+\*---------------------------------------------------------------------------*/
+
+void downconvert_and_rx_filter_coh(COMP rx_filt[COHPSK_NC*ND][P+1], int Nc, COMP rx_fdm[], float rx_hist[],
+                                   struct NCO phase_rx[], COMP rx_baseband[COHPSK_NC*ND][COHPSK_M+COHPSK_M/P],
+                                   int nin)
+{
+    int    c, i, j, k;
+    int    n = COHPSK_M/P;
+    float  acc_re[COHPSK_RX_NCH], acc_im[COHPSK_RX_NCH];
+    float *row;
+    COMP   bb[COHPSK_M+COHPSK_M/P];
+
+    assert(Nc == COHPSK_RX_NCH);
+    assert(nin <= (COHPSK_M+COHPSK_M/P));
+    assert((nin % n) == 0);
+
+    /* downconvert the new samples after the filter memory */
+
+    for(c=0; c<Nc; c++) {
+        nco_mix_conj(&phase_rx[c], bb, rx_fdm, nin);
+        row = &rx_hist[2*COHPSK_RX_NCH*(COHPSK_NFILTER-n)];
+        for(i=0; i<nin; i++, row+=2*COHPSK_RX_NCH) {
+            row[c] = bb[i].real;
+            row[COHPSK_RX_NCH+c] = bb[i].imag;
+        }
+        if (rx_baseband)
+            memcpy(rx_baseband[c], bb, sizeof(COMP)*nin);
+    }
+
+    for(i=0, j=0; i<nin; i+=n, j++) {
+        for(c=0; c<COHPSK_RX_NCH; c++) {
+            acc_re[c] = 0.0; acc_im[c] = 0.0;
+        }
+        row = &rx_hist[2*COHPSK_RX_NCH*i];
+        for(k=0; k<COHPSK_NFILTER; k++, row+=2*COHPSK_RX_NCH) {
+            for(c=0; c<COHPSK_RX_NCH; c++) {
+                acc_re[c] += gt_alpha5_root_coh[k]*row[c];
+                acc_im[c] += gt_alpha5_root_coh[k]*row[COHPSK_RX_NCH+c];
+            }
+        }
+        for(c=0; c<Nc; c++) {
+            rx_filt[c][j].real = acc_re[c];
+            rx_filt[c][j].imag = acc_im[c];
+        }
+    }
+
+    memmove(rx_hist, &rx_hist[2*COHPSK_RX_NCH*nin], 2*COHPSK_RX_NCH*(COHPSK_NFILTER-n)*sizeof(float));
+}
+
+
 /*---------------------------------------------------------------------------*\
 
   FUNCTION....: fdmdv_freq_shift_coh()
@@ -814,29 +897,26 @@ void rx_filter_coh(COMP rx_filt[COHPSK_NC+1][P+1], int Nc, COMP rx_baseband[COHP
   DATE CREATED: May 2015
 
   Frequency shift modem signal.  The use of complex input and output allows
-  single sided frequency shifting (no images).
+  single sided frequency shifting (no images).  fdmdv_freq_shift_coh_nco()
+  is the same shift on an NCO phase accumulator.
 
 \*---------------------------------------------------------------------------*/
 
 void fdmdv_freq_shift_coh(COMP rx_fdm_fcorr[], COMP rx_fdm[], float foff, float Fs,
                           COMP *foff_phase_rect, int nin)
 {
-    COMP  foff_rect;
-    float mag;
-    int   i;
-
-    foff_rect.real = cosf(2.0*PI*foff/Fs);
-    foff_rect.imag = sinf(2.0*PI*foff/Fs);
-    for(i=0; i<nin; i++) {
-	*foff_phase_rect = cmult(*foff_phase_rect, foff_rect);
-	rx_fdm_fcorr[i] = cmult(rx_fdm[i], *foff_phase_rect);
-    }
+    struct NCO nco;
 
-    /* normalise digital oscilator as the magnitude can drfift over time */
+    nco_init(&nco, 2.0*PI*foff/Fs, atan2f(foff_phase_rect->imag, foff_phase_rect->real));
+    nco_mix(&nco, rx_fdm_fcorr, rx_fdm, nin);
+    *foff_phase_rect = nco_phasor(nco.phase);
+}
 
-    mag = cabsolute(*foff_phase_rect);
-    foff_phase_rect->real /= mag;
-    foff_phase_rect->imag /= mag;
+void fdmdv_freq_shift_coh_nco(COMP rx_fdm_fcorr[], COMP rx_fdm[], float foff, float Fs,
+                              struct NCO *foff_phase, int nin)
+{
+    nco_set_freq(foff_phase, 2.0*PI*foff/Fs);
+    nco_mix(foff_phase, rx_fdm_fcorr, rx_fdm, nin);
 }
 
 
@@ -856,10 +936,15 @@ void rate_Fs_rx_processing(struct COHPSK *coh, COMP ch_symb[][COHPSK_NC*ND], COM
     rx_timing = 0;
 
     for (r=0; r<nsymb; r++) {
-        fdmdv_freq_shift_coh(rx_fdm_frame_bb, &ch_fdm_frame[ch_fdm_frame_index], -(*f_est), COHPSK_FS, &fdmdv->fbb_phase_rx, nin);
+        fdmdv_freq_shift_coh_nco(rx_fdm_frame_bb, &ch_fdm_frame[ch_fdm_frame_index], -(*f_est), COHPSK_FS, &fdmdv->fbb_phase_rx, nin);
         ch_fdm_frame_index += nin;
-        fdm_downconvert_coh(rx_baseband, COHPSK_NC*ND, rx_fdm_frame_bb, fdmdv->phase_rx, fdmdv->freq, nin);
-        rx_filter_coh(rx_filt, COHPSK_NC*ND, rx_baseband, coh->rx_filter_memory, nin);
+        if (coh->rx_hist) {
+            downconvert_and_rx_filter_coh(rx_filt, COHPSK_NC*ND, rx_fdm_frame_bb, coh->rx_hist, fdmdv->phase_rx,
+                                          coh->rx_baseband_log ? rx_baseband : NULL, nin);
+        } else {
+            fdm_downconvert_coh(rx_baseband, COHPSK_NC*ND, rx_fdm_frame_bb, fdmdv->phase_rx, nin);
+            rx_filter_coh(rx_filt, COHPSK_NC*ND, rx_baseband, coh->rx_filter_memory, nin);
+        }
         rx_timing = rx_est_timing(rx_onesym, fdmdv->Nc, rx_filt, fdmdv->rx_filter_mem_timing, env, nin, COHPSK_M);
 
         for(c=0; c<COHPSK_NC*ND; c++) {
@@ -899,7 +984,7 @@ void rate_Fs_rx_processing(struct COHPSK *coh, COMP ch_symb[][COHPSK_NC*ND], COM
             /* loop filter made up of 1st order IIR plus integrator.  Integerator
                was found to be reqd  */
 
-            fdmdv->foff_filt = (1.0-beta)*fdmdv->foff_filt + beta*atan2(mod_strip.imag, mod_strip.real);
+            fdmdv->foff_filt = (1.0-beta)*fdmdv->foff_filt + beta*c2_atan2(mod_strip.imag, mod_strip.real);
             //printf("foff_filt: %f angle: %f\n", fdmdv->foff_filt, atan2(mod_strip.imag, mod_strip.real));
             *f_est += g*fdmdv->foff_filt;
         }
@@ -1038,7 +1123,7 @@ void cohpsk_demod(struct COHPSK *coh, float rx_bits[], int *sync_good, COMP rx_f
             */
              frame_sync_fine_freq_est(coh, &ch_symb[(NSW-1)*NSYMROWPILOT], sync, &next_sync);
 
-            if (fabs(coh->f_fine_est) > 2.0) {
+            if (c2_fabs(coh->f_fine_est) > 2.0) {
                 if (coh->verbose)
                     fprintf(stderr, "  [%d] Hmm %f is a bit big :(\n", coh->frame, coh->f_fine_est);
                 next_sync = 0;
@@ -1111,18 +1196,22 @@ void cohpsk_demod(struct COHPSK *coh, float rx_bits[], int *sync_good, COMP rx_f
 
 int cohpsk_fs_offset(COMP out[], COMP in[], int n, float sample_rate_ppm)
 {
-    double tin, f;
+    float tin, f, step;
     int   tout, t1, t2;
 
-    tin = 0.0; tout = 0;
+    /* tin from tout each sample rather than summing steps, so a float
+       doesn't drift over long buffers */
+
+    step = 1.0f + sample_rate_ppm*1E-6f;
+    tin = 0.0f; tout = 0;
     while (tin < n) {
-      t1 = floor(tin);
-      t2 = ceil(tin);
+      t1 = floorf(tin);
+      t2 = ceilf(tin);
       f = tin - t1;
-      out[tout].real = (1.0-f)*in[t1].real + f*in[t2].real;
-      out[tout].imag = (1.0-f)*in[t1].imag + f*in[t2].imag;
+      out[tout].real = (1.0f-f)*in[t1].real + f*in[t2].real;
+      out[tout].imag = (1.0f-f)*in[t1].imag + f*in[t2].imag;
       tout += 1;
-      tin  += 1.0 + sample_rate_ppm/1E6;
+      tin   = tout*step;
       //printf("tin: %f tout: %d f: %f\n", tin, tout, f);
     }
 
@@ -1151,7 +1240,7 @@ void cohpsk_get_demod_stats(struct COHPSK *coh, struct MODEM_STATS *stats)
 
     stats->Nc = COHPSK_NC*ND;
     assert(stats->Nc <= MODEM_STATS_NC_MAX);
-    new_snr_est = 20*log10((coh->sig_rms+1E-6)/(coh->noise_rms+1E-6)) - 10*log10(3000.0/700.0);
+    new_snr_est = 20*c2_log10((coh->sig_rms+1E-6)/(coh->noise_rms+1E-6)) - 10*c2_log10(3000.0/700.0);
     stats->snr_est = 0.9*stats->snr_est + 0.1*new_snr_est;
 
     //fprintf(stderr, "sig_rms: %f noise_rms: %f snr_est: %f\n", coh->sig_rms, coh->noise_rms, stats->snr_est);
@@ -1177,6 +1266,50 @@ void cohpsk_set_verbose(struct COHPSK *coh, int verbose)
 }
 
 
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: cohpsk_set_channelizer()
+  DATE CREATED: Oct 2026
+
+  Selects downconvert_and_rx_filter_coh() in place of the separate
+  downconvert and rx filter in the demodulator, same results but
+  faster.  Allocates (or frees) its filter memory, moving the current
+  memory across, so can be called between frames.  Returns 1 if it is
+  in use, 0 if disabled or out of memory.
+
+\*---------------------------------------------------------------------------*/
+
+int cohpsk_set_channelizer(struct COHPSK *coh, int enable)
+{
+    int c, k;
+
+    assert(coh != NULL);
+
+    if (enable && (coh->rx_hist == NULL)) {
+        coh->rx_hist = (float*)codec2_malloc(2*COHPSK_RX_NCH*(COHPSK_NFILTER+COHPSK_M)*sizeof(float));
+        if (coh->rx_hist == NULL)
+            return 0;
+        for(k=0; k<COHPSK_NFILTER; k++)
+            for(c=0; c<COHPSK_RX_NCH; c++) {
+                coh->rx_hist[2*COHPSK_RX_NCH*k + c] = coh->rx_filter_memory[c][k].real;
+                coh->rx_hist[2*COHPSK_RX_NCH*k + COHPSK_RX_NCH + c] = coh->rx_filter_memory[c][k].imag;
+            }
+    }
+
+    if (!enable && coh->rx_hist) {
+        for(k=0; k<COHPSK_NFILTER; k++)
+            for(c=0; c<COHPSK_RX_NCH; c++) {
+                coh->rx_filter_memory[c][k].real = coh->rx_hist[2*COHPSK_RX_NCH*k + c];
+                coh->rx_filter_memory[c][k].imag = coh->rx_hist[2*COHPSK_RX_NCH*k + COHPSK_RX_NCH + c];
+            }
+        codec2_free(coh->rx_hist);
+        coh->rx_hist = NULL;
+    }
+
+    return coh->rx_hist != NULL;
+}
+
+
 void cohpsk_set_frame(struct COHPSK *coh, int frame)
 {
     assert(coh != NULL);
@@ -1301,3 +1434,87 @@ void cohpsk_set_carrier_ampl(struct COHPSK *coh, int c, float ampl) {
     fprintf(stderr, "cohpsk_set_carrier_ampl: %d %f\n", c, ampl);
 }
 
+
+#ifdef COHPSK_CHANNELIZER_UNITTEST
+#include <time.h>
+
+/*
+  Both paths mix with the same NCOs and sum each carrier's filter in tap
+  order, so they should agree to the last bit.  The bound leaves room
+  for a compiler contracting the two sums differently.
+*/
+
+#define CHAN_FRAMES   3000
+#define CHAN_TOL      1.25E-6
+
+static double chan_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1E6 + t.tv_nsec/1E3;
+}
+
+int main(void) {
+    struct COHPSK *ref, *chan;
+    COMP   rx_fdm[COHPSK_M+COHPSK_M/P];
+    COMP   rx_baseband_ref[COHPSK_NC*ND][COHPSK_M+COHPSK_M/P], rx_baseband_chan[COHPSK_NC*ND][COHPSK_M+COHPSK_M/P];
+    COMP   rx_filt_ref[COHPSK_NC*ND][P+1], rx_filt_chan[COHPSK_NC*ND][P+1];
+    int    f, i, c, k, nin;
+    float  err, max_err = 0.0;
+    double t0, us_ref = 0.0, us_chan = 0.0;
+
+    ref = cohpsk_create();
+    chan = cohpsk_create();
+    assert((ref != NULL) && (chan != NULL));
+    if (!cohpsk_set_channelizer(chan, 1)) {
+        printf("Bad! out of memory\n");
+        exit(1);
+    }
+
+    for(f=0; f<CHAN_FRAMES; f++) {
+        nin = COHPSK_M + (rand()%3 - 1)*COHPSK_M/P;
+        for(i=0; i<nin; i++) {
+            rx_fdm[i].real = (float)rand()/RAND_MAX - 0.5;
+            rx_fdm[i].imag = (float)rand()/RAND_MAX - 0.5;
+        }
+
+        t0 = chan_us();
+        fdm_downconvert_coh(rx_baseband_ref, COHPSK_NC*ND, rx_fdm, ref->fdmdv->phase_rx, nin);
+        rx_filter_coh(rx_filt_ref, COHPSK_NC*ND, rx_baseband_ref, ref->rx_filter_memory, nin);
+        us_ref += chan_us() - t0;
+
+        t0 = chan_us();
+        downconvert_and_rx_filter_coh(rx_filt_chan, COHPSK_NC*ND, rx_fdm, chan->rx_hist, chan->fdmdv->phase_rx,
+                                      rx_baseband_chan, nin);
+        us_chan += chan_us() - t0;
+
+        for(c=0; c<COHPSK_NC*ND; c++) {
+            for(k=0; k<nin/(COHPSK_M/P); k++) {
+                err = cabsolute(cadd(rx_filt_chan[c][k], fcmult(-1.0, rx_filt_ref[c][k])));
+                if (err > max_err)
+                    max_err = err;
+            }
+            for(i=0; i<nin; i++) {
+                err = cabsolute(cadd(rx_baseband_chan[c][i], fcmult(-1.0, rx_baseband_ref[c][i])));
+                if (err > max_err)
+                    max_err = err;
+            }
+        }
+    }
+
+    cohpsk_destroy(ref);
+    cohpsk_destroy(chan);
+
+    printf("%d frames: max error %e\n", CHAN_FRAMES, max_err);
+    printf("fdm_downconvert_coh + rx_filter_coh: %6.2f us/frame downconvert_and_rx_filter_coh: %6.2f us/frame\n",
+           us_ref/CHAN_FRAMES, us_chan/CHAN_FRAMES);
+
+    if (max_err > CHAN_TOL) {
+        printf("Bad!\n");
+        exit(1);
+    }
+
+    printf("Everything checks out\n");
+    return 0;
+}
+
+#endif
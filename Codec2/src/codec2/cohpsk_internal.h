@@ -36,6 +36,7 @@
 #define COHPSK_M          100                         /* oversampling rate */
 #define COHPSK_NSYM       6
 #define COHPSK_NFILTER    (COHPSK_NSYM*COHPSK_M)
+#define COHPSK_RX_NCH     (COHPSK_NC*COHPSK_ND)       /* carriers in rx_hist rows */
 #define COHPSK_EXCESS_BW  0.5                         /* excess BW factor of root nyq filter */
 #define COHPSK_NT         5                           /* number of symbols we estimate timing over */
 #define COHPSK_CLIP       6.5                         /* hard clipping for Nc*Nc=14 to reduce PAPR */
@@ -51,6 +52,7 @@ struct COHPSK {
     COMP         rx_symb[NSYMROWPILOT][COHPSK_NC*ND];   /* demodulated symbols                                   */
     float        f_est;
     COMP         rx_filter_memory[COHPSK_NC*ND][COHPSK_NFILTER];
+    float       *rx_hist;           /* downconvert_and_rx_filter_coh() memory, or NULL */
     COMP         ct_symb_buf[NCT_SYMB_BUF][COHPSK_NC*ND];
     int          ct;                                    /* coarse timing offset in symbols                       */
     float        rx_timing;                             /* fine timing for last symbol in frame                  */
@@ -112,10 +114,12 @@ void bits_to_qpsk_symbols(COMP tx_symb[][COHPSK_NC*COHPSK_ND], int tx_bits[], in
 void qpsk_symbols_to_bits(struct COHPSK *coh, float rx_bits[], COMP ct_symb_buf[][COHPSK_NC*COHPSK_ND]);
 void tx_filter_and_upconvert_coh(COMP tx_fdm[], int Nc, COMP tx_symbols[],
                                  COMP tx_filter_memory[COHPSK_NC][COHPSK_NSYM],
-                                 COMP phase_tx[], COMP freq[],
-                                 COMP *fbb_phase, COMP fbb_rect);
-void fdm_downconvert_coh(COMP rx_baseband[COHPSK_NC][COHPSK_M+COHPSK_M/P], int Nc, COMP rx_fdm[], COMP phase_rx[], COMP freq[], int nin);
+                                 struct NCO phase_tx[], struct NCO *fbb_phase);
+void fdm_downconvert_coh(COMP rx_baseband[COHPSK_NC][COHPSK_M+COHPSK_M/P], int Nc, COMP rx_fdm[], struct NCO phase_rx[], int nin);
 void rx_filter_coh(COMP rx_filt[COHPSK_NC+1][P+1], int Nc, COMP rx_baseband[COHPSK_NC+1][COHPSK_M+COHPSK_M/P], COMP rx_filter_memory[COHPSK_NC+1][COHPSK_NFILTER], int nin);
+void downconvert_and_rx_filter_coh(COMP rx_filt[COHPSK_NC*COHPSK_ND][P+1], int Nc, COMP rx_fdm[], float rx_hist[],
+                                   struct NCO phase_rx[], COMP rx_baseband[COHPSK_NC*COHPSK_ND][COHPSK_M+COHPSK_M/P],
+                                   int nin);
 void frame_sync_fine_freq_est(struct COHPSK *coh, COMP ch_symb[][COHPSK_NC*COHPSK_ND], int sync, int *next_sync);
 void fine_freq_correct(struct COHPSK *coh, int sync, int next_sync);
 int sync_state_machine(struct COHPSK *coh, int sync, int next_sync);
@@ -6,6 +6,13 @@
 
   Functions that implement the FDMDV modem.
 
+  To check channelize_and_rx_filter() against down_convert_and_rx_filter()
+  on the same input, and time both:
+
+     src$ gcc -O2 -DFDMDV_CHANNELIZER_UNITTEST -Icodec2 codec2/fdmdv.c codec2/nco.c \
+              codec2/codec2_fft.c codec2/kiss_fft.c codec2/kiss_fftr.c codec2/codec2_arena.c \
+              -o fdmdv_chan -lm && ./fdmdv_chan
+
 \*---------------------------------------------------------------------------*/
 
 /*
@@ -44,6 +51,7 @@
 #endif
 
 
+#include "codec2_math.h"
 #include "fdmdv_internal.h"
 #include "codec2_fdmdv.h"
 #include "comp_prim.h"
@@ -55,6 +63,7 @@
 #include "hanning.h"
 #include "os.h"
 #include "machdep.h"
+#include "codec2_arena.h"
 
 static int sync_uw[] = {1,-1,1,-1,1,-1};
 #ifdef __EMBEDDED__
@@ -94,15 +103,17 @@ struct FDMDV * fdmdv_create(int Nc)
     assert(FDMDV_NOM_SAMPLES_PER_FRAME == M_FAC);
     assert(FDMDV_MAX_SAMPLES_PER_FRAME == (M_FAC+M_FAC/P));
 
-    f = (struct FDMDV*)malloc(sizeof(struct FDMDV));
+    f = (struct FDMDV*)codec2_malloc(sizeof(struct FDMDV));
     if (f == NULL)
 	return NULL;
 
     f->Nc = Nc;
+    f->chan_nfft = 0;
+    f->chan_fft_cfg = NULL;
 
     f->ntest_bits = Nc*NB*4;
     f->current_test_bit = 0;
-    f->rx_test_bits_mem = (int*)malloc(sizeof(int)*f->ntest_bits);
+    f->rx_test_bits_mem = (int*)codec2_malloc(sizeof(int)*f->ntest_bits);
     assert(f->rx_test_bits_mem != NULL);
     for(i=0; i<f->ntest_bits; i++)
 	f->rx_test_bits_mem[i] = 0;
@@ -127,11 +138,8 @@ struct FDMDV * fdmdv_create(int Nc)
            This helped PAPR for a few dB.  We don't need to adjust rx
            phase as DQPSK takes care of that. */
 
-	f->phase_tx[c].real = COSF(2.0*PI*c/(Nc+1));
- 	f->phase_tx[c].imag = SINF(2.0*PI*c/(Nc+1));
-
-	f->phase_rx[c].real = 1.0;
- 	f->phase_rx[c].imag = 0.0;
+	nco_init(&f->phase_tx[c], 0.0, 2.0*PI*c/(Nc+1));
+	nco_init(&f->phase_rx[c], 0.0, 0.0);
 
 	for(k=0; k<NT*P; k++) {
 	    f->rx_filter_mem_timing[c][k].real = 0.0;
@@ -144,14 +152,12 @@ struct FDMDV * fdmdv_create(int Nc)
     f->freq[Nc].real = COSF(2.0*PI*0.0/FS);
     f->freq[Nc].imag = SINF(2.0*PI*0.0/FS);
     f->freq_pol[Nc]  = 2.0*PI*0.0/FS;
+    nco_set_freq(&f->phase_tx[Nc], f->freq_pol[Nc]);
+    nco_set_freq(&f->phase_rx[Nc], f->freq_pol[Nc]);
 
-    f->fbb_rect.real     = COSF(2.0*PI*FDMDV_FCENTRE/FS);
-    f->fbb_rect.imag     = SINF(2.0*PI*FDMDV_FCENTRE/FS);
     f->fbb_pol           = 2.0*PI*FDMDV_FCENTRE/FS;
-    f->fbb_phase_tx.real = 1.0;
-    f->fbb_phase_tx.imag = 0.0;
-    f->fbb_phase_rx.real = 1.0;
-    f->fbb_phase_rx.imag = 0.0;
+    nco_init(&f->fbb_phase_tx, f->fbb_pol, 0.0);
+    nco_init(&f->fbb_phase_rx, 0.0, 0.0);
 
     /* Generate DBPSK pilot Look Up Table (LUT) */
 
@@ -180,8 +186,7 @@ struct FDMDV * fdmdv_create(int Nc)
     }
 
     f->foff = 0.0;
-    f->foff_phase_rect.real = 1.0;
-    f->foff_phase_rect.imag = 0.0;
+    nco_init(&f->foff_phase, 0.0, 0.0);
 
     for(i=0; i<NFILTER+M_FAC; i++) {
         f->rx_fdm_mem[i].real = 0.0;
@@ -219,8 +224,49 @@ void fdmdv_destroy(struct FDMDV *fdmdv)
 {
     assert(fdmdv != NULL);
     codec2_fft_free(fdmdv->fft_pilot_cfg);
-    free(fdmdv->rx_test_bits_mem);
-    free(fdmdv);
+    if (fdmdv->chan_fft_cfg != NULL)
+        KISS_FFT_FREE(fdmdv->chan_fft_cfg);
+    codec2_free(fdmdv->rx_test_bits_mem);
+    codec2_free(fdmdv);
+}
+
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: fdmdv_size / fdmdv_create_arena
+  DATE CREATED: Oct 2026
+
+  As fdmdv_create(), but the modem states are placed in the size bytes at
+  mem, at least fdmdv_size() long, with no heap use.  fdmdv_destroy()
+  releases mem for reuse.
+
+\*---------------------------------------------------------------------------*/
+
+size_t fdmdv_size(int Nc)
+{
+    struct CODEC2_ARENA arena;
+    struct FDMDV *f;
+
+    codec2_arena_begin(&arena, NULL, 0);
+    f = fdmdv_create(Nc);
+    codec2_arena_end(&arena, f);
+    if (f == NULL)
+	return 0;
+    fdmdv_destroy(f);
+
+    return arena.used + CODEC2_ARENA_ALIGN;
+}
+
+struct FDMDV *fdmdv_create_arena(int Nc, void *mem, size_t size)
+{
+    struct CODEC2_ARENA arena;
+    struct FDMDV *f;
+
+    codec2_arena_begin(&arena, mem, size);
+    f = fdmdv_create(Nc);
+    codec2_arena_end(&arena, f);
+
+    return f;
 }
 
 
@@ -277,6 +323,8 @@ void fdmdv_set_fsep(struct FDMDV *f, float fsep) {
 	f->freq[c].real = COSF(2.0*PI*carrier_freq/FS);
  	f->freq[c].imag = SINF(2.0*PI*carrier_freq/FS);
  	f->freq_pol[c]  = 2.0*PI*carrier_freq/FS;
+	nco_set_freq(&f->phase_tx[c], f->freq_pol[c]);
+	nco_set_freq(&f->phase_rx[c], f->freq_pol[c]);
     }
 
     for(c=f->Nc/2; c<f->Nc; c++) {
@@ -284,7 +332,68 @@ void fdmdv_set_fsep(struct FDMDV *f, float fsep) {
 	f->freq[c].real = COSF(2.0*PI*carrier_freq/FS);
  	f->freq[c].imag = SINF(2.0*PI*carrier_freq/FS);
  	f->freq_pol[c]  = 2.0*PI*carrier_freq/FS;
+	nco_set_freq(&f->phase_tx[c], f->freq_pol[c]);
+	nco_set_freq(&f->phase_rx[c], f->freq_pol[c]);
     }
+
+    /* the channelizer's DFT size depends on the carrier spacing */
+
+    if (f->chan_nfft)
+        fdmdv_set_channelizer(f, 1);
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: fdmdv_set_channelizer()
+  DATE CREATED: Oct 2026
+
+  Selects the FFT channelizer, channelize_and_rx_filter(), in place of
+  down_convert_and_rx_filter() in the demodulator.  It needs every
+  carrier on a bin of some DFT of at most NFILTER/(M_FAC/Q) points, as
+  with the default 75 Hz spacing (80 points).  Returns 1 if it is in
+  use, 0 if disabled or the carriers don't fit.  Allocates the FFT, so
+  call it at start up.
+
+\*---------------------------------------------------------------------------*/
+
+int fdmdv_set_channelizer(struct FDMDV *f, int enable)
+{
+    int   c, n, dec_rate = M_FAC/Q;
+    float bin;
+
+    if (f->chan_fft_cfg != NULL)
+        KISS_FFT_FREE(f->chan_fft_cfg);
+    f->chan_fft_cfg = NULL;
+    f->chan_nfft = 0;
+
+    if (!enable)
+        return 0;
+
+    /* smallest DFT that has a bin on every carrier at the decimated rate */
+
+    for(n=1; n<=NFILTER/dec_rate; n++) {
+        for(c=0; c<f->Nc+1; c++) {
+            bin = f->freq_pol[c]*dec_rate*n/(2.0*PI);
+            if (fabsf(bin - roundf(bin)) > 1E-3)
+                break;
+        }
+        if (c == f->Nc+1)
+            break;
+    }
+    if (n > NFILTER/dec_rate)
+        return 0;
+
+    f->chan_fft_cfg = kiss_fft_alloc(n, 0, NULL, NULL);
+    if (f->chan_fft_cfg == NULL)
+        return 0;
+    f->chan_nfft = n;
+
+    for(c=0; c<f->Nc+1; c++) {
+        bin = roundf(f->freq_pol[c]*dec_rate*n/(2.0*PI));
+        f->chan_bin[c] = ((int)bin % n + n) % n;
+    }
+
+    return 1;
 }
 
 
@@ -419,16 +528,14 @@ void tx_filter(COMP tx_baseband[NC+1][M_FAC], int Nc, COMP tx_symbols[], COMP tx
 
 void tx_filter_and_upconvert(COMP tx_fdm[], int Nc, COMP tx_symbols[],
                              COMP tx_filter_memory[NC+1][NSYM],
-                             COMP phase_tx[], COMP freq[],
-                             COMP *fbb_phase, COMP fbb_rect)
+                             struct NCO phase_tx[], struct NCO *fbb_phase)
 {
     int     c;
     int     i,j,k;
     float   acc;
     COMP    gain;
-    COMP    tx_baseband;
+    COMP    tx_baseband[M_FAC];
     COMP  two = {2.0, 0.0};
-    float mag;
 
     gain.real = sqrtf(2.0)/2.0;
     gain.imag = 0.0;
@@ -456,28 +563,24 @@ void tx_filter_and_upconvert(COMP tx_fdm[], int Nc, COMP tx_symbols[],
 	    acc = 0.0;
 	    for(j=0,k=M_FAC-i-1; j<NSYM; j++,k+=M_FAC)
 		acc += M_FAC * tx_filter_memory[c][j].real * gt_alpha5_root[k];
-	    tx_baseband.real = acc;
+	    tx_baseband[i].real = acc;
 
 	    /* filter imag sample of symbol for carrier c */
 
 	    acc = 0.0;
 	    for(j=0,k=M_FAC-i-1; j<NSYM; j++,k+=M_FAC)
 		acc += M_FAC * tx_filter_memory[c][j].imag * gt_alpha5_root[k];
-	    tx_baseband.imag = acc;
+	    tx_baseband[i].imag = acc;
+	}
 
-            /* freq shift and sum */
+        /* freq shift and sum */
 
-	    phase_tx[c] = cmult(phase_tx[c], freq[c]);
-	    tx_fdm[i] = cadd(tx_fdm[i], cmult(tx_baseband, phase_tx[c]));
-	}
+        nco_mix_acc(&phase_tx[c], tx_fdm, tx_baseband, M_FAC);
     }
 
     /* shift whole thing up to carrier freq */
 
-    for (i=0; i<M_FAC; i++) {
-	*fbb_phase = cmult(*fbb_phase, fbb_rect);
-	tx_fdm[i] = cmult(tx_fdm[i], *fbb_phase);
-    }
+    nco_mix(fbb_phase, tx_fdm, tx_fdm, M_FAC);
 
     /*
       Scale such that total Carrier power C of real(tx_fdm) = Nc.  This
@@ -489,18 +592,6 @@ void tx_filter_and_upconvert(COMP tx_fdm[], int Nc, COMP tx_symbols[],
     for (i=0; i<M_FAC; i++)
 	tx_fdm[i] = cmult(two, tx_fdm[i]);
 
-    /* normalise digital oscillators as the magnitude can drift over time */
-
-    for (c=0; c<Nc+1; c++) {
-        mag = cabsolute(phase_tx[c]);
-	phase_tx[c].real /= mag;
-	phase_tx[c].imag /= mag;
-    }
-
-    mag = cabsolute(*fbb_phase);
-    fbb_phase->real /= mag;
-    fbb_phase->imag /= mag;
-
     /* shift memory, inserting zeros at end */
 
     for(i=0; i<NSYM-1; i++)
@@ -526,12 +617,11 @@ void tx_filter_and_upconvert(COMP tx_fdm[], int Nc, COMP tx_symbols[],
 
 \*---------------------------------------------------------------------------*/
 
-void fdm_upconvert(COMP tx_fdm[], int Nc, COMP tx_baseband[NC+1][M_FAC], COMP phase_tx[], COMP freq[],
-                   COMP *fbb_phase, COMP fbb_rect)
+void fdm_upconvert(COMP tx_fdm[], int Nc, COMP tx_baseband[NC+1][M_FAC], struct NCO phase_tx[],
+                   struct NCO *fbb_phase)
 {
     int   i,c;
     COMP  two = {2.0, 0.0};
-    float mag;
 
     for(i=0; i<M_FAC; i++) {
 	tx_fdm[i].real = 0.0;
@@ -539,17 +629,11 @@ void fdm_upconvert(COMP tx_fdm[], int Nc, COMP tx_baseband[NC+1][M_FAC], COMP ph
     }
 
     for (c=0; c<=Nc; c++)
-	for (i=0; i<M_FAC; i++) {
-	    phase_tx[c] = cmult(phase_tx[c], freq[c]);
-	    tx_fdm[i] = cadd(tx_fdm[i], cmult(tx_baseband[c][i], phase_tx[c]));
-	}
+	nco_mix_acc(&phase_tx[c], tx_fdm, tx_baseband[c], M_FAC);
 
     /* shift whole thing up to carrier freq */
 
-    for (i=0; i<M_FAC; i++) {
-	*fbb_phase = cmult(*fbb_phase, fbb_rect);
-	tx_fdm[i] = cmult(tx_fdm[i], *fbb_phase);
-    }
+    nco_mix(fbb_phase, tx_fdm, tx_fdm, M_FAC);
 
     /*
       Scale such that total Carrier power C of real(tx_fdm) = Nc.  This
@@ -560,18 +644,6 @@ void fdm_upconvert(COMP tx_fdm[], int Nc, COMP tx_baseband[NC+1][M_FAC], COMP ph
 
     for (i=0; i<M_FAC; i++)
 	tx_fdm[i] = cmult(two, tx_fdm[i]);
-
-    /* normalise digital oscilators as the magnitude can drift over time */
-
-    for (c=0; c<Nc+1; c++) {
-        mag = cabsolute(phase_tx[c]);
-	phase_tx[c].real /= mag;
-	phase_tx[c].imag /= mag;
-    }
-
-    mag = cabsolute(*fbb_phase);
-    fbb_phase->real /= mag;
-    fbb_phase->imag /= mag;
 }
 
 /*---------------------------------------------------------------------------*\
@@ -602,7 +674,7 @@ void fdmdv_mod(struct FDMDV *fdmdv, COMP tx_fdm[], int tx_bits[], int *sync_bit)
     memcpy(fdmdv->prev_tx_symbols, tx_symbols, sizeof(COMP)*(fdmdv->Nc+1));
     PROFILE_SAMPLE_AND_LOG(tx_filter_and_upconvert_start, mod_start, "    bits_to_dqpsk_symbols");
     tx_filter_and_upconvert(tx_fdm, fdmdv->Nc, tx_symbols, fdmdv->tx_filter_memory,
-                            fdmdv->phase_tx, fdmdv->freq, &fdmdv->fbb_phase_tx, fdmdv->fbb_rect);
+                            fdmdv->phase_tx, &fdmdv->fbb_phase_tx);
     PROFILE_SAMPLE_AND_LOG2(tx_filter_and_upconvert_start, "    tx_filter_and_upconvert");
 
     *sync_bit = fdmdv->tx_pilot_bit;
@@ -882,29 +954,27 @@ float rx_est_freq_offset(struct FDMDV *f, COMP rx_fdm[], int nin, int do_fft)
   DATE CREATED: 26/4/2012
 
   Frequency shift modem signal.  The use of complex input and output allows
-  single sided frequency shifting (no images).
+  single sided frequency shifting (no images).  The oscillator state is a
+  unit magnitude phasor, kept for existing callers, fdmdv_freq_shift_nco()
+  is the same shift on an NCO phase accumulator.
 
 \*---------------------------------------------------------------------------*/
 
 void fdmdv_freq_shift(COMP rx_fdm_fcorr[], COMP rx_fdm[], float foff,
                       COMP *foff_phase_rect, int nin)
 {
-    COMP  foff_rect;
-    float mag;
-    int   i;
+    struct NCO nco;
 
-    foff_rect.real = COSF(2.0*PI*foff/FS);
-    foff_rect.imag = SINF(2.0*PI*foff/FS);
-    for(i=0; i<nin; i++) {
-	*foff_phase_rect = cmult(*foff_phase_rect, foff_rect);
-	rx_fdm_fcorr[i] = cmult(rx_fdm[i], *foff_phase_rect);
-    }
-
-    /* normalise digital oscilator as the magnitude can drfift over time */
+    nco_init(&nco, 2.0*PI*foff/FS, atan2f(foff_phase_rect->imag, foff_phase_rect->real));
+    nco_mix(&nco, rx_fdm_fcorr, rx_fdm, nin);
+    *foff_phase_rect = nco_phasor(nco.phase);
+}
 
-    mag = cabsolute(*foff_phase_rect);
-    foff_phase_rect->real /= mag;
-    foff_phase_rect->imag /= mag;
+void fdmdv_freq_shift_nco(COMP rx_fdm_fcorr[], COMP rx_fdm[], float foff,
+                          struct NCO *foff_phase, int nin)
+{
+    nco_set_freq(foff_phase, 2.0*PI*foff/FS);
+    nco_mix(foff_phase, rx_fdm_fcorr, rx_fdm, nin);
 }
 
 /*---------------------------------------------------------------------------*\
@@ -917,10 +987,9 @@ void fdmdv_freq_shift(COMP rx_fdm_fcorr[], COMP rx_fdm[], float foff,
 
 \*---------------------------------------------------------------------------*/
 
-void fdm_downconvert(COMP rx_baseband[NC+1][M_FAC+M_FAC/P], int Nc, COMP rx_fdm[], COMP phase_rx[], COMP freq[], int nin)
+void fdm_downconvert(COMP rx_baseband[NC+1][M_FAC+M_FAC/P], int Nc, COMP rx_fdm[], struct NCO phase_rx[], int nin)
 {
-    int   i,c;
-    float mag;
+    int   c;
 
     /* maximum number of input samples to demod */
 
@@ -929,18 +998,7 @@ void fdm_downconvert(COMP rx_baseband[NC+1][M_FAC+M_FAC/P], int Nc, COMP rx_fdm[
     /* downconvert */
 
     for (c=0; c<Nc+1; c++)
-	for (i=0; i<nin; i++) {
-	    phase_rx[c] = cmult(phase_rx[c], freq[c]);
-	    rx_baseband[c][i] = cmult(rx_fdm[i], cconj(phase_rx[c]));
-	}
-
-    /* normalise digital oscilators as the magnitude can drift over time */
-
-    for (c=0; c<Nc+1; c++) {
-        mag = cabsolute(phase_rx[c]);
-	phase_rx[c].real /= mag;
-	phase_rx[c].imag /= mag;
-    }
+	nco_mix_conj(&phase_rx[c], rx_baseband[c], rx_fdm, nin);
 }
 
 /*---------------------------------------------------------------------------*\
@@ -1133,19 +1191,15 @@ static void fir_filter2(float acc[2], float mem[], const float coeff[], const un
 
 \*---------------------------------------------------------------------------*/
 
-/*
-   TODO: [ ] windback phase calculated once at init time
-*/
-
 void down_convert_and_rx_filter(COMP rx_filt[NC+1][P+1], int Nc, COMP rx_fdm[],
-                                COMP rx_fdm_mem[], COMP phase_rx[], COMP freq[],
-                                float freq_pol[], int nin, int dec_rate)
+                                COMP rx_fdm_mem[], struct NCO phase_rx[], int nin, int dec_rate)
 {
-    int i,k,c,st,Nval;
-    float windback_phase, mag;
-    COMP  windback_phase_rect;
+    int i,j,k,c,st,Nval,n;
     COMP  rx_baseband[NFILTER+M_FAC];
-    COMP  f_rect;
+    COMP  rx_dec[(NFILTER+M_FAC+M_FAC/P)/(M_FAC/Q)+1];
+    struct NCO osc;
+
+    assert(dec_rate >= M_FAC/Q);
 
     //PROFILE_VAR(windback_start,  downconvert_start, filter_start);
 
@@ -1161,6 +1215,17 @@ void down_convert_and_rx_filter(COMP rx_filt[NC+1][P+1], int Nc, COMP rx_fdm[],
     memmove(&rx_fdm_mem[0],&rx_fdm_mem[nin],(NFILTER+M_FAC-nin)*sizeof(COMP));
     memcpy(&rx_fdm_mem[NFILTER+M_FAC-nin],&rx_fdm[0],nin*sizeof(COMP));
 #endif
+
+    /* the samples that get mixed down, every dec_rate-th from the
+       first sample used in filtering, are the same for all carriers */
+
+    st  = NFILTER+M_FAC-1;    /* end of buffer                  */
+    st -= nin-1;          /* first new sample               */
+    st -= NFILTER;        /* first sample used in filtering */
+
+    for(i=st, n=0; i<NFILTER+M_FAC; i+=dec_rate, n++)
+        rx_dec[n] = rx_fdm_mem[i];
+
     for(c=0; c<Nc+1; c++) {
 
         /*
@@ -1177,28 +1242,21 @@ void down_convert_and_rx_filter(COMP rx_filt[NC+1][P+1], int Nc, COMP rx_fdm[],
          */
 
         //PROFILE_SAMPLE(windback_start);
-        windback_phase           = -freq_pol[c]*NFILTER;
-        windback_phase_rect.real = COSF(windback_phase);
-        windback_phase_rect.imag = SINF(windback_phase);
-        phase_rx[c]              = cmult(phase_rx[c],windback_phase_rect);
+        osc.phase = phase_rx[c].phase - phase_rx[c].step*NFILTER;
         //PROFILE_SAMPLE_AND_LOG(downconvert_start, windback_start, "        windback");
 
-        /* down convert all samples in buffer */
-
-        st  = NFILTER+M_FAC-1;    /* end of buffer                  */
-        st -= nin-1;          /* first new sample               */
-        st -= NFILTER;        /* first sample used in filtering */
+        /* down convert all samples in buffer, freq shift per dec_rate
+           step is dec_rate times original shift */
 
-        /* freq shift per dec_rate step is dec_rate times original shift */
+        osc.step = phase_rx[c].step*dec_rate;
+        nco_mix_conj(&osc, &rx_baseband[st], rx_dec, n);
+        phase_rx[c].phase = osc.phase;
 
-        f_rect = freq[c];
-        for(i=0; i<dec_rate-1; i++)
-            f_rect = cmult(f_rect,freq[c]);
+        /* spread out to every dec_rate-th sample, from the end so
+           nothing is overwritten before it is moved */
 
-        for(i=st; i<NFILTER+M_FAC; i+=dec_rate) {
-            phase_rx[c]    = cmult(phase_rx[c], f_rect);
-            rx_baseband[i] = cmult(rx_fdm_mem[i],cconj(phase_rx[c]));
-        }
+        for(j=n-1; j>0; j--)
+            rx_baseband[st+j*dec_rate] = rx_baseband[st+j];
         //PROFILE_SAMPLE_AND_LOG(filter_start, downconvert_start, "        downconvert");
 
         /* now we can filter this carrier's P symbols */
@@ -1217,15 +1275,79 @@ void down_convert_and_rx_filter(COMP rx_filt[NC+1][P+1], int Nc, COMP rx_fdm[],
 #endif
         }
         //PROFILE_SAMPLE_AND_LOG2(filter_start, "        filter");
+    }
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: channelize_and_rx_filter()
+  DATE CREATED: Oct 2026
+
+  Same outputs as down_convert_and_rx_filter() with dec_rate M_FAC/Q,
+  for all carriers at once.  With carrier c on bin b(c) of an N point
+  DFT at the decimated rate, mixing a decimated sample q taps into the
+  filter down by carrier c is a twiddle e^(-j*2*pi*b(c)*q/N) times a
+  phase common to the whole output.  So each output is the window of
+  rx_fdm_mem times the filter, folded modulo N, then one DFT, rather
+  than Nc+1 separate mixes and filters.  The dec_rate gain matches
+  fir_filter2().
+
+  phase_rx[] is advanced just as down_convert_and_rx_filter() does, so
+  the two can be swapped between frames.
+
+\*---------------------------------------------------------------------------*/
+
+void channelize_and_rx_filter(struct FDMDV *f, COMP rx_filt[NC+1][P+1], COMP rx_fdm[], int nin)
+{
+    int   dec_rate = M_FAC/Q;
+    int   ntaps = NFILTER/dec_rate;
+    int   Nval = M_FAC/P;
+    int   N = f->chan_nfft;
+    int   c, i, k, q, r, st;
+    COMP  fold[NFILTER/(M_FAC/Q)];
+    COMP  spec[NFILTER/(M_FAC/Q)];
+    uint32_t phase[NC+1];
+    COMP  m_in;
+
+    assert(N != 0);
+
+    memmove(&f->rx_fdm_mem[0],&f->rx_fdm_mem[nin],(NFILTER+M_FAC-nin)*sizeof(COMP));
+    memcpy(&f->rx_fdm_mem[NFILTER+M_FAC-nin],&rx_fdm[0],nin*sizeof(COMP));
+
+    /* first sample used in filtering, as down_convert_and_rx_filter() */
+
+    st = M_FAC - nin;
 
-        /* normalise digital oscilators as the magnitude can drift over time */
+    /* phase at the first decimated sample mixed, as in
+       down_convert_and_rx_filter() after its windback */
 
-        mag = cabsolute(phase_rx[c]);
-	phase_rx[c].real /= mag;
-	phase_rx[c].imag /= mag;
+    for(c=0; c<f->Nc+1; c++)
+        phase[c] = f->phase_rx[c].phase + f->phase_rx[c].step*(uint32_t)(dec_rate - NFILTER);
 
-       //printf("phase_rx[%d] = %f %f\n", c, phase_rx[c].real, phase_rx[c].imag);
+    for(i=0, k=0; i<nin; i+=Nval, k++) {
+        for(r=0; r<N; r++) {
+            fold[r].real = 0.0; fold[r].imag = 0.0;
+        }
+        for(q=0, r=0; q<ntaps; q++) {
+            m_in = f->rx_fdm_mem[st+i+q*dec_rate];
+            fold[r].real += gt_alpha5_root[q*dec_rate]*m_in.real;
+            fold[r].imag += gt_alpha5_root[q*dec_rate]*m_in.imag;
+            if (++r == N)
+                r = 0;
+        }
+
+        kiss_fft(f->chan_fft_cfg, (kiss_fft_cpx *)fold, (kiss_fft_cpx *)spec);
+
+        for(c=0; c<f->Nc+1; c++) {
+            rx_filt[c][k] = fcmult(dec_rate, cmult(spec[f->chan_bin[c]], cconj(nco_phasor(phase[c]))));
+            phase[c] += f->phase_rx[c].step*Nval;
+        }
     }
+
+    /* advance the oscillators by nin samples */
+
+    for(c=0; c<f->Nc+1; c++)
+        f->phase_rx[c].phase += f->phase_rx[c].step*nin;
 }
 
 /*---------------------------------------------------------------------------*\
@@ -1632,7 +1754,7 @@ void fdmdv_demod(struct FDMDV *fdmdv, int rx_bits[],
 
     /* shift down to complex baseband */
 
-    fdmdv_freq_shift(rx_fdm_bb, rx_fdm, -FDMDV_FCENTRE, &fdmdv->fbb_phase_rx, *nin);
+    fdmdv_freq_shift_nco(rx_fdm_bb, rx_fdm, -FDMDV_FCENTRE, &fdmdv->fbb_phase_rx, *nin);
 
     /* freq offset estimation and correction */
 
@@ -1642,14 +1764,17 @@ void fdmdv_demod(struct FDMDV *fdmdv, int rx_bits[],
 
     if (fdmdv->sync == 0)
 	fdmdv->foff = foff_coarse;
-    fdmdv_freq_shift(rx_fdm_fcorr, rx_fdm_bb, -fdmdv->foff, &fdmdv->foff_phase_rect, *nin);
+    fdmdv_freq_shift_nco(rx_fdm_fcorr, rx_fdm_bb, -fdmdv->foff, &fdmdv->foff_phase, *nin);
     PROFILE_SAMPLE_AND_LOG(down_convert_and_rx_filter_start, fdmdv_freq_shift_start, "    fdmdv_freq_shift");
 
     /* baseband processing */
 
     rxdec_filter(rx_fdm_filter, rx_fdm_fcorr, fdmdv->rxdec_lpf_mem, *nin);
-    down_convert_and_rx_filter(rx_filt, fdmdv->Nc, rx_fdm_filter, fdmdv->rx_fdm_mem, fdmdv->phase_rx, fdmdv->freq,
-                               fdmdv->freq_pol, *nin, M_FAC/Q);
+    if (fdmdv->chan_nfft)
+        channelize_and_rx_filter(fdmdv, rx_filt, rx_fdm_filter, *nin);
+    else
+        down_convert_and_rx_filter(rx_filt, fdmdv->Nc, rx_fdm_filter, fdmdv->rx_fdm_mem, fdmdv->phase_rx,
+                                   *nin, M_FAC/Q);
     PROFILE_SAMPLE_AND_LOG(rx_est_timing_start, down_convert_and_rx_filter_start, "    down_convert_and_rx_filter");
     fdmdv->rx_timing = rx_est_timing(rx_symbols, fdmdv->Nc, rx_filt, fdmdv->rx_filter_mem_timing, env, *nin, M_FAC);
     PROFILE_SAMPLE_AND_LOG(qpsk_to_bits_start, rx_est_timing_start, "    rx_est_timing");
@@ -1697,7 +1822,7 @@ float calc_snr(int Nc, float sig_est[], float noise_est[])
 
     S = 0.0;
     for(c=0; c<Nc+1; c++)
-	S += powf(sig_est[c], 2.0);
+	S += sig_est[c]*sig_est[c];
     SdB = 10.0*log10f(S+1E-12);
 
     /* Average noise mag across all carriers and square to get an
@@ -1709,7 +1834,7 @@ float calc_snr(int Nc, float sig_est[], float noise_est[])
     for(c=0; c<Nc+1; c++)
 	mean += noise_est[c];
     mean /= (Nc+1);
-    N50 = powf(mean, 2.0);
+    N50 = mean*mean;
     N50dB = 10.0*log10f(N50+1E-12);
 
     /* Now multiply by (3000 Hz)/(50 Hz) to find the total noise power
@@ -1885,7 +2010,8 @@ void fdmdv_16_to_8_short(short out8k[], short in16k[], int n)
 /*---------------------------------------------------------------------------*\
 
   Function used during development to test if magnitude of digital
-  oscillators was drifting.  It was!
+  oscillators was drifting.  It was!  They are now phase accumulators
+  (nco.h) that can't drift, so this prints their phases in radians.
 
 \*---------------------------------------------------------------------------*/
 
@@ -1895,14 +2021,14 @@ void fdmdv_dump_osc_mags(struct FDMDV *f)
 
     fprintf(stderr, "phase_tx[]:\n");
     for(i=0; i<=f->Nc; i++)
-	fprintf(stderr,"  %1.3f", (double)cabsolute(f->phase_tx[i]));
+	fprintf(stderr,"  %1.3f", (double)nco_radians(f->phase_tx[i].phase));
     fprintf(stderr,"\nfreq[]:\n");
     for(i=0; i<=f->Nc; i++)
 	fprintf(stderr,"  %1.3f", (double)cabsolute(f->freq[i]));
-    fprintf(stderr,"\nfoff_phase_rect: %1.3f", (double)cabsolute(f->foff_phase_rect));
+    fprintf(stderr,"\nfoff_phase: %1.3f", (double)nco_radians(f->foff_phase.phase));
     fprintf(stderr,"\nphase_rx[]:\n");
     for(i=0; i<=f->Nc; i++)
-	fprintf(stderr,"  %1.3f", (double)cabsolute(f->phase_rx[i]));
+	fprintf(stderr,"  %1.3f", (double)nco_radians(f->phase_rx[i].phase));
     fprintf(stderr, "\n\n");
 }
 
@@ -1988,3 +2114,82 @@ void fdmdv_simulate_channel(float *sig_pwr_av, COMP samples[], int nin, float ta
             sig_pwr, f->sig_pwr_av, target_snr_linear, noise_pwr_4000Hz, noise_gain);
     */
 }
+
+#ifdef FDMDV_CHANNELIZER_UNITTEST
+#include <time.h>
+
+/*
+  Both paths take their carrier phases from the same phase_rx[] NCOs,
+  so they differ only by float rounding in the mix, the fold and the
+  DFT, around 1E-6 against outputs peaking near 0.2.
+*/
+
+#define CHAN_FRAMES   2000
+#define CHAN_TOL      2E-6
+
+static double chan_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1E6 + t.tv_nsec/1E3;
+}
+
+int main(void) {
+    struct FDMDV *ref, *chan;
+    COMP   rx_fdm[M_FAC+M_FAC/P];
+    COMP   rx_filt_ref[NC+1][P+1], rx_filt_chan[NC+1][P+1];
+    int    f, i, c, k, nin;
+    float  err, max_err = 0.0, peak = 0.0;
+    double t0, us_ref = 0.0, us_chan = 0.0;
+
+    ref = fdmdv_create(FDMDV_NC);
+    chan = fdmdv_create(FDMDV_NC);
+    assert((ref != NULL) && (chan != NULL));
+    if (!fdmdv_set_channelizer(chan, 1)) {
+        printf("Bad! carriers don't fit a DFT\n");
+        exit(1);
+    }
+
+    for(f=0; f<CHAN_FRAMES; f++) {
+        /* the two nin values that don't read before rx_fdm_mem */
+
+        nin = (rand() & 1) ? M_FAC : M_FAC - M_FAC/P;
+        for(i=0; i<nin; i++) {
+            rx_fdm[i].real = (float)rand()/RAND_MAX - 0.5;
+            rx_fdm[i].imag = (float)rand()/RAND_MAX - 0.5;
+        }
+
+        t0 = chan_us();
+        down_convert_and_rx_filter(rx_filt_ref, ref->Nc, rx_fdm, ref->rx_fdm_mem, ref->phase_rx, nin, M_FAC/Q);
+        us_ref += chan_us() - t0;
+
+        t0 = chan_us();
+        channelize_and_rx_filter(chan, rx_filt_chan, rx_fdm, nin);
+        us_chan += chan_us() - t0;
+
+        for(c=0; c<ref->Nc+1; c++)
+            for(k=0; k<nin/(M_FAC/P); k++) {
+                err = cabsolute(cadd(rx_filt_chan[c][k], fcmult(-1.0, rx_filt_ref[c][k])));
+                if (err > max_err)
+                    max_err = err;
+                if (cabsolute(rx_filt_ref[c][k]) > peak)
+                    peak = cabsolute(rx_filt_ref[c][k]);
+            }
+    }
+
+    fdmdv_destroy(ref);
+    fdmdv_destroy(chan);
+
+    printf("%d frames: max error %e, peak %f\n", CHAN_FRAMES, max_err, peak);
+    printf("down_convert_and_rx_filter: %6.2f us/frame channelize_and_rx_filter: %6.2f us/frame\n",
+           us_ref/CHAN_FRAMES, us_chan/CHAN_FRAMES);
+
+    if (max_err > CHAN_TOL) {
+        printf("Bad!\n");
+        exit(1);
+    }
+
+    printf("Everything checks out\n");
+    return 0;
+}
+
+#endif
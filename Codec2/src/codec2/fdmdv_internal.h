@@ -32,6 +32,7 @@
 #include "comp.h"
 #include "codec2_fdmdv.h"
 #include "codec2_fft.h"
+#include "kiss_fft.h"
 
 /*---------------------------------------------------------------------------*\
 
@@ -95,7 +96,7 @@ struct FDMDV {
     int   tx_pilot_bit;
     COMP  prev_tx_symbols[NC+1];
     COMP  tx_filter_memory[NC+1][NSYM];
-    COMP  phase_tx[NC+1];
+    struct NCO phase_tx[NC+1];
     COMP  freq[NC+1];
     float freq_pol[NC+1];
 
@@ -117,22 +118,27 @@ struct FDMDV {
 
     /* baseband to low IF carrier states */
 
-    COMP  fbb_rect;
     float fbb_pol;
-    COMP  fbb_phase_tx;
-    COMP  fbb_phase_rx;
+    struct NCO fbb_phase_tx;
+    struct NCO fbb_phase_rx;
 
     /* freq offset correction states */
 
     float foff;
-    COMP foff_phase_rect;
+    struct NCO foff_phase;
     float foff_filt;
 
     /* Demodulator */
 
     COMP  rxdec_lpf_mem[NRXDEC-1+M_FAC];
     COMP  rx_fdm_mem[NFILTER+M_FAC];
-    COMP  phase_rx[NC+1];
+    struct NCO phase_rx[NC+1];
+
+    /* FFT channelizer, see fdmdv_set_channelizer() */
+
+    int          chan_nfft;                /* DFT size, 0 when off                       */
+    kiss_fft_cfg chan_fft_cfg;
+    int          chan_bin[NC+1];           /* DFT bin of each carrier                    */
     COMP  rx_filter_mem_timing[NC+1][NT*P];
     float rx_timing;
     COMP  phase_difference[NC+1];
@@ -163,21 +169,21 @@ struct FDMDV {
 
 void bits_to_dqpsk_symbols(COMP tx_symbols[], int Nc, COMP prev_tx_symbols[], int tx_bits[], int *pilot_bit, int old_qpsk_mapping);
 void tx_filter(COMP tx_baseband[NC+1][M_FAC], int Nc, COMP tx_symbols[], COMP tx_filter_memory[NC+1][NSYM]);
-void fdm_upconvert(COMP tx_fdm[], int Nc, COMP tx_baseband[NC+1][M_FAC], COMP phase_tx[], COMP freq_tx[],
-                   COMP *fbb_phase, COMP fbb_rect);
+void fdm_upconvert(COMP tx_fdm[], int Nc, COMP tx_baseband[NC+1][M_FAC], struct NCO phase_tx[],
+                   struct NCO *fbb_phase);
 void tx_filter_and_upconvert(COMP tx_fdm[], int Nc, COMP tx_symbols[],
                              COMP tx_filter_memory[NC+1][NSYM],
-                             COMP phase_tx[], COMP freq[], COMP *fbb_phase, COMP fbb_rect);
+                             struct NCO phase_tx[], struct NCO *fbb_phase);
 void generate_pilot_fdm(COMP *pilot_fdm, int *bit, float *symbol, float *filter_mem, COMP *phase, COMP *freq);
 void generate_pilot_lut(COMP pilot_lut[], COMP *pilot_freq);
 float rx_est_freq_offset(struct FDMDV *f, COMP rx_fdm[], int nin, int do_fft);
 void lpf_peak_pick(float *foff, float *max, COMP pilot_baseband[], COMP pilot_lpf[], codec2_fft_cfg fft_pilot_cfg, COMP S[], int nin, int do_fft);
-void fdm_downconvert(COMP rx_baseband[NC+1][M_FAC+M_FAC/P], int Nc, COMP rx_fdm[], COMP phase_rx[], COMP freq[], int nin);
+void fdm_downconvert(COMP rx_baseband[NC+1][M_FAC+M_FAC/P], int Nc, COMP rx_fdm[], struct NCO phase_rx[], int nin);
 void rxdec_filter(COMP rx_fdm_filter[], COMP rx_fdm[], COMP rxdec_lpf_mem[], int nin);
 void rx_filter(COMP rx_filt[NC+1][P+1], int Nc, COMP rx_baseband[NC+1][M_FAC+M_FAC/P], COMP rx_filter_memory[NC+1][NFILTER], int nin);
 void down_convert_and_rx_filter(COMP rx_filt[NC+1][P+1], int Nc, COMP rx_fdm[],
-                                COMP rx_fdm_mem[], COMP phase_rx[], COMP freq[],
-                                float freq_pol[], int nin, int dec_rate);
+                                COMP rx_fdm_mem[], struct NCO phase_rx[], int nin, int dec_rate);
+void channelize_and_rx_filter(struct FDMDV *f, COMP rx_filt[NC+1][P+1], COMP rx_fdm[], int nin);
 float rx_est_timing(COMP  rx_symbols[], int Nc,
 		    COMP  rx_filt[NC+1][P+1],
 		    COMP  rx_filter_mem_timing[NC+1][NT*P],
@@ -32,7 +32,16 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "codec2_fifo.h"
+#include "codec2_arena.h"
+
+/* pin is only written by the writer and pout only by the reader, each
+   published with a release store after the samples it covers are
+   copied, so one writer thread and one reader thread need no lock */
+
+#define FIFO_LOAD(p)     __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define FIFO_STORE(p,v)  __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
 
 struct FIFO {
     short *buf;
@@ -44,10 +53,10 @@ struct FIFO {
 struct FIFO *fifo_create(int nshort) {
     struct FIFO *fifo;
 
-    fifo = (struct FIFO *)malloc(sizeof(struct FIFO));
+    fifo = (struct FIFO *)codec2_malloc(sizeof(struct FIFO));
     assert(fifo != NULL);
 
-    fifo->buf = (short*)malloc(sizeof(short)*nshort);
+    fifo->buf = (short*)codec2_malloc(sizeof(short)*nshort);
     assert(fifo->buf != NULL);
     fifo->pin = fifo->buf;
     fifo->pout = fifo->buf;
@@ -58,14 +67,13 @@ struct FIFO *fifo_create(int nshort) {
 
 void fifo_destroy(struct FIFO *fifo) {
     assert(fifo != NULL);
-    free(fifo->buf);
-    free(fifo);
+    codec2_free(fifo->buf);
+    codec2_free(fifo);
 }
 
 int fifo_write(struct FIFO *fifo, short data[], int n) {
-    int            i;
-    short         *pdata;
-    short         *pin = fifo->pin;
+    short         *pin;
+    int            n1;
 
     assert(fifo != NULL);
     assert(data != NULL);
@@ -75,16 +83,18 @@ int fifo_write(struct FIFO *fifo, short data[], int n) {
     }
     else {
 
-	/* This could be made more efficient with block copies
-	   using memcpy */
-
-	pdata = data;
-	for(i=0; i<n; i++) {
-	    *pin++ = *pdata++;
-	    if (pin == (fifo->buf + fifo->nshort))
-		pin = fifo->buf;
-	}
-	fifo->pin = pin;
+	/* copy up to the end of the buffer, then wrap */
+
+	pin = fifo->pin;
+	n1 = (fifo->buf + fifo->nshort) - pin;
+	if (n1 > n)
+	    n1 = n;
+	memcpy(pin, data, sizeof(short)*n1);
+	memcpy(fifo->buf, data + n1, sizeof(short)*(n - n1));
+	pin += n;
+	if (pin >= fifo->buf + fifo->nshort)
+	    pin -= fifo->nshort;
+	FIFO_STORE(fifo->pin, pin);
     }
 
     return 0;
@@ -92,9 +102,8 @@ int fifo_write(struct FIFO *fifo, short data[], int n) {
 
 int fifo_read(struct FIFO *fifo, short data[], int n)
 {
-    int            i;
-    short         *pdata;
-    short         *pout = fifo->pout;
+    short         *pout;
+    int            n1;
 
     assert(fifo != NULL);
     assert(data != NULL);
@@ -104,16 +113,16 @@ int fifo_read(struct FIFO *fifo, short data[], int n)
     }
     else {
 
-	/* This could be made more efficient with block copies
-	   using memcpy */
-
-	pdata = data;
-	for(i=0; i<n; i++) {
-	    *pdata++ = *pout++;
-	    if (pout == (fifo->buf + fifo->nshort))
-		pout = fifo->buf;
-	}
-	fifo->pout = pout;
+	pout = fifo->pout;
+	n1 = (fifo->buf + fifo->nshort) - pout;
+	if (n1 > n)
+	    n1 = n;
+	memcpy(data, pout, sizeof(short)*n1);
+	memcpy(data + n1, fifo->buf, sizeof(short)*(n - n1));
+	pout += n;
+	if (pout >= fifo->buf + fifo->nshort)
+	    pout -= fifo->nshort;
+	FIFO_STORE(fifo->pout, pout);
     }
 
     return 0;
@@ -121,8 +130,8 @@ int fifo_read(struct FIFO *fifo, short data[], int n)
 
 int fifo_used(const struct FIFO * const fifo)
 {
-    short         *pin = fifo->pin;
-    short         *pout = fifo->pout;
+    short         *pin = FIFO_LOAD(fifo->pin);
+    short         *pout = FIFO_LOAD(fifo->pout);
     unsigned int   used;
 
     assert(fifo != NULL);
@@ -33,6 +33,7 @@
 \*---------------------------------------------------------------------------*/
 
 #define FILT_MEM 200
+#define DEM_BLOCK 64                     /* samples per nco_atan2_block() */
 
 /*---------------------------------------------------------------------------*\
 
@@ -46,8 +47,10 @@
 #include <string.h>
 #include <math.h>
 
+#include "codec2_math.h"
 #include "codec2_fm.h"
 #include "fm_fir_coeff.h"
+#include "nco.h"
 #include "comp_prim.h"
 
 /*---------------------------------------------------------------------------*\
@@ -56,6 +59,14 @@
 
 \*---------------------------------------------------------------------------*/
 
+/* modulator NCO phase in rads, kept 0 to 2PI in struct FM */
+
+static float fm_tx_phase(struct NCO *nco) {
+  float phase = nco_radians(nco->phase);
+
+  return (phase < 0) ? phase + 2*M_PI : phase;
+}
+
 /*---------------------------------------------------------------------------*\
 
   FUNCTION....: fm_create
@@ -119,67 +130,57 @@ void fm_demod(struct FM *fm_states, float rx_out[], float rx[])
   float  fd = fm_states->fd;
   float  wd = 2*M_PI*fd/Fs;
   COMP  *rx_bb = fm_states->rx_bb + FILT_MEM;
-  COMP   wc_rect, rx_bb_filt, rx_bb_diff;
-  float  rx_dem;
-  /*
-  float acc;
-  */
+  COMP   rx_bb_filt, rx_bb_diff[DEM_BLOCK];
+  float  rx_dem[DEM_BLOCK];
   float *rx_dem_mem = fm_states->rx_dem_mem + FILT_MEM;
   int    nsam = fm_states->nsam;
-  float  mag;
-  int    i,k;
+  struct NCO lo;
+  int    i,j,k,n;
+
+  /* down to complex baseband */
 
-  wc_rect.real = cosf(wc); wc_rect.imag = -sinf(wc);
+  nco_init(&lo, -wc, atan2f(fm_states->lo_phase.imag, fm_states->lo_phase.real));
+  nco_mix_real(&lo, rx_bb, rx, nsam);
+  fm_states->lo_phase = nco_phasor(lo.phase);
 
-  for(i=0; i<nsam; i++) {
+  for(i=0; i<nsam; i+=n) {
+      n = (nsam - i < DEM_BLOCK) ? nsam - i : DEM_BLOCK;
 
-      /* down to complex baseband */
+      for(j=0; j<n; j++) {
 
-      fm_states->lo_phase = cmult(fm_states->lo_phase, wc_rect);
-      rx_bb[i] = fcmult(rx[i], fm_states->lo_phase);
+          /* input FIR filter */
 
-      /* input FIR filter */
+          rx_bb_filt.real = 0.0; rx_bb_filt.imag = 0.0;
+          for(k=0; k<FILT_MEM/2; k++) {
+              rx_bb_filt.real += rx_bb[i+j-k].real * bin[k+FILT_MEM/4];
+              rx_bb_filt.imag += rx_bb[i+j-k].imag * bin[k+FILT_MEM/4];
+          }
 
-      rx_bb_filt.real = 0.0; rx_bb_filt.imag = 0.0;
+          /*
+             Differentiate first, in rect domain, then find angle, this
+             puts signal on the positive side of the real axis and helps
+             atan2() behaive.
+          */
 
-      for(k=0; k<FILT_MEM/2; k++) {
-          rx_bb_filt.real += rx_bb[i-k].real * bin[k+FILT_MEM/4];
-          rx_bb_filt.imag += rx_bb[i-k].imag * bin[k+FILT_MEM/4];
+          rx_bb_diff[j] = cmult(rx_bb_filt, cconj(fm_states->rx_bb_filt_prev));
+          fm_states->rx_bb_filt_prev = rx_bb_filt;
       }
 
-      //rx_bb_filt = rx_bb[i];
-      //printf("%f %f %f\n", rx[i], wc_rect.real, wc_rect.imag);
-      //printf("%f %f %f\n", rx[i], fm_states->lo_phase.real, fm_states->lo_phase.imag);
-      //printf("%f %f %f\n", rx[i], rx_bb[i].real, rx_bb[i].imag);
-      //printf("%f %f\n", rx_bb_filt.real, rx_bb_filt.imag);
-      /*
-         Differentiate first, in rect domain, then find angle, this
-         puts signal on the positive side of the real axis and helps
-         atan2() behaive.
-      */
-
-      rx_bb_diff = cmult(rx_bb_filt, cconj(fm_states->rx_bb_filt_prev));
-      fm_states->rx_bb_filt_prev = rx_bb_filt;
-
-      rx_dem = atan2f(rx_bb_diff.imag, rx_bb_diff.real);
-
-      /* limit maximum phase jumps, to remove static type noise at low SNRs */
-
-      if (rx_dem > wd)
-          rx_dem = wd;
-      if (rx_dem < -wd)
-          rx_dem = -wd;
-
-      rx_dem *= (1/wd);
-      //printf("%f %f\n", rx_bb_diff.real, rx_bb_diff.imag);
-      rx_dem_mem[i] = rx_dem;
-      /*
-      acc = 0;
-        for(k=0; k<FILT_MEM; k++) {
-          acc += rx_dem_mem[i-k] * bout[k];
+      nco_atan2_block(rx_dem, rx_bb_diff, n);
+
+      for(j=0; j<n; j++) {
+
+          /* limit maximum phase jumps, to remove static type noise at low SNRs */
+
+          if (rx_dem[j] > wd)
+              rx_dem[j] = wd;
+          if (rx_dem[j] < -wd)
+              rx_dem[j] = -wd;
+
+          rx_dem[j] *= (1/wd);
+          rx_dem_mem[i+j] = rx_dem[j];
+          rx_out[i+j] = rx_dem[j];
       }
-      */
-      rx_out[i] = rx_dem;
   }
 
   /* update filter memories */
@@ -190,13 +191,6 @@ void fm_demod(struct FM *fm_states, float rx_out[], float rx[])
       rx_bb[i] = rx_bb[i+nsam];
       rx_dem_mem[i] = rx_dem_mem[i+nsam];
   }
-
-  /* normalise digital oscillator as the magnitude can drift over time */
-
-  mag = cabsolute(fm_states->lo_phase);
-  fm_states->lo_phase.real /= mag;
-  fm_states->lo_phase.imag /= mag;
-
 }
 
 /*---------------------------------------------------------------------------*\
@@ -220,26 +214,15 @@ void fm_mod(struct FM *fm_states, float tx_in[], float tx_out[]) {
   float  fd = fm_states->fd;    //Max deviation in cycles/samp
   float  wd = 2*M_PI*fd/Fs;     //Max deviation in rads/samp
   int  nsam = fm_states->nsam;  //Samples per batch of modulation
-  float tx_phase = fm_states->tx_phase; //Transmit phase in rads
-  float w;			//Temp variable for phase of VFO during loop
-  int i;
-
-  //Go through the samples, spin the oscillator, and generate some FM
-  for(i=0; i<nsam; i++){
-      w = wc + wd*tx_in[i];   //Calculate phase of VFO
-      tx_phase += w;          //Spin TX oscillator
-
-      //TODO: Add pre-emphasis and pre-emph AGC for voice
-
-      //Make sure tx_phase stays from 0 to 2PI.
-      //If tx_phase goes above 4PI, It's because fc+fd*tx_in[i] is way too large for the sample
-      // rate.
-      if(tx_phase > 2*M_PI)
-          tx_phase -= 2*M_PI;
-      tx_out[i] = cosf(tx_phase);
-  }
-  //Save phase back into state struct
-  fm_states->tx_phase = tx_phase;
+  struct NCO tx;
+
+  //TODO: Add pre-emphasis and pre-emph AGC for voice
+
+  //Spin the oscillator at wc + wd*tx_in[i] rads/samp, the phase
+  //accumulator wraps by itself
+  nco_init(&tx, wc, fm_states->tx_phase);
+  nco_fm_real(&tx, tx_out, tx_in, wd, nsam);
+  fm_states->tx_phase = fm_tx_phase(&tx);
 }
 
 /*---------------------------------------------------------------------------*\
@@ -264,27 +247,13 @@ void fm_mod_comp(struct FM *fm_states, float tx_in[], COMP tx_out[]){
   float  fd = fm_states->fd;    //Max deviation in cycles/samp
   float  wd = 2*M_PI*fd/Fs;     //Max deviation in rads/samp
   int  nsam = fm_states->nsam;  //Samples per batch of modulation
-  float tx_phase = fm_states->tx_phase; //Transmit phase in rads
-  float w;			//Temp variable for phase of VFO during loop
-  int i;
-
-  //Go through the samples, spin the oscillator, and generate some FM
-  for(i=0; i<nsam; i++){
-      w = wc + wd*tx_in[i];   //Calculate phase of VFO
-      tx_phase += w;          //Spin TX oscillator
-      
-      //TODO: Add pre-emphasis and pre-emph AGC for voice
-
-      //Make sure tx_phase stays from 0 to 2PI.
-      //If tx_phase goes above 4PI, It's because fc+fd*tx_in[i] is way too large for the sample
-      // rate.
-      if(tx_phase > 2*M_PI)
-          tx_phase -= 2*M_PI;
-
-      tx_out[i].real = cosf(tx_phase);
-      tx_out[i].imag = sinf(tx_phase);
-  }
-  //Save phase back into state struct
-  fm_states->tx_phase = tx_phase;
+  struct NCO tx;
+
+  //TODO: Add pre-emphasis and pre-emph AGC for voice
+
+  //Spin the oscillator at wc + wd*tx_in[i] rads/samp
+  nco_init(&tx, wc, fm_states->tx_phase);
+  nco_fm(&tx, tx_out, tx_in, wd, nsam);
+  fm_states->tx_phase = fm_tx_phase(&tx);
 }
 
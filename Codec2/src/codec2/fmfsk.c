@@ -34,9 +34,11 @@
 #include <stdio.h>
 
 
+#include "codec2_math.h"
 #include "fmfsk.h"
 #include "modem_probe.h"
 #include "comp_prim.h"
+#include "codec2_arena.h"
 
 #define STD_PROC_BITS 96
 
@@ -57,7 +59,7 @@ struct FMFSK * fmfsk_create(int Fs,int Rb){
     int nbits = STD_PROC_BITS;
     
     /* Allocate the struct */
-    struct FMFSK *fmfsk = malloc(sizeof(struct FMFSK));
+    struct FMFSK *fmfsk = codec2_malloc(sizeof(struct FMFSK));
     if(fmfsk==NULL) return NULL;
     
     /* Set up static parameters */
@@ -75,18 +77,18 @@ struct FMFSK * fmfsk_create(int Fs,int Rb){
     fmfsk->nin = fmfsk->N;
     fmfsk->snr_mean = 0;
     
-    float *oldsamps = malloc(sizeof(float)*fmfsk->nmem);
+    float *oldsamps = codec2_malloc(sizeof(float)*fmfsk->nmem);
     if(oldsamps == NULL){
-        free(fmfsk);
+        codec2_free(fmfsk);
         return NULL;
     }
     
     fmfsk->oldsamps = oldsamps;
 
-    fmfsk->stats = (struct MODEM_STATS*)malloc(sizeof(struct MODEM_STATS));
+    fmfsk->stats = (struct MODEM_STATS*)codec2_malloc(sizeof(struct MODEM_STATS));
     if (fmfsk->stats == NULL) {
-        free(oldsamps);
-        free(fmfsk);
+        codec2_free(oldsamps);
+        codec2_free(fmfsk);
         return NULL;
     }
     
@@ -97,8 +99,8 @@ struct FMFSK * fmfsk_create(int Fs,int Rb){
  * Destroys an fmfsk modem and deallocates memory
  */
 void fmfsk_destroy(struct FMFSK *fmfsk){
-    free(fmfsk->oldsamps);
-    free(fmfsk);
+    codec2_free(fmfsk->oldsamps);
+    codec2_free(fmfsk);
 }
 
 /*
@@ -305,8 +307,8 @@ void fmfsk_demod(struct FMFSK *fmfsk, uint8_t rx_bits[],float fmfsk_in[]){
         }
     }
     #ifdef EST_EBNO
-    amp_even = sqrt(amp_even);
-    amp_odd = sqrt(amp_odd);
+    amp_even = c2_sqrt(amp_even);
+    amp_odd = c2_sqrt(amp_odd);
     #endif
     if(apeven>apodd){
         /* Zero out odd bits from output bitstream */
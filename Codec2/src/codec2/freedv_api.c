@@ -39,6 +39,7 @@
 #include <malloc.h>
 #endif /* __APPLE__ */
 
+#include "codec2_math.h"
 #include "fsk.h"
 #include "fmfsk.h"
 #include "codec2.h"
@@ -50,6 +51,7 @@
 #include "freedv_api_internal.h"
 #include "freedv_vhf_framing.h"
 #include "comp_prim.h"
+#include "codec2_arena.h"
 
 #define VERSION     11    /* The API version number.  The first version
                            is 10.  Increment if the API changes in a
@@ -86,7 +88,7 @@ struct freedv *freedv_open(int mode) {
         (mode != FREEDV_MODE_700C))
         return NULL;
 
-    f = (struct freedv*)malloc(sizeof(struct freedv));
+    f = (struct freedv*)codec2_malloc(sizeof(struct freedv));
     if (f == NULL)
         return NULL;
 
@@ -95,6 +97,8 @@ struct freedv *freedv_open(int mode) {
     f->freedv_put_error_pattern = NULL;
     f->error_pattern_callback_state = NULL;
     f->n_protocol_bits = 0;
+    f->deframer = NULL;
+    f->fdc = NULL;
 
     if (mode == FREEDV_MODE_1600) {
         f->snr_squelch_thresh = 2.0;
@@ -112,12 +116,12 @@ struct freedv *freedv_open(int mode) {
         f->n_max_modem_samples = FDMDV_NOM_SAMPLES_PER_FRAME+FDMDV_MAX_SAMPLES_PER_FRAME;
         f->modem_sample_rate = FS;
         nbit = fdmdv_bits_per_frame(f->fdmdv);
-        f->fdmdv_bits = (int*)malloc(nbit*sizeof(int));
+        f->fdmdv_bits = (int*)codec2_malloc(nbit*sizeof(int));
         if (f->fdmdv_bits == NULL)
             return NULL;
         nbit = 2*fdmdv_bits_per_frame(f->fdmdv);
-        f->tx_bits = (int*)malloc(nbit*sizeof(int));
-        f->rx_bits = (int*)malloc(nbit*sizeof(int));
+        f->tx_bits = (int*)codec2_malloc(nbit*sizeof(int));
+        f->rx_bits = (int*)codec2_malloc(nbit*sizeof(int));
         if ((f->tx_bits == NULL) || (f->rx_bits == NULL))
             return NULL;
         f->evenframe = 0;
@@ -150,7 +154,7 @@ struct freedv *freedv_open(int mode) {
         f->modem_sample_rate = FS;                                         /* note wierd sample rate tamed by interpolator */
         f->clip = 1;
         nbit = COHPSK_BITS_PER_FRAME;
-        f->tx_bits = (int*)malloc(nbit*sizeof(int));
+        f->tx_bits = (int*)codec2_malloc(nbit*sizeof(int));
         if (f->tx_bits == NULL)
             return NULL;
         f->sz_error_pattern = cohpsk_error_pattern_size();
@@ -174,7 +178,7 @@ struct freedv *freedv_open(int mode) {
         f->fsk = fsk_create_hbr(48000,1200,10,4,1200,1200);
         
         /* Note: fsk expects tx/rx bits as an array of uint8_ts, not ints */
-        f->tx_bits = (int*)malloc(f->fsk->Nbits*sizeof(uint8_t));
+        f->tx_bits = (int*)codec2_malloc(f->fsk->Nbits*sizeof(uint8_t));
         
         if(f->fsk == NULL){
             fvhff_destroy_deframer(f->deframer);
@@ -187,7 +191,7 @@ struct freedv *freedv_open(int mode) {
         f->nin = fsk_nin(f->fsk);
         f->modem_sample_rate = 48000;
         /* Malloc something to appease freedv_init and freedv_destroy */
-        f->codec_bits = malloc(1);
+        f->codec_bits = codec2_malloc(1);
     }
     
     if (mode == FREEDV_MODE_2400B) {
@@ -203,7 +207,7 @@ struct freedv *freedv_open(int mode) {
             return NULL;
         }
         /* Note: fsk expects tx/rx bits as an array of uint8_ts, not ints */
-        f->tx_bits = (int*)malloc(f->fmfsk->nbit*sizeof(uint8_t));
+        f->tx_bits = (int*)codec2_malloc(f->fmfsk->nbit*sizeof(uint8_t));
         
         f->n_nom_modem_samples = f->fmfsk->N;
         f->n_max_modem_samples = f->fmfsk->N + (f->fmfsk->Ts);
@@ -211,7 +215,7 @@ struct freedv *freedv_open(int mode) {
         f->nin = fmfsk_nin(f->fmfsk);
         f->modem_sample_rate = 48000;
         /* Malloc something to appease freedv_init and freedv_destroy */
-        f->codec_bits = malloc(1);
+        f->codec_bits = codec2_malloc(1);
     }
     
     if (mode == FREEDV_MODE_800XA) {
@@ -224,7 +228,7 @@ struct freedv *freedv_open(int mode) {
         fsk_set_nsym(f->fsk,32);
         
         /* Note: fsk expects tx/rx bits as an array of uint8_ts, not ints */
-        f->tx_bits = (int*)malloc(f->fsk->Nbits*sizeof(uint8_t));
+        f->tx_bits = (int*)codec2_malloc(f->fsk->Nbits*sizeof(uint8_t));
         
         if(f->fsk == NULL){
             fvhff_destroy_deframer(f->deframer);
@@ -237,7 +241,7 @@ struct freedv *freedv_open(int mode) {
         f->nin = fsk_nin(f->fsk);
         f->modem_sample_rate = 8000;
         /* Malloc something to appease freedv_init and freedv_destroy */
-        f->codec_bits = malloc(1);
+        f->codec_bits = codec2_malloc(1);
         
         f->n_protocol_bits = 0;
         codec2_mode = CODEC2_MODE_700C;
@@ -275,31 +279,36 @@ struct freedv *freedv_open(int mode) {
         nbyte = 2*((codec2_bits_per_frame(f->codec2) + 7) / 8);
     }
     
-    f->prev_rx_bits = (float*)malloc(sizeof(float)*2*codec2_bits_per_frame(f->codec2));
+    f->prev_rx_bits = (float*)codec2_malloc(sizeof(float)*2*codec2_bits_per_frame(f->codec2));
     if (f->prev_rx_bits == NULL)
         return NULL;
 
-    f->packed_codec_bits = (unsigned char*)malloc(nbyte*sizeof(char));
+    f->packed_codec_bits = (unsigned char*)codec2_malloc(nbyte*sizeof(char));
     if (mode == FREEDV_MODE_1600)
-        f->codec_bits = (int*)malloc(nbit*sizeof(int));
+        f->codec_bits = (int*)codec2_malloc(nbit*sizeof(int));
     if ((mode == FREEDV_MODE_700) || (mode == FREEDV_MODE_700B) || (mode == FREEDV_MODE_700C))
-        f->codec_bits = (int*)malloc(COHPSK_BITS_PER_FRAME*sizeof(int));
+        f->codec_bits = (int*)codec2_malloc(COHPSK_BITS_PER_FRAME*sizeof(int));
     
     /* Note: VHF Framer/deframer goes directly from packed codec/vc/proto bits to filled frame */
     if ((f->packed_codec_bits == NULL) || (f->codec_bits == NULL))
         return NULL;
 
     if ((mode == FREEDV_MODE_700) || (mode == FREEDV_MODE_700B) || (mode == FREEDV_MODE_700C) ) {        // change modem rates to 8000 sps
-        f->ptFilter7500to8000 = (struct quisk_cfFilter *)malloc(sizeof(struct quisk_cfFilter));
-        f->ptFilter8000to7500 = (struct quisk_cfFilter *)malloc(sizeof(struct quisk_cfFilter));
-        quisk_filt_cfInit(f->ptFilter8000to7500, quiskFilt120t480, sizeof(quiskFilt120t480)/sizeof(float));
-        quisk_filt_cfInit(f->ptFilter7500to8000, quiskFilt120t480, sizeof(quiskFilt120t480)/sizeof(float));
+        f->ptFilter7500to8000 = (struct quisk_cfFilter *)codec2_malloc(sizeof(struct quisk_cfFilter));
+        f->ptFilter8000to7500 = (struct quisk_cfFilter *)codec2_malloc(sizeof(struct quisk_cfFilter));
+        quisk_filt_cfInit(f->ptFilter8000to7500, quiskFilt120t480, sizeof(quiskFilt120t480)/sizeof(float), f->n_max_modem_samples);
+        quisk_filt_cfInit(f->ptFilter7500to8000, quiskFilt120t480, sizeof(quiskFilt120t480)/sizeof(float), f->n_max_modem_samples);
     }
     else {
         f->ptFilter7500to8000 = NULL;
         f->ptFilter8000to7500 = NULL;
     }
 
+    /* made now so setting up the data channel later doesn't need the heap */
+
+    if (f->deframer != NULL)
+        f->fdc = freedv_data_channel_create();
+
     varicode_decode_init(&f->varicode_dec_states, 1);
     f->nvaricode_bits = 0;
     f->varicode_bit_index = 0;
@@ -325,10 +334,15 @@ struct freedv *freedv_open(int mode) {
 void freedv_close(struct freedv *freedv) {
     assert(freedv != NULL);
 
-    free(freedv->prev_rx_bits);
-    free(freedv->packed_codec_bits);
-    free(freedv->codec_bits);
-    free(freedv->tx_bits);
+    /* the deframer destroys the data channel it was given */
+
+    if (freedv->fdc && ((freedv->deframer == NULL) || (freedv->deframer->fdc != freedv->fdc)))
+        freedv_data_channel_destroy(freedv->fdc);
+
+    codec2_free(freedv->prev_rx_bits);
+    codec2_free(freedv->packed_codec_bits);
+    codec2_free(freedv->codec_bits);
+    codec2_free(freedv->tx_bits);
     if (freedv->mode == FREEDV_MODE_1600)
         fdmdv_destroy(freedv->fdmdv);
 #ifndef CORTEX_M4
@@ -348,15 +362,54 @@ void freedv_close(struct freedv *freedv) {
     codec2_destroy(freedv->codec2);
     if (freedv->ptFilter8000to7500) {
         quisk_filt_destroy(freedv->ptFilter8000to7500);
-        free(freedv->ptFilter8000to7500);
+        codec2_free(freedv->ptFilter8000to7500);
         freedv->ptFilter8000to7500 = NULL;
     }
     if (freedv->ptFilter7500to8000) {
         quisk_filt_destroy(freedv->ptFilter7500to8000);
-        free(freedv->ptFilter7500to8000);
+        codec2_free(freedv->ptFilter7500to8000);
         freedv->ptFilter7500to8000 = NULL;
     }
-    free(freedv);
+    codec2_free(freedv);
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: freedv_size / freedv_open_arena
+  DATE CREATED: Oct 2026
+
+  freedv_open_arena() is freedv_open() with the codec, modem and all
+  buffers placed in the size bytes at mem, which must be at least
+  freedv_size(mode).  Nothing after it touches the heap, apart from
+  freedv_set_alt_modem_samp_rate().  freedv_close() releases mem for
+  reuse.  freedv_size() opens and closes a heap instance to measure,
+  so call it at start up.
+
+\*---------------------------------------------------------------------------*/
+
+size_t freedv_size(int mode) {
+    struct CODEC2_ARENA arena;
+    struct freedv      *f;
+
+    codec2_arena_begin(&arena, NULL, 0);
+    f = freedv_open(mode);
+    codec2_arena_end(&arena, f);
+    if (f == NULL)
+        return 0;
+    freedv_close(f);
+
+    return arena.used + CODEC2_ARENA_ALIGN;
+}
+
+struct freedv *freedv_open_arena(int mode, void *mem, size_t size) {
+    struct CODEC2_ARENA arena;
+    struct freedv      *f;
+
+    codec2_arena_begin(&arena, mem, size);
+    f = freedv_open(mode);
+    codec2_arena_end(&arena, f);
+
+    return f;
 }
 
 /*---------------------------------------------------------------------------*\
@@ -1310,31 +1363,42 @@ static int freedv_comprx_fdmdv_700(struct freedv *f, COMP demod_in_8kHz[], int *
 #endif
 
 
-int freedv_comprx(struct freedv *f, short speech_out[], COMP demod_in[]) {
-    assert(f != NULL);
-    int                 bits_per_codec_frame, bytes_per_codec_frame;
-    int                 i, nout = 0;
-    int valid;
-    
-    assert(f->nin <= f->n_max_modem_samples);
+/* demod and FEC decode of one frame, codec bits are left in
+   f->packed_codec_bits */
 
-    bits_per_codec_frame  = codec2_bits_per_frame(f->codec2);
-    bytes_per_codec_frame = (bits_per_codec_frame + 7) / 8;
+static int freedv_comprx_modem(struct freedv *f, COMP demod_in[], int *valid) {
+    int nout = 0;
 
     if (f->mode == FREEDV_MODE_1600) {
-        nout = freedv_comprx_fdmdv_1600(f, demod_in, &valid);
+        nout = freedv_comprx_fdmdv_1600(f, demod_in, valid);
     }
 #ifndef CORTEX_M4
     if ((f->mode == FREEDV_MODE_700) || (f->mode == FREEDV_MODE_700B) || (f->mode == FREEDV_MODE_700C)) {
-        nout = freedv_comprx_fdmdv_700(f, demod_in, &valid);
+        nout = freedv_comprx_fdmdv_700(f, demod_in, valid);
         //valid = -1;
     }
 
     if( (f->mode == FREEDV_MODE_2400A) || (f->mode == FREEDV_MODE_2400B) || (f->mode == FREEDV_MODE_800XA)){
-        nout = freedv_comprx_fsk(f, demod_in, &valid);
+        nout = freedv_comprx_fsk(f, demod_in, valid);
     }
 #endif
 
+    return nout;
+}
+
+int freedv_comprx(struct freedv *f, short speech_out[], COMP demod_in[]) {
+    assert(f != NULL);
+    int                 bits_per_codec_frame, bytes_per_codec_frame;
+    int                 i, nout = 0;
+    int valid;
+    
+    assert(f->nin <= f->n_max_modem_samples);
+
+    bits_per_codec_frame  = codec2_bits_per_frame(f->codec2);
+    bytes_per_codec_frame = (bits_per_codec_frame + 7) / 8;
+
+    nout = freedv_comprx_modem(f, demod_in, &valid);
+
     if (valid == 0) {
         for (i = 0; i < nout; i++)
             speech_out[i] = 0;
@@ -1355,6 +1419,41 @@ int freedv_comprx(struct freedv *f, short speech_out[], COMP demod_in[]) {
     return nout;
 }
 
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: freedv_comprx_demod
+  DATE CREATED: Oct 2026
+
+  The first half of freedv_comprx(): demodulates one frame of
+  freedv_nin() samples and decodes its FEC, without running the speech
+  decoder.  Returns the number of speech samples the frame makes, and
+  sets *valid to 1 when packed_codec_bits[] holds the frame's codec
+  bits, 0 when the output should be squelched, or -1 when the input
+  should be echoed.  Lets the speech decoder run elsewhere, e.g. in the
+  pipelined receiver.
+
+\*---------------------------------------------------------------------------*/
+
+int freedv_comprx_demod(struct freedv *f, unsigned char *packed_codec_bits, int *valid, COMP demod_in[])
+{
+    assert(f != NULL);
+    int nout;
+
+    assert(f->nin <= f->n_max_modem_samples);
+
+    *valid = 0;
+    nout = freedv_comprx_modem(f, demod_in, valid);
+    if (*valid == 1) {
+        int bits_per_codec_frame = codec2_bits_per_frame(f->codec2);
+        int bytes_per_codec_frame = (bits_per_codec_frame + 7) / 8;
+        int codec_frames = f->n_codec_bits / bits_per_codec_frame;
+
+        memcpy(packed_codec_bits, f->packed_codec_bits, bytes_per_codec_frame * codec_frames);
+    }
+
+    return nout;
+}
+
 int freedv_codecrx(struct freedv *f, unsigned char *packed_codec_bits, short demod_in[])
 {
     assert(f != NULL);
@@ -1480,7 +1579,7 @@ void freedv_set_callback_protocol(struct freedv *f, freedv_callback_protorx rx,
 void freedv_set_callback_data(struct freedv *f, freedv_callback_datarx datarx, freedv_callback_datatx datatx, void *callback_state) {
     if ((f->mode == FREEDV_MODE_2400A) || (f->mode == FREEDV_MODE_2400B) || (f->mode == FREEDV_MODE_800XA)){
         if (!f->deframer->fdc)
-            f->deframer->fdc = freedv_data_channel_create();
+            f->deframer->fdc = f->fdc ? f->fdc : freedv_data_channel_create();
         if (!f->deframer->fdc)
             return;
         
@@ -1504,7 +1603,7 @@ void freedv_set_data_header(struct freedv *f, unsigned char *header)
 {
     if ((f->mode == FREEDV_MODE_2400A) || (f->mode == FREEDV_MODE_2400B) || (f->mode == FREEDV_MODE_800XA)){
         if (!f->deframer->fdc)
-            f->deframer->fdc = freedv_data_channel_create();
+            f->deframer->fdc = f->fdc ? f->fdc : freedv_data_channel_create();
         if (!f->deframer->fdc)
             return;
         
@@ -1594,9 +1693,9 @@ int freedv_set_alt_modem_samp_rate(struct freedv *f, int samp_rate){
 			fsk_destroy(f->fsk);
 			f->fsk = fsk_create_hbr(samp_rate,1200,10,4,1200,1200);
         
-			free(f->tx_bits);
+			codec2_free(f->tx_bits);
 			/* Note: fsk expects tx/rx bits as an array of uint8_ts, not ints */
-			f->tx_bits = (int*)malloc(f->fsk->Nbits*sizeof(uint8_t));
+			f->tx_bits = (int*)codec2_malloc(f->fsk->Nbits*sizeof(uint8_t));
         
 			f->n_nom_modem_samples = f->fsk->N;
 			f->n_max_modem_samples = f->fsk->N + (f->fsk->Ts);
@@ -1691,15 +1790,16 @@ void freedv_get_modem_extended_stats(struct freedv *f, struct MODEM_STATS *stats
 
 \*---------------------------------------------------------------------------*/
 
-static void quisk_filt_cfInit(struct quisk_cfFilter * filter, float * coefs, int taps)
+static void quisk_filt_cfInit(struct quisk_cfFilter * filter, float * coefs, int taps, int count)
 {    // Prepare a new filter using coefs and taps.  Samples are complex.
+     // The sample buffer is sized for count samples per call up front.
     filter->dCoefs = coefs;
-    filter->cSamples = (COMP *)malloc(taps * sizeof(COMP));
+    filter->cSamples = (COMP *)codec2_malloc(taps * sizeof(COMP));
     memset(filter->cSamples, 0, taps * sizeof(COMP));
     filter->ptcSamp = filter->cSamples;
     filter->nTaps = taps;
-    filter->cBuf = NULL;
-    filter->nBuf = 0;
+    filter->cBuf = (COMP *)codec2_malloc(count * sizeof(COMP));
+    filter->nBuf = filter->cBuf ? count : 0;
     filter->decim_index = 0;
 }
 
@@ -1716,11 +1816,11 @@ static void quisk_filt_cfInit(struct quisk_cfFilter * filter, float * coefs, int
 static void quisk_filt_destroy(struct quisk_cfFilter * filter)
 {
     if (filter->cSamples) {
-        free(filter->cSamples);
+        codec2_free(filter->cSamples);
         filter->cSamples = NULL;
     }
     if (filter->cBuf) {
-        free(filter->cBuf);
+        codec2_free(filter->cBuf);
         filter->cBuf = NULL;
     }
 }
@@ -1749,8 +1849,8 @@ static int quisk_cfInterpDecim(COMP * cSamples, int count, struct quisk_cfFilter
     if (count > filter->nBuf) {    // increase size of sample buffer
         filter->nBuf = count * 2;
         if (filter->cBuf)
-            free(filter->cBuf);
-        filter->cBuf = (COMP *)malloc(filter->nBuf * sizeof(COMP));
+            codec2_free(filter->cBuf);
+        filter->cBuf = (COMP *)codec2_malloc(filter->nBuf * sizeof(COMP));
     }
     memcpy(filter->cBuf, cSamples, count * sizeof(COMP));
     nOut = 0;
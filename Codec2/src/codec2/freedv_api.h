@@ -78,6 +78,8 @@ typedef void (*freedv_callback_datatx)(void *, unsigned char *packet, size_t *si
 
 struct freedv *freedv_open(int mode);
 void freedv_close   (struct freedv *freedv);
+size_t freedv_size(int mode);
+struct freedv *freedv_open_arena(int mode, void *mem, size_t size);
 
 // Transmit -------------------------------------------------------------------
 
@@ -93,6 +95,7 @@ int freedv_nin      (struct freedv *freedv);
 int freedv_rx       (struct freedv *freedv, short speech_out[], short demod_in[]);
 int freedv_floatrx  (struct freedv *freedv, short speech_out[], float demod_in[]);
 int freedv_comprx   (struct freedv *freedv, short speech_out[], COMP  demod_in[]);
+int freedv_comprx_demod(struct freedv *freedv, unsigned char *packed_codec_bits, int *valid, COMP demod_in[]);
 int freedv_codecrx  (struct freedv *freedv, unsigned char *packed_codec_bits, short demod_in[]);
 
 // Set parameters ------------------------------------------------------------
@@ -135,6 +138,29 @@ int freedv_get_n_codec_bits             (struct freedv *freedv);
 int freedv_get_sz_error_pattern     (struct freedv *freedv);
 int freedv_get_protocol_bits        (struct freedv *freedv);
 
+// Pipelined receive ----------------------------------------------------------
+
+#define FREEDV_STAGE_DEMOD    0     /* demod, sync and FEC */
+#define FREEDV_STAGE_DECODE   1     /* speech decode       */
+#define FREEDV_STAGES         2
+
+struct freedv_pipeline;
+
+struct freedv_pipeline_stats {
+    int   frames[FREEDV_STAGES];
+    float latency_ms[FREEDV_STAGES];      /* mean time per frame */
+    float max_latency_ms[FREEDV_STAGES];
+    int   stalls[FREEDV_STAGES];          /* times blocked by a full queue downstream */
+    int   in_samples;                     /* modem samples queued */
+    int   out_samples;                    /* speech samples ready */
+};
+
+struct freedv_pipeline *freedv_pipeline_create(struct freedv *freedv, int frames, int threaded);
+void freedv_pipeline_destroy        (struct freedv_pipeline *p);
+int freedv_pipeline_write           (struct freedv_pipeline *p, short demod_in[], int n);
+int freedv_pipeline_read            (struct freedv_pipeline *p, short speech_out[], int n);
+void freedv_pipeline_get_stats      (struct freedv_pipeline *p, struct freedv_pipeline_stats *stats);
+
 #endif
 
 #ifdef __cplusplus
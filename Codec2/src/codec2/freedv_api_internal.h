@@ -54,7 +54,7 @@ struct quisk_cfFilter {        // Structure to hold the static data for FIR filt
 } ;
 
 static int quisk_cfInterpDecim(COMP *, int, struct quisk_cfFilter *, int, int);
-static void quisk_filt_cfInit(struct quisk_cfFilter *, float *, int);
+static void quisk_filt_cfInit(struct quisk_cfFilter *, float *, int, int);
 static void quisk_filt_destroy(struct quisk_cfFilter *);
 static float quiskFilt120t480[480];
 
@@ -69,6 +69,7 @@ struct freedv {
     struct FMFSK        *fmfsk;
     
     struct freedv_vhf_deframer * deframer;      //Extracts frames from VHF stream
+    struct freedv_data_channel * fdc;           //Data channel made at open, given to the deframer on first use
 
     struct quisk_cfFilter * ptFilter7500to8000;     // Filters to change to/from 7500 and 8000 sps
     struct quisk_cfFilter * ptFilter8000to7500;
@@ -29,6 +29,7 @@
 */
 
 #include "freedv_data_channel.h"
+#include "codec2_arena.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -108,7 +109,7 @@ struct freedv_data_channel *freedv_data_channel_create(void)
 {
     struct freedv_data_channel *fdc;
   
-    fdc = malloc(sizeof(struct freedv_data_channel));
+    fdc = codec2_malloc(sizeof(struct freedv_data_channel));
     if (!fdc)
         return NULL;
 
@@ -123,7 +124,7 @@ struct freedv_data_channel *freedv_data_channel_create(void)
 
 void freedv_data_channel_destroy(struct freedv_data_channel *fdc)
 {
-    free(fdc);
+    codec2_free(fdc);
 }
 
 
@@ -0,0 +1,489 @@
+/*---------------------------------------------------------------------------*\
+
+  FILE........: freedv_pipeline.c
+  DATE CREATED: Oct 2026
+
+  Pipelined FreeDV receiver.  Modem samples written by the caller go
+  through a FIFO to a demod stage (demodulation, sync and FEC), which
+  passes frames of codec bits through a ring of frame slots to a speech
+  decode stage, which writes speech to a FIFO the caller reads from.
+
+  When built with FREEDV_PIPELINE_THREADS (needs pthreads, so not for
+  the Cortex M4) each stage can run on its own worker thread, so on a
+  multi core machine one stream's demod overlaps its speech decoding,
+  and several streams don't queue up behind each other in the caller's
+  audio thread.  The FIFOs and the frame ring have a single writer and
+  a single reader each, so samples and frames pass between threads
+  without locks; the lock is only used to put idle workers to sleep.
+  Without worker threads the stages run in the caller's thread, inside
+  freedv_pipeline_write() and freedv_pipeline_read().
+
+  A full FIFO or ring stops the stage feeding it (backpressure), which
+  is counted in the stage's stalls, and freedv_pipeline_write() takes
+  only as many samples as there is room for.
+
+\*---------------------------------------------------------------------------*/
+
+/*
+  All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 2.1, as
+  published by the Free Software Foundation.  This program is
+  distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+  License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef FREEDV_PIPELINE_THREADS
+#include <pthread.h>
+#endif
+
+#include "freedv_api.h"
+#include "codec2.h"
+#include "codec2_fifo.h"
+
+#define STAGE_IDLE     0            /* nothing to do                          */
+#define STAGE_BLOCKED  1            /* input waiting, but no room for output  */
+#define STAGE_READY    2
+
+#define RING_LOAD(x)     __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define RING_STORE(x,v)  __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+
+struct pipeline_frame {
+    int            valid;           /* as freedv_comprx_demod()               */
+    int            nout;            /* speech samples this frame makes        */
+    unsigned char *bits;            /* packed codec bits, when valid == 1     */
+    short         *echo;            /* input samples, when valid == -1        */
+};
+
+struct pipeline_stage {
+    int            frames;
+    double         latency_sum;     /* ms                                     */
+    float          latency_max;
+    int            stalls;
+};
+
+struct freedv_pipeline {
+    struct freedv         *f;
+    struct CODEC2         *c2;
+    int                    nmax;    /* most modem samples per frame           */
+    int                    noutmax; /* most speech samples per frame          */
+
+    struct FIFO           *in;      /* modem samples, caller to demod         */
+    struct FIFO           *out;     /* speech samples, decode to caller       */
+
+    struct pipeline_frame *ring;    /* frames, demod to decode                */
+    int                    nring;
+    int                    head;    /* next slot to fill, demod only writes   */
+    int                    tail;    /* next slot to empty, decode only writes */
+
+    short                 *samples; /* demod stage's input frame              */
+    COMP                  *rx;
+    short                 *speech;  /* decode stage's output frame            */
+
+    struct pipeline_stage  stage[FREEDV_STAGES];
+
+#ifdef FREEDV_PIPELINE_THREADS
+    int                    threaded;
+    pthread_t              threads[FREEDV_STAGES];
+    pthread_mutex_t        lock;
+    pthread_cond_t         wake;    /* broadcast when any FIFO or ring moves  */
+    int                    quit;
+#endif
+};
+
+/* stage latencies are timed with or without worker threads, from the
+   CPU clock where there is no monotonic one */
+
+static double pipeline_now_ms(void) {
+#ifdef CLOCK_MONOTONIC
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1E3 + t.tv_nsec*1E-6;
+#else
+    return clock()*(1E3/CLOCKS_PER_SEC);
+#endif
+}
+
+static void pipeline_lock(struct freedv_pipeline *p) {
+#ifdef FREEDV_PIPELINE_THREADS
+    if (p->threaded)
+        pthread_mutex_lock(&p->lock);
+#else
+    (void)p;
+#endif
+}
+
+static void pipeline_unlock(struct freedv_pipeline *p) {
+#ifdef FREEDV_PIPELINE_THREADS
+    if (p->threaded)
+        pthread_mutex_unlock(&p->lock);
+#else
+    (void)p;
+#endif
+}
+
+/* wakes any worker waiting for a FIFO or the ring to move */
+
+static void pipeline_signal(struct freedv_pipeline *p) {
+#ifdef FREEDV_PIPELINE_THREADS
+    if (p->threaded) {
+        pthread_mutex_lock(&p->lock);
+        pthread_cond_broadcast(&p->wake);
+        pthread_mutex_unlock(&p->lock);
+    }
+#else
+    (void)p;
+#endif
+}
+
+static void pipeline_log(struct freedv_pipeline *p, int s, double start) {
+    struct pipeline_stage *st = &p->stage[s];
+    float ms = pipeline_now_ms() - start;
+
+    pipeline_lock(p);
+    st->frames++;
+    st->latency_sum += ms;
+    if (ms > st->latency_max)
+        st->latency_max = ms;
+    pipeline_unlock(p);
+}
+
+/* demod stage ------------------------------------------------------------*/
+
+static int demod_state(struct freedv_pipeline *p) {
+    if (fifo_used(p->in) < freedv_nin(p->f))
+        return STAGE_IDLE;
+    if ((p->head + 1) % p->nring == RING_LOAD(p->tail))
+        return STAGE_BLOCKED;
+    return STAGE_READY;
+}
+
+static void demod_run(struct freedv_pipeline *p) {
+    struct pipeline_frame *fr = &p->ring[p->head];
+    int    nin = freedv_nin(p->f);
+    int    i, n;
+    double start = pipeline_now_ms();
+
+    fifo_read(p->in, p->samples, nin);
+    for(i=0; i<nin; i++) {
+        p->rx[i].real = (float)p->samples[i];
+        p->rx[i].imag = 0.0;
+    }
+
+    fr->nout = freedv_comprx_demod(p->f, fr->bits, &fr->valid, p->rx);
+    assert(fr->nout <= p->noutmax);
+    if (fr->valid < 0) {
+        n = (fr->nout < nin) ? fr->nout : nin;
+        memcpy(fr->echo, p->samples, sizeof(short)*n);
+        memset(&fr->echo[n], 0, sizeof(short)*(fr->nout - n));
+    }
+
+    RING_STORE(p->head, (p->head + 1) % p->nring);
+    pipeline_log(p, FREEDV_STAGE_DEMOD, start);
+}
+
+/* speech decode stage -----------------------------------------------------*/
+
+static int decode_state(struct freedv_pipeline *p) {
+    if (RING_LOAD(p->head) == p->tail)
+        return STAGE_IDLE;
+    if (fifo_free(p->out) < p->ring[p->tail].nout)
+        return STAGE_BLOCKED;
+    return STAGE_READY;
+}
+
+static void decode_run(struct freedv_pipeline *p) {
+    struct pipeline_frame *fr = &p->ring[p->tail];
+    int    n = codec2_samples_per_frame(p->c2);
+    int    nbytes = (codec2_bits_per_frame(p->c2) + 7)/8;
+    int    i;
+    double start = pipeline_now_ms();
+
+    if (fr->valid == 0)
+        memset(p->speech, 0, sizeof(short)*fr->nout);
+    else if (fr->valid < 0)
+        memcpy(p->speech, fr->echo, sizeof(short)*fr->nout);
+    else
+        for(i=0; i*n<fr->nout; i++)
+            codec2_decode(p->c2, &p->speech[i*n], &fr->bits[i*nbytes]);
+    fifo_write(p->out, p->speech, fr->nout);
+
+    RING_STORE(p->tail, (p->tail + 1) % p->nring);
+    pipeline_log(p, FREEDV_STAGE_DECODE, start);
+}
+
+/* runs one stage until it has nothing to do or is blocked, returns the
+   number of frames it did */
+
+static int stage_run(struct freedv_pipeline *p, int s) {
+    int state, done = 0;
+
+    for(;;) {
+        state = (s == FREEDV_STAGE_DEMOD) ? demod_state(p) : decode_state(p);
+        if (state != STAGE_READY)
+            break;
+        if (s == FREEDV_STAGE_DEMOD)
+            demod_run(p);
+        else
+            decode_run(p);
+        done++;
+    }
+    if ((state == STAGE_BLOCKED) && (done > 0)) {
+        pipeline_lock(p);
+        p->stage[s].stalls++;
+        pipeline_unlock(p);
+    }
+
+    return done;
+}
+
+/* runs the stages in the caller's thread until neither can move */
+
+static void pipeline_run(struct freedv_pipeline *p) {
+    int moved;
+
+    do {
+        moved = stage_run(p, FREEDV_STAGE_DEMOD);
+        moved += stage_run(p, FREEDV_STAGE_DECODE);
+    } while(moved);
+}
+
+#ifdef FREEDV_PIPELINE_THREADS
+
+static void pipeline_worker(struct freedv_pipeline *p, int s) {
+    for(;;) {
+        if (stage_run(p, s) > 0)
+            pipeline_signal(p);
+
+        pthread_mutex_lock(&p->lock);
+        while(!p->quit && (((s == FREEDV_STAGE_DEMOD) ? demod_state(p) : decode_state(p)) != STAGE_READY))
+            pthread_cond_wait(&p->wake, &p->lock);
+        if (p->quit) {
+            pthread_mutex_unlock(&p->lock);
+            return;
+        }
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+static void *demod_worker(void *arg) {
+    pipeline_worker((struct freedv_pipeline *)arg, FREEDV_STAGE_DEMOD);
+    return NULL;
+}
+
+static void *decode_worker(void *arg) {
+    pipeline_worker((struct freedv_pipeline *)arg, FREEDV_STAGE_DECODE);
+    return NULL;
+}
+
+#endif
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: freedv_pipeline_create
+
+  Makes a pipelined receiver for freedv, which must not be used
+  directly again until the pipeline is destroyed.  frames is the depth
+  of the queues between stages, in modem frames (at least 2).  When
+  threaded is non zero, and built with FREEDV_PIPELINE_THREADS, each
+  stage runs on its own worker thread, and the text and protocol
+  callbacks of freedv are called from the demod worker.  Returns NULL
+  on failure.
+
+\*---------------------------------------------------------------------------*/
+
+struct freedv_pipeline *freedv_pipeline_create(struct freedv *freedv, int frames, int threaded) {
+    struct freedv_pipeline *p;
+    int nbytes, i;
+
+    assert(freedv != NULL);
+    if (frames < 2)
+        frames = 2;
+
+    p = (struct freedv_pipeline *)calloc(1, sizeof(struct freedv_pipeline));
+    if (p == NULL)
+        return NULL;
+
+    p->f = freedv;
+    p->c2 = freedv_get_codec2(freedv);
+    p->nmax = freedv_get_n_max_modem_samples(freedv);
+    p->noutmax = freedv_get_n_speech_samples(freedv);
+    if (p->nmax > p->noutmax)
+        p->noutmax = p->nmax;
+    nbytes = freedv_get_n_codec_bits(freedv)/8 + 1;
+
+    /* one ring slot is always left empty */
+
+    p->nring = frames + 1;
+    p->ring = (struct pipeline_frame *)calloc(p->nring, sizeof(struct pipeline_frame));
+    p->samples = (short*)malloc(sizeof(short)*p->nmax);
+    p->rx = (COMP*)malloc(sizeof(COMP)*p->nmax);
+    p->speech = (short*)malloc(sizeof(short)*p->noutmax);
+    if ((p->ring == NULL) || (p->samples == NULL) || (p->rx == NULL) || (p->speech == NULL)) {
+        freedv_pipeline_destroy(p);
+        return NULL;
+    }
+    for(i=0; i<p->nring; i++) {
+        p->ring[i].bits = (unsigned char*)malloc(nbytes);
+        p->ring[i].echo = (short*)malloc(sizeof(short)*p->noutmax);
+        if ((p->ring[i].bits == NULL) || (p->ring[i].echo == NULL)) {
+            freedv_pipeline_destroy(p);
+            return NULL;
+        }
+    }
+    p->in = fifo_create(frames*p->nmax + 1);
+    p->out = fifo_create(frames*p->noutmax + 1);
+
+#ifdef FREEDV_PIPELINE_THREADS
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wake, NULL);
+    if (threaded) {
+        p->threaded = 1;
+        if (pthread_create(&p->threads[FREEDV_STAGE_DEMOD], NULL, demod_worker, p) != 0) {
+            p->threaded = 0;
+        }
+        else if (pthread_create(&p->threads[FREEDV_STAGE_DECODE], NULL, decode_worker, p) != 0) {
+            /* run the decode stage in the caller's thread then */
+            p->threaded = 0;
+            pthread_mutex_lock(&p->lock);
+            p->quit = 1;
+            pthread_cond_broadcast(&p->wake);
+            pthread_mutex_unlock(&p->lock);
+            pthread_join(p->threads[FREEDV_STAGE_DEMOD], NULL);
+            p->quit = 0;
+        }
+    }
+#else
+    (void)threaded;
+#endif
+
+    return p;
+}
+
+void freedv_pipeline_destroy(struct freedv_pipeline *p) {
+    int i;
+
+    assert(p != NULL);
+
+#ifdef FREEDV_PIPELINE_THREADS
+    if (p->threaded) {
+        pthread_mutex_lock(&p->lock);
+        p->quit = 1;
+        pthread_cond_broadcast(&p->wake);
+        pthread_mutex_unlock(&p->lock);
+        for(i=0; i<FREEDV_STAGES; i++)
+            pthread_join(p->threads[i], NULL);
+    }
+    if (p->in != NULL) {
+        pthread_cond_destroy(&p->wake);
+        pthread_mutex_destroy(&p->lock);
+    }
+#endif
+
+    if (p->ring != NULL)
+        for(i=0; i<p->nring; i++) {
+            free(p->ring[i].bits);
+            free(p->ring[i].echo);
+        }
+    free(p->ring);
+    free(p->samples);
+    free(p->rx);
+    free(p->speech);
+    if (p->in != NULL)
+        fifo_destroy(p->in);
+    if (p->out != NULL)
+        fifo_destroy(p->out);
+    free(p);
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: freedv_pipeline_write
+
+  Queues n modem samples, sampled at freedv_get_modem_sample_rate(),
+  any number at a time.  Returns the number taken, which is less than
+  n when the pipeline is backed up; write the rest later.
+
+\*---------------------------------------------------------------------------*/
+
+int freedv_pipeline_write(struct freedv_pipeline *p, short demod_in[], int n) {
+    int room;
+
+    assert(p != NULL);
+
+    room = fifo_free(p->in);
+    if (n > room)
+        n = room;
+    if (n > 0)
+        fifo_write(p->in, demod_in, n);
+
+#ifdef FREEDV_PIPELINE_THREADS
+    if (p->threaded) {
+        pipeline_signal(p);
+        return n;
+    }
+#endif
+    pipeline_run(p);
+
+    return n;
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: freedv_pipeline_read
+
+  Reads up to n samples of speech (or squelch or echoed input, as
+  freedv_rx() describes), returns the number read.
+
+\*---------------------------------------------------------------------------*/
+
+int freedv_pipeline_read(struct freedv_pipeline *p, short speech_out[], int n) {
+    int used;
+
+    assert(p != NULL);
+
+#ifdef FREEDV_PIPELINE_THREADS
+    if (!p->threaded)
+#endif
+        pipeline_run(p);
+
+    used = fifo_used(p->out);
+    if (n > used)
+        n = used;
+    if (n > 0) {
+        fifo_read(p->out, speech_out, n);
+        pipeline_signal(p);
+    }
+
+    return n;
+}
+
+/* stats, the latencies are the time each stage spends on a frame */
+
+void freedv_pipeline_get_stats(struct freedv_pipeline *p, struct freedv_pipeline_stats *stats) {
+    int s;
+
+    assert(p != NULL);
+
+    pipeline_lock(p);
+    for(s=0; s<FREEDV_STAGES; s++) {
+        stats->frames[s] = p->stage[s].frames;
+        stats->latency_ms[s] = p->stage[s].frames ? p->stage[s].latency_sum/p->stage[s].frames : 0.0;
+        stats->max_latency_ms[s] = p->stage[s].latency_max;
+        stats->stalls[s] = p->stage[s].stalls;
+    }
+    pipeline_unlock(p);
+    stats->in_samples = fifo_used(p->in);
+    stats->out_samples = fifo_used(p->out);
+}
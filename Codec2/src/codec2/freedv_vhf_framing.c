@@ -41,6 +41,7 @@
 #include <string.h>
 #include <assert.h>
 #include "freedv_vhf_framing.h"
+#include "codec2_arena.h"
 
 /* The voice UW of the VHF type A frame */
 static const uint8_t A_uw_v[] =    {0,1,1,0,0,1,1,1,
@@ -290,12 +291,21 @@ void fvhff_frame_data_bits(struct freedv_vhf_deframer * def, int frame_type,
     }
 }
 
+/* Pack a UW, first bit in the MSB */
+static uint32_t fvhff_pack_uw(const uint8_t uw[], int uw_size){
+    uint32_t w = 0;
+    int i;
+    for(i=0; i<uw_size; i++)
+        w = (w<<1) | uw[i];
+    return w;
+}
+
 /* Init and allocate memory for a freedv-vhf framer/deframer */
 struct freedv_vhf_deframer * fvhff_create_deframer(uint8_t frame_type, int enable_bit_flip){
     struct freedv_vhf_deframer * deframer;
-    uint8_t *bits,*invbits;
     int frame_size;
     int uw_size;
+    int uw_offset;
     
     assert( (frame_type == FREEDV_VHF_FRAME_A) || (frame_type == FREEDV_HF_FRAME_B) );
     
@@ -303,37 +313,34 @@ struct freedv_vhf_deframer * fvhff_create_deframer(uint8_t frame_type, int enabl
     if(frame_type == FREEDV_VHF_FRAME_A){
         frame_size = 96;
         uw_size = 16;
+        uw_offset = 40;
     }else if(frame_type == FREEDV_HF_FRAME_B){
         frame_size = 64;
         uw_size = 8;
+        uw_offset = 0;
     }else{
         return NULL;
     }
     
     /* Allocate memory for the thing */
-    deframer = malloc(sizeof(struct freedv_vhf_deframer));
+    deframer = codec2_malloc(sizeof(struct freedv_vhf_deframer));
     if(deframer == NULL)
         return NULL;
-        
-    /* Allocate the not-bit buffer */
-    if(enable_bit_flip){
-        invbits = malloc(sizeof(uint8_t)*frame_size);
-        if(invbits == NULL)
-            return NULL;
+    
+    /* Bits are kept packed, inverted bits are worked out as they're needed */
+    memset(deframer->buf,0,sizeof(deframer->buf));
+    deframer->bit_flip = enable_bit_flip;
+    if(frame_type == FREEDV_VHF_FRAME_A){
+        deframer->uw[0] = fvhff_pack_uw(A_uw_v,uw_size);
+        deframer->uw[1] = fvhff_pack_uw(A_uw_d,uw_size);
     }else{
-        invbits = NULL;
+        deframer->uw[0] = fvhff_pack_uw(B_uw_v,uw_size);
+        deframer->uw[1] = fvhff_pack_uw(B_uw_d,uw_size);
     }
-    
-    /* Allocate the bit buffer */
-    bits = malloc(sizeof(uint8_t)*frame_size);
-    if(bits == NULL)
-        return NULL;
-    
-    deframer->bits = bits;
-    deframer->invbits = invbits;
+    deframer->uw_offset = uw_offset;
+
     deframer->ftype = frame_type;
     deframer->state = ST_NOSYNC;
-    deframer->bitptr = 0;
     deframer->last_uw = 0;
     deframer->miss_cnt = 0;
     deframer->frame_size = frame_size;
@@ -390,69 +397,99 @@ int fvhff_get_varicode_size(struct freedv_vhf_deframer * def){
 
 void fvhff_destroy_deframer(struct freedv_vhf_deframer * def){
     freedv_data_channel_destroy(def->fdc);
-    free(def->bits);
-    free(def);
+    codec2_free(def);
 }
 
 int fvhff_synchronized(struct freedv_vhf_deframer * def){
     return (def->state) == ST_SYNC;
 }
 
-/* See if the UW is where it should be, to within a tolerance, in a bit buffer */
-static int fvhff_match_uw(struct freedv_vhf_deframer * def,uint8_t bits[],int tol,int *rdiff, enum frame_payload_type *pt){
-    int frame_type  = def->ftype;
-    int bitptr      = def->bitptr;
-    int frame_size  = def->frame_size;
-    int uw_len      = def->uw_size;
-    int iuw,ibit;
-    const uint8_t * uw[2];
-    int uw_offset;
-    int diff[2] = { 0, 0 };
-    int i;
-    int match[2];
-    int r;
+/*
+ * The deframer keeps its bits packed in 64 bit words, the last frame's
+ * bits followed by the new ones.  A frame seen after bit i has come in
+ * starts at bit i+1 of that stream, so each field is a shift and a mask
+ * and the inverted bits for FMFSK are just the complement.
+ */
 
-    /* defaults to make compiler happy on -O3 */
+/* CLZ is an instruction on the M4, the builtin maps straight to it */
+#if defined(__GNUC__)
+#define fvhff_clz64(x) __builtin_clzll(x)
+#else
+static inline int fvhff_clz64(uint64_t x){
+    int n = 0;
+    while(!(x & ((uint64_t)1<<63))){
+        x <<= 1;
+        n++;
+    }
+    return n;
+}
+#endif
+
+#if defined(__POPCNT__) || defined(__ARM_NEON)
+#define fvhff_popcount(c) __builtin_popcount(c)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define fvhff_popcount(c) __popcnt(c)
+#else
+/* the builtin is a library call unless the target has a popcount instruction */
+static inline int fvhff_popcount(uint32_t c){
+    c = c - ((c >> 1) & 0x55555555);
+    c = (c & 0x33333333) + ((c >> 2) & 0x33333333);
+    c = (c + (c >> 4)) & 0x0F0F0F0F;
+    return (c * 0x01010101) >> 24;
+}
+#endif
+
+/* Get n (1..64) bits starting at bit o of the stream, first bit in the MSB of the result */
+static inline uint64_t fvhff_get(const uint64_t buf[], int o, int n){
+    int w = o>>6;
+    int b = o&63;
+    uint64_t v = buf[w]<<b;
+    if(b)
+        v |= buf[w+1]>>(64-b);
+    return v>>(64-n);
+}
 
-    *pt = FRAME_PAYLOAD_TYPE_VOICE; 
-    *rdiff = 0;
+/* Get n bits of the frame starting at bit o, a field at k, from the inverted stream if inv */
+static inline uint64_t fvhff_field(struct freedv_vhf_deframer * def,int o,int inv,int k,int n){
+    uint64_t v = fvhff_get(def->buf,o+k,n);
+    if(inv)
+        v = ~v & (~(uint64_t)0>>(64-n));
+    return v;
+}
 
-    /* Set up parameters for the standard type of frame */
-    if(frame_type == FREEDV_VHF_FRAME_A){
-        uw[0] = A_uw_v;
-        uw[1] = A_uw_d;
-        uw_len = 16;
-        uw_offset = 40;
-    } else if(frame_type == FREEDV_HF_FRAME_B){
-        uw[0] = B_uw_v;
-        uw[1] = B_uw_d;
-        uw_len = 8;
-        uw_offset = 0;
-    } else {
-        return 0;
+/* Pack n bits, first bit in the MSB of out[0], padding the last byte with zeros */
+static void fvhff_put(uint8_t out[],uint64_t v,int n){
+    int i;
+    v <<= 64-n;
+    for(i=0; i<(n+7)/8; i++){
+        out[i] = v>>56;
+        v <<= 8;
     }
-    
-    /* Check both the voice and data UWs */
-    for (i = 0; i < 2; i++) {
-        /* Start bit pointer where UW should be */
-        ibit = bitptr + uw_offset;
-        if(ibit >= frame_size) ibit -= frame_size;
-        /* Walk through and match bits in frame with bits of UW */
-        for(iuw=0; iuw<uw_len; iuw++){
-            if(bits[ibit] != uw[i][iuw]) diff[i]++;
-            ibit++;
-            if(ibit >= frame_size) ibit = 0;
-        }
-        match[i] = diff[i] <= tol;
+}
+
+/* See if the UW is where it should be, to within a tolerance, in the frame starting at bit o */
+static int fvhff_match_uw(struct freedv_vhf_deframer * def,int o,int inv,int tol,int *rdiff, enum frame_payload_type *pt){
+    int uw_len = def->uw_size;
+    uint32_t w = fvhff_get(def->buf,o+def->uw_offset,uw_len);
+    int diff[2];
+    int r;
+
+    /* Check both the voice and data UWs, an inverted UW misses where this one hits */
+    diff[0] = fvhff_popcount(w ^ def->uw[0]);
+    diff[1] = fvhff_popcount(w ^ def->uw[1]);
+    if(inv){
+        diff[0] = uw_len - diff[0];
+        diff[1] = uw_len - diff[1];
     }
-    /* Pick the best matching UW */
 
+    /* Pick the best matching UW */
     if (diff[0] < diff[1]) {
-        r = match[0];
+        r = diff[0] <= tol;
         *rdiff = diff[0];
         *pt = FRAME_PAYLOAD_TYPE_VOICE;
     } else {
-        r = match[1];
+        r = diff[1] <= tol;
         *rdiff = diff[1];
         *pt = FRAME_PAYLOAD_TYPE_DATA;
     }
@@ -460,239 +497,119 @@ static int fvhff_match_uw(struct freedv_vhf_deframer * def,uint8_t bits[],int to
     return r;
 }
 
-static void fvhff_extract_frame_voice(struct freedv_vhf_deframer * def,uint8_t bits[],uint8_t codec2_out[],uint8_t proto_out[],uint8_t vc_out[]){
-    int frame_type  = def->ftype;
-    int bitptr      = def->bitptr;
-    int frame_size  = def->frame_size;
-    int iframe,ibit;
-    
-    if(frame_type == FREEDV_VHF_FRAME_A){
-        /* Extract codec2 bits */
-        memset(codec2_out,0,7);
-        ibit = 0;
-        /* Extract and pack first half, MSB first */
-        iframe = bitptr+16;
-        if(iframe >= frame_size) iframe-=frame_size;
-        for(;ibit<24;ibit++){
-            codec2_out[ibit>>3] |= (bits[iframe]&0x1)<<(7-(ibit&0x7));
-            iframe++;
-            if(iframe >= frame_size) iframe=0;
-        }
-        
-        /* Extract and pack last half, MSB first */
-        iframe = bitptr+56;
-        if(iframe >= frame_size) iframe-=frame_size;
-        for(;ibit<52;ibit++){
-            codec2_out[ibit>>3] |= (bits[iframe]&0x1)<<(7-(ibit&0x7));
-            iframe++;
-            if(iframe >= frame_size) iframe=0;
-        }
-        /* Extract varicode bits, if wanted */
-        if(vc_out!=NULL){
-            iframe = bitptr+90;
-            if(iframe >= frame_size) iframe-=frame_size;
-            vc_out[0] = bits[iframe];
-            iframe++;
-            vc_out[1] = bits[iframe];
-        }
-        /* Extract protocol bits, if proto is passed through */
-        if(proto_out!=NULL){
-            /* Clear protocol bit array */
-            memset(proto_out,0,3);
-            ibit = 0;
-            /* Extract and pack first half, MSB first */
-            iframe = bitptr+4;
-            if(iframe >= frame_size) iframe-=frame_size;
-            for(;ibit<12;ibit++){
-                proto_out[ibit>>3] |= (bits[iframe]&0x1)<<(7-(ibit&0x7));
-                iframe++;
-                if(iframe >= frame_size) iframe=0;
-            }
-            
-            /* Extract and pack last half, MSB first */
-            iframe = bitptr+84;
-            if(iframe >= frame_size) iframe-=frame_size;
-            for(;ibit<20;ibit++){
-                proto_out[ibit>>3] |= (bits[iframe]&0x1)<<(7-(ibit&0x7));
-                iframe++;
-                if(iframe >= frame_size) iframe=0;
-            }
-        }
+/* Bits in a count held one bit plane per word, enough for a 16 bit UW */
+#define FVHFF_PLANES 5
+
+/* Add one to the count of each lane set in m */
+static inline void fvhff_count(uint64_t c[],uint64_t m){
+    uint64_t t;
+    int k;
+    for(k=0; k<FVHFF_PLANES; k++){
+        t = c[k] & m;
+        c[k] ^= m;
+        m = t;
+    }
+}
 
-    }else if(frame_type == FREEDV_HF_FRAME_B){
-        /* Pointers to both c2 frames */
-        uint8_t * codec2_out1 = &codec2_out[0];
-        uint8_t * codec2_out2 = &codec2_out[4];
-        
-        /* Extract codec2 bits */
-        memset(codec2_out,0,8);
-        ibit = 0;
-        
-        /* Extract and pack first c2 frame, MSB first */
-        iframe = bitptr+8;
-        if(iframe >= frame_size) iframe-=frame_size;
-        for(;ibit<28;ibit++){
-            codec2_out1[ibit>>3] |= (bits[iframe]&0x1)<<(7-(ibit&0x7));
-            iframe++;
-            if(iframe >= frame_size) iframe=0;
-        }
-        
-        /* Extract and pack second c2 frame, MSB first */
-        iframe = bitptr+36;
-        ibit = 0;
-        if(iframe >= frame_size) iframe-=frame_size;
-        for(;ibit<28;ibit++){
-            codec2_out2[ibit>>3] |= (bits[iframe]&0x1)<<(7-(ibit&0x7));
-            iframe++;
-            if(iframe >= frame_size) iframe=0;
-        }
-    }else if(frame_type == FREEDV_VHF_FRAME_AT){
-        /* Extract codec2 bits */
-        memset(codec2_out,0,7);
-        ibit = 0;
-        /* Extract and pack first half, MSB first */
-        iframe = bitptr+12;
-        if(iframe >= frame_size) iframe-=frame_size;
-        for(;ibit<24;ibit++){
-            codec2_out[ibit>>3] |= (bits[iframe]&0x1)<<(7-(ibit&0x7));
-            iframe++;
-            if(iframe >= frame_size) iframe=0;
-        }
-        
-        /* Extract and pack last half, MSB first */
-        iframe = bitptr+52;
-        if(iframe >= frame_size) iframe-=frame_size;
-        for(;ibit<52;ibit++){
-            codec2_out[ibit>>3] |= (bits[iframe]&0x1)<<(7-(ibit&0x7));
-            iframe++;
-            if(iframe >= frame_size) iframe=0;
+/* Lanes whose count is <= k */
+static inline uint64_t fvhff_count_le(const uint64_t c[],int k){
+    uint64_t lt = 0;
+    uint64_t eq = ~(uint64_t)0;
+    int b;
+    for(b=FVHFF_PLANES-1; b>=0; b--){
+        if((k>>b) & 1){
+            lt |= eq & ~c[b];
+            eq &= c[b];
+        }else{
+            eq &= ~c[b];
         }
-        /* Extract varicode bits, if wanted */
+    }
+    return lt | eq;
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: fvhff_search_uw
+  DATE CREATED: Oct 2026
+
+  Looks for either UW, or if bit flip is on their inversions, within
+  tol bits after each new bit from i on.  Lane j of a word stands for
+  the frame after bit i+j, so XORing in each UW bit and keeping a
+  bit-sliced count of the misses finds the Hamming distance at 64
+  offsets in one pass.  Returns the first bit a UW was seen after, or
+  frame_size if there wasn't one.
+
+\*---------------------------------------------------------------------------*/
+
+static int fvhff_search_uw(struct freedv_vhf_deframer * def,int i,int tol){
+    int frame_size = def->frame_size;
+    int uw_len     = def->uw_size;
+    uint64_t cv[FVHFF_PLANES],cd[FVHFF_PLANES];
+    uint64_t s,hit;
+    int iuw,k;
+
+    for(; i<frame_size; i+=64){
+        for(k=0; k<FVHFF_PLANES; k++)
+            cv[k] = cd[k] = 0;
+        for(iuw=0; iuw<uw_len; iuw++){
+            s = fvhff_get(def->buf,i+1+def->uw_offset+iuw,64);
+            fvhff_count(cv, ((def->uw[0]>>(uw_len-1-iuw)) & 1) ? ~s : s);
+            fvhff_count(cd, ((def->uw[1]>>(uw_len-1-iuw)) & 1) ? ~s : s);
+        }
+        hit = fvhff_count_le(cv,tol) | fvhff_count_le(cd,tol);
+        if(def->bit_flip)
+            hit |= ~fvhff_count_le(cv,uw_len-tol-1) | ~fvhff_count_le(cd,uw_len-tol-1);
+        if(frame_size-i < 64)
+            hit &= ~(~(uint64_t)0>>(frame_size-i));
+        if(hit)
+            return i + fvhff_clz64(hit);
+    }
+    return frame_size;
+}
+
+static void fvhff_extract_frame_voice(struct freedv_vhf_deframer * def,int o,int inv,uint8_t codec2_out[],uint8_t proto_out[],uint8_t vc_out[]){
+    if(def->ftype == FREEDV_VHF_FRAME_A){
+        /* Codec2 bits either side of the UW */
+        fvhff_put(codec2_out, (fvhff_field(def,o,inv,16,24)<<28) | fvhff_field(def,o,inv,56,28), 52);
+
+        /* Varicode bits, if present */
         if(vc_out!=NULL){
-            iframe = bitptr+86;
-            if(iframe >= frame_size) iframe-=frame_size;
-            vc_out[0] = bits[iframe];
-            iframe++;
-            vc_out[1] = bits[iframe];
-        }
-        /* Extract protocol bits, if proto is passed through */
-        if(proto_out!=NULL){
-            /* Clear protocol bit array */
-            memset(proto_out,0,3);
-            ibit = 0;
-            /* Extract and pack first half, MSB first */
-            iframe = bitptr+4;
-            if(iframe >= frame_size) iframe-=frame_size;
-            for(;ibit<12;ibit++){
-                proto_out[ibit>>3] |= (bits[iframe]&0x1)<<(7-(ibit&0x7));
-                iframe++;
-                if(iframe >= frame_size) iframe=0;
-            }
-            
-            /* Extract and pack last half, MSB first */
-            iframe = bitptr+84;
-            if(iframe >= frame_size) iframe-=frame_size;
-            for(;ibit<20;ibit++){
-                proto_out[ibit>>3] |= (bits[iframe]&0x1)<<(7-(ibit&0x7));
-                iframe++;
-                if(iframe >= frame_size) iframe=0;
-            }
+            vc_out[0] = fvhff_field(def,o,inv,90,1);
+            vc_out[1] = fvhff_field(def,o,inv,91,1);
         }
 
+        /* Protocol bits, if present */
+        if(proto_out!=NULL)
+            fvhff_put(proto_out, (fvhff_field(def,o,inv,4,12)<<8) | fvhff_field(def,o,inv,84,8), 20);
+
+    }else if(def->ftype == FREEDV_HF_FRAME_B){
+        /* Two codec2 frames after the UW */
+        fvhff_put(&codec2_out[0], fvhff_field(def,o,inv,8,28), 28);
+        fvhff_put(&codec2_out[4], fvhff_field(def,o,inv,36,28), 28);
     }
 }
 
-static void fvhff_extract_frame_data(struct freedv_vhf_deframer * def,uint8_t bits[]){
-    int frame_type  = def->ftype;
-    int bitptr      = def->bitptr;
-    int frame_size  = def->frame_size;
-    int iframe,ibit;
-    
-    if(frame_type == FREEDV_VHF_FRAME_A){
+static void fvhff_extract_frame_data(struct freedv_vhf_deframer * def,int o,int inv){
+    if(def->ftype == FREEDV_VHF_FRAME_A){
         uint8_t data[8];
-        int end_bits = 0;
-        int from_bit;
-        int bcast_bit;
-    
-        iframe = bitptr+4;
-        if(iframe >= frame_size) iframe-=frame_size;
-        from_bit = bits[iframe];
-        iframe++;
-        if(iframe >= frame_size) iframe-=frame_size;
-        bcast_bit = bits[iframe];
-
-        /* Extract data bits */
-        memset(data,0,8);
-        ibit = 0;
-        /* Extract and pack first half, MSB first */
-        iframe = bitptr+8;
-        if(iframe >= frame_size) iframe-=frame_size;
-        for(;ibit<32;ibit++){
-            data[ibit>>3] |= (bits[iframe]&0x1)<<(7-(ibit&0x7));
-            iframe++;
-            if(iframe >= frame_size) iframe=0;
-        }
-        
-        /* Extract and pack last half, MSB first */
-        iframe = bitptr+56;
-        if(iframe >= frame_size) iframe-=frame_size;
-        for(;ibit<64;ibit++){
-            data[ibit>>3] |= (bits[iframe]&0x1)<<(7-(ibit&0x7));
-            iframe++;
-            if(iframe >= frame_size) iframe=0;
-        }
+        int end_bits  = fvhff_field(def,o,inv,88,4);
+        int from_bit  = fvhff_field(def,o,inv,4,1);
+        int bcast_bit = fvhff_field(def,o,inv,5,1);
+
+        /* Data bits either side of the UW */
+        fvhff_put(data, (fvhff_field(def,o,inv,8,32)<<32) | fvhff_field(def,o,inv,56,32), 64);
 
-        /* Extract endbits value, MSB first*/
-        iframe = bitptr+88;
-        ibit = 0;
-        if(iframe >= frame_size) iframe-=frame_size;
-        for(;ibit<4;ibit++){
-            end_bits |= (bits[iframe]&0x1)<<(3-(ibit));
-            iframe++;
-            if(iframe >= frame_size) iframe=0;
-        }
-    
         if (def->fdc) {
             freedv_data_channel_rx_frame(def->fdc, data, 8, from_bit, bcast_bit, 0, end_bits);
         }
-    } else if(frame_type == FREEDV_HF_FRAME_B){
+    } else if(def->ftype == FREEDV_HF_FRAME_B){
         uint8_t data[6];
-        int end_bits = 0;
-        int from_bit;
-        int bcast_bit;
-	int crc_bit;
-        
-        ibit = 0;
-        memset(data,0,6);
-        
-        /* Extract and pack first c2 frame, MSB first */
-        iframe = bitptr+8;
-        if(iframe >= frame_size) iframe-=frame_size;
-        for(;ibit<48;ibit++){
-            data[ibit>>3] |= (bits[iframe]&0x1)<<(7-(ibit&0x7));
-            iframe++;
-            if(iframe >= frame_size) iframe=0;
-        }
+        int end_bits  = fvhff_field(def,o,inv,60,4);
+        int from_bit  = fvhff_field(def,o,inv,56,1);
+        int bcast_bit = fvhff_field(def,o,inv,57,1);
+        int crc_bit   = fvhff_field(def,o,inv,58,1);
 
-        iframe = bitptr+56;
-        if(iframe >= frame_size) iframe-=frame_size;
-        from_bit = bits[iframe];
-        iframe++;
-        if(iframe >= frame_size) iframe-=frame_size;
-        bcast_bit = bits[iframe];
-        iframe++;
-        if(iframe >= frame_size) iframe-=frame_size;
-        crc_bit = bits[iframe];
-        
-        /* Extract endbits value, MSB first*/
-        iframe = bitptr+60;
-        ibit = 0;
-        if(iframe >= frame_size) iframe-=frame_size;
-        for(;ibit<4;ibit++){
-            end_bits |= (bits[iframe]&0x1)<<(3-(ibit));
-            iframe++;
-            if(iframe >= frame_size) iframe=0;
-        }
+        fvhff_put(data, fvhff_field(def,o,inv,8,48), 48);
 
         if (def->fdc) {
             freedv_data_channel_rx_frame(def->fdc, data, 6, from_bit, bcast_bit, crc_bit, end_bits);
@@ -700,34 +617,32 @@ static void fvhff_extract_frame_data(struct freedv_vhf_deframer * def,uint8_t bi
     }
 }
 
-static void fvhff_extract_frame(struct freedv_vhf_deframer * def,uint8_t bits[],uint8_t codec2_out[],uint8_t proto_out[],uint8_t vc_out[],enum frame_payload_type pt){
+static void fvhff_extract_frame(struct freedv_vhf_deframer * def,int o,int inv,uint8_t codec2_out[],uint8_t proto_out[],uint8_t vc_out[],enum frame_payload_type pt){
     switch (pt) {
         case FRAME_PAYLOAD_TYPE_VOICE:
-        fvhff_extract_frame_voice(def, bits, codec2_out, proto_out, vc_out);
+        fvhff_extract_frame_voice(def, o, inv, codec2_out, proto_out, vc_out);
         break;
     case FRAME_PAYLOAD_TYPE_DATA:
-        fvhff_extract_frame_data(def, bits);
+        fvhff_extract_frame_data(def, o, inv);
         break;
     }
 }
 
 /*
- * Try to find the UW and extract codec/proto/vc bits in def->frame_size bits 
+ * Try to find the UW and extract codec/proto/vc bits in def->frame_size bits,
+ * packed MSB first
  */
-int fvhff_deframe_bits(struct freedv_vhf_deframer * def,uint8_t codec2_out[],uint8_t proto_out[],uint8_t vc_out[],uint8_t bits_in[]){
-    uint8_t * strbits  = def->bits;
-    uint8_t * invbits  = def->invbits;
-    uint8_t * bits;
+int fvhff_deframe_packed(struct freedv_vhf_deframer * def,uint8_t codec2_out[],uint8_t proto_out[],uint8_t vc_out[],const uint8_t packed_in[]){
+    uint64_t * buf     = def->buf;
     int on_inv_bits = def->on_inv_bits;
     int frame_type  = def->ftype;
     int state       = def->state;
-    int bitptr      = def->bitptr;
     int last_uw     = def->last_uw;
     int miss_cnt    = def->miss_cnt;
     int frame_size  = def->frame_size;
     int uw_size     = def->uw_size;
     int uw_diff;
-    int i;
+    int i,o;
     int uw_first_tol;   
     int uw_sync_tol;
     int miss_tol;
@@ -746,82 +661,91 @@ int fvhff_deframe_bits(struct freedv_vhf_deframer * def,uint8_t codec2_out[],uin
     }else{
         return 0;
     }
-    /* Skip N bits for multi-bit symbol modems */
-    for(i=0; i<frame_size; i++){
-        /* Put a bit in the buffer */
-        strbits[bitptr] = bits_in[i];
-        /* If we're checking the inverted bitstream, put a bit in it */
-        if(invbits!=NULL)
-            invbits[bitptr] = bits_in[i]?0:1;
-        
-        bitptr++;
-        if(bitptr >= frame_size) bitptr -= frame_size;
-        def->bitptr = bitptr;
-        /* Enter state machine */
+
+    /* Put the new bits in the buffer after the last frame's */
+    for(i=0; i<frame_size/8; i++){
+        o = frame_size + 8*i;
+        buf[o>>6] |= (uint64_t)packed_in[i] << (56-(o&63));
+    }
+
+    /* Enter state machine, i is the next bit to come in */
+    i = 0;
+    while(i<frame_size){
         if(state==ST_SYNC){
             /* Already synchronized, just wait till UW is back where it should be */
-            last_uw++;
-            if(invbits!=NULL){
-                if(on_inv_bits)
-                    bits = invbits;
-                else
-                    bits = strbits;
-            }else{
-                bits=strbits;
+            if(frame_size-last_uw > frame_size-i){
+                last_uw += frame_size-i;
+                break;
             }
+            i += frame_size-last_uw;
+            o = i;
             /* UW should be here. We're sunk, so deframe anyway */
-            if(last_uw == frame_size){
-                last_uw = 0;
-                
-                if(!fvhff_match_uw(def,bits,uw_sync_tol,&uw_diff, &pt))
-                    miss_cnt++;
-                else
-                    miss_cnt=0;
-                
-                /* If we go over the miss tolerance, go into no-sync */
-                if(miss_cnt>miss_tol){
-                    state = ST_NOSYNC;
-                }
-                /* Extract the bits */
-                extracted_frame = 1;
-                fvhff_extract_frame(def,bits,codec2_out,proto_out,vc_out,pt);
-                
-                /* Update BER estimate */
-                def->ber_est = (.995*def->ber_est) + (.005*((float)uw_diff)/((float)uw_size));
-                def->total_uw_bits += uw_size;
-                def->total_uw_err += uw_diff;
+            last_uw = 0;
+            
+            if(!fvhff_match_uw(def,o,on_inv_bits,uw_sync_tol,&uw_diff, &pt))
+                miss_cnt++;
+            else
+                miss_cnt=0;
+            
+            /* If we go over the miss tolerance, go into no-sync */
+            if(miss_cnt>miss_tol){
+                state = ST_NOSYNC;
             }
+            /* Extract the bits */
+            extracted_frame = 1;
+            fvhff_extract_frame(def,o,on_inv_bits,codec2_out,proto_out,vc_out,pt);
+            
+            /* Update BER estimate */
+            def->ber_est = (.995f*def->ber_est) + (.005f*((float)uw_diff)/((float)uw_size));
+            def->total_uw_bits += uw_size;
+            def->total_uw_err += uw_diff;
         /* Not yet sunk */
         }else{
+            i = fvhff_search_uw(def,i,uw_first_tol);
+            if(i == frame_size){
+                /* Nothing this frame, pt is left as the last bit's match */
+                fvhff_match_uw(def,frame_size,0,uw_first_tol,&uw_diff,&pt);
+                break;
+            }
+            o = ++i;
             /* It's a sync!*/
-            if(invbits!=NULL){
-                if(fvhff_match_uw(def,invbits,uw_first_tol, &uw_diff, &pt)){
+            if(def->bit_flip){
+                if(fvhff_match_uw(def,o,1,uw_first_tol, &uw_diff, &pt)){
                     state = ST_SYNC;
                     last_uw = 0;
                     miss_cnt = 0;
                     extracted_frame = 1;
                     on_inv_bits = 1;
-                    fvhff_extract_frame(def,invbits,codec2_out,proto_out,vc_out,pt);
+                    fvhff_extract_frame(def,o,1,codec2_out,proto_out,vc_out,pt);
                     /* Update BER estimate */
-                    def->ber_est = (.995*def->ber_est) + (.005*((float)uw_diff)/((float)uw_size));
+                    def->ber_est = (.995f*def->ber_est) + (.005f*((float)uw_diff)/((float)uw_size));
                     def->total_uw_bits += uw_size;
                     def->total_uw_err += uw_diff;
                 }
             }
-            if(fvhff_match_uw(def,strbits,uw_first_tol, &uw_diff, &pt)){
+            if(fvhff_match_uw(def,o,0,uw_first_tol, &uw_diff, &pt)){
                 state = ST_SYNC;
                 last_uw = 0;
                 miss_cnt = 0;
                 extracted_frame = 1;
                 on_inv_bits = 0;
-                fvhff_extract_frame(def,strbits,codec2_out,proto_out,vc_out,pt);
+                fvhff_extract_frame(def,o,0,codec2_out,proto_out,vc_out,pt);
                 /* Update BER estimate */
-                def->ber_est = (.995*def->ber_est) + (.005*((float)uw_diff)/((float)uw_size));
+                def->ber_est = (.995f*def->ber_est) + (.005f*((float)uw_diff)/((float)uw_size));
                 def->total_uw_bits += uw_size;
                 def->total_uw_err += uw_diff;
             }
         }
     }
+
+    /* The new bits are the next call's history */
+    for(i=0; i<frame_size; i+=64)
+        buf[i>>6] = fvhff_get(buf,frame_size+i,64);
+    if(frame_size & 63)
+        buf[frame_size>>6] &= ~(~(uint64_t)0>>(frame_size&63));
+    for(i=(frame_size+63)>>6; i<FVHFF_BUF_WORDS; i++)
+        buf[i] = 0;
+
     def->state = state;
     def->last_uw = last_uw;
     def->miss_cnt = miss_cnt;
@@ -829,3 +753,17 @@ int fvhff_deframe_bits(struct freedv_vhf_deframer * def,uint8_t codec2_out[],uin
     /* return zero for data frames, they are already handled by callback */
     return extracted_frame && pt == FRAME_PAYLOAD_TYPE_VOICE;
 }
+
+/*
+ * As fvhff_deframe_packed(), for demods that give one bit per byte
+ */
+int fvhff_deframe_bits(struct freedv_vhf_deframer * def,uint8_t codec2_out[],uint8_t proto_out[],uint8_t vc_out[],uint8_t bits_in[]){
+    uint8_t packed_in[96/8];
+    int i;
+
+    memset(packed_in,0,sizeof(packed_in));
+    for(i=0; i<def->frame_size; i++)
+        packed_in[i>>3] |= (bits_in[i]&0x1)<<(7-(i&0x7));
+
+    return fvhff_deframe_packed(def,codec2_out,proto_out,vc_out,packed_in);
+}
@@ -43,13 +43,18 @@
 #define FREEDV_HF_FRAME_B 2     /* 800XA Frame */
 #define FREEDV_VHF_FRAME_AT 3   /* 4800T Frame */
 
+/* Last frame's bits then the new ones, packed, with a spare word so
+   64 bit reads at any offset stay inside */
+#define FVHFF_BUF_WORDS 4
+
 struct freedv_vhf_deframer {
     int ftype;          /* Type of frame to be looking for */
     int state;          /* State of deframer */
-    uint8_t * bits;     /* Bits currently being decanted */
-    uint8_t * invbits;  /* Inversion of bits currently being decanted, for FMFSK */
-    
-    int bitptr;         /* Pointer into circular bit buffer */
+    uint64_t buf[FVHFF_BUF_WORDS]; /* Bits currently being decanted, first bit in the MSB of buf[0] */
+    int bit_flip;       /* Also look for inverted bits, for FMFSK */
+    uint32_t uw[2];     /* Voice and data UWs, packed, first bit in the MSB */
+    int uw_offset;      /* Where the UW starts in a frame */
+
     int miss_cnt;       /* How many UWs have been missed */
     int last_uw;        /* How many bits since the last UW? */
     int frame_size;     /* How big is a frame? */
@@ -86,6 +91,8 @@ void fvhff_frame_data_bits(struct freedv_vhf_deframer * def, int frame_type,uint
 
 /* Find and extract frames from a stream of bits */
 int fvhff_deframe_bits(struct freedv_vhf_deframer * def,uint8_t codec2_out[],uint8_t proto_out[],uint8_t vc_out[],uint8_t bits_in[]);
+/* As fvhff_deframe_bits(), with frame_size bits packed MSB first into bytes */
+int fvhff_deframe_packed(struct freedv_vhf_deframer * def,uint8_t codec2_out[],uint8_t proto_out[],uint8_t vc_out[],const uint8_t packed_in[]);
 
 /* Is the de-framer synchronized? */
 int fvhff_synchronized(struct freedv_vhf_deframer * def);
@@ -71,12 +71,14 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <math.h>
 
+#include "codec2_math.h"
 #include "fsk.h"
 #include "comp_prim.h"
-#include "kiss_fftr.h"
 #include "modem_probe.h"
+#include "codec2_arena.h"
 
 /*---------------------------------------------------------------------------*\
 
@@ -94,15 +96,11 @@ static void fsk_generate_hann_table(struct FSK* fsk){
     int Ndft = fsk->Ndft;
     size_t i;
 
-    /* Set up complex oscilator to calculate hann function */
-    COMP dphi = comp_exp_j((2*M_PI)/((float)Ndft-1));
-    COMP rphi = {.5,0};
-    
-    rphi = cmult(cconj(dphi),rphi);
+    /* hann function from the oscillator's table */
+    uint32_t dphi = nco_angle((2*M_PI)/((float)Ndft-1));
     
     for(i=0; i<Ndft; i++){
-        rphi = cmult(dphi,rphi);
-        float hannc = .5-rphi.real;
+        float hannc = .5-.5*nco_cos(dphi*(uint32_t)i);
         //float hann = .5-(.5*cosf((2*M_PI*(float)(i))/((float)Ndft-1)));
         
         fsk->hann_table[i] = hannc;
@@ -142,7 +140,7 @@ struct FSK * fsk_create_hbr(int Fs, int Rs,int P,int M, int tx_f1, int tx_fs)
     assert( ((Fs/Rs)%P) == 0 );
     assert( M==2 || M==4);
     
-    fsk = (struct FSK*) malloc(sizeof(struct FSK));
+    fsk = (struct FSK*) codec2_malloc(sizeof(struct FSK));
     if(fsk == NULL) return NULL;
      
     
@@ -178,14 +176,14 @@ struct FSK * fsk_create_hbr(int Fs, int Rs,int P,int M, int tx_f1, int tx_fs)
     /* Set up rx state */
     
     for( i=0; i<M; i++)
-        fsk->phi_c[i] = comp_exp_j(0);
+        fsk->phi_c[i] = 0;
     
     memold = (4*fsk->Ts);
     
     fsk->nstash = memold; 
-    fsk->samp_old = (COMP*) malloc(sizeof(COMP)*memold);
+    fsk->samp_old = (COMP*) codec2_malloc(sizeof(COMP)*memold);
     if(fsk->samp_old == NULL){
-        free(fsk);
+        codec2_free(fsk);
         return NULL;
     }
     
@@ -194,29 +192,29 @@ struct FSK * fsk_create_hbr(int Fs, int Rs,int P,int M, int tx_f1, int tx_fs)
         fsk->samp_old[i].imag = 0;
     }
 
-    fsk->fft_cfg = kiss_fft_alloc(fsk->Ndft,0,NULL,NULL);
+    fsk->fft_cfg = codec2_fft_alloc(fsk->Ndft,0,NULL,NULL);
     if(fsk->fft_cfg == NULL){
-        free(fsk->samp_old);
-        free(fsk);
+        codec2_free(fsk->samp_old);
+        codec2_free(fsk);
         return NULL;
     }
     
-    fsk->fft_est = (float*)malloc(sizeof(float)*fsk->Ndft/2);
+    fsk->fft_est = (float*)codec2_malloc(sizeof(float)*fsk->Ndft/2);
     if(fsk->fft_est == NULL){
-        free(fsk->samp_old);
-        free(fsk->fft_cfg);
-        free(fsk);
+        codec2_free(fsk->samp_old);
+        codec2_fft_free(fsk->fft_cfg);
+        codec2_free(fsk);
         return NULL;
     }
     
     #ifdef USE_HANN_TABLE
         #ifdef GENERATE_HANN_TABLE_RUNTIME
-            fsk->hann_table = (float*)malloc(sizeof(float)*fsk->Ndft);
+            fsk->hann_table = (float*)codec2_malloc(sizeof(float)*fsk->Ndft);
             if(fsk->hann_table == NULL){
-                free(fsk->fft_est);
-                free(fsk->samp_old);
-                free(fsk->fft_cfg);
-                free(fsk);
+                codec2_free(fsk->fft_est);
+                codec2_free(fsk->samp_old);
+                codec2_fft_free(fsk->fft_cfg);
+                codec2_free(fsk);
                 return NULL;
             }
             fsk_generate_hann_table(fsk);
@@ -230,7 +228,7 @@ struct FSK * fsk_create_hbr(int Fs, int Rs,int P,int M, int tx_f1, int tx_fs)
     fsk->norm_rx_timing = 0;
     
     /* Set up tx state */
-    fsk->tx_phase_c = comp_exp_j(0);
+    nco_init(&fsk->tx_nco, 0.0, 0.0);
     
     /* Set up demod stats */
     fsk->EbNodB = 0;
@@ -240,12 +238,12 @@ struct FSK * fsk_create_hbr(int Fs, int Rs,int P,int M, int tx_f1, int tx_fs)
     
     fsk->ppm = 0;
 
-    fsk->stats = (struct MODEM_STATS*)malloc(sizeof(struct MODEM_STATS));
+    fsk->stats = (struct MODEM_STATS*)codec2_malloc(sizeof(struct MODEM_STATS));
     if(fsk->stats == NULL){
-        free(fsk->fft_est);
-        free(fsk->samp_old);
-        free(fsk->fft_cfg);
-        free(fsk);
+        codec2_free(fsk->fft_est);
+        codec2_free(fsk->samp_old);
+        codec2_fft_free(fsk->fft_cfg);
+        codec2_free(fsk);
         return NULL;
     }
     fsk->normalise_eye = 1;
@@ -288,7 +286,7 @@ struct FSK * fsk_create(int Fs, int Rs,int M, int tx_f1, int tx_fs)
     assert( ((Fs/Rs)%horus_P) == 0 );
     assert( M==2 || M==4);
     
-    fsk = (struct FSK*) malloc(sizeof(struct FSK));
+    fsk = (struct FSK*) codec2_malloc(sizeof(struct FSK));
     if(fsk == NULL) return NULL;
      
     Ndft = 1024;
@@ -313,14 +311,14 @@ struct FSK * fsk_create(int Fs, int Rs,int M, int tx_f1, int tx_fs)
     
     /* Set up rx state */
     for( i=0; i<M; i++)
-        fsk->phi_c[i] = comp_exp_j(0);
+        fsk->phi_c[i] = 0;
     
     memold = (4*fsk->Ts);
     
     fsk->nstash = memold; 
-    fsk->samp_old = (COMP*) malloc(sizeof(COMP)*memold);
+    fsk->samp_old = (COMP*) codec2_malloc(sizeof(COMP)*memold);
     if(fsk->samp_old == NULL){
-        free(fsk);
+        codec2_free(fsk);
         return NULL;
     }
     
@@ -329,29 +327,29 @@ struct FSK * fsk_create(int Fs, int Rs,int M, int tx_f1, int tx_fs)
         fsk->samp_old[i].imag = 0.0;
     }
     
-    fsk->fft_cfg = kiss_fft_alloc(Ndft,0,NULL,NULL);
+    fsk->fft_cfg = codec2_fft_alloc(Ndft,0,NULL,NULL);
     if(fsk->fft_cfg == NULL){
-        free(fsk->samp_old);
-        free(fsk);
+        codec2_free(fsk->samp_old);
+        codec2_free(fsk);
         return NULL;
     }
     
-    fsk->fft_est = (float*)malloc(sizeof(float)*fsk->Ndft/2);
+    fsk->fft_est = (float*)codec2_malloc(sizeof(float)*fsk->Ndft/2);
     if(fsk->fft_est == NULL){
-        free(fsk->samp_old);
-        free(fsk->fft_cfg);
-        free(fsk);
+        codec2_free(fsk->samp_old);
+        codec2_fft_free(fsk->fft_cfg);
+        codec2_free(fsk);
         return NULL;
     }
     
     #ifdef USE_HANN_TABLE
         #ifdef GENERATE_HANN_TABLE_RUNTIME
-            fsk->hann_table = (float*)malloc(sizeof(float)*fsk->Ndft);
+            fsk->hann_table = (float*)codec2_malloc(sizeof(float)*fsk->Ndft);
             if(fsk->hann_table == NULL){
-                free(fsk->fft_est);
-                free(fsk->samp_old);
-                free(fsk->fft_cfg);
-                free(fsk);
+                codec2_free(fsk->fft_est);
+                codec2_free(fsk->samp_old);
+                codec2_fft_free(fsk->fft_cfg);
+                codec2_free(fsk);
                 return NULL;
             }
             fsk_generate_hann_table(fsk);
@@ -365,7 +363,7 @@ struct FSK * fsk_create(int Fs, int Rs,int M, int tx_f1, int tx_fs)
     fsk->norm_rx_timing = 0;
     
     /* Set up tx state */
-    fsk->tx_phase_c = comp_exp_j(0);
+    nco_init(&fsk->tx_nco, 0.0, 0.0);
     
     /* Set up demod stats */
     fsk->EbNodB = 0;
@@ -375,12 +373,12 @@ struct FSK * fsk_create(int Fs, int Rs,int M, int tx_f1, int tx_fs)
     
     fsk->ppm = 0;
     
-    fsk->stats = (struct MODEM_STATS*)malloc(sizeof(struct MODEM_STATS));
+    fsk->stats = (struct MODEM_STATS*)codec2_malloc(sizeof(struct MODEM_STATS));
     if(fsk->stats == NULL){
-        free(fsk->fft_est);
-        free(fsk->samp_old);
-        free(fsk->fft_cfg);
-        free(fsk);
+        codec2_free(fsk->fft_est);
+        codec2_free(fsk->samp_old);
+        codec2_fft_free(fsk->fft_cfg);
+        codec2_free(fsk);
         return NULL;
     }
     fsk->normalise_eye = 1;
@@ -389,6 +387,59 @@ struct FSK * fsk_create(int Fs, int Rs,int M, int tx_f1, int tx_fs)
 }
 
 
+size_t fsk_size(int Fs, int Rs, int M, int tx_f1, int tx_fs)
+{
+    struct CODEC2_ARENA arena;
+    struct FSK *fsk;
+
+    codec2_arena_begin(&arena, NULL, 0);
+    fsk = fsk_create(Fs, Rs, M, tx_f1, tx_fs);
+    codec2_arena_end(&arena, fsk);
+    if(fsk == NULL) return 0;
+    fsk_destroy(fsk);
+
+    return arena.used + CODEC2_ARENA_ALIGN;
+}
+
+struct FSK * fsk_create_arena(int Fs, int Rs, int M, int tx_f1, int tx_fs, void *mem, size_t size)
+{
+    struct CODEC2_ARENA arena;
+    struct FSK *fsk;
+
+    codec2_arena_begin(&arena, mem, size);
+    fsk = fsk_create(Fs, Rs, M, tx_f1, tx_fs);
+    codec2_arena_end(&arena, fsk);
+
+    return fsk;
+}
+
+size_t fsk_hbr_size(int Fs, int Rs, int P, int M, int tx_f1, int tx_fs)
+{
+    struct CODEC2_ARENA arena;
+    struct FSK *fsk;
+
+    codec2_arena_begin(&arena, NULL, 0);
+    fsk = fsk_create_hbr(Fs, Rs, P, M, tx_f1, tx_fs);
+    codec2_arena_end(&arena, fsk);
+    if(fsk == NULL) return 0;
+    fsk_destroy(fsk);
+
+    return arena.used + CODEC2_ARENA_ALIGN;
+}
+
+struct FSK * fsk_create_hbr_arena(int Fs, int Rs, int P, int M, int tx_f1, int tx_fs, void *mem, size_t size)
+{
+    struct CODEC2_ARENA arena;
+    struct FSK *fsk;
+
+    codec2_arena_begin(&arena, mem, size);
+    fsk = fsk_create_hbr(Fs, Rs, P, M, tx_f1, tx_fs);
+    codec2_arena_end(&arena, fsk);
+
+    return fsk;
+}
+
+
 void fsk_set_nsym(struct FSK *fsk,int nsyms){
     assert(nsyms>0);
     int Ndft,i;
@@ -409,11 +460,11 @@ void fsk_set_nsym(struct FSK *fsk,int nsyms){
     
     fsk->Ndft = Ndft;
     
-    free(fsk->fft_cfg);
-    free(fsk->fft_est);
+    codec2_fft_free(fsk->fft_cfg);
+    codec2_free(fsk->fft_est);
     
-    fsk->fft_cfg = kiss_fft_alloc(Ndft,0,NULL,NULL);
-    fsk->fft_est = (float*)malloc(sizeof(float)*fsk->Ndft/2);
+    fsk->fft_cfg = codec2_fft_alloc(Ndft,0,NULL,NULL);
+    fsk->fft_est = (float*)codec2_malloc(sizeof(float)*fsk->Ndft/2);
     
     for(i=0;i<Ndft/2;i++)fsk->fft_est[i] = 0;
     
@@ -435,10 +486,14 @@ uint32_t fsk_nin(struct FSK *fsk){
 }
 
 void fsk_destroy(struct FSK *fsk){
-    free(fsk->fft_cfg);
-    free(fsk->samp_old);
-    free(fsk->stats);
-    free(fsk);
+    codec2_fft_free(fsk->fft_cfg);
+    codec2_free(fsk->fft_est);
+    #if defined(USE_HANN_TABLE) && defined(GENERATE_HANN_TABLE_RUNTIME)
+    codec2_free(fsk->hann_table);
+    #endif
+    codec2_free(fsk->samp_old);
+    codec2_free(fsk->stats);
+    codec2_free(fsk);
 }
 
 void fsk_get_demod_stats(struct FSK *fsk, struct MODEM_STATS *stats){
@@ -494,23 +549,21 @@ void fsk_demod_freq_est(struct FSK *fsk, COMP fsk_in[],float *freqs,int M){
     float max;
     float tc;
     int imax;
-    kiss_fft_cfg fft_cfg = fsk->fft_cfg;
+    codec2_fft_cfg fft_cfg = fsk->fft_cfg;
     int freqi[M];
     int f_min,f_max,f_zero;
     
-    /* Array to do complex FFT from using kiss_fft */
+    /* Array to do complex FFT from using codec2_fft */
     #ifdef DEMOD_ALLOC_STACK
     kiss_fft_cpx *fftin  = (kiss_fft_cpx*)alloca(sizeof(kiss_fft_cpx)*Ndft);
     kiss_fft_cpx *fftout = (kiss_fft_cpx*)alloca(sizeof(kiss_fft_cpx)*Ndft);
     #else
-    kiss_fft_cpx *fftin  = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx)*Ndft);
-    kiss_fft_cpx *fftout = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx)*Ndft);
+    kiss_fft_cpx *fftin  = (kiss_fft_cpx*)codec2_malloc(sizeof(kiss_fft_cpx)*Ndft);
+    kiss_fft_cpx *fftout = (kiss_fft_cpx*)codec2_malloc(sizeof(kiss_fft_cpx)*Ndft);
     #endif
     
     #ifndef USE_HANN_TABLE
-    COMP dphi = comp_exp_j((2*M_PI)/((float)Ndft-1));
-    COMP rphi = {.5,0};
-    rphi = cmult(cconj(dphi),rphi);
+    uint32_t dphi = nco_angle((2*M_PI)/((float)Ndft-1));
     #endif
 
     fft_samps = Ndft;
@@ -530,8 +583,7 @@ void fsk_demod_freq_est(struct FSK *fsk, COMP fsk_in[],float *freqs,int M){
             hann = fsk->hann_table[i];
             #else
             //hann = 1-cosf((2*M_PI*(float)(i))/((float)fft_samps-1));
-            rphi = cmult(dphi,rphi);
-            hann = .5-rphi.real;
+            hann = .5-.5*nco_cos(dphi*(uint32_t)i);
             #endif
             fftin[i].r = hann*fsk_in[i+Ndft*j].real;
             fftin[i].i = hann*fsk_in[i+Ndft*j].imag;
@@ -543,7 +595,7 @@ void fsk_demod_freq_est(struct FSK *fsk, COMP fsk_in[],float *freqs,int M){
         }
         
         /* Do the FFT */
-        kiss_fft(fft_cfg,fftin,fftout);
+        codec2_fft(fft_cfg,(codec2_fft_cpx*)fftin,(codec2_fft_cpx*)fftout);
         
         /* Find the magnitude^2 of each freq slot and stash away in the real
         * value, so this only has to be done once. Since we're only comparing
@@ -611,12 +663,33 @@ void fsk_demod_freq_est(struct FSK *fsk, COMP fsk_in[],float *freqs,int M){
         freqs[i] = (float)(freqi[i])*((float)Fs/(float)Ndft);
     }
     #ifndef DEMOD_ALLOC_STACK
-    free(fftin);
-    free(fftout);
+    codec2_free(fftin);
+    codec2_free(fftout);
     #endif
 }
 
-void fsk2_demod(struct FSK *fsk, uint8_t rx_bits[], float rx_sd[], COMP fsk_in[]){
+/*
+ * Down convert n samples from index s of the demod's sample stream,
+ * nold old samples then the new ones, with a tone's oscillators for
+ * the old and new samples.
+ */
+static void fsk_downconvert(struct NCO *osc_old, struct NCO *osc_new, COMP out[],
+                            COMP old[], int nold, COMP in[], int s, int n){
+    int k = 0;
+
+    if (s < nold) {
+        k = (nold - s < n) ? nold - s : n;
+        nco_mix_conj(osc_old, out, &old[s], k);
+    }
+    if (k < n)
+        nco_mix_conj(osc_new, &out[k], &in[s + k - nold], n - k);
+}
+
+/*
+ * Demodulates one frame given the tone frequencies, the part of the demod
+ * after frequency estimation, shared by fsk2_demod() and the FSK bank.
+ */
+static void fsk2_demod_tones(struct FSK *fsk, uint8_t rx_bits[], float rx_sd[], COMP fsk_in[], float f_est[]){
     int N = fsk->N;
     int Ts = fsk->Ts;
     int Rs = fsk->Rs;
@@ -633,19 +706,16 @@ void fsk2_demod(struct FSK *fsk, uint8_t rx_bits[], float rx_sd[], COMP fsk_in[]
     COMP* f_int[M];     /* Filtered and downsampled symbol tones */
     COMP t[M];          /* complex number temps */
     COMP t_c;           /* another complex temp */
-    COMP phi_c[M];  
-    COMP phi_ft;        
+    uint32_t phi_c[M];  
+    uint32_t phi_ft;        
     int nold = Nmem-nin;
     
-    COMP dphi[M];
-    COMP dphift;
+    struct NCO osc_old[M], osc_new[M];
+    uint32_t dphift;
     float rx_timing,norm_rx_timing,old_norm_rx_timing,d_norm_rx_timing,appm;
-    int using_old_samps;
-
-    COMP* sample_src;
     COMP* f_intbuf_m;
     
-    float f_est[M],fc_avg,fc_tx;
+    float fc_avg,fc_tx;
     float meanebno,stdebno,eye_max;
     int neyesamp,neyeoffset;
     
@@ -653,20 +723,11 @@ void fsk2_demod(struct FSK *fsk, uint8_t rx_bits[], float rx_sd[], COMP fsk_in[]
     char mp_name_tmp[20]; /* Temporary string for modem probe trace names */
     #endif
     
-    /* Load up demod phases from struct */
-    for( m=0; m<M; m++)
-        phi_c[m] = fsk->phi_c[m];
-    
-    /* Estimate tone frequencies */
-    fsk_demod_freq_est(fsk,fsk_in,f_est,M);
-    modem_probe_samp_f("t_f_est",f_est,M);
-    
-    
     /* Allocate circular buffer for integration */
     #ifdef DEMOD_ALLOC_STACK
     f_intbuf_m = (COMP*) alloca(sizeof(COMP)*Ts);
     #else
-    f_intbuf_m = (COMP*) malloc(sizeof(COMP)*Ts);    
+    f_intbuf_m = (COMP*) codec2_malloc(sizeof(COMP)*Ts);    
     #endif
     
     /* allocate memory for the integrated samples */
@@ -677,7 +738,7 @@ void fsk2_demod(struct FSK *fsk, uint8_t rx_bits[], float rx_sd[], COMP fsk_in[]
         f_int[m] = (COMP*) alloca(sizeof(COMP)*(nsym+1)*P);
         
         #else
-        f_int[m] = (COMP*) malloc(sizeof(COMP)*(nsym+1)*P);
+        f_int[m] = (COMP*) codec2_malloc(sizeof(COMP)*(nsym+1)*P);
         #endif
     }
     
@@ -688,77 +749,42 @@ void fsk2_demod(struct FSK *fsk, uint8_t rx_bits[], float rx_sd[], COMP fsk_in[]
             fsk->f_est[m] = f_est[m];
     }
     
-    /* Initalize downmixers for each symbol tone */
+    /* Initalize downmixers for each symbol tone.  The old samples are
+       mixed at the last frame's estimate, the new ones at this frame's */
     for( m=0; m<M; m++){
-        /* Back the stored phase off to account for re-integraton of old samples */
-        dphi[m] = comp_exp_j(-2*(Nmem-nin-(Ts/P))*M_PI*((fsk->f_est[m])/(float)(Fs)));
-        phi_c[m] = cmult(dphi[m],phi_c[m]);
-
-        /* Figure out how much to nudge each sample downmixer for every sample */
-        dphi[m] = comp_exp_j(2*M_PI*((fsk->f_est[m])/(float)(Fs)));
+        osc_old[m].step = nco_angle(2*M_PI*((fsk->f_est[m])/(float)(Fs)));
+        osc_new[m].step = nco_angle(2*M_PI*((f_est[m])/(float)(Fs)));
+
+        /* Back the stored phase off to account for re-integraton of old samples,
+           then the first sample is mixed at phi_c[m] */
+        phi_c[m] = fsk->phi_c[m] - osc_old[m].step*(uint32_t)(Nmem-nin-(Ts/P));
+        osc_old[m].phase = phi_c[m] - osc_old[m].step;
+        osc_new[m].phase = phi_c[m] + osc_old[m].step*(uint32_t)nold - osc_new[m].step;
     }
     
     /* Integrate and downsample for symbol tones */
     for(m=0; m<M; m++){
         /* Copy buffer pointers in to avoid second buffer indirection */
-        float f_est_m = f_est[m];
         COMP* f_int_m = &(f_int[m][0]);
-        COMP dphi_m = dphi[m];
-        
-        dc_i = 0;
-        cbuf_i = 0;
-        sample_src = &(fsk->samp_old[nstash-nold]);
-        using_old_samps = 1;
         
         /* Pre-fill integration buffer */
-        for(dc_i=0; dc_i<Ts-(Ts/P); dc_i++){
-            /* Switch sample source to new samples when we run out of old ones */
-            if(dc_i>=nold && using_old_samps){
-                sample_src = &fsk_in[0];
-                dc_i = 0;
-                using_old_samps = 0;
-                
-                /* Recalculate delta-phi after switching to new sample source */
-                phi_c[m] = comp_normalize(phi_c[m]);
-                dphi_m = comp_exp_j(2*M_PI*((f_est_m)/(float)(Fs)));
-            }
-            /* Downconvert and place into integration buffer */
-            f_intbuf_m[dc_i]=cmult(sample_src[dc_i],cconj(phi_c[m]));
-            
-            #ifdef MODEMPROBE_ENABLE
-            snprintf(mp_name_tmp,19,"t_f%zd_dc",m+1);
-            modem_probe_samp_c(mp_name_tmp,&f_intbuf_m[dc_i],1);
-            #endif
-            /* Spin downconversion phases */
-            phi_c[m] = cmult(phi_c[m],dphi_m);
-        }
+        dc_i = Ts-(Ts/P);
+        fsk_downconvert(&osc_old[m], &osc_new[m], f_intbuf_m, &(fsk->samp_old[nstash-nold]), nold, fsk_in, 0, dc_i);
+        #ifdef MODEMPROBE_ENABLE
+        snprintf(mp_name_tmp,19,"t_f%zd_dc",m+1);
+        modem_probe_samp_c(mp_name_tmp,f_intbuf_m,dc_i);
+        #endif
         cbuf_i = dc_i;
         
         /* Integrate over Ts at offsets of Ts/P */
         for(i=0; i<(nsym+1)*P; i++){
             /* Downconvert and Place Ts/P samples in the integration buffers */
-            for(j=0; j<(Ts/P); j++,dc_i++){
-                /* Switch sample source to new samples when we run out of old ones */
-                if(dc_i>=nold && using_old_samps){
-                    sample_src = &fsk_in[0];
-                    dc_i = 0;
-                    using_old_samps = 0;
-                    
-                    /* Recalculate delta-phi after switching to new sample source */
-                    phi_c[m] = comp_normalize(phi_c[m]);
-                    dphi_m = comp_exp_j(2*M_PI*((f_est_m)/(float)(Fs)));
-                }
-                /* Downconvert and place into integration buffer */
-                f_intbuf_m[cbuf_i+j]=cmult(sample_src[dc_i],cconj(phi_c[m]));
-        
-                #ifdef MODEMPROBE_ENABLE
-                snprintf(mp_name_tmp,19,"t_f%zd_dc",m+1);
-                modem_probe_samp_c(mp_name_tmp,&f_intbuf_m[cbuf_i+j],1);
-                #endif
-                /* Spin downconversion phases */
-                phi_c[m] = cmult(phi_c[m],dphi_m);
-                
-            }
+            fsk_downconvert(&osc_old[m], &osc_new[m], &f_intbuf_m[cbuf_i], &(fsk->samp_old[nstash-nold]), nold, fsk_in, dc_i, Ts/P);
+            #ifdef MODEMPROBE_ENABLE
+            snprintf(mp_name_tmp,19,"t_f%zd_dc",m+1);
+            modem_probe_samp_c(mp_name_tmp,&f_intbuf_m[cbuf_i],Ts/P);
+            #endif
+            dc_i += Ts/P;
             
             /* Dump internal samples */
             cbuf_i += Ts/P;
@@ -774,6 +800,12 @@ void fsk2_demod(struct FSK *fsk, uint8_t rx_bits[], float rx_sd[], COMP fsk_in[]
             f_int_m[i].real = it_r;
             f_int_m[i].imag = it_i;
         }
+
+        /* phase of the next sample */
+        if (dc_i > (size_t)nold)
+            phi_c[m] = osc_new[m].phase + osc_new[m].step;
+        else
+            phi_c[m] = osc_old[m].phase + osc_old[m].step;
     }
     
     /* Save phases back into FSK struct */
@@ -790,9 +822,8 @@ void fsk2_demod(struct FSK *fsk, uint8_t rx_bits[], float rx_sd[], COMP fsk_in[]
      * extract angle */
      
     /* Figure out how much to spin the oscillator to extract magic spectral line */
-    dphift = comp_exp_j(2*M_PI*((float)(Rs)/(float)(P*Rs)));
-    phi_ft.real = 1;
-    phi_ft.imag = 0;
+    dphift = nco_angle(2*M_PI*((float)(Rs)/(float)(P*Rs)));
+    phi_ft = 0;
     t_c=comp0();
     for(i=0; i<(nsym+1)*P; i++){
         /* Get abs^2 of fx_int[i], and add 'em */
@@ -802,10 +833,10 @@ void fsk2_demod(struct FSK *fsk, uint8_t rx_bits[], float rx_sd[], COMP fsk_in[]
         }
         
         /* Down shift and accumulate magic line */
-        t_c = cadd(t_c,fcmult(ft1,phi_ft));
+        t_c = cadd(t_c,fcmult(ft1,nco_phasor(phi_ft)));
 
         /* Spin the oscillator for the magic line shift */
-        phi_ft = cmult(phi_ft,dphift);
+        phi_ft += dphift;
     }
     /* Get the magic angle */
     norm_rx_timing =  atan2f(t_c.imag,t_c.real)/(2*M_PI);
@@ -923,7 +954,7 @@ void fsk2_demod(struct FSK *fsk, uint8_t rx_bits[], float rx_sd[], COMP fsk_in[]
     
     /* Calculate the std. dev for EbNodB estimate */
     stdebno = (stdebno/(float)nsym) - (meanebno*meanebno);
-    stdebno = sqrt(stdebno);
+    stdebno = c2_sqrt(stdebno);
     
     fsk->EbNodB = -6+(20*log10f((1e-6+meanebno)/(1e-6+stdebno)));
     #else
@@ -992,12 +1023,22 @@ void fsk2_demod(struct FSK *fsk, uint8_t rx_bits[], float rx_sd[], COMP fsk_in[]
     
     #ifndef DEMOD_ALLOC_STACK
     for( m=0; m<M; m++){
-        free(f_int[m]);
+        codec2_free(f_int[m]);
     }
-    free(f_intbuf_m);
+    codec2_free(f_intbuf_m);
     #endif
 }
 
+void fsk2_demod(struct FSK *fsk, uint8_t rx_bits[], float rx_sd[], COMP fsk_in[]){
+    float f_est[MODE_M_MAX];
+
+    /* Estimate tone frequencies */
+    fsk_demod_freq_est(fsk,fsk_in,f_est,fsk->mode);
+    modem_probe_samp_f("t_f_est",f_est,fsk->mode);
+
+    fsk2_demod_tones(fsk,rx_bits,rx_sd,fsk_in,f_est);
+}
+
 void fsk_demod(struct FSK *fsk, uint8_t rx_bits[], COMP fsk_in[]){
     fsk2_demod(fsk,rx_bits,NULL,fsk_in);
 }
@@ -1007,19 +1048,18 @@ void fsk_demod_sd(struct FSK *fsk, float rx_sd[], COMP fsk_in[]){
 }
 
 void fsk_mod(struct FSK *fsk,float fsk_out[],uint8_t tx_bits[]){
-    COMP tx_phase_c = fsk->tx_phase_c; /* Current complex TX phase */
+    struct NCO tx_nco = fsk->tx_nco; /* TX oscillator */
     int f1_tx = fsk->f1_tx;         /* '0' frequency */
     int fs_tx = fsk->fs_tx;         /* space between frequencies */
     int Ts = fsk->Ts;               /* samples-per-symbol */
     int Fs = fsk->Fs;               /* sample freq */
     int M = fsk->mode;
-    COMP dosc_f[M];                 /* phase shift per sample */
-    COMP dph;                       /* phase shift of current bit */
+    uint32_t dosc_f[M];             /* phase step per sample */
     size_t i,j,m,bit_i,sym;
     
-    /* Init the per sample phase shift complex numbers */
+    /* Init the per sample phase steps */
     for( m=0; m<M; m++){
-        dosc_f[m] = comp_exp_j(2*M_PI*((float)(f1_tx+(fs_tx*m))/(float)(Fs)));
+        dosc_f[m] = nco_angle(2*M_PI*((float)(f1_tx+(fs_tx*m))/(float)(Fs)));
     }
     
     bit_i = 0;
@@ -1032,38 +1072,33 @@ void fsk_mod(struct FSK *fsk,float fsk_out[],uint8_t tx_bits[]){
             sym = (sym<<1)|bit;
             bit_i++;
         }
-        /* Look up symbol phase shift */
-        dph = dosc_f[sym];
+        /* Look up symbol phase step */
+        tx_nco.step = dosc_f[sym];
         /* Spin the oscillator for a symbol period */
+        nco_gen_real(&tx_nco,&fsk_out[i*Ts],Ts);
         for(j=0; j<Ts; j++){
-            tx_phase_c = cmult(tx_phase_c,dph);
-            fsk_out[i*Ts+j] = 2*tx_phase_c.real;
+            fsk_out[i*Ts+j] *= 2;
         }
-    
     }
     
-    /* Normalize TX phase to prevent drift */
-    tx_phase_c = comp_normalize(tx_phase_c);
-    
-    /* save TX phase */
-    fsk->tx_phase_c = tx_phase_c;
+    /* save TX phase, the accumulator wraps so needs no normalising */
+    fsk->tx_nco = tx_nco;
     
 }
 
 void fsk_mod_c(struct FSK *fsk,COMP fsk_out[],uint8_t tx_bits[]){
-    COMP tx_phase_c = fsk->tx_phase_c; /* Current complex TX phase */
+    struct NCO tx_nco = fsk->tx_nco; /* TX oscillator */
     int f1_tx = fsk->f1_tx;         /* '0' frequency */
     int fs_tx = fsk->fs_tx;         /* space between frequencies */
     int Ts = fsk->Ts;               /* samples-per-symbol */
     int Fs = fsk->Fs;               /* sample freq */
     int M = fsk->mode;
-    COMP dosc_f[M];                 /* phase shift per sample */
-    COMP dph;                       /* phase shift of current bit */
+    uint32_t dosc_f[M];             /* phase step per sample */
     size_t i,j,m,bit_i,sym;
     
-    /* Init the per sample phase shift complex numbers */
+    /* Init the per sample phase steps */
     for( m=0; m<M; m++){
-        dosc_f[m] = comp_exp_j(2*M_PI*((float)(f1_tx+(fs_tx*m))/(float)(Fs)));
+        dosc_f[m] = nco_angle(2*M_PI*((float)(f1_tx+(fs_tx*m))/(float)(Fs)));
     }
     
     bit_i = 0;
@@ -1076,20 +1111,17 @@ void fsk_mod_c(struct FSK *fsk,COMP fsk_out[],uint8_t tx_bits[]){
             sym = (sym<<1)|bit;
             bit_i++;
         }
-        /* Look up symbol phase shift */
-        dph = dosc_f[sym];
+        /* Look up symbol phase step */
+        tx_nco.step = dosc_f[sym];
         /* Spin the oscillator for a symbol period */
+        nco_gen(&tx_nco,&fsk_out[i*Ts],Ts);
         for(j=0; j<Ts; j++){
-            tx_phase_c = cmult(tx_phase_c,dph);
-            fsk_out[i*Ts+j] = fcmult(2,tx_phase_c);
+            fsk_out[i*Ts+j] = fcmult(2,fsk_out[i*Ts+j]);
         }
     }
     
-    /* Normalize TX phase to prevent drift */
-    tx_phase_c = comp_normalize(tx_phase_c);
-    
-    /* save TX phase */
-    fsk->tx_phase_c = tx_phase_c;
+    /* save TX phase, the accumulator wraps so needs no normalising */
+    fsk->tx_nco = tx_nco;
     
 }
 
@@ -1097,9 +1129,358 @@ void fsk_stats_normalise_eye(struct FSK *fsk, int normalise_enable) {
     fsk->normalise_eye = normalise_enable;
 }
 
+/*---------------------------------------------------------------------------*\
+
+                               FSK BANK
+
+  N demods tracking signals at different frequencies in one wideband
+  input.  One FFT of the input per frame feeds the tone frequency
+  estimates of every channel, and each channel's signal is mixed down
+  and decimated by a polyphase FIR to a low rate before its tone
+  correlators, so adding a channel costs one mixer, one decimator and
+  a low rate demod rather than a full rate FSK modem.
+
+\*---------------------------------------------------------------------------*/
+
+struct FSK_BANK_CHANNEL {
+    struct FSK *fsk;        /* demod running at Fs/decim */
+    float fc;               /* centre freq in the wideband input */
+    struct NCO osc;         /* downconverter, stepped per input sample */
+    int quarter;            /* Fs/decim/4 shift, as a power of j */
+    COMP *hist;             /* last ntaps-1 mixed samples */
+    COMP *buf;              /* decimated samples waiting for the demod */
+    int nbuf;
+};
+
+struct FSK_BANK {
+    int Fs;                 /* wideband sample rate */
+    int decim;              /* channel rate is Fs/decim */
+    int M;
+    int nin;                /* wideband samples per fsk_bank_demod() */
+    int Ndft;               /* shared freq est FFT size */
+    int est_space;          /* min tone spacing for freq est */
+    codec2_fft_cfg fft_cfg;
+    float *hann;
+    float *fft_est;         /* averaged magnitude spectrum, all Ndft bins */
+    COMP *fftbuf;
+    float *taps;            /* decimation filter */
+    int ntaps;
+    COMP *mixed;            /* ntaps-1 + nin mixed samples */
+    int nchannels;
+    struct FSK_BANK_CHANNEL *ch;
+};
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: fsk_bank_create
+  DATE CREATED: Oct 2026
+
+  Creates a bank of nchannels M-FSK demods, Rs symbols/s each, fed by
+  a wideband input sampled at Fs.  Each channel is decimated to
+  Fs/decim, which must be a multiple of Rs with (Fs/decim/Rs)%P == 0,
+  and can hold a signal up to Fs/decim/2 wide.  Channels start centred
+  on 0 Hz, use fsk_bank_set_channel() to place them.  Returns NULL on
+  failure.
+
+\*---------------------------------------------------------------------------*/
+
+struct FSK_BANK * fsk_bank_create(int Fs, int decim, int Rs, int P, int M, int nchannels)
+{
+    struct FSK_BANK *bank;
+    struct FSK_BANK_CHANNEL *ch;
+    int Fs_ch, N, i, c;
+    float fcut, w, sum;
+
+    assert(decim > 0);
+    assert((Fs%decim) == 0);
+    assert(nchannels > 0);
+
+    Fs_ch = Fs/decim;
+
+    bank = (struct FSK_BANK*) codec2_calloc(1, sizeof(struct FSK_BANK));
+    if(bank == NULL) return NULL;
+
+    bank->Fs = Fs;
+    bank->decim = decim;
+    bank->M = M;
+    bank->est_space = Rs-(Rs/5);
+    bank->ntaps = 8*decim+1;
+    bank->nchannels = nchannels;
+
+    bank->ch = (struct FSK_BANK_CHANNEL*) codec2_calloc(nchannels, sizeof(struct FSK_BANK_CHANNEL));
+    if(bank->ch == NULL){
+        fsk_bank_destroy(bank);
+        return NULL;
+    }
+
+    /* channel demods, with the tx freqs set so foff is relative to
+       the channel centre, which lands on Fs_ch/4 after decimation */
+
+    for(c=0; c<nchannels; c++){
+        ch = &bank->ch[c];
+        ch->fsk = fsk_create_hbr(Fs_ch, Rs, P, M, Fs_ch/4-Rs/2, Rs);
+        if(ch->fsk == NULL){
+            fsk_bank_destroy(bank);
+            return NULL;
+        }
+        N = ch->fsk->N;
+        ch->hist = (COMP*) codec2_calloc(bank->ntaps-1, sizeof(COMP));
+        ch->buf = (COMP*) codec2_malloc(sizeof(COMP)*(2*N+ch->fsk->Ts));
+        if((ch->hist == NULL) || (ch->buf == NULL)){
+            fsk_bank_destroy(bank);
+            return NULL;
+        }
+        nco_init(&ch->osc, 0, 0);
+    }
+
+    /* Find smallest 2^N value that fits the input frame for the shared FFT */
+    N = bank->ch[0].fsk->N;
+    bank->nin = N*decim;
+    for(bank->Ndft=1; bank->Ndft*2 <= bank->nin; bank->Ndft*=2);
+
+    bank->fft_cfg = codec2_fft_alloc(bank->Ndft,0,NULL,NULL);
+    bank->hann = (float*) codec2_malloc(sizeof(float)*bank->Ndft);
+    bank->fft_est = (float*) codec2_calloc(bank->Ndft, sizeof(float));
+    bank->fftbuf = (COMP*) codec2_malloc(sizeof(COMP)*bank->Ndft);
+    bank->taps = (float*) codec2_malloc(sizeof(float)*bank->ntaps);
+    bank->mixed = (COMP*) codec2_malloc(sizeof(COMP)*(bank->ntaps-1+bank->nin));
+    if((bank->fft_cfg == NULL) || (bank->hann == NULL) || (bank->fft_est == NULL) ||
+       (bank->fftbuf == NULL) || (bank->taps == NULL) || (bank->mixed == NULL)){
+        fsk_bank_destroy(bank);
+        return NULL;
+    }
+
+    for(i=0; i<bank->Ndft; i++)
+        bank->hann[i] = 0.5-0.5*cosf((2*M_PI*(float)i)/((float)bank->Ndft-1));
+
+    /* Hamming windowed sinc low pass, cut off at Fs_ch/2 so the
+       +/- Fs_ch/4 channel is flat and its aliases fall outside it */
+
+    fcut = 0.5/(float)decim;
+    sum = 0;
+    for(i=0; i<bank->ntaps; i++){
+        w = (float)(i - (bank->ntaps-1)/2);
+        bank->taps[i] = (w == 0) ? 2*fcut : sinf(2*M_PI*fcut*w)/(M_PI*w);
+        bank->taps[i] *= 0.54-0.46*cosf((2*M_PI*(float)i)/(float)(bank->ntaps-1));
+        sum += bank->taps[i];
+    }
+    for(i=0; i<bank->ntaps; i++)
+        bank->taps[i] /= sum;
+
+    return bank;
+}
+
+void fsk_bank_destroy(struct FSK_BANK *bank){
+    int c;
+
+    if(bank->ch != NULL){
+        for(c=0; c<bank->nchannels; c++){
+            if(bank->ch[c].fsk != NULL)
+                fsk_destroy(bank->ch[c].fsk);
+            codec2_free(bank->ch[c].hist);
+            codec2_free(bank->ch[c].buf);
+        }
+    }
+    if(bank->fft_cfg != NULL)
+        codec2_fft_free(bank->fft_cfg);
+    codec2_free(bank->hann);
+    codec2_free(bank->fft_est);
+    codec2_free(bank->fftbuf);
+    codec2_free(bank->taps);
+    codec2_free(bank->mixed);
+    codec2_free(bank->ch);
+    codec2_free(bank);
+}
+
+/*
+ * Centres channel c on fc Hz of the wideband input, and resets its demod
+ */
+void fsk_bank_set_channel(struct FSK_BANK *bank, int c, float fc){
+    struct FSK_BANK_CHANNEL *ch;
+    int m;
+
+    assert((c >= 0) && (c < bank->nchannels));
+    ch = &bank->ch[c];
+
+    ch->fc = fc;
+    nco_init(&ch->osc, 2*M_PI*fc/(float)bank->Fs, 0);
+    ch->quarter = 0;
+    ch->nbuf = 0;
+    memset(ch->hist, 0, sizeof(COMP)*(bank->ntaps-1));
+
+    fsk_clear_estimators(ch->fsk);
+    for(m=0; m<bank->M; m++){
+        ch->fsk->f_est[m] = 0;
+        ch->fsk->phi_c[m] = 0;
+    }
+}
+
+uint32_t fsk_bank_nin(struct FSK_BANK *bank){
+    return (uint32_t)bank->nin;
+}
+
+struct FSK * fsk_bank_get_fsk(struct FSK_BANK *bank, int c){
+    assert((c >= 0) && (c < bank->nchannels));
+    return bank->ch[c].fsk;
+}
+
+/*
+ * Averages the spectrum of this frame of wideband input into fft_est,
+ * as fsk_demod_freq_est() does for one modem
+ */
+static void fsk_bank_spectrum(struct FSK_BANK *bank, COMP fsk_in[]){
+    int Ndft = bank->Ndft;
+    float tc = 0.95*Ndft/bank->Fs;
+    int i,j;
+
+    for(j=0; j<bank->nin/Ndft; j++){
+        for(i=0; i<Ndft; i++){
+            bank->fftbuf[i].real = bank->hann[i]*fsk_in[i+Ndft*j].real;
+            bank->fftbuf[i].imag = bank->hann[i]*fsk_in[i+Ndft*j].imag;
+        }
+        codec2_fft_inplace(bank->fft_cfg,(codec2_fft_cpx*)bank->fftbuf);
+        for(i=0; i<Ndft; i++)
+            bank->fft_est[i] = (bank->fft_est[i]*(1-tc)) +
+                (sqrtf(bank->fftbuf[i].real*bank->fftbuf[i].real + bank->fftbuf[i].imag*bank->fftbuf[i].imag)*tc);
+    }
+}
+
+/*
+ * Finds the M tones of channel c in the shared spectrum, as freqs at
+ * the channel's decimated rate
+ */
+static void fsk_bank_freq_est(struct FSK_BANK *bank, int c, float *freqs){
+    struct FSK_BANK_CHANNEL *ch = &bank->ch[c];
+    int Ndft = bank->Ndft;
+    float Fs_ch = (float)bank->Fs/(float)bank->decim;
+    float df = (float)bank->Fs/(float)Ndft;
+    int Rs = ch->fsk->Rs;
+    int lo, n, zero, i, j, m, imax, tmp;
+    int freqi[MODE_M_MAX];
+    float max;
+    float *est = (float*)bank->fftbuf;
 
+    /* bins from fc - Fs_ch/4 to fc + Fs_ch/4, less Rs/2 at each edge */
 
+    lo = (int)floorf((ch->fc - Fs_ch/4 + Rs/2)/df);
+    n = (int)((Fs_ch/2 - Rs)/df);
+    zero = (bank->est_space*Ndft)/bank->Fs;
+    for(i=0; i<n; i++)
+        est[i] = bank->fft_est[((lo+i)%Ndft + Ndft)%Ndft];
 
+    for(m=0; m<bank->M; m++){
+        imax = 0;
+        max = 0;
+        for(i=0; i<n; i++){
+            if(est[i] > max){
+                max = est[i];
+                imax = i;
+            }
+        }
+        for(j=(imax-zero < 0 ? 0 : imax-zero); j<imax+zero && j<n; j++)
+            est[j] = 0;
+        freqi[m] = imax;
+    }
 
+    /* Gnome sort the freq list */
+    i = 1;
+    while(i<bank->M){
+        if(freqi[i] >= freqi[i-1]) i++;
+        else{
+            tmp = freqi[i];
+            freqi[i] = freqi[i-1];
+            freqi[i-1] = tmp;
+            if(i>1) i--;
+        }
+    }
 
+    for(m=0; m<bank->M; m++)
+        freqs[m] = (float)(lo+freqi[m])*df - ch->fc + Fs_ch/4;
+}
 
+/*
+ * Mixes channel c down, decimates it and appends the result to its buffer
+ */
+static void fsk_bank_downconvert(struct FSK_BANK *bank, int c, COMP fsk_in[]){
+    struct FSK_BANK_CHANNEL *ch = &bank->ch[c];
+    int nhist = bank->ntaps-1;
+    int decim = bank->decim;
+    COMP *x = bank->mixed;
+    COMP *y = &ch->buf[ch->nbuf];
+    COMP acc, t;
+    int i, k;
+
+    memcpy(x, ch->hist, sizeof(COMP)*nhist);
+    nco_mix_conj(&ch->osc, &x[nhist], fsk_in, bank->nin);
+    memcpy(ch->hist, &x[bank->nin], sizeof(COMP)*nhist);
+
+    /* polyphase decimator, only the kept outputs are computed, then
+       shift up by Fs_ch/4 so the channel is all positive freqs */
+
+    for(k=0; k<bank->nin/decim; k++){
+        acc.real = 0; acc.imag = 0;
+        for(i=0; i<bank->ntaps; i++){
+            acc.real += bank->taps[i]*x[k*decim+i].real;
+            acc.imag += bank->taps[i]*x[k*decim+i].imag;
+        }
+        t = acc;
+        switch(ch->quarter){
+        case 0: break;
+        case 1: t.real = -acc.imag; t.imag =  acc.real; break;
+        case 2: t.real = -acc.real; t.imag = -acc.imag; break;
+        case 3: t.real =  acc.imag; t.imag = -acc.real; break;
+        }
+        y[k] = t;
+        ch->quarter = (ch->quarter+1)&3;
+    }
+    ch->nbuf += bank->nin/decim;
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: fsk_bank_demod
+  DATE CREATED: Oct 2026
+
+  Demodulates fsk_bank_nin() samples of wideband input on every
+  channel.  Timing tracking means a channel returns 0, 1 or (rarely)
+  FSK_BANK_MAX_FRAMES frames per call, so rx_bits[c] (or rx_sd[c] for
+  soft decisions, either may be NULL) must hold FSK_BANK_MAX_FRAMES*
+  Nbits, and nframes[c] is set to the number of frames written.
+
+\*---------------------------------------------------------------------------*/
+
+void fsk_bank_demod(struct FSK_BANK *bank, uint8_t *rx_bits[], float *rx_sd[], int nframes[], COMP fsk_in[]){
+    struct FSK_BANK_CHANNEL *ch;
+    struct FSK *fsk;
+    float f_est[MODE_M_MAX];
+    int c, n, nin;
+
+    fsk_bank_spectrum(bank, fsk_in);
+
+    for(c=0; c<bank->nchannels; c++){
+        ch = &bank->ch[c];
+        fsk = ch->fsk;
+        fsk_bank_downconvert(bank, c, fsk_in);
+        fsk_bank_freq_est(bank, c, f_est);
+
+        for(n=0; (n<FSK_BANK_MAX_FRAMES) && (ch->nbuf >= fsk->nin); n++){
+            nin = fsk->nin;
+            fsk2_demod_tones(fsk,
+                             rx_bits ? &rx_bits[c][n*fsk->Nbits] : NULL,
+                             rx_sd ? &rx_sd[c][n*fsk->Nbits] : NULL,
+                             ch->buf, f_est);
+            ch->nbuf -= nin;
+            memmove(ch->buf, &ch->buf[nin], sizeof(COMP)*ch->nbuf);
+        }
+        nframes[c] = n;
+    }
+}
+
+/*
+ * Demod stats for channel c, foff is the offset of the signal from the
+ * channel centre
+ */
+void fsk_bank_get_demod_stats(struct FSK_BANK *bank, int c, struct MODEM_STATS *stats){
+    assert((c >= 0) && (c < bank->nchannels));
+    fsk_get_demod_stats(bank->ch[c].fsk, stats);
+}
@@ -28,10 +28,12 @@
 
 #ifndef __C2FSK_H
 #define __C2FSK_H
+#include <stddef.h>
 #include <stdint.h>
 #include "comp.h"
-#include "kiss_fftr.h"
+#include "codec2_fft.h"
 #include "modem_stats.h"
+#include "nco.h"
 
 #define MODE_2FSK 2
 #define MODE_4FSK 4
@@ -60,9 +62,9 @@ struct FSK {
     float* hann_table;		/* Precomputed or runtime computed hann window table */
     
     /*  Parameters used by demod */
-    COMP phi_c[MODE_M_MAX];
+    uint32_t phi_c[MODE_M_MAX];  /* tone down mixer phases, as struct NCO phase */
     
-    kiss_fft_cfg fft_cfg;   /* Config for KISS FFT, used in freq est */
+    codec2_fft_cfg fft_cfg; /* Config for FFT, used in freq est */
     float norm_rx_timing;   /* Normalized RX timing */
     
     COMP* samp_old;         /* Tail end of last batch of samples */
@@ -73,7 +75,7 @@ struct FSK {
     /* Memory used by demod but not important between demod frames */
     
     /*  Parameters used by mod */
-    COMP tx_phase_c;        /* TX phase, but complex */ 
+    struct NCO tx_nco;      /* TX oscillator */
     
     /*  Statistics generated by demod */
     float EbNodB;           /* Estimated EbNo in dB */
@@ -108,6 +110,16 @@ struct FSK * fsk_create(int Fs, int Rs, int M, int tx_f1, int tx_fs);
  */
 struct FSK * fsk_create_hbr(int Fs, int Rs, int P, int M, int tx_f1, int tx_fs);
 
+/*
+ * As fsk_create() and fsk_create_hbr(), but placing the modem in the size
+ * bytes at mem with no heap use. The _size() functions return how big mem
+ * must be. fsk_destroy() releases mem for reuse.
+ */
+size_t fsk_size(int Fs, int Rs, int M, int tx_f1, int tx_fs);
+struct FSK * fsk_create_arena(int Fs, int Rs, int M, int tx_f1, int tx_fs, void *mem, size_t size);
+size_t fsk_hbr_size(int Fs, int Rs, int P, int M, int tx_f1, int tx_fs);
+struct FSK * fsk_create_hbr_arena(int Fs, int Rs, int P, int M, int tx_f1, int tx_fs, void *mem, size_t size);
+
 /* 
  * Set a new number of symbols per processing frame
  */
@@ -187,4 +199,53 @@ void fsk_demod_sd(struct FSK *fsk, float rx_bits[],COMP fsk_in[]);
   
 void fsk_stats_normalise_eye(struct FSK *fsk, int normalise_enable);
 
+/*
+ * FSK bank: demods for several signals in one wideband input, sharing
+ * one frequency estimation FFT.  Each channel is mixed down and
+ * decimated to Fs/decim before its demod.
+ */
+
+#define FSK_BANK_MAX_FRAMES 2   /* most frames a channel returns per fsk_bank_demod() */
+
+struct FSK_BANK;
+
+/*
+ * Create a bank of nchannels demods
+ *
+ * int Fs - Wideband sample frequency
+ * int decim - Decimation to each channel, Fs/decim must be a multiple of Rs
+ * int Rs - Symbol rate
+ * int P - Timing oversample rate, as fsk_create_hbr()
+ * int M - 2 or 4 FSK
+ */
+struct FSK_BANK * fsk_bank_create(int Fs, int decim, int Rs, int P, int M, int nchannels);
+void fsk_bank_destroy(struct FSK_BANK *bank);
+
+/*
+ * Centre channel c on fc Hz of the wideband input, it may hold a signal
+ * up to Fs/decim/2 wide.  Resets the channel's demod.
+ */
+void fsk_bank_set_channel(struct FSK_BANK *bank, int c, float fc);
+
+/*
+ * Number of wideband samples each fsk_bank_demod() takes, it is fixed
+ */
+uint32_t fsk_bank_nin(struct FSK_BANK *bank);
+
+/*
+ * Demodulate fsk_bank_nin() wideband samples on every channel
+ *
+ * uint8_t *rx_bits[] - Per channel, FSK_BANK_MAX_FRAMES*Nbits hard bits, or NULL
+ * float *rx_sd[] - Per channel, FSK_BANK_MAX_FRAMES*Nbits soft bits, or NULL
+ * int nframes[] - Set to the frames written for each channel
+ * COMP fsk_in[] - fsk_bank_nin() samples of wideband input
+ */
+void fsk_bank_demod(struct FSK_BANK *bank, uint8_t *rx_bits[], float *rx_sd[], int nframes[], COMP fsk_in[]);
+
+/*
+ * Channel c's demod, for its Nbits and settings, and its stats
+ */
+struct FSK * fsk_bank_get_fsk(struct FSK_BANK *bank, int c);
+void fsk_bank_get_demod_stats(struct FSK_BANK *bank, int c, struct MODEM_STATS *stats);
+
 #endif
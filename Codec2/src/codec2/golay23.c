@@ -53,7 +53,8 @@ static int inited = 0;
 //since we want to avoid bit-reversing inside syndrome() we bit-reverse the polynomial instead
 #define GOLAY_POLYNOMIAL    0xC75   //AE3 reversed
 
-static int syndrome(int c) {
+#if defined(NO_TABLES) || defined(RUN_TIME_TABLES)
+static int syndrome_no_tables(int c) {
     //could probably be done slightly smarter, but works
     int x;
     for (x = 11; x >= 0; x--) {
@@ -63,29 +64,37 @@ static int syndrome(int c) {
     }
     return c;
 }
+#endif
+
+#ifndef NO_TABLES
+//the low 11 bits are their own remainder, and the remainder of the
+//high 12 bits is the parity of their codeword, so one lookup does it
+static inline int syndrome(int c) {
+    return (encoding_table[(c >> 11) & 0xFFF] ^ c) & 0x7FF;
+}
+#else
+#define syndrome syndrome_no_tables
+#endif
 
-#ifdef __GNUC__
+//the builtin is a library call unless the target has a popcount instruction
+#if defined(__GNUC__) && (defined(__POPCNT__) || defined(__ARM_NEON))
 #define popcount __builtin_popcount
-#elif defined(__MSC_VER)
+#elif defined(_MSC_VER)
 #include <intrin.h>
 #define popcount __popcnt
 #else
-static int popcount(unsigned int c) {
-    int ret = 0;
-    while (c) {
-        if (c & 1) {
-            ret++;
-        }
-        c >>= 1;
-    }
-    return ret;
+static inline int popcount(unsigned int c) {
+    c = c - ((c >> 1) & 0x55555555);
+    c = (c & 0x33333333) + ((c >> 2) & 0x33333333);
+    c = (c + (c >> 4)) & 0x0F0F0F0F;
+    return (c * 0x01010101) >> 24;
 }
 #endif
 
 #if defined(NO_TABLES) || defined(RUN_TIME_TABLES)
 static int golay23_encode_no_tables(int c) {
     c <<= 11;
-    return syndrome(c) | c;
+    return syndrome_no_tables(c) | c;
 }
 #endif
 
@@ -187,6 +196,41 @@ int  golay23_decode(int c) {
 #endif
 }
 
+/* Decodes n codewords, corrected[] may be received[].  Returns the
+   total number of bit errors corrected. */
+
+int  golay23_decode_batch(int corrected[], const int received[], int n) {
+    int i, c, e, errors = 0;
+
+#ifdef RUN_TIME_TABLES
+    assert(inited);
+#endif
+
+    for (i = 0; i < n; i++) {
+        c = received[i] & 0x7FFFFF;
+#ifdef NO_TABLES
+        e = c ^ golay23_decode(c);
+#else
+        e = decoding_table[syndrome(c)];
+#endif
+        corrected[i] = c ^ e;
+        errors += popcount(e);
+    }
+
+    return errors;
+}
+
+/* Remainder of the 23 bit pattern c divided by the generator polynomial,
+   the 11 parity bits when c is 12 data bits shifted left by 11 */
+
+int  golay23_syndrome(int c) {
+    assert(c >= 0 && c <= 0x7FFFFF);
+#ifdef RUN_TIME_TABLES
+    assert(inited);
+#endif
+    return syndrome(c);
+}
+
 int  golay23_count_errors(int recd_codeword, int corrected_codeword) {
     return popcount(recd_codeword ^ corrected_codeword);
 }
@@ -35,6 +35,8 @@ extern "C" {
 void golay23_init(void);
 int  golay23_encode(int data);
 int  golay23_decode(int received_codeword);
+int  golay23_decode_batch(int corrected[], const int received[], int n);
+int  golay23_syndrome(int pattern);
 int  golay23_count_errors(int recd_codeword, int corrected_codeword);
 
 #ifdef __cplusplus
@@ -14,7 +14,7 @@
 
   1/ Unit test on a PC:
 
-     $ gcc horus_l2.c -o horus_l2 -Wall -DHORUS_L2_UNITTEST
+     $ gcc horus_l2.c golay23.c -o horus_l2 -Wall -DHORUS_L2_UNITTEST
      $ ./horus_l2
 
      test 0: 22 bytes of payload data BER: 0.00 errors: 0
@@ -29,24 +29,25 @@
   2/ To build with just the tx function, ie for linking with the payload
   firmware:
 
-    $ gcc horus_l2.c -c -Wall
+    $ gcc horus_l2.c golay23.c -c -Wall -DNO_TABLES
     
   By default the RX side is #ifdef-ed out, leaving the minimal amount
-  of code for tx.
+  of code for tx, and -DNO_TABLES keeps the Golay tables out of
+  golay23.c.
 
   3/ Generate some tx_bits as input for testing with fsk_horus:
  
-    $ gcc horus_l2.c -o horus_l2 -Wall -DGEN_TX_BITS -DSCRAMBLER
+    $ gcc horus_l2.c golay23.c -o horus_l2 -Wall -DGEN_TX_BITS -DSCRAMBLER
     $ ./horus_l2
     $ more ../octave/horus_tx_bits_binary.txt
    
   4/ Unit testing interleaver:
 
-    $ gcc horus_l2.c -o horus_l2 -Wall -DINTERLEAVER -DTEST_INTERLEAVER -DSCRAMBLER
+    $ gcc horus_l2.c golay23.c -o horus_l2 -Wall -DINTERLEAVER -DTEST_INTERLEAVER -DSCRAMBLER
 
   5/ Compile for use as decoder called by fsk_horus.m and fsk_horus_stream.m:
 
-    $ gcc horus_l2.c -o horus_l2 -Wall -DDEC_RX_BITS -DHORUS_L2_RX
+    $ gcc horus_l2.c golay23.c -o horus_l2 -Wall -DDEC_RX_BITS -DHORUS_L2_RX
 
 \*---------------------------------------------------------------------------*/
 
@@ -56,20 +57,16 @@
 #include <string.h>
 #include <stdint.h>
 #include "horus_l2.h"
+#include "golay23.h"
 
 #ifdef HORUS_L2_UNITTEST
 #define HORUS_L2_RX
 #endif
 
-#define RUN_TIME_TABLES
-
 static char uw[] = {'$','$'};
 
 /* Function Prototypes ------------------------------------------------*/
 
-int32_t get_syndrome(int32_t pattern);
-void golay23_init(void);
-int golay23_decode(int received_codeword);
 unsigned short gen_crc16(unsigned char* data_p, unsigned char length);
 void interleave(unsigned char *inout, int nbytes, int dir);
 void scramble(unsigned char *inout, int nbytes);
@@ -175,7 +172,7 @@ int horus_l2_encode_tx_packet(unsigned char *output_tx_data,
             #ifdef DEBUG0
             fprintf(stderr, "  ningolay: %d ingolay: 0x%04x\n", ningolay, ingolay);
             #endif
-            golayparity = get_syndrome(ingolay<<11);
+            golayparity = golay23_syndrome(ingolay<<11);
             ingolay = 0;
 
             #ifdef DEBUG0
@@ -217,7 +214,7 @@ int horus_l2_encode_tx_packet(unsigned char *output_tx_data,
 
     if (ningolay % 12) {
         ingolay >>= 1;
-        golayparity = get_syndrome(ingolay<<12);
+        golayparity = golay23_syndrome(ingolay<<12);
         #ifdef DEBUG0
         fprintf(stderr, "  ningolay: %d ingolay: 0x%04x\n", ningolay, ingolay);
         fprintf(stderr, "  golayparity: 0x%04x\n", golayparity);
@@ -290,6 +287,7 @@ void horus_l2_decode_rx_packet(unsigned char *output_payload_data,
     unsigned char *pin  = input_rx_data;
     int            ninbit, ingolay, ningolay, paritybyte, nparitybits;
     int            ninbyte, shift, inbit, golayparitybit, i, outbit, outbyte, noutbits, outdata;
+    int            ncodewords, nbits, ntogo, k;
     int num_tx_data_bytes = horus_l2_get_num_tx_data_bytes(num_payload_data_bytes);
 
     /* optional scrambler and interleaver - we dont interleave UW */
@@ -304,10 +302,13 @@ void horus_l2_decode_rx_packet(unsigned char *output_payload_data,
 
     pin = input_rx_data + sizeof(uw) + num_payload_data_bytes;
 
-    /* Read input data bits one at a time.  When we have 12 read 11 parity bits. Golay decode.
-       Write decoded (output data) bits every time we have 8 of them. */
+    /* Read input data bits one at a time.  When we have 12 read 11
+       parity bits and save the codeword.  The codewords are then Golay
+       decoded in one batch, and the decoded data bits written out. */
 
     num_payload_data_bits = num_payload_data_bytes*8;
+    int codewords[(num_payload_data_bits + 11)/12];
+    ncodewords = 0;
     ninbit = 0;
     ingolay = 0;
     ningolay = 0;
@@ -316,9 +317,6 @@ void horus_l2_decode_rx_packet(unsigned char *output_payload_data,
     #ifdef DEBUG0
     fprintf(stderr,"  Read paritybyte: 0x%02x\n", paritybyte);
     #endif
-    pout = output_payload_data;
-    noutbits = 0;
-    outbyte = 0;
 
     while (ninbit < num_payload_data_bits) {
 
@@ -363,43 +361,13 @@ void horus_l2_decode_rx_packet(unsigned char *output_payload_data,
 
             #ifdef DEBUG0
             fprintf(stderr, "  golay code word: 0x%04x\n", ingolay);
-            fprintf(stderr, "  golay decode...: 0x%04x\n", golay23_decode(ingolay));
-            #endif
-           
-            /* write decoded/error corrected bits to output payload data */
-
-            outdata = golay23_decode(ingolay) >> 11;
-            #ifdef DEBUG0
-            fprintf(stderr, "  outdata...: 0x%04x\n", outdata);
             #endif
-
-            for(i=0; i<12; i++) {   
-                shift = 11 - i;
-                outbit = (outdata >> shift) & 0x1;
-                outbyte |= outbit;
-                noutbits++;
-                if (noutbits % 8) {
-                    outbyte <<= 1;
-                }
-                else {
-                    #ifdef DEBUG0
-                    fprintf(stderr, "  output payload byte: 0x%02x\n", outbyte);
-                    #endif
-                    *pout++ = outbyte;
-                    outbyte = 0;
-                }
-            }
-
+            codewords[ncodewords++] = ingolay;
             ingolay = 0;
         }
     } /* while(.... */
 
-
-    #ifdef DEBUG0
-    fprintf(stderr, "finishing up .....\n");
-    #endif
-
-    /* Complete final Golay decode  */
+    /* Final partial Golay codeword */
 
     int golayparity = 0;
     if (ningolay % 12) {
@@ -420,24 +388,32 @@ void horus_l2_decode_rx_packet(unsigned char *output_payload_data,
         }
 
         ingolay >>= 1;
-        int codeword = (ingolay<<12) + golayparity;
+        codewords[ncodewords++] = (ingolay<<12) + golayparity;
         #ifdef DEBUG0
         fprintf(stderr, "  ningolay: %d ingolay: 0x%04x\n", ningolay, ingolay);
-        fprintf(stderr, "  golay code word: 0x%04x\n", codeword);
-        fprintf(stderr, "  golay decode...: 0x%04x\n", golay23_decode(codeword));
+        fprintf(stderr, "  golay code word: 0x%04x\n", codewords[ncodewords-1]);
         #endif
+    }
+
+    golay23_decode_batch(codewords, codewords, ncodewords);
+
+    /* write decoded/error corrected bits to output payload data, the
+       bits of a final partial codeword sit one place higher */
+
+    pout = output_payload_data;
+    noutbits = 0;
+    outbyte = 0;
 
-        outdata = golay23_decode(codeword) >> 11;
+    for(k=0; k<ncodewords; k++) {
+        outdata = codewords[k] >> 11;
         #ifdef DEBUG0
         fprintf(stderr, "  outdata...: 0x%04x\n", outdata);
-        fprintf(stderr, "  num_payload_data_bits: %d noutbits: %d\n", num_payload_data_bits, noutbits);
         #endif
 
-        /* write final byte */
-
-        int ntogo = num_payload_data_bits - noutbits;
-        for(i=0; i<ntogo; i++) {   
-            shift = ntogo - i;
+        ntogo = num_payload_data_bits - noutbits;
+        nbits = (ntogo < 12) ? ntogo : 12;
+        for(i=0; i<nbits; i++) {
+            shift = (ntogo < 12) ? ntogo - i : 11 - i;
             outbit = (outdata >> shift) & 0x1;
             outbyte |= outbit;
             noutbits++;
@@ -876,291 +852,6 @@ int main(void) {
 }
 #endif
 
-/*---------------------------------------------------------------------------*\
-
-                                   GOLAY FUNCTIONS
-
-\*---------------------------------------------------------------------------*/
-
-/* File:    golay23.c
- * Title:   Encoder/decoder for a binary (23,12,7) Golay code
- * Author:  Robert Morelos-Zaragoza (robert@spectra.eng.hawaii.edu)
- * Date:    August 1994
- *
- * The binary (23,12,7) Golay code is an example of a perfect code, that is,
- * the number of syndromes equals the number of correctable error patterns.
- * The minimum distance is 7, so all error patterns of Hamming weight up to
- * 3 can be corrected. The total number of these error patterns is:
- *
- *       Number of errors         Number of patterns
- *       ----------------         ------------------
- *              0                         1
- *              1                        23
- *              2                       253
- *              3                      1771
- *                                     ----
- *    Total number of error patterns = 2048 = 2^{11} = number of syndromes
- *                                               --
- *                number of redundant bits -------^
- *
- * Because of its relatively low length (23), dimension (12) and number of
- * redundant bits (11), the binary (23,12,7) Golay code can be encoded and
- * decoded simply by using look-up tables. The program below uses a 16K
- * encoding table and an 8K decoding table.
- *
- * For more information, suggestions, or other ideas on implementing error
- * correcting codes, please contact me at (I'm temporarily in Japan, but
- * below is my U.S. address):
- *
- *                    Robert Morelos-Zaragoza
- *                    770 S. Post Oak Ln. #200
- *                      Houston, Texas 77056
- *
- *             email: robert@spectra.eng.hawaii.edu
- *
- *       Homework: Add an overall parity-check bit to get the (24,12,8)
- *                 extended Golay code.
- *
- * COPYRIGHT NOTICE: This computer program is free for non-commercial purposes.
- * You may implement this program for any non-commercial application. You may
- * also implement this program for commercial purposes, provided that you
- * obtain my written permission. Any modification of this program is covered
- * by this copyright.
- *
- * ==   Copyright (c) 1994  Robert Morelos-Zaragoza. All rights reserved.   ==
- */
-
-#include <assert.h>
-#include <stdio.h>
-#include <stdlib.h>
-#define X22             0x00400000   /* vector representation of X^{22} */
-#define X11             0x00000800   /* vector representation of X^{11} */
-#define MASK12          0xfffff800   /* auxiliary vector for testing */
-#define GENPOL          0x00000c75   /* generator polinomial, g(x) */
-
-/* Global variables:
- *
- * pattern = error pattern, or information, or received vector
- * encoding_table[] = encoding table
- * decoding_table[] = decoding table
- * data = information bits, i(x)
- * codeword = code bits = x^{11}i(x) + (x^{11}i(x) mod g(x))
- * numerr = number of errors = Hamming weight of error polynomial e(x)
- * position[] = error positions in the vector representation of e(x)
- * recd = representation of corrupted received polynomial r(x) = c(x) + e(x)
- * decerror = number of decoding errors
- * a[] = auxiliary array to generate correctable error patterns
- */
-
-#ifdef HORUS_L2_RX
-static int inited =  0;
-
-#ifdef RUN_TIME_TABLES
-static int encoding_table[4096], decoding_table[2048];
-#else
-#include "golayenctable.h"
-#include "golaydectable.h"
-#endif
-
-#ifdef RUN_TIME_TABLES
-static int arr2int(int a[], int r)
-/*
- * Convert a binary vector of Hamming weight r, and nonzero positions in
- * array a[1]...a[r], to a long integer \sum_{i=1}^r 2^{a[i]-1}.
- */
-{
-   int i;
-   long mul, result = 0, temp;
-
-   for (i=1; i<=r; i++) {
-      mul = 1;
-      temp = a[i]-1;
-      while (temp--)
-         mul = mul << 1;
-      result += mul;
-      }
-   return(result);
-}
-#endif
-#endif
-
-#ifdef HORUS_L2_RX
-void nextcomb(int n, int r, int a[])
-/*
- * Calculate next r-combination of an n-set.
- */
-{
-  int  i, j;
-
-  a[r]++;
-  if (a[r] <= n)
-      return;
-  j = r - 1;
-  while (a[j] == n - r + j)
-     j--;
-  for (i = r; i >= j; i--)
-      a[i] = a[j] + i - j + 1;
-  return;
-}
-#endif
-
-int32_t get_syndrome(int32_t pattern)
-/*
- * Compute the syndrome corresponding to the given pattern, i.e., the
- * remainder after dividing the pattern (when considering it as the vector
- * representation of a polynomial) by the generator polynomial, GENPOL.
- * In the program this pattern has several meanings: (1) pattern = infomation
- * bits, when constructing the encoding table; (2) pattern = error pattern,
- * when constructing the decoding table; and (3) pattern = received vector, to
- * obtain its syndrome in decoding.
- */
-{
-    int32_t aux = X22;
-
-    if (pattern >= X11)
-       while (pattern & MASK12) {
-           while (!(aux & pattern))
-              aux = aux >> 1;
-           pattern ^= (aux/X11) * GENPOL;
-           }
-    return(pattern);
-}
-
-#ifdef HORUS_L2_RX
-
-/*---------------------------------------------------------------------------*\
-
-  FUNCTION....: golay23_init()
-  AUTHOR......: David Rowe
-  DATE CREATED: 3 March 2013
-
-  Call this once when you start your program to init the Golay tables.
-
-\*---------------------------------------------------------------------------*/
-
-void golay23_init(void) {
-#ifdef RUN_TIME_TABLES
-   int  i;
-   long temp;
-   int  a[4];
-   int  pattern;
-
-   /*
-    * ---------------------------------------------------------------------
-    *                  Generate ENCODING TABLE
-    *
-    * An entry to the table is an information vector, a 32-bit integer,
-    * whose 12 least significant positions are the information bits. The
-    * resulting value is a codeword in the (23,12,7) Golay code: A 32-bit
-    * integer whose 23 least significant bits are coded bits: Of these, the
-    * 12 most significant bits are information bits and the 11 least
-    * significant bits are redundant bits (systematic encoding).
-    * ---------------------------------------------------------------------
-    */
-    for (pattern = 0; pattern < 4096; pattern++) {
-        temp = pattern << 11;          /* multiply information by X^{11} */
-        encoding_table[pattern] = temp + get_syndrome(temp);/* add redundancy */
-        }
-
-   /*
-    * ---------------------------------------------------------------------
-    *                  Generate DECODING TABLE
-    *
-    * An entry to the decoding table is a syndrome and the resulting value
-    * is the most likely error pattern. First an error pattern is generated.
-    * Then its syndrome is calculated and used as a pointer to the table
-    * where the error pattern value is stored.
-    * ---------------------------------------------------------------------
-    *
-    * (1) Error patterns of WEIGHT 1 (SINGLE ERRORS)
-    */
-    decoding_table[0] = 0;
-    decoding_table[1] = 1;
-    temp = 1;
-    for (i=2; i<= 23; i++) {
-        temp *= 2;
-        decoding_table[get_syndrome(temp)] = temp;
-        }
-   /*
-    * (2) Error patterns of WEIGHT 2 (DOUBLE ERRORS)
-    */
-    a[1] = 1; a[2] = 2;
-    temp = arr2int(a,2);
-    decoding_table[get_syndrome(temp)] = temp;
-    for (i=1; i<253; i++) {
-        nextcomb(23,2,a);
-        temp = arr2int(a,2);
-        decoding_table[get_syndrome(temp)] = temp;
-        }
-   /*
-    * (3) Error patterns of WEIGHT 3 (TRIPLE ERRORS)
-    */
-    a[1] = 1; a[2] = 2; a[3] = 3;
-    temp = arr2int(a,3);
-    decoding_table[get_syndrome(temp)] = temp;
-    for (i=1; i<1771; i++) {
-        nextcomb(23,3,a);
-        temp = arr2int(a,3);
-        decoding_table[get_syndrome(temp)] = temp;
-    }
-#endif
-    inited = 1;
-}
-
-/*---------------------------------------------------------------------------*\
-
-  FUNCTION....: golay23_encode()
-  AUTHOR......: David Rowe
-  DATE CREATED: 3 March 2013
-
-  Given 12 bits of data retiurns a 23 bit codeword for transmission
-  over the channel.
-
-\*---------------------------------------------------------------------------*/
-
-int golay23_encode(int data) {
-    assert(inited);
-    assert(data <= 0xfff);
-
-    //printf("data: 0x%x\n", data);
-    return encoding_table[data];
-}
-
-/*---------------------------------------------------------------------------*\
-
-  FUNCTION....: golay23_decode()
-  AUTHOR......: David Rowe
-  DATE CREATED: 3 March 2013
-
-  Given a 23 bit received codeword, returns the 12 bit corrected data.
-
-\*---------------------------------------------------------------------------*/
-
-int golay23_decode(int received_codeword) {
-    assert(inited);
-    assert((received_codeword < (1<<23)) && (received_codeword >= 0));
-
-    //printf("syndrome: 0x%x\n", get_syndrome(received_codeword));
-    return received_codeword ^= decoding_table[get_syndrome(received_codeword)];
-}
-
-int golay23_count_errors(int recd_codeword, int corrected_codeword)
-{
-    int errors = 0;
-    int diff, i;
-
-    diff = recd_codeword ^ corrected_codeword;
-    for(i=0; i<23; i++) {
-        if (diff & 0x1)
-            errors++;
-        diff >>= 1;
-    }
-
-    return errors;
-}
-
-#endif
-
 // from http://stackoverflow.com/questions/10564491/function-to-calculate-a-crc16-checksum
 
 unsigned short gen_crc16(unsigned char* data_p, unsigned char length){
@@ -30,6 +30,7 @@
 #include <string.h>
 #include <stdio.h>
 
+#include "codec2_math.h"
 #include "defines.h"
 #include "interp.h"
 #include "lsp.h"
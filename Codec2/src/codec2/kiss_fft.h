@@ -29,8 +29,9 @@ extern "C" {
 #define KISS_FFT_MALLOC(nbytes) _mm_malloc(nbytes,16)
 #define KISS_FFT_FREE _mm_free
 #else
-#define KISS_FFT_MALLOC malloc
-#define KISS_FFT_FREE free
+#include "codec2_arena.h"
+#define KISS_FFT_MALLOC codec2_malloc
+#define KISS_FFT_FREE codec2_free
 #endif
 
 
@@ -38,6 +38,7 @@
 #include <stdlib.h>
 #include <math.h>
 
+#include "codec2_math.h"
 #include "linreg.h"
 #include "comp_prim.h"
 
@@ -33,6 +33,7 @@
 
 #include <assert.h>
 #include <math.h>
+#include "codec2_math.h"
 #include "defines.h"
 #include "lpc.h"
 
@@ -126,6 +127,14 @@ void autocorrelate(
   int order	/* order of LPC analysis */
 )
 {
+#ifdef CODEC2_FIXED_POINT
+  q15_t q[Nsam];	/* Sn[] in Q15, x 2^-e */
+  int e,j;
+
+  e = q15_block(q, Sn, Nsam);
+  for(j=0; j<order+1; j++)
+    Rn[j] = ldexpf((float)q15_dot(q, &q[j], Nsam-j), 2*e);
+#else
   int i,j;	/* loop variables */
 
   for(j=0; j<order+1; j++) {
@@ -133,6 +142,7 @@ void autocorrelate(
     for(i=0; i<Nsam-j; i++)
       Rn[j] += Sn[i]*Sn[i+j];
   }
+#endif
 }
 
 /*---------------------------------------------------------------------------*\
@@ -28,6 +28,7 @@
   along with this program; if not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "codec2_math.h"
 #include "defines.h"
 #include "lsp.h"
 #include <math.h>
@@ -84,6 +85,7 @@
 
 \*---------------------------------------------------------------------------*/
 
+#ifndef CODEC2_FIXED_POINT
 
 static float
 cheb_poly_eva(float *coef,float x,int order)
@@ -119,6 +121,133 @@ cheb_poly_eva(float *coef,float x,int order)
     return sum;
 }
 
+#else
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: cheb_poly_eva_q()
+  DATE CREATED: Oct 2026
+
+  Q30 version of cheb_poly_eva().  |T[i](x)| <= 1 for |x| <= 1, so
+  with x clamped at -1 (the last step of the search can overshoot, the
+  roots are all inside) T[] fits Q30 in 32 bits.  coef[] is block
+  scaled to 28 bits by cheb_coef_q() so the 64 bit sum can't overflow.
+  Only the sign of the result is used.
+
+\*---------------------------------------------------------------------------*/
+
+static int64_t cheb_poly_eva_q(q31_t *coef, q31_t x, int order)
+{
+    int     i;
+    int64_t sum;
+    q31_t   T[(order / 2) + 1];
+
+    if (x < -(1<<30))
+	x = -(1<<30);
+    T[0] = 1<<30;
+    T[1] = x;
+    for(i=2;i<=order/2;i++)
+	T[i] = (q31_t)((((int64_t)x*T[i-1]) >> 29) - T[i-2]);
+
+    sum = 0;
+    for(i=0;i<=order/2;i++)
+	sum += (int64_t)coef[(order/2)-i]*T[i];
+
+    return sum;
+}
+
+static void cheb_coef_q(q31_t q[], float c[], int n)
+{
+    float max, scale;
+    int   e, i;
+
+    max = 1E-12;
+    for(i=0; i<n; i++)
+	if (fabsf(c[i]) > max)
+	    max = fabsf(c[i]);
+    frexpf(max, &e);
+    scale = ldexpf(1.0, 28-e);
+    for(i=0; i<n; i++)
+	q[i] = (q31_t)(c[i]*scale);
+}
+
+/* true when the polynomial changes sign between the two points, as
+   (psumr*psuml < 0.0) || (psumr == 0.0) in lpc_to_lsp() */
+
+static int sign_change_q(int64_t psumr, int64_t psuml)
+{
+    return ((psumr < 0) && (psuml > 0)) || ((psumr > 0) && (psuml < 0)) || (psumr == 0);
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: lsp_roots_q()
+  DATE CREATED: Oct 2026
+
+  The root search of lpc_to_lsp() with x in Q30, returns the roots in
+  the x=cos(w) domain.
+
+\*---------------------------------------------------------------------------*/
+
+static int lsp_roots_q(float *P, float *Q, int order, float *freq, int nb, float delta)
+{
+    q31_t   Pq[(order / 2) + 1], Qq[(order / 2) + 1];
+    q31_t  *pt;
+    q31_t   xl, xr, xm = 0, temp_xr, dx;
+    int64_t psuml, psumr, psumm, temp_psumr;
+    int     j, k, flag, roots = 0;
+
+    cheb_coef_q(Pq, P, order/2 + 1);
+    cheb_coef_q(Qq, Q, order/2 + 1);
+    dx = (q31_t)(delta*(1<<30));
+
+    xr = 0;
+    xl = 1<<30;
+
+    for(j=0;j<order;j++){
+	pt = (j%2) ? Qq : Pq;
+
+	psuml = cheb_poly_eva_q(pt,xl,order);
+	flag = 1;
+	while(flag && (xr >= -(1<<30))){
+	    xr = xl - dx;
+	    psumr = cheb_poly_eva_q(pt,xr,order);
+	    temp_psumr = psumr;
+	    temp_xr = xr;
+
+	    if(sign_change_q(psumr, psuml)){
+		roots++;
+
+		psumm=psuml;
+		for(k=0;k<=nb;k++){
+		    xm = xl/2 + xr/2;
+		    psumm=cheb_poly_eva_q(pt,xm,order);
+		    if(((psumm > 0) && (psuml > 0)) || ((psumm < 0) && (psuml < 0))){
+			psuml=psumm;
+			xl=xm;
+		    }
+		    else{
+			psumr=psumm;
+			xr=xm;
+		    }
+		}
+
+		freq[j] = xm*(1.0/(1<<30));
+		xl = xm;
+		flag = 0;
+	    }
+	    else{
+		psuml=temp_psumr;
+		xl=temp_xr;
+	    }
+	}
+    }
+
+    return roots;
+}
+
+#endif
+
 
 /*---------------------------------------------------------------------------*\
 
@@ -137,20 +266,22 @@ int lpc_to_lsp (float *a, int order, float *freq, int nb, float delta)
 /*  int nb			number of sub-intervals (4) 		*/
 /*  float delta			grid spacing interval (0.02) 		*/
 {
+#ifndef CODEC2_FIXED_POINT
     float psuml,psumr,psumm,temp_xr,xl,xr,xm = 0;
     float temp_psumr;
-    int i,j,m,flag,k;
+    int j,flag,k;
+    float *pt;                	/* ptr used for cheb_poly_eval()
+				   whether P' or Q' 			*/
+#endif
+    int i,m;
     float *px;                	/* ptrs of respective P'(z) & Q'(z)	*/
     float *qx;
     float *p;
     float *q;
-    float *pt;                	/* ptr used for cheb_poly_eval()
-				   whether P' or Q' 			*/
     int roots=0;              	/* number of roots found 	        */
     float Q[order + 1];
     float P[order + 1];
 
-    flag = 1;
     m = order/2;            	/* order of P'(z) & Q'(z) polynimials 	*/
 
     /* Allocate memory space for polynomials */
@@ -179,6 +310,9 @@ int lpc_to_lsp (float *a, int order, float *freq, int nb, float delta)
     px = P;             	/* re-initialise ptrs 			*/
     qx = Q;
 
+#ifdef CODEC2_FIXED_POINT
+    roots = lsp_roots_q(P, Q, order, freq, nb, delta);
+#else
     /* Search for a zero in P'(z) polynomial first and then alternate to Q'(z).
     Keep alternating between the two polynomials as each zero is found 	*/
 
@@ -237,6 +371,7 @@ int lpc_to_lsp (float *a, int order, float *freq, int nb, float delta)
 	    }
 	}
     }
+#endif
 
     /* convert from x domain to radians */
 
@@ -265,6 +400,47 @@ void lsp_to_lpc(float *lsp, float *ak, int order)
 
 
 {
+#ifdef CODEC2_FIXED_POINT
+    int i,j;
+    q31_t xout1,xout2,xin1,xin2;
+    q31_t *w;
+    q31_t x[order];		/* cos(lsp) in Q30 */
+    q31_t W[(order * 4) + 2];	/* filter states in Q19 */
+
+    /* The cascade in Q19.  Each section's coefficient magnitudes sum
+       to at most 4, so for order 10 nothing exceeds 2*4^5 = 2^11, 2^30
+       in Q19. */
+
+    for(i=0; i<order; i++)
+	x[i] = (q31_t)(cosf(lsp[i])*(1<<30));
+    for(i=0;i<=4*(order/2)+1;i++)
+	W[i] = 0;
+
+    xin1 = 1<<19;
+    xin2 = 1<<19;
+    for(j=0;j<=order;j++){
+	for(i=0;i<(order/2);i++){
+	    w = W+(i*4);
+	    xout1 = xin1 - (q31_t)(((int64_t)x[2*i]*w[0]) >> 29) + w[1];
+	    xout2 = xin2 - (q31_t)(((int64_t)x[2*i+1]*w[2]) >> 29) + w[3];
+	    w[1] = w[0];
+	    w[3] = w[2];
+	    w[0] = xin1;
+	    w[2] = xin2;
+	    xin1 = xout1;
+	    xin2 = xout2;
+	}
+	w = W+(order/2)*4;
+	xout1 = xin1 + w[0];
+	xout2 = xin2 - w[1];
+	ak[j] = (float)((int64_t)xout1 + xout2)*(0.5f/(1<<19));
+	w[0] = xin1;
+	w[1] = xin2;
+
+	xin1 = 0;
+	xin2 = 0;
+    }
+#else
     int i,j;
     float xout1,xout2,xin1,xin2;
     float *pw,*n1,*n2,*n3,*n4 = 0;
@@ -317,5 +493,309 @@ void lsp_to_lpc(float *lsp, float *ak, int order)
 	xin1 = 0.0;
 	xin2 = 0.0;
     }
+#endif
+}
+
+
+#ifdef CODEC2_MATH_UNITTEST
+#include <string.h>
+#include <time.h>
+#include "lpc.h"
+#include "sine.h"
+#include "postfilter.h"
+
+/*
+  Reference vector test of the kernels codec2_math.h swaps in each
+  profile, see the build line there.  The vectors below were printed
+  by the default build with "./c2math gen", for frames generated here
+  from a fixed seed.  Each profile must stay within the tolerances.
+  Those for autocorrelate, the LSPs and ak are a few times the worst
+  errors seen over 20000 random frames, synthesise() and postfilter()
+  come in well under theirs.
+
+  It then times each kernel, run it in each profile to compare them.
+*/
+
+#define UT_FRAMES     4
+#define UT_NSAM       320                 /* LPC analysis window          */
+#define UT_ORDER      10
+#define UT_NSAMP      80                  /* n_samp at 8 kHz              */
+#define UT_L          40                  /* harmonics for the postfilter */
+
+#define UT_TOL_RN     1E-4                /* of R[0]                      */
+#define UT_TOL_LSP    2.5E-3              /* radians                      */
+#define UT_TOL_AK     2E-4
+#define UT_TOL_SYNTH  1E-4                /* of the peak output           */
+#define UT_TOL_BG     1E-3                /* dB                           */
+
+#define UT_TIME_RUNS  20000               /* calls timed per kernel       */
+
+static const float ref_Rn[UT_FRAMES][UT_ORDER+1] = {
+    { 378871808, 257542368, 154011952, 115774456, 66809452, -48756804, -74261712, -73471136, -66154688, -72099064, -54527100 },
+    { 380553216, 302299552, 196304048, 144246640, 118259984, 94572296, 23742022, -54570212, -76169264, -73895664, -69571480 },
+    { 382248096, 327271808, 235461968, 173313616, 138742768, 120407584, 103545072, 66490920, -2576355.25, -57926968, -75136960 },
+    { 382202080, 342446208, 265642496, 201993472, 160752032, 136240416, 121354912, 108489584, 86079920, 40588260, -18755074 }
+};
+static const float ref_lsp[UT_FRAMES][UT_ORDER] = {
+    {
+        0.265948117, 0.438681364, 0.661769092, 0.970741332, 1.40075874,
+        1.61518526, 1.85019815, 2.06185722, 2.47576404, 2.94125128
+    },
+    {
+        0.233040377, 0.380611807, 0.668856323, 1.05080175, 1.25642431,
+        1.44609785, 1.8068893, 2.1925962, 2.35874128, 2.69705915
+    },
+    {
+        0.202676699, 0.346329242, 0.715856373, 0.964670181, 1.12266529,
+        1.50762856, 1.7902081, 1.96059179, 2.47072124, 2.64665604
+    },
+    {
+        0.179650128, 0.331285298, 0.723442256, 0.853714705, 1.18521881,
+        1.4571135, 1.6748898, 2.07002592, 2.30017328, 2.71938467
+    }
+};
+static const float ref_ak[UT_FRAMES][UT_ORDER+1] = {
+    { 1, -0.834849238, 0.25528276, -0.195863605, -0.201035142, 0.61455369, -0.322603464, 0.206992626, -0.138314962, -0.0477932692, 0.113282084 },
+    { 1, -1.18828654, 0.71402657, -0.512501061, 0.349158227, -0.486347914, 0.395227671, 0.0812916756, -0.155994058, 0.134430051, -0.0595302582 },
+    { 1, -1.47984946, 1.09625065, -0.752796292, 0.518921733, -0.46257925, 0.387473583, -0.598043442, 0.804368496, -0.462917447, 0.147031903 },
+    { 1, -1.6645366, 1.35897386, -0.919820428, 0.543545842, -0.310182333, 0.0992004871, 0.042160511, -0.284578323, 0.297194123, -0.0139058828 }
+};
+static const float ref_Sn_[UT_FRAMES][UT_NSAMP] = {
+    {
+        0, -4.49732065, 66.7990417, -35.8219185, -98.923996, 350.819336, 151.863419, -92.4225769,
+        -56.7008362, 238.304108, 88.9870377, 228.405228, 124.447426, 2.61278009, -161.218353, -557.45166,
+        -500.781433, -486.894135, -438.202301, -75.3588638, -269.478912, -308.344727, -678.989197, 581.56427,
+        -86.9694748, -417.038696, 126.477531, 159.375427, -659.232117, 744.768311, 1126.44543, 11.162097,
+        1204.1665, -518.310852, -910.115112, 2492.24316, 833.44342, -307.568207, -227.333389, 894.015381,
+        228.987976, 1028.83252, 467.987701, 33.7300949, -510.395569, -1472.05908, -1421.9939, -1499.35303,
+        -1288.76392, -50.866188, -663.969727, -853.748047, -1647.79712, 1423.17419, -346.702576, -820.342651,
+        313.68512, 265.840698, -1403.02942, 1511.81799, 1923.39209, 283.3909, 2602.92847, -1215.1886,
+        -1770.92236, 4600.54688, 1383.92114, -213.978958, -277.600952, 1282.53503, 208.049042, 2050.99927,
+        887.685303, 57.4710884, -825.714966, -2148.93555, -2273.71167, -2733.95532, -2243.79346, 82.2359619
+    },
+    {
+        -1019.08856, -1533.15527, -2489.1377, 2100.78589, -626.36969, -879.826416, 573.064148, 263.07312,
+        -2128.94092, 1595.91333, 2236.44775, 795.279541, 2930.40625, -1413.12915, -1348.23364, 4801.8374,
+        557.355408, 505.888794, 352.487396, 1309.66187, -284.965668, 2786.02197, 1770.3374, 309.048401,
+        -1038.21887, -2353.93799, -1256.51135, -2491.48218, -1461.97021, -430.934387, -2470.36279, -2426.95801,
+        -3411.03809, 65.1201172, -518.972473, -614.404663, 454.701904, 626.246033, 554.309692, 4584.46631,
+        2050.49341, 2855.00415, 1795.99841, -1205.47083, -1016.29639, 2495.16479, 1307.05615, 909.626465,
+        -961.872437, -1622.44702, -2687.88013, -363.926636, -110.708038, 66.8638763, 482.542877, 602.265442,
+        -147.321564, -646.869873, -3925.13599, -1597.26892, 999.009827, 30.3914185, -2340.90454, 672.228699,
+        1689.67749, 1587.84558, -2635.03906, 2118.60767, 1561.89478, 2558.81738, -988.184998, 3735.09985,
+        4147.31006, 1835.03784, -1468.05957, -1955.5929, 690.996948, -1314.19702, -409.147552, -1755.03113
+    },
+    {
+        -4744.31738, -3288.28589, -4859.60156, -2715.60498, -627.07019, -647.393372, -273.516785, 859.628784,
+        3304.79492, 6691.56201, 2253.02319, 4335.46387, -754.672729, -966.268433, -1551.05322, -346.65451,
+        1334.69043, 1951.6377, -1269.33008, -1759.39429, -2820.75781, -893.189148, -160.925781, 862.495667,
+        1714.30688, 1442.474, 743.431763, 537.223389, -2310.07861, -2044.14636, 23.3075256, -788.181396,
+        -2306.28394, -475.263947, 833.638977, 906.968506, -534.758789, 3018.73535, 2627.11304, 3044.98193,
+        438.485535, 3308.19312, 2034.95544, 927.641296, 1033.74451, 479.960449, -830.269897, -865.805603,
+        -2288.51733, -3482.8374, -4120.7373, -4097.18652, -5099.39404, -4593.02539, -2921.37329, 1577.61206,
+        1295.49585, -522.210632, 1608.35767, 3491.00293, 374.626221, 472.543518, -2194.29175, -187.961853,
+        359.183929, -424.540558, 15.6862488, 1856.49731, 3170.21655, 4104.5835, -1388.69214, -161.478592,
+        -2150.58179, -3416.27734, -2258.93896, 2117.29224, -721.684814, 2846.70752, 5071.771, 2045.81946
+    },
+    {
+        310.337769, 1810.73083, 1326.64026, -2529.55933, -6158.40137, -3413.90161, -887.648499, 956.218567,
+        -1440.3811, -433.989899, 696.190063, 754.300842, 1285.06433, 2311.69873, 2649.32227, 1560.60938,
+        1125.14075, 1765.01953, 870.871277, -734.289612, -877.105896, -483.827087, -699.094604, -139.586639,
+        -937.658936, -1013.56927, 1050.77441, 2409.49902, 2456.25977, 1946.99463, 600.3125, -128.490723,
+        -1907.73242, -200.330566, 2346.8623, 1395.33521, -1573.51892, 157.059174, -907.365723, -2009.09277,
+        -1033.4668, -2146.90942, -3009.96533, -3143.43213, -1396.78174, 584.493835, -676.851685, -606.426819,
+        1688.60986, 1733.34277, -461.088531, -1151.95349, -1924.43042, -53.6470947, 1600.44006, 769.428162,
+        1786.80566, 1203.33862, -1059.53564, 1141.88123, 1240.76367, 1024.45776, 1168.78198, 648.288818,
+        -192.273438, 1104.29407, -80.5246124, -1861.54565, -2437.1748, 1445.3606, 1977.05396, 2004.00464,
+        -1232.6665, -2845.76587, -3907.59229, -1962.77148, 1956.4873, 2777.78027, -428.655243, -1078.96924
+    }
+};
+static const float ref_bg_est[UT_FRAMES] = {
+    0.8999089, 0.8999089, 1.72518766, 1.72518766
+};
+static const int ref_uv[UT_FRAMES] = {
+    0, 8, 0, 5
+};
+
+static unsigned long ut_seed = 1;
+
+static float ut_rand(void) {
+    ut_seed = ut_seed*1664525 + 1013904223;
+    return (float)((ut_seed >> 8) & 0xffffff)/16777216.0f;
+}
+
+/* windowed harmonics of Wo plus a little noise, speech sized */
+
+static void ut_speech(float Sn[], float Wo) {
+    float s[UT_NSAM], a[UT_NSAM/2], theta[UT_NSAM/2];
+    int   L = (int)(3.14159265f/Wo), h, n;
+
+    for(h=1; h<=L; h++) {
+        a[h] = 1000.0f*expf(-0.1f*h)*(1.0f + 0.5f*sinf(0.7f*h));
+        theta[h] = 6.2831853f*ut_rand();
+    }
+    for(n=0; n<UT_NSAM; n++) {
+        s[n] = 10.0f*(ut_rand() - 0.5f);
+        for(h=1; h<=L; h++)
+            s[n] += a[h]*cosf(Wo*h*n + theta[h]);
+    }
+    hanning_window(s, Sn, UT_NSAM);
+}
+
+static void ut_print(const char *name, const float x[], int n, int per_row) {
+    int i;
+
+    printf("%s\n", name);
+    for(i=0; i<n; i++)
+        printf("%s%.9g,%s", (i % per_row) ? " " : "    ", x[i], ((i % per_row) == per_row-1) ? "\n" : "");
+    if (n % per_row)
+        printf("\n");
+}
+
+static double ut_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1E6 + t.tv_nsec/1E3;
+}
+
+static int ut_check(const char *name, int f, const float x[], const float ref[], int n, float tol) {
+    float err = 0.0f;
+    int   i;
+
+    for(i=0; i<n; i++)
+        if (fabsf(x[i] - ref[i]) > err)
+            err = fabsf(x[i] - ref[i]);
+    printf("  frame %d %-12s max error %e%s\n", f, name, err, (err > tol) ? " Bad!" : "");
+
+    return err > tol;
+}
+
+int main(int argc, char *argv[]) {
+    C2CONST         c2const = c2const_create(8000);
+    codec2_fftr_cfg fftr_inv_cfg;
+    MODEL           model;
+    float           Sn[UT_NSAM], Rn[UT_ORDER+1], ak[UT_ORDER+1], lsp[UT_ORDER];
+    float           Pn[2*UT_NSAMP], Sn_[2*UT_NSAMP], phi[MAX_AMP+1], peak, bg_est;
+    float           out_Rn[UT_FRAMES][UT_ORDER+1], out_lsp[UT_FRAMES][UT_ORDER], out_ak[UT_FRAMES][UT_ORDER+1];
+    float           out_Sn_[UT_FRAMES][UT_NSAMP], out_bg_est[UT_FRAMES];
+    int             out_uv[UT_FRAMES];
+    int             gen = (argc > 1) && (strcmp(argv[1], "gen") == 0);
+    int             f, i, l, roots, fails = 0;
+    double          t0, us[5];
+
+    fftr_inv_cfg = codec2_fftr_alloc(FFT_DEC, 1, NULL, NULL);
+    make_synthesis_window(&c2const, Pn);
+    memset(Sn_, 0, sizeof(Sn_));
+    bg_est = 0.0;
+
+    for(f=0; f<UT_FRAMES; f++) {
+
+        /* autocorrelate() and lpc_to_lsp() on a synthetic vowel */
+
+        ut_speech(Sn, 6.2831853f/(40 + 15*f));
+        autocorrelate(Sn, out_Rn[f], UT_NSAM, UT_ORDER);
+        memcpy(Rn, out_Rn[f], sizeof(Rn));
+        levinson_durbin(Rn, ak, UT_ORDER);
+        roots = lpc_to_lsp(ak, UT_ORDER, out_lsp[f], 5, 0.01);   /* LSP_DELTA1 */
+        if (roots != UT_ORDER) {
+            printf("  frame %d lpc_to_lsp found %d roots Bad!\n", f, roots);
+            fails++;
+        }
+
+        /* lsp_to_lpc() from the reference LSPs, so errors don't compound */
+
+        memcpy(lsp, gen ? out_lsp[f] : ref_lsp[f], sizeof(lsp));
+        lsp_to_lpc(lsp, out_ak[f], UT_ORDER);
+
+        /* synthesise() of a random frame, overlap added onto the last */
+
+        model.Wo = 6.2831853f/(30 + 20*f);
+        model.L  = (int)(3.14159265f/model.Wo);
+        for(l=1; l<=model.L; l++) {
+            model.A[l] = 1000.0f*expf(-0.05f*l)*ut_rand();
+            model.phi[l] = 6.2831853f*ut_rand();
+        }
+        synthesise(UT_NSAMP, fftr_inv_cfg, Sn_, &model, Pn, 1);
+        memcpy(out_Sn_[f], Sn_, sizeof(out_Sn_[f]));
+
+        /* postfilter(), quiet unvoiced frames set bg_est for the voiced ones */
+
+        model.voiced = f & 1;
+        model.L = UT_L;
+        for(l=1; l<=UT_L; l++) {
+            model.A[l] = model.voiced ? powf(10.0f, 3.0f*ut_rand()) : 5.0f*ut_rand();
+            model.phi[l] = phi[l] = 0.0f;
+        }
+        postfilter(&model, &bg_est);
+        out_bg_est[f] = bg_est;
+        for(l=1, out_uv[f]=0; l<=UT_L; l++)
+            out_uv[f] += model.phi[l] != phi[l];
+    }
+
+    /* time the kernels on the last frame */
+
+    t0 = ut_us();
+    for(i=0; i<UT_TIME_RUNS; i++)
+        autocorrelate(Sn, Rn, UT_NSAM, UT_ORDER);
+    us[0] = ut_us() - t0;
+    t0 = ut_us();
+    for(i=0; i<UT_TIME_RUNS; i++)
+        lpc_to_lsp(ak, UT_ORDER, lsp, 5, 0.01);
+    us[1] = ut_us() - t0;
+    t0 = ut_us();
+    for(i=0; i<UT_TIME_RUNS; i++)
+        lsp_to_lpc(lsp, ak, UT_ORDER);
+    us[2] = ut_us() - t0;
+    t0 = ut_us();
+    for(i=0; i<UT_TIME_RUNS; i++)
+        synthesise(UT_NSAMP, fftr_inv_cfg, Sn_, &model, Pn, 1);
+    us[3] = ut_us() - t0;
+    t0 = ut_us();
+    for(i=0; i<UT_TIME_RUNS; i++)
+        postfilter(&model, &bg_est);
+    us[4] = ut_us() - t0;
+
+    codec2_fftr_free(fftr_inv_cfg);
+
+    if (gen) {
+        ut_print("REF_RN", &out_Rn[0][0], UT_FRAMES*(UT_ORDER+1), UT_ORDER+1);
+        ut_print("REF_LSP", &out_lsp[0][0], UT_FRAMES*UT_ORDER, UT_ORDER/2);
+        ut_print("REF_AK", &out_ak[0][0], UT_FRAMES*(UT_ORDER+1), UT_ORDER+1);
+        ut_print("REF_SN", &out_Sn_[0][0], UT_FRAMES*UT_NSAMP, 8);
+        ut_print("REF_BG", out_bg_est, UT_FRAMES, UT_FRAMES);
+        for(f=0; f<UT_FRAMES; f++)
+            printf("%s%d,", f ? " " : "REF_UV\n    ", out_uv[f]);
+        printf("\n");
+        return 0;
+    }
+
+    for(f=0, peak=0.0f; f<UT_FRAMES; f++)
+        for(i=0; i<UT_NSAMP; i++)
+            if (fabsf(ref_Sn_[f][i]) > peak)
+                peak = fabsf(ref_Sn_[f][i]);
+
+    for(f=0; f<UT_FRAMES; f++) {
+        fails += ut_check("autocorrelate", f, out_Rn[f], ref_Rn[f], UT_ORDER+1, UT_TOL_RN*ref_Rn[f][0]);
+        fails += ut_check("lpc_to_lsp", f, out_lsp[f], ref_lsp[f], UT_ORDER, UT_TOL_LSP);
+        fails += ut_check("lsp_to_lpc", f, out_ak[f], ref_ak[f], UT_ORDER+1, UT_TOL_AK);
+        fails += ut_check("synthesise", f, out_Sn_[f], ref_Sn_[f], UT_NSAMP, UT_TOL_SYNTH*peak);
+        fails += ut_check("postfilter", f, &out_bg_est[f], &ref_bg_est[f], 1, UT_TOL_BG);
+        if (out_uv[f] != ref_uv[f]) {
+            printf("  frame %d postfilter unvoiced %d harmonics, expected %d Bad!\n", f, out_uv[f], ref_uv[f]);
+            fails++;
+        }
+    }
+
+    printf("autocorrelate %6.2f lpc_to_lsp %6.2f lsp_to_lpc %6.2f synthesise %6.2f postfilter %6.2f us/call\n",
+           us[0]/UT_TIME_RUNS, us[1]/UT_TIME_RUNS, us[2]/UT_TIME_RUNS, us[3]/UT_TIME_RUNS, us[4]/UT_TIME_RUNS);
+
+    if (fails) {
+        printf("Bad!\n");
+        exit(1);
+    }
+
+    printf("Everything checks out\n");
+    return 0;
 }
 
+#endif
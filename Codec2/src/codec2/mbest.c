@@ -33,34 +33,47 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "codec2_math.h"
 #include "mbest.h"
+#include "codec2_arena.h"
+#include "vq_search.h"
 
 struct MBEST *mbest_create(int entries) {
-    int           i,j;
     struct MBEST *mbest;
 
     assert(entries > 0);
-    mbest = (struct MBEST *)malloc(sizeof(struct MBEST));
+    mbest = (struct MBEST *)codec2_malloc(sizeof(struct MBEST));
     assert(mbest != NULL);
 
-    mbest->entries = entries;
-    mbest->list = (struct MBEST_LIST *)malloc(entries*sizeof(struct MBEST_LIST));
+    mbest_init(mbest, (struct MBEST_LIST *)codec2_malloc(entries*sizeof(struct MBEST_LIST)), entries);
     assert(mbest->list != NULL);
 
+    return mbest;
+}
+
+
+/* sets up an mbest list in caller supplied memory, e.g. on the stack */
+
+void mbest_init(struct MBEST *mbest, struct MBEST_LIST list[], int entries) {
+    int i,j;
+
+    mbest->entries = entries;
+    mbest->list = list;
+    if (list == NULL)
+	return;
+
     for(i=0; i<mbest->entries; i++) {
 	for(j=0; j<MBEST_STAGES; j++)
 	    mbest->list[i].index[j] = 0;
 	mbest->list[i].error = 1E32;
     }
-
-    return mbest;
 }
 
 
 void mbest_destroy(struct MBEST *mbest) {
     assert(mbest != NULL);
-    free(mbest->list);
-    free(mbest);
+    codec2_free(mbest->list);
+    codec2_free(mbest);
 }
 
 
@@ -125,18 +138,19 @@ void mbest_search(
 		  int           index[] /* indexes that lead us here     */
 )
 {
-   float   e;
-   int     i,j;
-   float   diff;
-
-   for(j=0; j<m; j++) {
-	e = 0.0;
-	for(i=0; i<k; i++) {
-	    diff = cb[j*k+i]-vec[i];
-	    e += powf(diff*w[i],2.0);
+   float   e[VQ_BLOCK];
+   int     start,n,j;
+
+   for(start=0; start<m; start+=VQ_BLOCK) {
+	n = (m - start < VQ_BLOCK) ? m - start : VQ_BLOCK;
+	vq_errors(cb, k, m, start, n, vec, w, VQ_WEIGHTED, e);
+	for(j=0; j<n; j++) {
+	    /* most entries can't make the list, skip the insert for them */
+	    if (e[j] < mbest->list[mbest->entries-1].error) {
+		index[0] = start + j;
+		mbest_insert(mbest, index, e[j]);
+	    }
 	}
-	index[0] = j;
-	mbest_insert(mbest, index, e);
    }
 }
 
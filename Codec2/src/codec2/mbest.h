@@ -43,6 +43,7 @@ struct MBEST {
 };
 
 struct MBEST *mbest_create(int entries);
+void mbest_init(struct MBEST *mbest, struct MBEST_LIST list[], int entries);
 void mbest_destroy(struct MBEST *mbest);
 void mbest_insert(struct MBEST *mbest, int index[], float error);
 void mbest_search(const float  *cb, float vec[], float w[], int k, int m, struct MBEST *mbest, int index[]);
@@ -27,6 +27,7 @@
 
 #include <assert.h>
 #include <math.h>
+#include "codec2_math.h"
 #include "modem_stats.h"
 #include "codec2_fdmdv.h"
 
@@ -100,7 +101,7 @@ void modem_stats_get_rx_spectrum(struct MODEM_STATS *f, float mag_spec_dB[], COM
 
     /* FFT scales up a signal of level 1 FDMDV_NSPEC */
 
-    full_scale_dB = 20*log10(MODEM_STATS_NSPEC*FDMDV_SCALE);
+    full_scale_dB = 20*c2_log10(MODEM_STATS_NSPEC*FDMDV_SCALE);
 
     /* scale and convert to dB */
 
@@ -5,11 +5,19 @@
 
   C-callable core functions moved from MpDecode.c, so they can be used for
   Octave and C programs.
+
+  To compare the layered decoder with run_ldpc_decoder(), BER/FER and
+  time per codeword over BPSK/AWGN:
+
+    src$ gcc -O2 -DMPDECODE_LAYERED_BENCH -Icodec2 codec2/mpdecode_core.c \
+             -o ldpc_bench -lm && ./ldpc_bench [codewords]
 */
 
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include "codec2_math.h"
 #include "mpdecode_core.h"
 
 int extract_output(char out_char[], int DecodedBits[], int ParityCheckCount[], 
@@ -41,8 +49,8 @@ static float phi0(
     return( 9.2168e-3 );
   /* return( 8.1736e-003 ); */
   else {
-    z = (float) exp(x);
-    return( (float) log( (z+1)/(z-1) ) ); 
+    z = (float) c2_exp(x);
+    return( (float) c2_log( (z+1)/(z-1) ) ); 
   }
 }
 
@@ -62,12 +70,38 @@ static float LambdaAPPstar(	float mag1,
 				float mag2 )
 {
   if (mag1 > mag2)
-    return( fabs( mag2 + correction( mag1 + mag2 ) - correction( mag1 - mag2 ) ) );
+    return( c2_fabs( mag2 + correction( mag1 + mag2 ) - correction( mag1 - mag2 ) ) );
   else
-    return( fabs( mag1 + correction( mag1 + mag2 ) - correction( mag2 - mag1 ) ) );
+    return( c2_fabs( mag1 + correction( mag1 + mag2 ) - correction( mag2 - mag1 ) ) );
 }
 
-void init_c_v_nodes(struct c_node *c_nodes, 
+/* node memory comes from caller supplied scratch when mem != NULL,
+   otherwise from calloc() */
+
+struct LDPC_MEM {
+    char *next;
+    char *end;
+};
+
+#define LDPC_ALIGN       sizeof(double)
+#define LDPC_ROUND(n)    ((((size_t)(n)) + LDPC_ALIGN - 1) & ~(LDPC_ALIGN - 1))
+
+static void *ldpc_calloc(struct LDPC_MEM *mem, size_t nmemb, size_t size)
+{
+    size_t n = LDPC_ROUND(nmemb*size);
+    void  *p;
+
+    if (mem == NULL)
+        return calloc(nmemb, size);
+    if (n > (size_t)(mem->end - mem->next))
+        return NULL;
+    p = mem->next;
+    memset(p, 0, n);
+    mem->next += n;
+    return p;
+}
+
+static void init_nodes(struct c_node *c_nodes, 
                     int     shift, 
                     int     NumberParityBits, 
                     int     max_row_weight,
@@ -79,7 +113,8 @@ void init_c_v_nodes(struct c_node *c_nodes,
                     double *H_cols,
                     int     max_col_weight,
                     int     dec_type,
-                    double *input)
+                    ldpc_real *input,
+                    struct LDPC_MEM *mem)
 {
     int i, j, k, count, cnt, c_index, v_index;
 
@@ -131,9 +166,9 @@ void init_c_v_nodes(struct c_node *c_nodes,
         if (shift ==0){
             for (i=0;i<NumberParityBits;i++) {
                 /* now that we know the size, we can dynamically allocate memory */
-                c_nodes[i].index =  calloc( c_nodes[i].degree, sizeof( int ) );
-                c_nodes[i].message =calloc( c_nodes[i].degree, sizeof( float ) );
-                c_nodes[i].socket = calloc( c_nodes[i].degree, sizeof( int ) );
+                c_nodes[i].index =  ldpc_calloc(mem, c_nodes[i].degree, sizeof( int ) );
+                c_nodes[i].message =ldpc_calloc(mem, c_nodes[i].degree, sizeof( float ) );
+                c_nodes[i].socket = ldpc_calloc(mem, c_nodes[i].degree, sizeof( int ) );
 			
                 for (j=0;j<c_nodes[i].degree-2;j++) {
                     c_nodes[i].index[j] = (int) (H_rows[i+j*NumberParityBits] - 1);
@@ -157,9 +192,9 @@ void init_c_v_nodes(struct c_node *c_nodes,
             for (i=0;i<(NumberParityBits/shift);i++){		  
 		  
                 for (k =0;k<shift;k++){
-                    c_nodes[cnt].index =  calloc( c_nodes[cnt].degree, sizeof( int ) );
-                    c_nodes[cnt].message =calloc( c_nodes[cnt].degree, sizeof( float ) );
-                    c_nodes[cnt].socket = calloc( c_nodes[cnt].degree, sizeof( int ) );
+                    c_nodes[cnt].index =  ldpc_calloc(mem, c_nodes[cnt].degree, sizeof( int ) );
+                    c_nodes[cnt].message =ldpc_calloc(mem, c_nodes[cnt].degree, sizeof( float ) );
+                    c_nodes[cnt].socket = ldpc_calloc(mem, c_nodes[cnt].degree, sizeof( int ) );
 			 		   
                     for (j=0;j<c_nodes[cnt].degree-2;j++) {
                         c_nodes[cnt].index[j] = (int) (H_rows[cnt+j*NumberParityBits] - 1);
@@ -185,9 +220,9 @@ void init_c_v_nodes(struct c_node *c_nodes,
     } else {
         for (i=0;i<NumberParityBits;i++) {
             /* now that we know the size, we can dynamically allocate memory */
-            c_nodes[i].index =  calloc( c_nodes[i].degree, sizeof( int ) );
-            c_nodes[i].message =calloc( c_nodes[i].degree, sizeof( float ) );
-            c_nodes[i].socket = calloc( c_nodes[i].degree, sizeof( int ) );
+            c_nodes[i].index =  ldpc_calloc(mem, c_nodes[i].degree, sizeof( int ) );
+            c_nodes[i].message =ldpc_calloc(mem, c_nodes[i].degree, sizeof( float ) );
+            c_nodes[i].socket = ldpc_calloc(mem, c_nodes[i].degree, sizeof( int ) );
             for (j=0;j<c_nodes[i].degree;j++){
                 c_nodes[i].index[j] = (int) (H_rows[i+j*NumberParityBits] - 1);
             }			
@@ -235,10 +270,10 @@ void init_c_v_nodes(struct c_node *c_nodes,
 
     for (i=0;i<CodeLength;i++) {
         /* allocate memory according to the degree of the v-node */
-        v_nodes[i].index = calloc( v_nodes[i].degree, sizeof( int ) );
-        v_nodes[i].message = calloc( v_nodes[i].degree, sizeof( float ) );
-        v_nodes[i].sign = calloc( v_nodes[i].degree, sizeof( int ) );
-        v_nodes[i].socket = calloc( v_nodes[i].degree, sizeof( int ) );
+        v_nodes[i].index = ldpc_calloc(mem, v_nodes[i].degree, sizeof( int ) );
+        v_nodes[i].message = ldpc_calloc(mem, v_nodes[i].degree, sizeof( float ) );
+        v_nodes[i].sign = ldpc_calloc(mem, v_nodes[i].degree, sizeof( int ) );
+        v_nodes[i].socket = ldpc_calloc(mem, v_nodes[i].degree, sizeof( int ) );
 		
         /* index tells which c-nodes this v-node is connected to */
         v_nodes[i].initial_value = input[i];
@@ -265,9 +300,9 @@ void init_c_v_nodes(struct c_node *c_nodes,
                 }				
             /* initialize v-node with received LLR */			
             if ( dec_type == 1)
-                v_nodes[i].message[j] = fabs(input[i]);
+                v_nodes[i].message[j] = c2_fabs(input[i]);
             else
-                v_nodes[i].message[j] = phi0( fabs(input[i]) );
+                v_nodes[i].message[j] = phi0( c2_fabs(input[i]) );
 				
             if (input[i] < 0)
                 v_nodes[i].sign[j] = 1;			
@@ -293,6 +328,25 @@ void init_c_v_nodes(struct c_node *c_nodes,
 }
 
 
+void init_c_v_nodes(struct c_node *c_nodes, 
+                    int     shift, 
+                    int     NumberParityBits, 
+                    int     max_row_weight,
+                    double *H_rows,
+                    int     H1,
+                    int     CodeLength,
+                    struct v_node *v_nodes, 
+                    int     NumberRowsHcols, 
+                    double *H_cols,
+                    int     max_col_weight,
+                    int     dec_type,
+                    ldpc_real *input)
+{
+    init_nodes(c_nodes, shift, NumberParityBits, max_row_weight, H_rows, H1, CodeLength,
+               v_nodes, NumberRowsHcols, H_cols, max_col_weight, dec_type, input, NULL);
+}
+
+
 /* function for doing the MP decoding */
 void ApproximateMinStar(	 int	  BitErrors[],
 				 int      DecodedBits[],
@@ -379,7 +433,7 @@ void ApproximateMinStar(	 int	  BitErrors[],
       for (j=0;j<v_nodes[i].degree;j++) {
 	temp_sum = Qi - c_nodes[ v_nodes[i].index[j] ].message[ v_nodes[i].socket[j] ];
 				
-	v_nodes[i].message[j] = fabs( temp_sum );
+	v_nodes[i].message[j] = c2_fabs( temp_sum );
 	if (temp_sum > 0)
 	  v_nodes[i].sign[j] = 0;
 	else
@@ -452,7 +506,7 @@ void MinSum(		 int	  BitErrors[],
       for (j=0;j<v_nodes[i].degree;j++) {
 	temp_sum = Qi - c_nodes[ v_nodes[i].index[j] ].message[ v_nodes[i].socket[j] ];
 				
-	v_nodes[i].message[j] = fabs( temp_sum )*q_scale_factor;
+	v_nodes[i].message[j] = c2_fabs( temp_sum )*q_scale_factor;
 	if (temp_sum > 0)
 	  v_nodes[i].sign[j] = 0;
 	else
@@ -531,7 +585,7 @@ void SumProduct(	 int	  BitErrors[],
       for (j=0;j<v_nodes[i].degree;j++) {
 	temp_sum = Qi - c_nodes[ v_nodes[i].index[j] ].message[ v_nodes[i].socket[j] ];
 				
-	v_nodes[i].message[j] = phi0( fabs( temp_sum ) )*q_scale_factor;
+	v_nodes[i].message[j] = phi0( c2_fabs( temp_sum ) )*q_scale_factor;
 	if (temp_sum > 0)
 	  v_nodes[i].sign[j] = 0;
 	else
@@ -560,17 +614,45 @@ void SumProduct(	 int	  BitErrors[],
 }
 
 
-/* Convenience function to call LDPC decoder from C programs */
+/* Upper bound on the scratch memory run_ldpc_decoder_scratch() needs
+   for this code, c-node degree is at most max_row_weight+2 and v-node
+   degree max(max_col_weight,2)+1 */
+
+size_t ldpc_scratch_size(struct LDPC *ldpc) {
+    size_t R = ldpc->NumberParityBits;
+    size_t N = ldpc->CodeLength;
+    size_t cdeg = ldpc->max_row_weight + 2;
+    size_t vdeg = (ldpc->max_col_weight > 2 ? ldpc->max_col_weight : 2) + 1;
+
+    return LDPC_ROUND(R*sizeof(struct c_node)) + LDPC_ROUND(N*sizeof(struct v_node))
+         + R*(2*LDPC_ROUND(cdeg*sizeof(int)) + LDPC_ROUND(cdeg*sizeof(float)))
+         + N*(3*LDPC_ROUND(vdeg*sizeof(int)) + LDPC_ROUND(vdeg*sizeof(float)))
+         + LDPC_ROUND(ldpc->max_iter*N*sizeof(int)) + LDPC_ROUND(ldpc->max_iter*sizeof(int))
+         + LDPC_ROUND((N - R)*sizeof(int)) + LDPC_ALIGN;
+}
 
-int run_ldpc_decoder(struct LDPC *ldpc, char out_char[], double input[]) {
+/* Convenience function to call LDPC decoder from C programs.  All
+   decoder state lives in scratch, at least ldpc_scratch_size() bytes,
+   so there is no heap activity per codeword.  Returns the number of
+   iterations, or -1 if scratch is too small. */
+
+int run_ldpc_decoder_scratch(struct LDPC *ldpc, char out_char[], ldpc_real input[], void *scratch, size_t size) {
     int		max_iter, dec_type;
     float       q_scale_factor, r_scale_factor;
     int		max_row_weight, max_col_weight;
     int         CodeLength, NumberParityBits, NumberRowsHcols, shift, H1;
-    int         i;
     struct c_node *c_nodes;
     struct v_node *v_nodes;
+    struct LDPC_MEM mem;
     
+    if ((scratch == NULL) || (size < ldpc_scratch_size(ldpc)))
+        return -1;
+
+    /* start on an aligned boundary, the size bound allows for it */
+
+    mem.next = (char*)scratch + (LDPC_ALIGN - ((size_t)scratch % LDPC_ALIGN)) % LDPC_ALIGN;
+    mem.end = (char*)scratch + size;
+
     /* default values */
 
     max_iter  = ldpc->max_iter;
@@ -582,8 +664,10 @@ int run_ldpc_decoder(struct LDPC *ldpc, char out_char[], double input[]) {
     NumberParityBits = ldpc->NumberParityBits;
     NumberRowsHcols = ldpc->NumberRowsHcols;
 
-    int *DecodedBits = calloc( max_iter*CodeLength, sizeof( int ) );
-    int *ParityCheckCount = calloc( max_iter, sizeof(int) );
+    /* cleared on each call as scratch is zeroed as it is carved up */
+
+    int *DecodedBits = ldpc_calloc(&mem, max_iter*CodeLength, sizeof( int ) );
+    int *ParityCheckCount = ldpc_calloc(&mem, max_iter, sizeof(int) );
 
     /* derive some parameters */
 
@@ -597,28 +681,18 @@ int run_ldpc_decoder(struct LDPC *ldpc, char out_char[], double input[]) {
 	
     max_row_weight = ldpc->max_row_weight;
     max_col_weight = ldpc->max_col_weight;
-    /*	
-    c_nodes = calloc( NumberParityBits, sizeof( struct c_node ) );
-    v_nodes = calloc( CodeLength, sizeof( struct v_node));
-    */
+
     /* initialize c-node and v-node structures */
 
-    c_nodes = calloc( NumberParityBits, sizeof( struct c_node ) );
-    v_nodes = calloc( CodeLength, sizeof( struct v_node));
+    c_nodes = ldpc_calloc(&mem, NumberParityBits, sizeof( struct c_node ) );
+    v_nodes = ldpc_calloc(&mem, CodeLength, sizeof( struct v_node));
 	
-    init_c_v_nodes(c_nodes, shift, NumberParityBits, max_row_weight, ldpc->H_rows, H1, CodeLength, 
-                   v_nodes, NumberRowsHcols, ldpc->H_cols, max_col_weight, dec_type, input);
+    init_nodes(c_nodes, shift, NumberParityBits, max_row_weight, ldpc->H_rows, H1, CodeLength, 
+               v_nodes, NumberRowsHcols, ldpc->H_cols, max_col_weight, dec_type, input, &mem);
 
     int DataLength = CodeLength - NumberParityBits;
-    int *data_int = calloc( DataLength, sizeof(int) );
+    int *data_int = ldpc_calloc(&mem, DataLength, sizeof(int) );
 	
-    /* need to clear these on each call */
-
-    for(i=0; i<max_iter; i++)
-        ParityCheckCount[i] = 0;
-     for(i=0; i<max_iter*CodeLength; i++)
-         DecodedBits[i] = 0;
-
     /* Call function to do the actual decoding */
 
     if ( dec_type == 1) {
@@ -633,49 +707,397 @@ int run_ldpc_decoder(struct LDPC *ldpc, char out_char[], double input[]) {
                     NumberParityBits, max_iter, r_scale_factor, q_scale_factor, data_int ); 
     }
 
-    int iter = extract_output(out_char, DecodedBits, ParityCheckCount, max_iter, CodeLength, NumberParityBits);
+    return extract_output(out_char, DecodedBits, ParityCheckCount, max_iter, CodeLength, NumberParityBits);
+}
+
+/* Allocates the scratch run_ldpc_decoder() and ldpc_layered_create()
+   use, call once after the code parameters in ldpc are filled in (and
+   again via ldpc_close() if they change).  Returns 0 on success. */
+
+int ldpc_open(struct LDPC *ldpc) {
+    ldpc->scratch_size = ldpc_scratch_size(ldpc) + LDPC_ROUND(ldpc->CodeLength*sizeof(ldpc_real));
+    ldpc->scratch = malloc(ldpc->scratch_size);
+    if (ldpc->scratch == NULL) {
+        ldpc->scratch_size = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void ldpc_close(struct LDPC *ldpc) {
+    free(ldpc->scratch);
+    ldpc->scratch = NULL;
+    ldpc->scratch_size = 0;
+}
+
+/* As run_ldpc_decoder_scratch(), using the scratch allocated by
+   ldpc_open() */
 
-    /* Clean up memory */
+int run_ldpc_decoder(struct LDPC *ldpc, char out_char[], ldpc_real input[]) {
+    return run_ldpc_decoder_scratch(ldpc, out_char, input, ldpc->scratch, ldpc->scratch_size);
+}
 
-    free(ParityCheckCount);
-    free(DecodedBits);
-    free( data_int );
 
-    /*  Cleaning c-node elements */
+/*---------------------------------------------------------------------------*\
+
+  Layered normalised min-sum decoder.
+
+  The parity check matrix is flattened into one edge array when the
+  decoder is created, rather than the linked c_node/v_node structures.
+  Check nodes are updated one layer at a time, each update using the
+  posterior LLRs left by the one before, so it converges in roughly
+  half the iterations of the flooding decoders above.  Decoding stops
+  as soon as the hard decisions satisfy every parity check.
+
+  Rows are packed in to groups of LDPC_GROUP rows of equal degree that
+  share no variable nodes.  Updating the rows of a group together then
+  gives exactly the same result as updating them in turn, so the SIMD
+  builds work on the rows of a group across vector lanes and stay bit
+  exact with the portable C build (e.g. the Cortex M4).
+
+\*---------------------------------------------------------------------------*/
+
+#if !defined(LDPC_LAYERED_SCALAR) && defined(__SSE2__)
+#include <emmintrin.h>
+#define LDPC_LANES 4
+typedef __m128 ldpc_vec;
+#define LDPC_LOAD(p)      _mm_loadu_ps(p)
+#define LDPC_STORE(p,a)   _mm_storeu_ps(p,a)
+#define LDPC_SET1(x)      _mm_set1_ps(x)
+#define LDPC_ADD(a,b)     _mm_add_ps(a,b)
+#define LDPC_MUL(a,b)     _mm_mul_ps(a,b)
+#define LDPC_MIN(a,b)     _mm_min_ps(a,b)
+#define LDPC_MAX(a,b)     _mm_max_ps(a,b)
+#define LDPC_AND(a,b)     _mm_and_ps(a,b)
+#define LDPC_ANDNOT(a,b)  _mm_andnot_ps(a,b)    /* ~a & b */
+#define LDPC_XOR(a,b)     _mm_xor_ps(a,b)
+#define LDPC_SEL(m,a,b)   _mm_or_ps(_mm_and_ps(m,a), _mm_andnot_ps(m,b))
+#define LDPC_CMPEQ(a,b)   _mm_cmpeq_ps(a,b)
+#elif !defined(LDPC_LAYERED_SCALAR) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define LDPC_LANES 4
+typedef float32x4_t ldpc_vec;
+#define LDPC_U(a)         vreinterpretq_u32_f32(a)
+#define LDPC_F(a)         vreinterpretq_f32_u32(a)
+#define LDPC_LOAD(p)      vld1q_f32(p)
+#define LDPC_STORE(p,a)   vst1q_f32(p,a)
+#define LDPC_SET1(x)      vdupq_n_f32(x)
+#define LDPC_ADD(a,b)     vaddq_f32(a,b)
+#define LDPC_MUL(a,b)     vmulq_f32(a,b)
+#define LDPC_MIN(a,b)     vminq_f32(a,b)
+#define LDPC_MAX(a,b)     vmaxq_f32(a,b)
+#define LDPC_AND(a,b)     LDPC_F(vandq_u32(LDPC_U(a), LDPC_U(b)))
+#define LDPC_ANDNOT(a,b)  LDPC_F(vbicq_u32(LDPC_U(b), LDPC_U(a)))
+#define LDPC_XOR(a,b)     LDPC_F(veorq_u32(LDPC_U(a), LDPC_U(b)))
+#define LDPC_SEL(m,a,b)   vbslq_f32(LDPC_U(m), a, b)
+#define LDPC_CMPEQ(a,b)   LDPC_F(vceqq_f32(a,b))
+#else
+#define LDPC_LANES 1
+#endif
+
+#define LDPC_GROUP          8       /* rows updated together, multiple of LDPC_LANES  */
+#define LDPC_LAYERED_SCALE  0.875f   /* normalisation of the min-sum check messages    */
+
+struct LDPC_LAYERED {
+    int    CodeLength;
+    int    NumberParityBits;
+    int    max_iter;
+    float  scale;
+
+    int    ngroups;
+    int   *group_start;             /* first edge of each group                        */
+    int   *group_rows;              /* rows in each group, <= LDPC_GROUP               */
+    int   *group_degree;            /* degree of every row in the group                */
+    int    max_degree;
+
+    int    nedges;
+    int   *col;                     /* variable node of edge k of row r of a group, at
+                                       group_start + k*group_rows + r                  */
+    float *r_msg;                   /* check to variable messages, one per edge        */
+    float *llr;                     /* posterior LLR of each variable node             */
+    float *t;                       /* variable to check messages of one group         */
+};
+
+/* sign bit of x, as the SIMD code sees it, so -0.0 counts as negative */
+
+static unsigned ldpc_sign(float x) {
+    union { float f; unsigned u; } v;
+    v.f = x;
+    return v.u >> 31;
+}
 
-    for (i=0;i<NumberParityBits;i++) {
-        free( c_nodes[i].index );
-        free( c_nodes[i].message );
-        free( c_nodes[i].socket );
+/* Check node update of the rows of one group.  t[] holds the variable to
+   check messages, k*n + r for edge k of row r, and is overwritten with
+   the new posterior LLRs.  Each new check message has the magnitude of
+   the smallest other input, found from the two smallest magnitudes, and
+   the sign that makes the parity even. */
+
+static void ldpc_layer(float t[], float r_msg[], int degree, int n, float scale) {
+    int   r, k;
+
+#if LDPC_LANES > 1
+    if (n == LDPC_GROUP) {
+        const ldpc_vec sign_mask = LDPC_SET1(-0.0f);
+        const ldpc_vec vscale = LDPC_SET1(scale);
+
+        for(r=0; r<n; r+=LDPC_LANES) {
+            ldpc_vec min1 = LDPC_SET1(1E30f), min2 = min1, sign = LDPC_SET1(0.0f);
+            ldpc_vec a, x, m, mag;
+
+            for(k=0; k<degree; k++) {
+                x = LDPC_LOAD(&t[k*n+r]);
+                a = LDPC_ANDNOT(sign_mask, x);
+                sign = LDPC_XOR(sign, LDPC_AND(sign_mask, x));
+                min2 = LDPC_MIN(min2, LDPC_MAX(min1, a));
+                min1 = LDPC_MIN(min1, a);
+            }
+            for(k=0; k<degree; k++) {
+                x = LDPC_LOAD(&t[k*n+r]);
+                a = LDPC_ANDNOT(sign_mask, x);
+                m = LDPC_CMPEQ(a, min1);
+                mag = LDPC_MUL(LDPC_SEL(m, min2, min1), vscale);
+                mag = LDPC_XOR(mag, LDPC_XOR(sign, LDPC_AND(sign_mask, x)));
+                LDPC_STORE(&r_msg[k*n+r], mag);
+                LDPC_STORE(&t[k*n+r], LDPC_ADD(x, mag));
+            }
+        }
+        return;
     }
-	
-    /* printf( "Cleaning c-nodes \n" ); */
-    free( c_nodes );
-	
-    /* printf( "Cleaning v-node elements\n" ); */
-    for (i=0;i<CodeLength;i++) {
-        free( v_nodes[i].index);
-        free( v_nodes[i].sign );
-        free( v_nodes[i].message );
-        free( v_nodes[i].socket );
+#endif
+
+    for(r=0; r<n; r++) {
+        float    min1 = 1E30f, min2 = 1E30f, a, mag, hi;
+        unsigned sign = 0;
+
+        for(k=0; k<degree; k++) {
+            a = fabsf(t[k*n+r]);
+            sign ^= ldpc_sign(t[k*n+r]);
+            hi = (min1 > a) ? min1 : a;
+            if (hi < min2) min2 = hi;
+            if (a < min1) min1 = a;
+        }
+        for(k=0; k<degree; k++) {
+            a = fabsf(t[k*n+r]);
+            mag = ((a == min1) ? min2 : min1)*scale;
+            if (sign ^ ldpc_sign(t[k*n+r]))
+                mag = -mag;
+            r_msg[k*n+r] = mag;
+            t[k*n+r] += mag;
+        }
     }
-	
-    /* printf( "Cleaning v-nodes \n" ); */
-    free( v_nodes );
+}
+
+/* returns the number of satisfied parity checks for the hard decisions */
+
+static int ldpc_layered_checks(struct LDPC_LAYERED *l) {
+    int g, r, k, n, e, count = 0;
+    unsigned parity;
+
+    for(g=0; g<l->ngroups; g++) {
+        n = l->group_rows[g];
+        e = l->group_start[g];
+        for(r=0; r<n; r++) {
+            parity = 0;
+            for(k=0; k<l->group_degree[g]; k++)
+                parity ^= ldpc_sign(l->llr[l->col[e+k*n+r]]);
+            count += (parity == 0);
+        }
+    }
+
+    return count;
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: ldpc_layered_create
+
+  Builds the layered decoder for the code described by ldpc, using
+  ldpc->max_iter as the iteration limit.  ldpc must have been set up
+  with ldpc_open(), its scratch holds the temporary node structures.
+  Returns NULL on failure.
+
+\*---------------------------------------------------------------------------*/
+
+struct LDPC_LAYERED *ldpc_layered_create(struct LDPC *ldpc) {
+    struct LDPC_LAYERED *l;
+    struct c_node *c_nodes;
+    struct v_node *v_nodes;
+    struct LDPC_MEM mem;
+    ldpc_real *zeros;
+    int    *placed, *stamp;
+    int     N, R, shift, H1, i, j, k, g, e, r, d, n;
+
+    N = ldpc->CodeLength;
+    R = ldpc->NumberParityBits;
+
+    /* the node structures give the row lists with all the special
+       cases of the HRA codes handled */
+
+    if ((ldpc->scratch == NULL) || (ldpc->scratch_size < ldpc_scratch_size(ldpc) + LDPC_ROUND(N*sizeof(ldpc_real))))
+        return NULL;
+    mem.next = (char*)ldpc->scratch;
+    mem.end = (char*)ldpc->scratch + ldpc->scratch_size;
+
+    shift = (R + ldpc->NumberRowsHcols) - N;
+    if (ldpc->NumberRowsHcols == N) {
+        H1=0;
+        shift=0;
+    } else {
+        H1=1;
+    }
+    zeros = ldpc_calloc(&mem, N, sizeof(ldpc_real));
+    c_nodes = ldpc_calloc(&mem, R, sizeof(struct c_node));
+    v_nodes = ldpc_calloc(&mem, N, sizeof(struct v_node));
+    init_nodes(c_nodes, shift, R, ldpc->max_row_weight, ldpc->H_rows, H1, N,
+               v_nodes, ldpc->NumberRowsHcols, ldpc->H_cols, ldpc->max_col_weight,
+               1, zeros, &mem);
+
+    l = (struct LDPC_LAYERED*)calloc(1, sizeof(struct LDPC_LAYERED));
+    if (l == NULL)
+        return NULL;
+    l->CodeLength = N;
+    l->NumberParityBits = R;
+    l->max_iter = ldpc->max_iter;
+    l->scale = LDPC_LAYERED_SCALE;
+
+    l->nedges = 0;
+    l->max_degree = 0;
+    for(i=0; i<R; i++) {
+        l->nedges += c_nodes[i].degree;
+        if (c_nodes[i].degree > l->max_degree)
+            l->max_degree = c_nodes[i].degree;
+    }
+
+    l->group_start = (int*)calloc(R, sizeof(int));
+    l->group_rows = (int*)calloc(R, sizeof(int));
+    l->group_degree = (int*)calloc(R, sizeof(int));
+    l->col = (int*)calloc(l->nedges, sizeof(int));
+    l->r_msg = (float*)calloc(l->nedges, sizeof(float));
+    l->llr = (float*)calloc(N, sizeof(float));
+    l->t = (float*)calloc(l->max_degree*LDPC_GROUP, sizeof(float));
+    placed = (int*)calloc(R, sizeof(int));
+    stamp = (int*)calloc(N, sizeof(int));
+    if (!l->group_start || !l->group_rows || !l->group_degree || !l->col ||
+        !l->r_msg || !l->llr || !l->t || !placed || !stamp) {
+        free(placed);
+        free(stamp);
+        ldpc_layered_destroy(l);
+        return NULL;
+    }
+
+    /* greedy packing, each group takes the next unplaced rows of its
+       degree that don't touch the variables already in the group */
+
+    g = 0;
+    e = 0;
+    for(i=0; i<R; i++) {
+        int rows[LDPC_GROUP];
+
+        if (placed[i])
+            continue;
+        d = c_nodes[i].degree;
+        n = 0;
+        for(j=i; (j<R) && (n<LDPC_GROUP); j++) {
+            if (placed[j] || (c_nodes[j].degree != d))
+                continue;
+            for(k=0; k<d; k++)
+                if (stamp[c_nodes[j].index[k]] == g+1)
+                    break;
+            if (k < d)
+                continue;
+            for(k=0; k<d; k++)
+                stamp[c_nodes[j].index[k]] = g+1;
+            placed[j] = 1;
+            rows[n++] = j;
+        }
+        l->group_start[g] = e;
+        l->group_rows[g] = n;
+        l->group_degree[g] = d;
+        for(r=0; r<n; r++)
+            for(k=0; k<d; k++)
+                l->col[e+k*n+r] = c_nodes[rows[r]].index[k];
+        e += n*d;
+        g++;
+    }
+    l->ngroups = g;
+
+    free(placed);
+    free(stamp);
+
+    return l;
+}
+
+void ldpc_layered_destroy(struct LDPC_LAYERED *l) {
+    free(l->group_start);
+    free(l->group_rows);
+    free(l->group_degree);
+    free(l->col);
+    free(l->r_msg);
+    free(l->llr);
+    free(l->t);
+    free(l);
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: run_ldpc_decoder_layered
+
+  Decodes one codeword of input LLRs (same convention as
+  run_ldpc_decoder(), negative for a 1) into out_char[CodeLength].
+  Returns the number of iterations used.  If parity_checks is not NULL
+  it is set to the number of satisfied parity checks, NumberParityBits
+  when a valid codeword was found.
+
+\*---------------------------------------------------------------------------*/
+
+int run_ldpc_decoder_layered(struct LDPC_LAYERED *l, char out_char[], ldpc_real input[], int *parity_checks) {
+    int   iter, g, k, n, e, d, i, checks;
+    int   *col;
+    float *t = l->t;
+
+    for(i=0; i<l->CodeLength; i++)
+        l->llr[i] = input[i];
+    memset(l->r_msg, 0, l->nedges*sizeof(float));
+
+    checks = ldpc_layered_checks(l);
+    for(iter=0; (iter<l->max_iter) && (checks < l->NumberParityBits); iter++) {
+        for(g=0; g<l->ngroups; g++) {
+            n = l->group_rows[g];
+            d = l->group_degree[g];
+            e = l->group_start[g];
+            col = &l->col[e];
+
+            /* remove this layer's old messages from the posteriors */
+
+            for(k=0; k<n*d; k++)
+                t[k] = l->llr[col[k]] - l->r_msg[e+k];
+
+            ldpc_layer(t, &l->r_msg[e], d, n, l->scale);
+
+            for(k=0; k<n*d; k++)
+                l->llr[col[k]] = t[k];
+        }
+        checks = ldpc_layered_checks(l);
+    }
+
+    for(i=0; i<l->CodeLength; i++)
+        out_char[i] = ldpc_sign(l->llr[i]);
+    if (parity_checks != NULL)
+        *parity_checks = checks;
 
     return iter;
 }
 
 
-void sd_to_llr(double llr[], double sd[], int n) {
-    double sum, mean, sign, sumsq, estvar, estEsN0, x;
+void sd_to_llr(ldpc_real llr[], ldpc_real sd[], int n) {
+    ldpc_real sum, mean, sign, sumsq, estvar, estEsN0, x;
     int i;
 
     /* convert SD samples to LLRs -------------------------------*/
 
     sum = 0.0;
     for(i=0; i<n; i++)
-        sum += fabs(sd[i]);
+        sum += c2_fabs(sd[i]);
     mean = sum/n;
                 
     /* scale by mean to map onto +/- 1 symbol position */
@@ -729,3 +1151,126 @@ int extract_output(char out_char[], int DecodedBits[], int ParityCheckCount[], i
     return iter;
 }
 
+
+
+#ifdef MPDECODE_LAYERED_BENCH
+#include <assert.h>
+#include <time.h>
+#include "HRA_112_112.h"
+#include "H2064_516_sparse.h"
+
+/* repeat-accumulate encoder for the codes above, the codeword is the
+   data bits followed by the parity bits */
+
+static void bench_encode(struct LDPC *ldpc, char data[], char parity[]) {
+    int p, i, ind, par, prev = 0;
+
+    for(p=0; p<ldpc->NumberParityBits; p++) {
+        par = 0;
+        for(i=0; i<ldpc->max_row_weight; i++) {
+            ind = (int)ldpc->H_rows[p + i*ldpc->NumberParityBits];
+            if (ind > 0)
+                par += data[ind-1];
+        }
+        prev = (par + prev) & 1;
+        parity[p] = prev;
+    }
+}
+
+static float bench_gauss(void) {
+    float u1 = (rand() + 1.0)/(RAND_MAX + 2.0);
+    float u2 = (rand() + 1.0)/(RAND_MAX + 2.0);
+    return sqrtf(-2.0*logf(u1))*cosf(2.0*M_PI*u2);
+}
+
+static double bench_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1E6 + t.tv_nsec/1E3;
+}
+
+static void bench_code(const char *name, struct LDPC *ldpc, const float EbNodB[], int npoints, int frames) {
+    struct LDPC_LAYERED *layered = ldpc_layered_create(ldpc);
+    int        n = ldpc->CodeLength, k = n - ldpc->NumberParityBits;
+    char      *codeword = malloc(n), *out = malloc(n);
+    ldpc_real *llr = malloc(n*sizeof(ldpc_real));
+    double     t0, us[2];
+    long       biterr[2], frameerr[2], iters[2];
+    float      sigma;
+    int        p, f, i, d, e;
+
+    assert((layered != NULL) && (codeword != NULL) && (out != NULL) && (llr != NULL));
+    printf("\n%s, rate %d/%d, %d codewords per point\n", name, k, n, frames);
+    printf("  Eb/No   decoder      BER       FER  iters  us/codeword\n");
+    for(p=0; p<npoints; p++) {
+        sigma = sqrtf(1.0/(2.0*k/n*powf(10.0, EbNodB[p]/10.0)));
+        memset(biterr, 0, sizeof(biterr)); memset(frameerr, 0, sizeof(frameerr));
+        memset(iters, 0, sizeof(iters)); us[0] = us[1] = 0.0;
+        for(f=0; f<frames; f++) {
+            for(i=0; i<k; i++)
+                codeword[i] = rand() & 1;
+            bench_encode(ldpc, codeword, &codeword[k]);
+            for(i=0; i<n; i++)
+                llr[i] = 2.0*((codeword[i] ? -1.0 : 1.0) + sigma*bench_gauss())/(sigma*sigma);
+
+            for(d=0; d<2; d++) {
+                t0 = bench_us();
+                if (d == 0)
+                    iters[d] += run_ldpc_decoder(ldpc, out, llr);
+                else
+                    iters[d] += run_ldpc_decoder_layered(layered, out, llr, NULL);
+                us[d] += bench_us() - t0;
+                for(i=0, e=0; i<k; i++)
+                    e += out[i] != codeword[i];
+                biterr[d] += e;
+                frameerr[d] += e != 0;
+            }
+        }
+        for(d=0; d<2; d++)
+            printf("  %5.2f  %-9s %9.2e %8.4f %6.1f %10.1f\n", EbNodB[p], d ? "layered" : "existing",
+                   (double)biterr[d]/((double)frames*k), (double)frameerr[d]/frames,
+                   (double)iters[d]/frames, us[d]/frames);
+    }
+    ldpc_layered_destroy(layered);
+    free(codeword); free(out); free(llr);
+}
+
+int main(int argc, char *argv[]) {
+    const float hra_EbNodB[] = {1.0, 1.5, 2.0, 2.5, 3.0, 3.5, 4.0};
+    const float h2064_EbNodB[] = {2.0, 2.5, 3.0, 3.5, 4.0};
+    int         frames = (argc > 1) ? atoi(argv[1]) : 1000;
+    struct LDPC ldpc;
+
+    ldpc.max_iter = HRA_112_112_MAX_ITER;
+    ldpc.dec_type = HRA_112_112_DEC_TYPE;
+    ldpc.q_scale_factor = 1;
+    ldpc.r_scale_factor = 1;
+    ldpc.CodeLength = HRA_112_112_CODELENGTH;
+    ldpc.NumberParityBits = HRA_112_112_NUMBERPARITYBITS;
+    ldpc.NumberRowsHcols = HRA_112_112_NUMBERROWSHCOLS;
+    ldpc.max_row_weight = HRA_112_112_MAX_ROW_WEIGHT;
+    ldpc.max_col_weight = HRA_112_112_MAX_COL_WEIGHT;
+    ldpc.H_rows = HRA_112_112_H_rows;
+    ldpc.H_cols = HRA_112_112_H_cols;
+    if (ldpc_open(&ldpc) != 0)
+        return 1;
+    bench_code("HRA_112_112", &ldpc, hra_EbNodB, sizeof(hra_EbNodB)/sizeof(float), frames);
+
+    ldpc.max_iter = MAX_ITER;
+    ldpc.dec_type = DEC_TYPE;
+    ldpc.CodeLength = CODELENGTH;
+    ldpc.NumberParityBits = NUMBERPARITYBITS;
+    ldpc.NumberRowsHcols = NUMBERROWSHCOLS;
+    ldpc.max_row_weight = MAX_ROW_WEIGHT;
+    ldpc.max_col_weight = MAX_COL_WEIGHT;
+    ldpc.H_rows = H_rows;
+    ldpc.H_cols = H_cols;
+    ldpc_close(&ldpc);
+    if (ldpc_open(&ldpc) != 0)
+        return 1;
+    bench_code("H2064_516", &ldpc, h2064_EbNodB, sizeof(h2064_EbNodB)/sizeof(float), frames/10);
+    ldpc_close(&ldpc);
+
+    return 0;
+}
+#endif
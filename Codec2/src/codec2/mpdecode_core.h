@@ -11,6 +11,17 @@
 #ifndef __MPDECODE_CORE__
 #define __MPDECODE_CORE__
 
+#include <stddef.h>
+
+/* soft decisions and LLRs, float in the -DCODEC2_FLOAT32 profile.  The
+   H_rows/H_cols tables are indexes and stay as generated */
+
+#ifdef CODEC2_FLOAT32
+typedef float ldpc_real;
+#else
+typedef double ldpc_real;
+#endif
+
 struct LDPC {
     int max_iter;
     int dec_type;
@@ -23,11 +34,29 @@ struct LDPC {
     int max_col_weight;
     double *H_rows;
     double *H_cols;
+
+    /* decoder scratch, allocated by ldpc_open() and reused for every
+       codeword */
+
+    void  *scratch;
+    size_t scratch_size;
 };
 
-int run_ldpc_decoder(struct LDPC *ldpc, char out_char[], double input[]);
+int ldpc_open(struct LDPC *ldpc);
+void ldpc_close(struct LDPC *ldpc);
+int run_ldpc_decoder(struct LDPC *ldpc, char out_char[], ldpc_real input[]);
+size_t ldpc_scratch_size(struct LDPC *ldpc);
+int run_ldpc_decoder_scratch(struct LDPC *ldpc, char out_char[], ldpc_real input[], void *scratch, size_t size);
+
+/* layered normalised min-sum decoder with early termination */
+
+struct LDPC_LAYERED;
+
+struct LDPC_LAYERED *ldpc_layered_create(struct LDPC *ldpc);
+void ldpc_layered_destroy(struct LDPC_LAYERED *l);
+int run_ldpc_decoder_layered(struct LDPC_LAYERED *l, char out_char[], ldpc_real input[], int *parity_checks);
 
-void sd_to_llr(double llr[], double sd[], int n);
+void sd_to_llr(ldpc_real llr[], ldpc_real sd[], int n);
 
 struct v_node {
   int degree;
@@ -57,7 +86,7 @@ void init_c_v_nodes(struct c_node *c_nodes,
                     double *H_cols,
                     int     max_col_weight,
                     int     dec_type,
-                    double *input);
+                    ldpc_real *input);
 
 void ApproximateMinStar(	 int	  BitErrors[],
 				 int      DecodedBits[],
@@ -0,0 +1,476 @@
+/*---------------------------------------------------------------------------*\
+
+  FILE........: nco.c
+  DATE CREATED: Oct 2026
+
+  Numerically controlled oscillator and mixers shared by the fdmdv,
+  cohpsk, fsk and fm modems, plus a fast atan2() for FM discrimination.
+  Every block function takes the oscillator's state and advances it by
+  n samples, so blocks can be any length and still phase continuous.
+
+  To regenerate the sine table:
+
+     src$ gcc codec2/nco.c -Icodec2 -o nco -O2 -DNCO_MAKETABLES -lm && ./nco
+
+  To test against libm:
+
+     src$ gcc codec2/nco.c -Icodec2 -o nco -O2 -DNCO_UNITTEST -lm && ./nco
+
+\*---------------------------------------------------------------------------*/
+
+/*
+  All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 2.1, as
+  published by the Free Software Foundation.  This program is
+  distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+  License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <math.h>
+
+#include "nco.h"
+
+#ifndef NCO_MAKETABLES
+#include "nco_table.h"
+#endif
+
+#define NCO_2PI       6.283185307179586
+#define NCO_PI_F      3.14159265f
+#define NCO_PI_2_F    1.57079633f
+
+/* phase units per radian, and the largest per sample deviation nco_fm()
+   will add, just under 2^31 */
+
+#define NCO_UNITS     (4294967296.0/NCO_2PI)
+#define NCO_MAX_DEV   2147483000.0f
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: nco_angle
+  DATE CREATED: Oct 2026
+
+  Converts w radians to phase units, modulo 2*pi.  Done in double so
+  that frequency steps are exact to 2^-32 of the sample rate, call it
+  when the frequency changes, not per sample.
+
+\*---------------------------------------------------------------------------*/
+
+uint32_t nco_angle(float w) {
+    return (uint32_t)(int64_t)floor((double)w*NCO_UNITS + 0.5);
+}
+
+/* phase in radians, -pi to pi */
+
+float nco_radians(uint32_t phase) {
+    return (float)((int32_t)phase*(NCO_2PI/4294967296.0));
+}
+
+void nco_init(struct NCO *nco, float w, float phi) {
+    nco->phase = nco_angle(phi);
+    nco->step = nco_angle(w);
+}
+
+void nco_set_freq(struct NCO *nco, float w) {
+    nco->step = nco_angle(w);
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: nco_block
+  DATE CREATED: Oct 2026
+
+  The block functions don't look up every sample.  The phase is looked
+  up at the start of each NCO_BLOCK samples and multiplied by
+  e^(j*k*step), k=1..NCO_BLOCK, looked up once per call.  These are
+  independent multiplies so vectorise, unlike a phasor recursion, and
+  as each block restarts from the accumulator there is no drift, the
+  error stays under 1E-6.
+
+\*---------------------------------------------------------------------------*/
+
+#define NCO_BLOCK 16
+
+/* e^(j*k*step) for k=1..NCO_BLOCK */
+
+static void nco_powers(uint32_t step, float pw_re[], float pw_im[]) {
+    COMP p;
+    int  k;
+
+    for(k=0; k<NCO_BLOCK; k++) {
+        p = nco_phasor(step*(uint32_t)(k+1));
+        pw_re[k] = p.real;
+        pw_im[k] = p.imag;
+    }
+}
+
+/* NCO_BLOCK samples of oscillator after phase */
+
+static inline void nco_block(uint32_t phase, float pw_re[], float pw_im[], float re[], float im[]) {
+    COMP a = nco_phasor(phase);
+    int  k;
+
+    for(k=0; k<NCO_BLOCK; k++) {
+        re[k] = a.real*pw_re[k] - a.imag*pw_im[k];
+        im[k] = a.real*pw_im[k] + a.imag*pw_re[k];
+    }
+}
+
+/* Runs body for k=0..m-1 with sample i+k of the oscillator in re[k],
+   im[k].  Short calls, where looking up the powers would cost more
+   than it saves, look each sample up directly. */
+
+#define NCO_BLOCKS(nco, n, body)                                        \
+    do {                                                                \
+        float pw_re[NCO_BLOCK], pw_im[NCO_BLOCK];                       \
+        float re[NCO_BLOCK], im[NCO_BLOCK];                             \
+        COMP  p;                                                        \
+        int   i = 0, k, m;                                              \
+        if ((n) >= 2*NCO_BLOCK) {                                       \
+            nco_powers((nco)->step, pw_re, pw_im);                      \
+            for(; i+NCO_BLOCK<=(n); i+=NCO_BLOCK) {                     \
+                nco_block((nco)->phase, pw_re, pw_im, re, im);          \
+                for(k=0; k<NCO_BLOCK; k++) { body; }                    \
+                (nco)->phase += (nco)->step*NCO_BLOCK;                  \
+            }                                                           \
+        }                                                               \
+        for(m=(n)-i, k=0; k<m; k++) {                                   \
+            (nco)->phase += (nco)->step;                                \
+            p = nco_phasor((nco)->phase);                               \
+            re[k] = p.real; im[k] = p.imag;                             \
+        }                                                               \
+        for(k=0; k<m; k++) { body; }                                    \
+    } while(0)
+
+/* out = e^(j*phase) */
+
+void nco_gen(struct NCO *nco, COMP out[], int n) {
+    NCO_BLOCKS(nco, n, out[i+k].real = re[k]; out[i+k].imag = im[k]);
+}
+
+/* out = cos(phase) */
+
+void nco_gen_real(struct NCO *nco, float out[], int n) {
+    NCO_BLOCKS(nco, n, out[i+k] = re[k]);
+}
+
+/* out = in*e^(j*phase), out may be in */
+
+void nco_mix(struct NCO *nco, COMP out[], COMP in[], int n) {
+    COMP x;
+
+    NCO_BLOCKS(nco, n,
+               x = in[i+k];
+               out[i+k].real = x.real*re[k] - x.imag*im[k];
+               out[i+k].imag = x.real*im[k] + x.imag*re[k]);
+}
+
+/* out = in*e^(-j*phase), a down converter, out may be in */
+
+void nco_mix_conj(struct NCO *nco, COMP out[], COMP in[], int n) {
+    COMP x;
+
+    NCO_BLOCKS(nco, n,
+               x = in[i+k];
+               out[i+k].real = x.real*re[k] + x.imag*im[k];
+               out[i+k].imag = x.imag*re[k] - x.real*im[k]);
+}
+
+/* out += in*e^(j*phase), for summing up converted carriers */
+
+void nco_mix_acc(struct NCO *nco, COMP out[], COMP in[], int n) {
+    COMP x;
+
+    NCO_BLOCKS(nco, n,
+               x = in[i+k];
+               out[i+k].real += x.real*re[k] - x.imag*im[k];
+               out[i+k].imag += x.real*im[k] + x.imag*re[k]);
+}
+
+/* out = in*e^(j*phase) for real in */
+
+void nco_mix_real(struct NCO *nco, COMP out[], float in[], int n) {
+    NCO_BLOCKS(nco, n,
+               out[i+k].real = in[i+k]*re[k];
+               out[i+k].imag = in[i+k]*im[k]);
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: nco_fm
+  DATE CREATED: Oct 2026
+
+  Frequency modulator, the phase advances by step + wd*x[i] radians
+  each sample and out = e^(j*phase).  nco_fm_real() gives just the
+  real part.
+
+\*---------------------------------------------------------------------------*/
+
+static inline uint32_t nco_dev(float wdu, float x) {
+    float d = wdu*x;
+
+    if (d > NCO_MAX_DEV)  d = NCO_MAX_DEV;
+    if (d < -NCO_MAX_DEV) d = -NCO_MAX_DEV;
+    return (uint32_t)(int32_t)d;
+}
+
+void nco_fm(struct NCO *nco, COMP out[], float x[], float wd, int n) {
+    uint32_t phase = nco->phase, step = nco->step;
+    float    wdu = wd*(float)NCO_UNITS;
+    int      i;
+
+    for(i=0; i<n; i++) {
+        phase += step + nco_dev(wdu, x[i]);
+        out[i] = nco_phasor(phase);
+    }
+    nco->phase = phase;
+}
+
+void nco_fm_real(struct NCO *nco, float out[], float x[], float wd, int n) {
+    uint32_t phase = nco->phase, step = nco->step;
+    float    wdu = wd*(float)NCO_UNITS;
+    int      i;
+
+    for(i=0; i<n; i++) {
+        phase += step + nco_dev(wdu, x[i]);
+        out[i] = nco_cos(phase);
+    }
+    nco->phase = phase;
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: nco_atan2
+  DATE CREATED: Oct 2026
+
+  atan2(y,x) from the odd polynomial of Abramowitz and Stegun 4.4.49 on
+  min(|x|,|y|)/max(|x|,|y|), then folded out to the right octant.
+  Error is under 1E-6 radians.  atan2(0,0) is 0.
+
+  nco_atan2_block() does n at once with SSE2 or NEON, to the same
+  precision, out[i] = atan2(in[i].imag, in[i].real).
+
+\*---------------------------------------------------------------------------*/
+
+#define NCO_A2   -0.3333314528f
+#define NCO_A4    0.1999355085f
+#define NCO_A6   -0.1420889944f
+#define NCO_A8    0.1065626393f
+#define NCO_A10  -0.0752896400f
+#define NCO_A12   0.0429096138f
+#define NCO_A14  -0.0161657367f
+#define NCO_A16   0.0028662257f
+
+float nco_atan2(float y, float x) {
+    float ax = fabsf(x), ay = fabsf(y);
+    float mx = ax > ay ? ax : ay;
+    float mn = ax > ay ? ay : ax;
+    float a, s, r;
+
+    if (mx == 0.0f)
+        return 0.0f;
+    a = mn/mx;
+    s = a*a;
+    r = a*(1.0f + s*(NCO_A2 + s*(NCO_A4 + s*(NCO_A6 + s*(NCO_A8 + s*(NCO_A10 + s*(NCO_A12 + s*(NCO_A14 + s*NCO_A16))))))));
+    if (ay > ax) r = NCO_PI_2_F - r;
+    if (x < 0.0f) r = NCO_PI_F - r;
+    return y < 0.0f ? -r : r;
+}
+
+#if !defined(NCO_SCALAR) && defined(__SSE2__)
+#include <emmintrin.h>
+#define NCO_LANES 4
+typedef __m128 nco_vec;
+#define NCO_SET1(x)      _mm_set1_ps(x)
+#define NCO_ADD(a,b)     _mm_add_ps(a,b)
+#define NCO_SUB(a,b)     _mm_sub_ps(a,b)
+#define NCO_MUL(a,b)     _mm_mul_ps(a,b)
+#define NCO_DIV(a,b)     _mm_div_ps(a,b)
+#define NCO_MIN(a,b)     _mm_min_ps(a,b)
+#define NCO_MAX(a,b)     _mm_max_ps(a,b)
+#define NCO_ABS(a)       _mm_andnot_ps(_mm_set1_ps(-0.0f), a)
+#define NCO_SIGN(a)      _mm_and_ps(_mm_set1_ps(-0.0f), a)
+#define NCO_XOR(a,b)     _mm_xor_ps(a,b)
+#define NCO_GT(a,b)      _mm_cmpgt_ps(a,b)
+#define NCO_SEL(m,a,b)   _mm_or_ps(_mm_and_ps(m,a), _mm_andnot_ps(m,b))
+#define NCO_NZ(m,a)      _mm_and_ps(m,a)
+#elif !defined(NCO_SCALAR) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NCO_LANES 4
+typedef float32x4_t nco_vec;
+#define NCO_U(a)         vreinterpretq_u32_f32(a)
+#define NCO_F(a)         vreinterpretq_f32_u32(a)
+#define NCO_SET1(x)      vdupq_n_f32(x)
+#define NCO_ADD(a,b)     vaddq_f32(a,b)
+#define NCO_SUB(a,b)     vsubq_f32(a,b)
+#define NCO_MUL(a,b)     vmulq_f32(a,b)
+#define NCO_MIN(a,b)     vminq_f32(a,b)
+#define NCO_MAX(a,b)     vmaxq_f32(a,b)
+#define NCO_ABS(a)       vabsq_f32(a)
+#define NCO_SIGN(a)      NCO_F(vandq_u32(NCO_U(a), vdupq_n_u32(0x80000000)))
+#define NCO_XOR(a,b)     NCO_F(veorq_u32(NCO_U(a), NCO_U(b)))
+#define NCO_GT(a,b)      NCO_F(vcgtq_f32(a,b))
+#define NCO_SEL(m,a,b)   vbslq_f32(NCO_U(m), a, b)
+#define NCO_NZ(m,a)      NCO_F(vandq_u32(NCO_U(m), NCO_U(a)))
+#ifdef __aarch64__
+#define NCO_DIV(a,b)     vdivq_f32(a,b)
+#else
+static inline float32x4_t NCO_DIV(float32x4_t a, float32x4_t b) {
+    float32x4_t r = vrecpeq_f32(b);
+    r = vmulq_f32(r, vrecpsq_f32(b, r));
+    r = vmulq_f32(r, vrecpsq_f32(b, r));
+    return vmulq_f32(a, r);
+}
+#endif
+#else
+#define NCO_LANES 1
+#endif
+
+void nco_atan2_block(float out[], COMP in[], int n) {
+    int i = 0;
+
+#if NCO_LANES > 1
+    for(; i+NCO_LANES<=n; i+=NCO_LANES) {
+        float   xs[NCO_LANES], ys[NCO_LANES];
+        nco_vec x, y, ax, ay, mx, mn, a, s, r, swap;
+        int     l;
+
+        for(l=0; l<NCO_LANES; l++) {
+            xs[l] = in[i+l].real;
+            ys[l] = in[i+l].imag;
+        }
+#ifdef __SSE2__
+        x = _mm_loadu_ps(xs); y = _mm_loadu_ps(ys);
+#else
+        x = vld1q_f32(xs); y = vld1q_f32(ys);
+#endif
+        ax = NCO_ABS(x); ay = NCO_ABS(y);
+        mx = NCO_MAX(ax, ay);
+        mn = NCO_MIN(ax, ay);
+
+        /* 0/0 lanes give 0, as the scalar version */
+
+        a = NCO_NZ(NCO_GT(mx, NCO_SET1(0.0f)), NCO_DIV(mn, NCO_MAX(mx, NCO_SET1(1E-30f))));
+        s = NCO_MUL(a, a);
+        r = NCO_ADD(NCO_SET1(NCO_A14), NCO_MUL(s, NCO_SET1(NCO_A16)));
+        r = NCO_ADD(NCO_SET1(NCO_A12), NCO_MUL(s, r));
+        r = NCO_ADD(NCO_SET1(NCO_A10), NCO_MUL(s, r));
+        r = NCO_ADD(NCO_SET1(NCO_A8),  NCO_MUL(s, r));
+        r = NCO_ADD(NCO_SET1(NCO_A6),  NCO_MUL(s, r));
+        r = NCO_ADD(NCO_SET1(NCO_A4),  NCO_MUL(s, r));
+        r = NCO_ADD(NCO_SET1(NCO_A2),  NCO_MUL(s, r));
+        r = NCO_ADD(NCO_SET1(1.0f),    NCO_MUL(s, r));
+        r = NCO_MUL(a, r);
+
+        swap = NCO_GT(ay, ax);
+        r = NCO_SEL(swap, NCO_SUB(NCO_SET1(NCO_PI_2_F), r), r);
+        swap = NCO_GT(NCO_SET1(0.0f), x);
+        r = NCO_SEL(swap, NCO_SUB(NCO_SET1(NCO_PI_F), r), r);
+        r = NCO_XOR(r, NCO_SIGN(y));
+
+#ifdef __SSE2__
+        _mm_storeu_ps(&out[i], r);
+#else
+        vst1q_f32(&out[i], r);
+#endif
+    }
+#endif
+
+    for(; i<n; i++)
+        out[i] = nco_atan2(in[i].imag, in[i].real);
+}
+
+/**
+ * Table generation and testing code below
+ */
+
+#ifdef NCO_MAKETABLES
+#include <stdio.h>
+
+const float nco_sintab[NCO_LUT_SIZE+2];
+
+int main() {
+    FILE *f = fopen("nco_table.h", "w");
+    int   i;
+
+    assert(f != NULL);
+    fprintf(f, "/* Generated by nco.c -DNCO_MAKETABLES */\n\n"
+               "/* sin() at NCO_LUT_SIZE+1 steps over 0 to pi/2, one more past pi/2 for interpolation */\n\n"
+               "const float nco_sintab[NCO_LUT_SIZE+2]={\n");
+    for (i = 0; i < NCO_LUT_SIZE+2; i++)
+        fprintf(f, i < NCO_LUT_SIZE+1 ? "  %.9ef,\n" : "  %.9ef\n", sin(i*NCO_2PI/4.0/NCO_LUT_SIZE));
+    fprintf(f, "};\n");
+    fclose(f);
+
+    return 0;
+}
+
+#elif defined(NCO_UNITTEST)
+#include <stdio.h>
+#include <stdlib.h>
+
+int main() {
+    struct NCO nco;
+    COMP       osc[1000], in[1000];
+    float      a[1000];
+    double     e, err = 0.0, aerr = 0.0, want;
+    int        i, k;
+
+    /* table lookups over the whole circle */
+
+    for(k=0; k<(1<<20); k++) {
+        uint32_t phase = (uint32_t)k*4096 + 1234;
+        COMP     c = nco_phasor(phase);
+        double   w = phase*NCO_2PI/4294967296.0;
+
+        e = fabs(c.real - cos(w)) + fabs(c.imag - sin(w)) + fabs(nco_sin(phase) - sin(w));
+        if (e > err) err = e;
+    }
+    printf("phasor max error %g\n", err);
+
+    /* oscillator stays on phase, to its frequency resolution of 2^-32 */
+
+    err = 0.0;
+    nco_init(&nco, 0.123456, 1.0);
+    for(k=0; k<1000; k++) {
+        nco_gen(&nco, osc, 1000);
+        for(i=0; i<1000; i++) {
+            want = 1.0 + (double)(k*1000 + i + 1)*nco.step*(NCO_2PI/4294967296.0);
+            e = fabs(osc[i].real - cos(want)) + fabs(osc[i].imag - sin(want));
+            if (e > err) err = e;
+        }
+    }
+    printf("1E6 samples, oscillator max error %g\n", err);
+
+    for(i=0; i<1000; i++) {
+        in[i].real = (rand() - RAND_MAX/2)/(float)RAND_MAX;
+        in[i].imag = (rand() - RAND_MAX/2)/(float)RAND_MAX;
+    }
+    in[0].real = 0.0; in[0].imag = 0.0;
+    in[1].real = -1.0; in[1].imag = 0.0;
+    in[2].real = 0.0; in[2].imag = -1.0;
+    nco_atan2_block(a, in, 1000);
+    for(i=0; i<1000; i++) {
+        want = (i == 0) ? 0.0 : atan2(in[i].imag, in[i].real);
+        e = fabs(a[i] - want);
+        if (e > aerr) aerr = e;
+        e = fabs(nco_atan2(in[i].imag, in[i].real) - want);
+        if (e > aerr) aerr = e;
+    }
+    printf("atan2 max error %g\n", aerr);
+
+    if ((err > 1E-6) || (aerr > 1E-6)) {
+        printf("Bad!\n");
+        exit(1);
+    }
+    printf("Everything checks out\n");
+    return 0;
+}
+#endif
@@ -0,0 +1,104 @@
+/*---------------------------------------------------------------------------*\
+
+  FILE........: nco.h
+  DATE CREATED: Oct 2026
+
+  Numerically controlled oscillator shared by the modems.  The phase
+  is a 32 bit accumulator, 2^32 is 2*pi, so it wraps exactly and never
+  needs normalising.  Sine and cosine come from a quarter wave table
+  with linear interpolation, error under 3E-7.
+
+\*---------------------------------------------------------------------------*/
+
+/*
+  All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 2.1, as
+  published by the Free Software Foundation.  This program is
+  distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+  License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __NCO__
+#define __NCO__
+
+#include <stdint.h>
+#include "comp.h"
+
+#define NCO_LUT_BITS    10                    /* table steps per quarter wave, log2 */
+#define NCO_LUT_SIZE    (1<<NCO_LUT_BITS)
+#define NCO_FRAC_BITS   (30-NCO_LUT_BITS)     /* phase bits interpolated between steps */
+
+/* Each sample the phase is advanced by step, then used, as the phasor
+   oscillators (phase = phase*freq then mix) this replaces. */
+
+struct NCO {
+    uint32_t phase;
+    uint32_t step;
+};
+
+extern const float nco_sintab[NCO_LUT_SIZE+2];
+
+uint32_t nco_angle(float w);
+float    nco_radians(uint32_t phase);
+void     nco_init(struct NCO *nco, float w, float phi);
+void     nco_set_freq(struct NCO *nco, float w);
+
+void     nco_gen(struct NCO *nco, COMP out[], int n);
+void     nco_gen_real(struct NCO *nco, float out[], int n);
+void     nco_mix(struct NCO *nco, COMP out[], COMP in[], int n);
+void     nco_mix_conj(struct NCO *nco, COMP out[], COMP in[], int n);
+void     nco_mix_acc(struct NCO *nco, COMP out[], COMP in[], int n);
+void     nco_mix_real(struct NCO *nco, COMP out[], float in[], int n);
+void     nco_fm(struct NCO *nco, COMP out[], float x[], float wd, int n);
+void     nco_fm_real(struct NCO *nco, float out[], float x[], float wd, int n);
+
+float    nco_atan2(float y, float x);
+void     nco_atan2_block(float out[], COMP in[], int n);
+
+/* sin of phase p in the first quadrant, 0 <= p <= 2^30 */
+
+static inline float nco_quarter(uint32_t p) {
+    int   i = p >> NCO_FRAC_BITS;
+    float f = (float)(int32_t)(p & ((1<<NCO_FRAC_BITS)-1))*(1.0f/(1<<NCO_FRAC_BITS));
+
+    return nco_sintab[i] + f*(nco_sintab[i+1] - nco_sintab[i]);
+}
+
+static inline float nco_sin(uint32_t phase) {
+    uint32_t p = phase & 0x3fffffff;
+    float    s = nco_quarter((phase & 0x40000000) ? 0x40000000 - p : p);
+
+    return (phase & 0x80000000) ? -s : s;
+}
+
+static inline float nco_cos(uint32_t phase) {
+    return nco_sin(phase + 0x40000000);
+}
+
+/* cos(phase) + j*sin(phase) */
+
+static inline COMP nco_phasor(uint32_t phase) {
+    uint32_t p = phase & 0x3fffffff;
+    float    a = nco_quarter(p);
+    float    b = nco_quarter(0x40000000 - p);
+    COMP     r;
+
+    if (phase & 0x40000000) {
+        r.real = -a; r.imag = b;
+    } else {
+        r.real = b;  r.imag = a;
+    }
+    if (phase & 0x80000000) {
+        r.real = -r.real; r.imag = -r.imag;
+    }
+    return r;
+}
+
+#endif
@@ -25,6 +25,7 @@
   along with this program; if not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "codec2_math.h"
 #include "defines.h"
 #include "nlp.h"
 #include "dump.h"
@@ -32,6 +33,7 @@
 #undef PROFILE
 #include "machdep.h"
 #include "os.h"
+#include "codec2_arena.h"
 
 #include <assert.h>
 #include <math.h>
@@ -156,7 +158,7 @@ void *nlp_create(C2CONST *c2const)
     int  m = c2const->m_pitch;
     int  Fs = c2const->Fs;
 
-    nlp = (NLP*)malloc(sizeof(NLP));
+    nlp = (NLP*)codec2_malloc(sizeof(NLP));
     if (nlp == NULL)
 	return NULL;
 
@@ -168,12 +170,12 @@ void *nlp_create(C2CONST *c2const)
     /* if running at 16kHz allocate storage for decimating filter memory */
 
     if (Fs == 16000) {
-        nlp->Sn16k = (float*)malloc(sizeof(float)*(FDMDV_OS_TAPS_16K + c2const->n_samp));
+        nlp->Sn16k = (float*)codec2_malloc(sizeof(float)*(FDMDV_OS_TAPS_16K + c2const->n_samp));
         for(i=0; i<FDMDV_OS_TAPS_16K; i++) {
            nlp->Sn16k[i] = 0.0;
         }
         if (nlp->Sn16k == NULL) {
-            free(nlp);
+            codec2_free(nlp);
             return NULL;
         }
 
@@ -217,9 +219,9 @@ void nlp_destroy(void *nlp_state)
 
     codec2_fft_free(nlp->fft_cfg);
     if (nlp->Fs == 16000) {
-        free(nlp->Sn16k);
+        codec2_free(nlp->Sn16k);
     }
-    free(nlp_state);
+    codec2_free(nlp_state);
 }
 
 /*---------------------------------------------------------------------------*\
@@ -373,8 +375,8 @@ float nlp(
 
     /* todo: express everything in f0, as pitch in samples is dep on Fs */
 
-    int pmin = floor(SAMPLE_RATE*P_MIN_S);
-    int pmax = floor(SAMPLE_RATE*P_MAX_S);
+    int pmin = c2_floor(SAMPLE_RATE*P_MIN_S);
+    int pmax = c2_floor(SAMPLE_RATE*P_MAX_S);
 
     /* find global peak */
 
@@ -6,6 +6,14 @@
 
   A Library of functions that implement a BPSK/QPSK OFDM modem
 
+  To check the FFT timing acquisition against the direct correlation,
+  and time coarse_sync() and ofdm_acquire() per call:
+
+     src$ gcc -O2 -DOFDM_ACQUIRE_BENCH -Icodec2 codec2/ofdm.c codec2/codec2_fft.c \
+              codec2/kiss_fft.c codec2/kiss_fftr.c codec2/codec2_arena.c -o ofdm_acq -lm && ./ofdm_acq
+
+  Add -DUSE_SIMD_FFT codec2/simd_fft.c to time it with the SIMD FFT.
+
 \*---------------------------------------------------------------------------*/
 
 /*
@@ -34,9 +42,12 @@
 #include <assert.h>
 #include <complex.h>
 
+#include "codec2_math.h"
 #include "comp.h"
+#include "comp_prim.h"
 #include "ofdm_internal.h"
 #include "codec2_ofdm.h"
+#include "codec2_arena.h"
 
 /* Static Prototypes */
 
@@ -47,6 +58,7 @@ static complex float qpsk_mod(int *);
 static void qpsk_demod(complex float, int *);
 static void ofdm_txframe(struct OFDM *, complex float [OFDM_SAMPLESPERFRAME], complex float *);
 static int coarse_sync(struct OFDM *, complex float *, int);
+static int acquire(struct OFDM *, complex float *, int, int, int *);
 
 /* Defines */
 
@@ -138,38 +150,143 @@ static complex float vector_sum(complex float *a, int num_elements) {
  * Correlates the OFDM pilot symbol samples with a window of received
  * samples to determine the most likely timing offset.  Combines two
  * frames pilots so we need at least Nsamperframe+M+Ncp samples in rx.
+ * Long windows go to the FFT correlator.
  */
 
 static int coarse_sync(struct OFDM *ofdm, complex float *rx, int length) {
-    complex float csam;
     int Ncorr = length - (OFDM_SAMPLESPERFRAME + (OFDM_M + OFDM_NCP));
-    float corr[Ncorr];
     int i, j;
 
+    if (Ncorr >= OFDM_ACQ_MIN_NCORR) {
+        return acquire(ofdm, rx, length, 0, NULL);
+    }
+
+    /* find the max magnitude and its index */
+
+    float mag = 0.0f;
+    int t_est = 0;
+
     for (i = 0; i < Ncorr; i++) {
         complex float temp = 0.0f + 0.0f * I;
 
         for (j = 0; j < (OFDM_M + OFDM_NCP); j++) {
-            csam = conjf(ofdm->pilot_samples[j]);
-            temp = temp + (rx[i + j] * csam);
-            temp = temp + (rx[i + j + OFDM_SAMPLESPERFRAME] * csam);
+            temp = temp + (rx[i + j] * ofdm->pilot_conj[j]);
+            temp = temp + (rx[i + j + OFDM_SAMPLESPERFRAME] * ofdm->pilot_conj[j]);
         }
 
-        corr[i] = cabsf(temp);
+        if (cabsf(temp) > mag) {
+            mag = cabsf(temp);
+            t_est = i;
+        }
     }
 
-    /* find the max magnitude and its index */
+    return t_est;
+}
 
-    float mag = 0.0f;
+/*
+ * FFT of OFDM_ACQ_NFFT samples of rx from st, zero past length.
+ */
+
+static void acquire_block(struct OFDM *ofdm, COMP *spectrum, complex float *rx, int st, int length) {
+    int n;
+
+    for (n = 0; n < OFDM_ACQ_NFFT; n++) {
+        if ((st + n) < length) {
+            ofdm->acq_in[n].real = crealf(rx[st + n]);
+            ofdm->acq_in[n].imag = cimagf(rx[st + n]);
+        } else {
+            ofdm->acq_in[n].real = ofdm->acq_in[n].imag = 0.0f;
+        }
+    }
+
+    codec2_fft(ofdm->acq_fwd_cfg, ofdm->acq_in, spectrum);
+}
+
+/*
+ * Same search as coarse_sync(), by overlap-save FFT correlation against
+ * the pilot's conjugated spectrum, jointly over 2 * nhyp + 1 frequency
+ * offsets FS / OFDM_ACQ_NFFT apart.  A hypothesis is a rotation of the
+ * received spectrum, so each block costs two forward FFTs and one or
+ * two inverse FFTs per hypothesis.
+ *
+ * With nhyp == 0 the caller has removed the frequency offset and the two
+ * frames' pilots are summed coherently, as in coarse_sync().  Otherwise
+ * they are summed in power, as the offset left within a hypothesis would
+ * turn one pilot against the other over a frame.
+ *
+ * Returns the timing offset, and the hypothesis in *hyp if not NULL.
+ */
+
+static int acquire(struct OFDM *ofdm, complex float *rx, int length, int nhyp, int *hyp) {
+    const int Nvalid = OFDM_ACQ_NFFT - (OFDM_M + OFDM_NCP) + 1;
+    int Ncorr = length - (OFDM_SAMPLESPERFRAME + (OFDM_M + OFDM_NCP));
+    COMP *a = ofdm->acq_a;
+    COMP *b = ofdm->acq_b;
+    COMP *out = ofdm->acq_out;
+    float mag, max_mag = -1.0f;
+    int st, i, k, m, mk, n;
     int t_est = 0;
+    int k_est = 0;
 
-    for (i = 0; i < Ncorr; i++) {
-        if (corr[i] > mag) {
-            mag = corr[i];
-            t_est = i;
+    for (st = 0; st < Ncorr; st += Nvalid) {
+        n = min(Nvalid, Ncorr - st);
+
+        acquire_block(ofdm, a, rx, st, length);
+        acquire_block(ofdm, b, rx, st + OFDM_SAMPLESPERFRAME, length);
+
+        for (k = -nhyp; k <= nhyp; k++) {
+            if (nhyp == 0) {
+                for (m = 0; m < OFDM_ACQ_NFFT; m++) {
+                    ofdm->acq_in[m] = cmult(cadd(a[m], b[m]), ofdm->acq_pilot[m]);
+                }
+
+                codec2_fft(ofdm->acq_inv_cfg, ofdm->acq_in, out);
+
+                for (i = 0; i < n; i++) {
+                    ofdm->acq_mag[i] = out[i].real * out[i].real + out[i].imag * out[i].imag;
+                }
+            } else {
+                /* bin m + k of the received spectrum is bin m after removing k bins of offset */
+
+                for (m = 0; m < OFDM_ACQ_NFFT; m++) {
+                    mk = (m + k) & (OFDM_ACQ_NFFT - 1);
+                    ofdm->acq_in[m] = cmult(a[mk], ofdm->acq_pilot[m]);
+                }
+
+                codec2_fft(ofdm->acq_inv_cfg, ofdm->acq_in, out);
+
+                for (i = 0; i < n; i++) {
+                    ofdm->acq_mag[i] = out[i].real * out[i].real + out[i].imag * out[i].imag;
+                }
+
+                for (m = 0; m < OFDM_ACQ_NFFT; m++) {
+                    mk = (m + k) & (OFDM_ACQ_NFFT - 1);
+                    ofdm->acq_in[m] = cmult(b[mk], ofdm->acq_pilot[m]);
+                }
+
+                codec2_fft(ofdm->acq_inv_cfg, ofdm->acq_in, out);
+
+                for (i = 0; i < n; i++) {
+                    ofdm->acq_mag[i] += out[i].real * out[i].real + out[i].imag * out[i].imag;
+                }
+            }
+
+            for (i = 0; i < n; i++) {
+                mag = ofdm->acq_mag[i];
+
+                if (mag > max_mag) {
+                    max_mag = mag;
+                    t_est = st + i;
+                    k_est = k;
+                }
+            }
         }
     }
 
+    if (hyp != NULL) {
+        *hyp = k_est;
+    }
+
     return t_est;
 }
 
@@ -250,7 +367,7 @@ struct OFDM *ofdm_create() {
     struct OFDM *ofdm;
     int i, j;
 
-    if ((ofdm = (struct OFDM *) malloc(sizeof (struct OFDM))) == NULL) {
+    if ((ofdm = (struct OFDM *) codec2_malloc(sizeof (struct OFDM))) == NULL) {
         return NULL;
     }
 
@@ -320,11 +437,71 @@ struct OFDM *ofdm_create() {
         ofdm->pilot_samples[i] = temp[j];
     }
 
+    for (i = 0; i < (OFDM_M + OFDM_NCP); i++) {
+        ofdm->pilot_conj[i] = conjf(ofdm->pilot_samples[i]);
+    }
+
+    /* conjugated pilot spectrum for the FFT correlator */
+
+    ofdm->acq_fwd_cfg = codec2_fft_alloc(OFDM_ACQ_NFFT, 0, NULL, NULL);
+    ofdm->acq_inv_cfg = codec2_fft_alloc(OFDM_ACQ_NFFT, 1, NULL, NULL);
+
+    if ((ofdm->acq_fwd_cfg == NULL) || (ofdm->acq_inv_cfg == NULL)) {
+        return NULL;
+    }
+
+    acquire_block(ofdm, ofdm->acq_pilot, ofdm->pilot_samples, 0, OFDM_M + OFDM_NCP);
+
+    for (i = 0; i < OFDM_ACQ_NFFT; i++) {
+        ofdm->acq_pilot[i] = cconj(ofdm->acq_pilot[i]);
+    }
+
     return ofdm; /* Success */
 }
 
 void ofdm_destroy(struct OFDM *ofdm) {
-    free(ofdm);
+    codec2_fft_free(ofdm->acq_fwd_cfg);
+    codec2_fft_free(ofdm->acq_inv_cfg);
+    codec2_free(ofdm);
+}
+
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: ofdm_size / ofdm_create_arena
+  DATE CREATED: Oct 2026
+
+  As ofdm_create(), but the modem states are placed in the size bytes at
+  mem, at least ofdm_size() long, with no heap use.  ofdm_destroy()
+  releases mem for reuse.
+
+\*---------------------------------------------------------------------------*/
+
+size_t ofdm_size(void)
+{
+    struct CODEC2_ARENA arena;
+    struct OFDM *ofdm;
+
+    codec2_arena_begin(&arena, NULL, 0);
+    ofdm = ofdm_create();
+    codec2_arena_end(&arena, ofdm);
+    if (ofdm == NULL)
+	return 0;
+    ofdm_destroy(ofdm);
+
+    return arena.used + CODEC2_ARENA_ALIGN;
+}
+
+struct OFDM *ofdm_create_arena(void *mem, size_t size)
+{
+    struct CODEC2_ARENA arena;
+    struct OFDM *ofdm;
+
+    codec2_arena_begin(&arena, mem, size);
+    ofdm = ofdm_create();
+    codec2_arena_end(&arena, ofdm);
+
+    return ofdm;
 }
 
 int ofdm_get_nin(struct OFDM *ofdm) {
@@ -364,6 +541,34 @@ void ofdm_set_off_est_hz(struct OFDM *ofdm, float val) {
     ofdm->foff_est_hz = val;
 }
 
+/*
+ * -----------------------------------------------------------
+ * ofdm_acquire - Finds timing and coarse frequency offset
+ * -----------------------------------------------------------
+ *
+ * Searches length samples of rx, which must be longer than one frame
+ * and one symbol, for two pilots a frame apart, trying frequency
+ * offsets up to +/- max_foff_hz.  Returns the sample offset of the
+ * first pilot and sets *foff_hz to the best offset, to FS/512 (FS/256
+ * on the Cortex M4).  Uses no heap or VLAs.
+ */
+
+int ofdm_acquire(struct OFDM *ofdm, COMP *rx, int length, float max_foff_hz, float *foff_hz) {
+    int nhyp, hyp, t_est;
+
+    assert(length > (OFDM_SAMPLESPERFRAME + (OFDM_M + OFDM_NCP)));
+
+    nhyp = ceilf(fabsf(max_foff_hz) * OFDM_ACQ_NFFT / OFDM_FS);
+    nhyp = min(nhyp, OFDM_ACQ_NFFT / 2 - 1);
+
+    /* COMP has the layout of complex float */
+
+    t_est = acquire(ofdm, (complex float *) rx, length, nhyp, &hyp);
+    *foff_hz = hyp * OFDM_FS / OFDM_ACQ_NFFT;
+
+    return t_est;
+}
+
 /*
  * --------------------------------------
  * ofdm_mod - modulates one frame of bits
@@ -779,3 +984,163 @@ void ofdm_demod(struct OFDM *ofdm, int *rx_bits, COMP *rxbuf_in) {
     }
 }
 
+
+#ifdef OFDM_ACQUIRE_BENCH
+#include <time.h>
+
+#define BENCH_FRAMES  4
+#define BENCH_CALLS   200
+
+static float bench_gauss(void) {
+    float u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    float u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+    return sqrtf(-2.0 * logf(u1)) * cosf(2.0 * M_PI * u2);
+}
+
+static double bench_us(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1E6 + t.tv_nsec / 1E3;
+}
+
+/* coarse_sync() as it was before the FFT correlator */
+
+static int bench_direct_sync(struct OFDM *ofdm, complex float *rx, int length) {
+    int Ncorr = length - (OFDM_SAMPLESPERFRAME + (OFDM_M + OFDM_NCP));
+    complex float csam, temp;
+    float mag = 0.0f;
+    int i, j, t_est = 0;
+
+    for (i = 0; i < Ncorr; i++) {
+        temp = 0.0f + 0.0f * I;
+
+        for (j = 0; j < (OFDM_M + OFDM_NCP); j++) {
+            csam = conjf(ofdm->pilot_samples[j]);
+            temp = temp + (rx[i + j] * csam);
+            temp = temp + (rx[i + j + OFDM_SAMPLESPERFRAME] * csam);
+        }
+
+        if (cabsf(temp) > mag) {
+            mag = cabsf(temp);
+            t_est = i;
+        }
+    }
+
+    return t_est;
+}
+
+/*
+ * BENCH_FRAMES frames of random QPSK delayed by delay samples, shifted
+ * foff_hz and with noise added at snr_db.
+ */
+
+static void bench_channel(complex float rx[], complex float tx[], int delay, float foff_hz, float snr_db) {
+    const int n = BENCH_FRAMES * OFDM_SAMPLESPERFRAME;
+    float power = 0.0f, sigma;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        power += crealf(tx[i] * conjf(tx[i]));
+    }
+
+    sigma = sqrtf(power / n / (2.0f * powf(10.0f, snr_db / 10.0f)));
+
+    for (i = 0; i < n; i++) {
+        rx[i] = (i < delay) ? 0.0f : tx[i - delay] * cexpf(I * TAU * foff_hz * i / OFDM_FS);
+        rx[i] += sigma * (bench_gauss() + bench_gauss() * I);
+    }
+}
+
+int main(void) {
+    static const int ncorrs[] = { 10, 100, 353, 700, 1400 };
+    static const float foffs[] = { 0.0f, 7.0f, -23.0f, 41.0f, -60.0f, 95.0f };
+    static complex float tx[BENCH_FRAMES * OFDM_SAMPLESPERFRAME];
+    static complex float rx[BENCH_FRAMES * OFDM_SAMPLESPERFRAME];
+    struct OFDM *ofdm;
+    COMP frame[OFDM_SAMPLESPERFRAME];
+    int bits[OFDM_BITSPERFRAME];
+    int f, i, c, delay, length, t_direct, t_fft, t_est;
+    int fails = 0;
+    float foff_est;
+    double t0, us_direct, us_fft;
+
+    ofdm = ofdm_create();
+    assert(ofdm != NULL);
+
+    for (f = 0; f < BENCH_FRAMES; f++) {
+        for (i = 0; i < OFDM_BITSPERFRAME; i++) {
+            bits[i] = rand() & 1;
+        }
+
+        ofdm_mod(ofdm, frame, bits);
+
+        for (i = 0; i < OFDM_SAMPLESPERFRAME; i++) {
+            tx[f * OFDM_SAMPLESPERFRAME + i] = frame[i].real + frame[i].imag * I;
+        }
+    }
+
+    printf("coarse_sync(), delay Ncorr/2, 10 dB SNR\n");
+    printf("  Ncorr  t direct  t fft  direct us  fft us\n");
+
+    for (c = 0; c < sizeof(ncorrs) / sizeof(ncorrs[0]); c++) {
+        length = ncorrs[c] + OFDM_SAMPLESPERFRAME + (OFDM_M + OFDM_NCP);
+        bench_channel(rx, tx, ncorrs[c] / 2, 0.0f, 10.0f);
+
+        t0 = bench_us();
+        for (i = 0; i < BENCH_CALLS; i++) {
+            t_direct = bench_direct_sync(ofdm, rx, length);
+        }
+        us_direct = (bench_us() - t0) / BENCH_CALLS;
+
+        t0 = bench_us();
+        for (i = 0; i < BENCH_CALLS; i++) {
+            t_fft = coarse_sync(ofdm, rx, length);
+        }
+        us_fft = (bench_us() - t0) / BENCH_CALLS;
+
+        printf("  %5d  %8d  %5d  %9.1f  %6.1f\n", ncorrs[c], t_direct, t_fft, us_direct, us_fft);
+
+        if (t_fft != t_direct) {
+            fails++;
+        }
+    }
+
+    printf("ofdm_acquire(), delay 700, Ncorr 1400, +/-100 Hz, 0 dB SNR\n");
+    printf("  foff Hz  t est  foff est  us\n");
+
+    delay = 700;
+    length = 1400 + OFDM_SAMPLESPERFRAME + (OFDM_M + OFDM_NCP);
+
+    for (c = 0; c < sizeof(foffs) / sizeof(foffs[0]); c++) {
+        bench_channel(rx, tx, delay, foffs[c], 0.0f);
+
+        t0 = bench_us();
+        for (i = 0; i < BENCH_CALLS; i++) {
+            t_est = ofdm_acquire(ofdm, (COMP *) rx, length, 100.0f, &foff_est);
+        }
+        us_fft = (bench_us() - t0) / BENCH_CALLS;
+
+        printf("  %7.0f  %5d  %8.1f  %6.1f\n", foffs[c], t_est, foff_est, us_fft);
+
+        /* noise can move the peak by a sample, fine timing takes it from there */
+
+        if ((abs(t_est - delay) > 1) || (fabsf(foff_est - foffs[c]) > OFDM_FS / OFDM_ACQ_NFFT)) {
+            fails++;
+        }
+    }
+
+    ofdm_destroy(ofdm);
+
+    if (fails) {
+        printf("Bad!\n");
+        exit(1);
+    }
+
+    printf("Everything checks out\n");
+
+    return 0;
+}
+
+#endif
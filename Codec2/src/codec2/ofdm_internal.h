@@ -35,6 +35,8 @@ extern "C" {
 #include <complex.h>
 #include <stdbool.h>
 
+#include "codec2_fft.h"
+
 #ifndef M_PI
 #define M_PI        3.14159265358979323846f  /* math constant */
 #endif
@@ -69,6 +71,20 @@ extern "C" {
 #define OFDM_MAX_SAMPLESPERFRAME (OFDM_SAMPLESPERFRAME + (OFDM_M + OFDM_NCP)/4)
 #define OFDM_RXBUF               (3 * OFDM_SAMPLESPERFRAME + 3 * (OFDM_M + OFDM_NCP))
 
+/*
+ * Timing acquisition correlates by overlap-save FFTs of OFDM_ACQ_NFFT
+ * points, each giving OFDM_ACQ_NFFT - (M + Ncp) + 1 timing offsets.  It
+ * only pays off over the direct sum for OFDM_ACQ_MIN_NCORR or more
+ * offsets.  Frequency hypotheses are spaced FS / OFDM_ACQ_NFFT apart.
+ */
+
+#ifdef CORTEX_M4
+#define OFDM_ACQ_NFFT            256
+#else
+#define OFDM_ACQ_NFFT            512
+#endif
+#define OFDM_ACQ_MIN_NCORR       64
+
 struct OFDM {
     float foff_est_gain;
     float foff_est_hz;
@@ -83,6 +99,7 @@ struct OFDM {
     bool phase_est_en;
 
     complex float pilot_samples[OFDM_M + OFDM_NCP];
+    complex float pilot_conj[OFDM_M + OFDM_NCP];
     complex float W[OFDM_NC + 2][OFDM_M];
     complex float rxbuf[OFDM_RXBUF];
     complex float pilots[OFDM_NC + 2];
@@ -94,6 +111,17 @@ struct OFDM {
     complex float rx_np[OFDM_ROWSPERFRAME * OFDM_NC];
     float rx_amp[OFDM_ROWSPERFRAME * OFDM_NC];
     float aphase_est_pilot_log[OFDM_ROWSPERFRAME * OFDM_NC];
+
+    /* Timing acquisition, FFT configs and scratch */
+
+    codec2_fft_cfg acq_fwd_cfg;
+    codec2_fft_cfg acq_inv_cfg;
+    COMP acq_pilot[OFDM_ACQ_NFFT];          /* conjugate of the pilot's spectrum      */
+    COMP acq_in[OFDM_ACQ_NFFT];             /* received block, then product spectrum  */
+    COMP acq_a[OFDM_ACQ_NFFT];              /* spectra of the blocks one frame apart  */
+    COMP acq_b[OFDM_ACQ_NFFT];
+    COMP acq_out[OFDM_ACQ_NFFT];            /* correlation                            */
+    float acq_mag[OFDM_ACQ_NFFT];           /* its magnitude squared at each offset   */
 };
 
 #ifdef __cplusplus
@@ -25,6 +25,7 @@
   along with this program; if not,see <http://www.gnu.org/licenses/>.
 */
 
+#include "codec2_math.h"
 #include "defines.h"
 #include "phase.h"
 #include "kiss_fft.h"
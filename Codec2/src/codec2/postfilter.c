@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <math.h>
 
+#include "codec2_math.h"
 #include "defines.h"
 #include "comp.h"
 #include "dump.h"
@@ -105,12 +106,22 @@ void postfilter(
 {
   int   m, uv;
   float e, thresh;
+#ifdef CODEC2_FIXED_POINT
+  q15_t A[MAX_AMP];	/* A[1..L] in Q15, x 2^eA */
+  int   eA;
+  q31_t qthresh;
+#endif
 
   /* determine average energy across spectrum */
 
+#ifdef CODEC2_FIXED_POINT
+  eA = q15_block(A, &model->A[1], model->L);
+  e = 1E-12 + ldexpf((float)q15_dot(A, A, model->L), 2*eA);
+#else
   e = 1E-12;
   for(m=1; m<=model->L; m++)
       e += model->A[m]*model->A[m];
+#endif
 
   assert(e > 0.0);
   e = 10.0*log10f(e/model->L);
@@ -128,12 +139,23 @@ void postfilter(
 
   uv = 0;
   thresh = powf(10.0, (*bg_est + BG_MARGIN)/20.0);
+#ifdef CODEC2_FIXED_POINT
+  thresh = ldexpf(thresh, -eA);
+  qthresh = (thresh < 32768.0f) ? (q31_t)thresh : 32768;
+  if (model->voiced)
+      for(m=1; m<=model->L; m++)
+	  if (A[m-1] < qthresh) {
+	      model->phi[m] = TWO_PI*(float)codec2_rand()/CODEC2_RAND_MAX;
+	      uv++;
+	  }
+#else
   if (model->voiced)
       for(m=1; m<=model->L; m++)
 	  if (model->A[m] < thresh) {
 	      model->phi[m] = TWO_PI*(float)codec2_rand()/CODEC2_RAND_MAX;
 	      uv++;
 	  }
+#endif
 
 #ifdef DUMP
   dump_bg(e, *bg_est, 100.0*uv/model->L);
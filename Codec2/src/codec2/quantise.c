@@ -31,6 +31,7 @@
 #include <string.h>
 #include <math.h>
 
+#include "codec2_math.h"
 #include "defines.h"
 #include "dump.h"
 #include "quantise.h"
@@ -39,6 +40,7 @@
 #include "codec2_fft.h"
 #include "phase.h"
 #include "mbest.h"
+#include "vq_search.h"
 
 #undef PROFILE
 #include "machdep.h"
@@ -99,6 +101,7 @@ int lsp_pred_vq_bits(int i) {
 
 void quantise_init()
 {
+    vq_search_init();
 }
 
 /*---------------------------------------------------------------------------*\
@@ -119,26 +122,11 @@ long quantise(const float * cb, float vec[], float w[], int k, int m, float *se)
 /* int     m;		size of codebook		*/
 /* float   *se;		accumulated squared error 	*/
 {
-   float   e;		/* current error		*/
    long	   besti;	/* best index so far		*/
    float   beste;	/* best error so far		*/
-   long	   j;
-   int     i;
-   float   diff;
 
-   besti = 0;
    beste = 1E32;
-   for(j=0; j<m; j++) {
-	e = 0.0;
-	for(i=0; i<k; i++) {
-	    diff = cb[j*k+i]-vec[i];
-	    e += powf(diff*w[i],2.0);
-	}
-	if (e < beste) {
-	    beste = e;
-	    besti = j;
-	}
-   }
+   besti = vq_nearest(cb, k, m, vec, w, VQ_WEIGHTED, &beste);
 
    *se += beste;
 
@@ -465,42 +453,16 @@ void compute_weights_anssi_mode2(const float *x, float *w, int ndim)
 
 int find_nearest(const float *codebook, int nb_entries, float *x, int ndim)
 {
-  int i, j;
   float min_dist = 1e15;
-  int nearest = 0;
 
-  for (i=0;i<nb_entries;i++)
-  {
-    float dist=0;
-    for (j=0;j<ndim;j++)
-      dist += (x[j]-codebook[i*ndim+j])*(x[j]-codebook[i*ndim+j]);
-    if (dist<min_dist)
-    {
-      min_dist = dist;
-      nearest = i;
-    }
-  }
-  return nearest;
+  return vq_nearest(codebook, ndim, nb_entries, x, NULL, VQ_WEIGHTED, &min_dist);
 }
 
 int find_nearest_weighted(const float *codebook, int nb_entries, float *x, const float *w, int ndim)
 {
-  int i, j;
   float min_dist = 1e15;
-  int nearest = 0;
 
-  for (i=0;i<nb_entries;i++)
-  {
-    float dist=0;
-    for (j=0;j<ndim;j++)
-      dist += w[j]*(x[j]-codebook[i*ndim+j])*(x[j]-codebook[i*ndim+j]);
-    if (dist<min_dist)
-    {
-      min_dist = dist;
-      nearest = i;
-    }
-  }
-  return nearest;
+  return vq_nearest(codebook, ndim, nb_entries, x, w, VQ_WEIGHT_SQ, &min_dist);
 }
 
 void lspjvm_quantise(float *x, float *xq, int order)
@@ -597,7 +559,8 @@ float lspmelvq_mbest_encode(int *indexes, float *x, float *xq, int ndim, int mbe
   const float *codebook1 = lspmelvq_cb[0].cb;
   const float *codebook2 = lspmelvq_cb[1].cb;
   const float *codebook3 = lspmelvq_cb[2].cb;
-  struct MBEST *mbest_stage1, *mbest_stage2, *mbest_stage3;
+  struct MBEST mbest[3], *mbest_stage1, *mbest_stage2, *mbest_stage3;
+  struct MBEST_LIST list[3][mbest_entries];
   float target[ndim];
   float w[ndim];
   int   index[MBEST_STAGES];
@@ -606,9 +569,13 @@ float lspmelvq_mbest_encode(int *indexes, float *x, float *xq, int ndim, int mbe
   for(i=0; i<ndim; i++)
       w[i] = 1.0;
 
-  mbest_stage1 = mbest_create(mbest_entries);
-  mbest_stage2 = mbest_create(mbest_entries);
-  mbest_stage3 = mbest_create(mbest_entries);
+  /* lists on the stack, no heap activity per frame */
+
+  for(i=0; i<3; i++)
+      mbest_init(&mbest[i], list[i], mbest_entries);
+  mbest_stage1 = &mbest[0];
+  mbest_stage2 = &mbest[1];
+  mbest_stage3 = &mbest[2];
   for(i=0; i<MBEST_STAGES; i++)
       index[i] = 0;
 
@@ -649,10 +616,6 @@ float lspmelvq_mbest_encode(int *indexes, float *x, float *xq, int ndim, int mbe
       xq[i] = tmp;
   }
 
-  mbest_destroy(mbest_stage1);
-  mbest_destroy(mbest_stage2);
-  mbest_destroy(mbest_stage3);
-
   indexes[0] = n1; indexes[1] = n2; indexes[2] = n3;
 
   return mse;
@@ -1924,7 +1887,7 @@ void quantise_WoE(C2CONST *c2const, MODEL *model, float *e, float xq[])
 {
   int          i, n1;
   float        x[2];
-  float        err[2];
+  float        err[2] = {0.0, 0.0};
   float        w[2];
   const float *codebook1 = ge_cb[0].cb;
   int          nb_entries = ge_cb[0].m;
@@ -1985,7 +1948,7 @@ int encode_WoE(MODEL *model, float e, float xq[])
 {
   int          i, n1;
   float        x[2];
-  float        err[2];
+  float        err[2] = {0.0, 0.0};
   float        w[2];
   const float *codebook1 = ge_cb[0].cb;
   int          nb_entries = ge_cb[0].m;
@@ -0,0 +1,540 @@
+/*---------------------------------------------------------------------------*\
+
+  FILE........: simd_fft.c
+  DATE CREATED: Oct 2026
+
+  Planned power of two FFTs, the USE_SIMD_FFT backend of codec2_fft.h.
+
+  A Stockham (self sorting) decimation in frequency FFT of radix-4
+  stages, plus one radix-2 stage when log2(nfft) is odd, ping ponging
+  between the output and a work buffer so there is no bit reversal
+  pass.  The twiddles of every stage are computed when the plan is
+  made and stored already laid out as the vectors the butterflies
+  multiply by.  Each SSE2 or NEON vector holds two complex samples:
+  the first stage works on two butterflies at a time, the others on
+  two samples of the same butterfly.  Builds without SIMD run the same
+  code on a plain C vector type.
+
+  Real FFTs are done as a complex FFT of half the length, with the
+  same packing as kiss_fftr().
+
+  To check against KISS FFT and time both per call:
+
+     src$ gcc -O2 -DSIMD_FFT_UNITTEST -Icodec2 codec2/simd_fft.c codec2/kiss_fft.c \
+              codec2/kiss_fftr.c codec2/codec2_arena.c -o simd_fft -lm && ./simd_fft
+
+\*---------------------------------------------------------------------------*/
+
+/*
+  All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 2.1, as
+  published by the Free Software Foundation.  This program is
+  distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+  License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "simd_fft.h"
+#include "kiss_fft.h"
+#include "codec2_arena.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+typedef __m128 fvec;
+#define V_LOAD(p)      _mm_loadu_ps((const float*)(p))
+#define V_STORE(p,a)   _mm_storeu_ps((float*)(p),a)
+#define V_ADD(a,b)     _mm_add_ps(a,b)
+#define V_SUB(a,b)     _mm_sub_ps(a,b)
+#define V_MUL(a,b)     _mm_mul_ps(a,b)
+#define V_XOR(a,b)     _mm_xor_ps(a,b)
+#define V_SWAP(a)      _mm_shuffle_ps(a,a,_MM_SHUFFLE(2,3,0,1))   /* (i,r) of each sample */
+#define V_LO(a,b)      _mm_movelh_ps(a,b)                          /* first samples of a,b */
+#define V_HI(a,b)      _mm_movehl_ps(b,a)                          /* second samples       */
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+typedef float32x4_t fvec;
+#define V_LOAD(p)      vld1q_f32((const float*)(p))
+#define V_STORE(p,a)   vst1q_f32((float*)(p),a)
+#define V_ADD(a,b)     vaddq_f32(a,b)
+#define V_SUB(a,b)     vsubq_f32(a,b)
+#define V_MUL(a,b)     vmulq_f32(a,b)
+#define V_XOR(a,b)     vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)))
+#define V_SWAP(a)      vrev64q_f32(a)
+#define V_LO(a,b)      vcombine_f32(vget_low_f32(a), vget_low_f32(b))
+#define V_HI(a,b)      vcombine_f32(vget_high_f32(a), vget_high_f32(b))
+#else
+typedef struct { float v[4]; } fvec;
+
+static inline fvec v_load(const float *p) { fvec r; memcpy(r.v, p, sizeof(r.v)); return r; }
+static inline fvec v_add(fvec a, fvec b) { int i; for(i=0; i<4; i++) a.v[i] += b.v[i]; return a; }
+static inline fvec v_sub(fvec a, fvec b) { int i; for(i=0; i<4; i++) a.v[i] -= b.v[i]; return a; }
+static inline fvec v_mul(fvec a, fvec b) { int i; for(i=0; i<4; i++) a.v[i] *= b.v[i]; return a; }
+static inline fvec v_xor(fvec a, fvec b) { int i; for(i=0; i<4; i++) if (signbit(b.v[i])) a.v[i] = -a.v[i]; return a; }
+static inline fvec v_swap(fvec a) { fvec r = {{a.v[1], a.v[0], a.v[3], a.v[2]}}; return r; }
+static inline fvec v_lo(fvec a, fvec b) { fvec r = {{a.v[0], a.v[1], b.v[0], b.v[1]}}; return r; }
+static inline fvec v_hi(fvec a, fvec b) { fvec r = {{a.v[2], a.v[3], b.v[2], b.v[3]}}; return r; }
+
+#define V_LOAD(p)      v_load((const float*)(p))
+#define V_STORE(p,a)   memcpy((float*)(p), (a).v, sizeof((a).v))
+#define V_ADD(a,b)     v_add(a,b)
+#define V_SUB(a,b)     v_sub(a,b)
+#define V_MUL(a,b)     v_mul(a,b)
+#define V_XOR(a,b)     v_xor(a,b)
+#define V_SWAP(a)      v_swap(a)
+#define V_LO(a,b)      v_lo(a,b)
+#define V_HI(a,b)      v_hi(a,b)
+#endif
+
+/* complex multiply of the two samples in z by w, with w stored as
+   wre = (wr,wr,...) and wim = (-wi,wi,...) */
+
+#define V_CMUL(z,wre,wim)  V_ADD(V_MUL(wre,z), V_MUL(wim,V_SWAP(z)))
+
+#define TW_VEC    4                 /* floats per vector                             */
+#define TW_STEP   (6*TW_VEC)        /* w1, w2, w3 re and im vectors per vector step  */
+
+struct simd_fft_state {
+    int           nfft;
+    int           inverse;
+    int           nstages;          /* radix-4 stages, plus one if radix-2 is needed */
+    float        *twiddles;
+    COMP         *work;
+    float         jmul[TW_VEC];     /* sign mask multiplying by j, or -j if inverse  */
+    kiss_fft_cfg  kiss;             /* sizes that aren't planned                     */
+};
+
+struct simd_fftr_state {
+    simd_fft_cfg  sub;
+    COMP         *tmpbuf;
+    COMP         *super_twiddles;
+};
+
+static void tw_store(float *t, int k, int lane, double phase) {
+    t[(2*k)*TW_VEC + 2*lane]       = cos(phase);
+    t[(2*k)*TW_VEC + 2*lane + 1]   = cos(phase);
+    t[(2*k+1)*TW_VEC + 2*lane]     = -sin(phase);
+    t[(2*k+1)*TW_VEC + 2*lane + 1] = sin(phase);
+}
+
+/* radix-4 butterfly of a,b,c,d, twiddled by the vectors at t */
+
+#define BUTTERFLY4(a,b,c,d,t,jmul,y0,y1,y2,y3) do {                       \
+        fvec apc = V_ADD(a,c), amc = V_SUB(a,c);                          \
+        fvec bpd = V_ADD(b,d), jbmd = V_XOR(V_SWAP(V_SUB(b,d)), jmul);    \
+        y0 = V_ADD(apc, bpd);                                             \
+        y1 = V_SUB(amc, jbmd);                                            \
+        y1 = V_CMUL(y1, V_LOAD(&t[0*TW_VEC]), V_LOAD(&t[1*TW_VEC]));      \
+        y2 = V_SUB(apc, bpd);                                             \
+        y2 = V_CMUL(y2, V_LOAD(&t[2*TW_VEC]), V_LOAD(&t[3*TW_VEC]));      \
+        y3 = V_ADD(amc, jbmd);                                            \
+        y3 = V_CMUL(y3, V_LOAD(&t[4*TW_VEC]), V_LOAD(&t[5*TW_VEC]));      \
+    } while(0)
+
+/* first stage, stride 1, two butterflies p and p+1 per vector */
+
+static void stage_first(const COMP *x, COMP *y, int m, const float *t, fvec jmul) {
+    int  n1 = m/4, p;
+    fvec a, b, c, d, y0, y1, y2, y3;
+
+    for(p=0; p<n1; p+=2, t+=TW_STEP) {
+        a = V_LOAD(&x[p]);
+        b = V_LOAD(&x[p+n1]);
+        c = V_LOAD(&x[p+2*n1]);
+        d = V_LOAD(&x[p+3*n1]);
+        BUTTERFLY4(a, b, c, d, t, jmul, y0, y1, y2, y3);
+        V_STORE(&y[4*p],   V_LO(y0, y1));
+        V_STORE(&y[4*p+2], V_LO(y2, y3));
+        V_STORE(&y[4*p+4], V_HI(y0, y1));
+        V_STORE(&y[4*p+6], V_HI(y2, y3));
+    }
+}
+
+/* later stages, stride s >= 4, two samples of one butterfly per vector */
+
+static void stage_radix4(const COMP *x, COMP *y, int m, int s, const float *t, fvec jmul) {
+    int  n1 = m/4, p, q;
+    fvec a, b, c, d, y0, y1, y2, y3;
+
+    for(p=0; p<n1; p++, t+=TW_STEP) {
+        const COMP *xp = &x[s*p];
+        COMP       *yp = &y[4*s*p];
+        for(q=0; q<s; q+=2) {
+            a = V_LOAD(&xp[q]);
+            b = V_LOAD(&xp[q+s*n1]);
+            c = V_LOAD(&xp[q+2*s*n1]);
+            d = V_LOAD(&xp[q+3*s*n1]);
+            BUTTERFLY4(a, b, c, d, t, jmul, y0, y1, y2, y3);
+            V_STORE(&yp[q],     y0);
+            V_STORE(&yp[q+s],   y1);
+            V_STORE(&yp[q+2*s], y2);
+            V_STORE(&yp[q+3*s], y3);
+        }
+    }
+}
+
+/* last stage when log2(nfft) is odd, stride s = nfft/2 */
+
+static void stage_radix2(const COMP *x, COMP *y, int s) {
+    int  q;
+    fvec a, b;
+
+    for(q=0; q<s; q+=2) {
+        a = V_LOAD(&x[q]);
+        b = V_LOAD(&x[q+s]);
+        V_STORE(&y[q],   V_ADD(a, b));
+        V_STORE(&y[q+s], V_SUB(a, b));
+    }
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: simd_fft_alloc
+
+  Makes the plan for an nfft point complex FFT, returns NULL if out of
+  memory.
+
+\*---------------------------------------------------------------------------*/
+
+simd_fft_cfg simd_fft_alloc(int nfft, int inverse_fft) {
+    struct simd_fft_state *st;
+    double sign = inverse_fft ? 1.0 : -1.0;
+    float *t;
+    int    m, s, p, k, lane, steps;
+
+    st = (struct simd_fft_state*)codec2_calloc(1, sizeof(struct simd_fft_state));
+    if (st == NULL)
+        return NULL;
+    st->nfft = nfft;
+    st->inverse = inverse_fft;
+
+    if ((nfft < 8) || (nfft & (nfft-1))) {
+        st->kiss = kiss_fft_alloc(nfft, inverse_fft, NULL, NULL);
+        if (st->kiss == NULL) {
+            codec2_free(st);
+            return NULL;
+        }
+        return st;
+    }
+
+    /* one vector step per butterfly pair in the first stage, and per
+       butterfly in the others */
+
+    steps = 0;
+    for(m=nfft, s=1; m>=4; m/=4, s*=4) {
+        steps += (s == 1) ? m/8 : m/4;
+        st->nstages++;
+    }
+    if (m == 2)
+        st->nstages++;
+
+    st->twiddles = (float*)codec2_malloc(sizeof(float)*TW_STEP*steps);
+    st->work = (COMP*)codec2_malloc(sizeof(COMP)*nfft);
+    if ((st->twiddles == NULL) || (st->work == NULL)) {
+        simd_fft_free(st);
+        return NULL;
+    }
+
+    t = st->twiddles;
+    for(m=nfft, s=1; m>=4; m/=4, s*=4) {
+        for(p=0; p<m/4; ) {
+            for(lane=0; lane<2; lane++) {
+                for(k=0; k<3; k++)
+                    tw_store(t, k, lane, sign*2.0*M_PI*(k+1)*p/m);
+                if (s == 1)
+                    p++;
+            }
+            if (s != 1)
+                p++;
+            t += TW_STEP;
+        }
+    }
+
+    /* j(r,i) = (-i,r), -j(r,i) = (i,-r) */
+
+    for(lane=0; lane<2; lane++) {
+        st->jmul[2*lane]   = inverse_fft ? 0.0f : -0.0f;
+        st->jmul[2*lane+1] = inverse_fft ? -0.0f : 0.0f;
+    }
+
+    return st;
+}
+
+void simd_fft_free(simd_fft_cfg st) {
+    if (st->kiss != NULL)
+        KISS_FFT_FREE(st->kiss);
+    codec2_free(st->twiddles);
+    codec2_free(st->work);
+    codec2_free(st);
+}
+
+void simd_fft(simd_fft_cfg st, const COMP *in, COMP *out) {
+    const COMP  *src = in;
+    COMP        *dst;
+    const float *t = st->twiddles;
+    fvec         jmul = V_LOAD(st->jmul);
+    int          m, s;
+
+    if (st->kiss != NULL) {
+        kiss_fft(st->kiss, (const kiss_fft_cpx*)in, (kiss_fft_cpx*)out);
+        return;
+    }
+
+    /* pick the first destination so the last stage lands in out, an
+       odd number of stages in place starts from a copy in work */
+
+    if (st->nstages & 1) {
+        if (in == out) {
+            memcpy(st->work, in, sizeof(COMP)*st->nfft);
+            src = st->work;
+        }
+        dst = out;
+    }
+    else
+        dst = st->work;
+
+    for(m=st->nfft, s=1; m>=4; m/=4, s*=4) {
+        if (s == 1) {
+            stage_first(src, dst, m, t, jmul);
+            t += TW_STEP*(m/8);
+        }
+        else {
+            stage_radix4(src, dst, m, s, t, jmul);
+            t += TW_STEP*(m/4);
+        }
+        src = dst;
+        dst = (dst == out) ? st->work : out;
+    }
+    if (m == 2)
+        stage_radix2(src, dst, s);
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: simd_fftr_alloc
+
+  Makes the plan for an nfft point real FFT, or its inverse, returns
+  NULL if out of memory or nfft is odd.
+
+\*---------------------------------------------------------------------------*/
+
+simd_fftr_cfg simd_fftr_alloc(int nfft, int inverse_fft) {
+    struct simd_fftr_state *st;
+    int    ncfft = nfft/2, i;
+    double phase;
+
+    if (nfft & 1)
+        return NULL;
+
+    st = (struct simd_fftr_state*)codec2_calloc(1, sizeof(struct simd_fftr_state));
+    if (st == NULL)
+        return NULL;
+    st->sub = simd_fft_alloc(ncfft, inverse_fft);
+    st->tmpbuf = (COMP*)codec2_malloc(sizeof(COMP)*ncfft);
+    st->super_twiddles = (COMP*)codec2_malloc(sizeof(COMP)*(ncfft/2));
+    if ((st->sub == NULL) || (st->tmpbuf == NULL) || (st->super_twiddles == NULL)) {
+        simd_fftr_free(st);
+        return NULL;
+    }
+
+    for(i=0; i<ncfft/2; i++) {
+        phase = -M_PI*((double)(i+1)/ncfft + 0.5);
+        if (inverse_fft)
+            phase = -phase;
+        st->super_twiddles[i].real = cos(phase);
+        st->super_twiddles[i].imag = sin(phase);
+    }
+
+    return st;
+}
+
+void simd_fftr_free(simd_fftr_cfg st) {
+    if (st->sub != NULL)
+        simd_fft_free(st->sub);
+    codec2_free(st->tmpbuf);
+    codec2_free(st->super_twiddles);
+    codec2_free(st);
+}
+
+void simd_fftr(simd_fftr_cfg st, const float *timedata, COMP *freqdata) {
+    int   k, ncfft = st->sub->nfft;
+    COMP  fpk, fpnk, f1k, f2k, tw, w;
+
+    assert(st->sub->inverse == 0);
+
+    /* FFT of the even and odd samples packed as real and imag */
+
+    simd_fft(st->sub, (const COMP*)timedata, st->tmpbuf);
+
+    freqdata[0].real = st->tmpbuf[0].real + st->tmpbuf[0].imag;
+    freqdata[ncfft].real = st->tmpbuf[0].real - st->tmpbuf[0].imag;
+    freqdata[ncfft].imag = freqdata[0].imag = 0;
+
+    for(k=1; k<=ncfft/2; k++) {
+        fpk = st->tmpbuf[k];
+        fpnk.real = st->tmpbuf[ncfft-k].real;
+        fpnk.imag = -st->tmpbuf[ncfft-k].imag;
+
+        f1k.real = fpk.real + fpnk.real;
+        f1k.imag = fpk.imag + fpnk.imag;
+        f2k.real = fpk.real - fpnk.real;
+        f2k.imag = fpk.imag - fpnk.imag;
+        w = st->super_twiddles[k-1];
+        tw.real = f2k.real*w.real - f2k.imag*w.imag;
+        tw.imag = f2k.real*w.imag + f2k.imag*w.real;
+
+        freqdata[k].real = 0.5f*(f1k.real + tw.real);
+        freqdata[k].imag = 0.5f*(f1k.imag + tw.imag);
+        freqdata[ncfft-k].real = 0.5f*(f1k.real - tw.real);
+        freqdata[ncfft-k].imag = 0.5f*(tw.imag - f1k.imag);
+    }
+}
+
+void simd_fftri(simd_fftr_cfg st, const COMP *freqdata, float *timedata) {
+    int   k, ncfft = st->sub->nfft;
+    COMP  fk, fnkc, fek, fok, tmp, w;
+
+    assert(st->sub->inverse == 1);
+
+    st->tmpbuf[0].real = freqdata[0].real + freqdata[ncfft].real;
+    st->tmpbuf[0].imag = freqdata[0].real - freqdata[ncfft].real;
+
+    for(k=1; k<=ncfft/2; k++) {
+        fk = freqdata[k];
+        fnkc.real = freqdata[ncfft-k].real;
+        fnkc.imag = -freqdata[ncfft-k].imag;
+
+        fek.real = fk.real + fnkc.real;
+        fek.imag = fk.imag + fnkc.imag;
+        tmp.real = fk.real - fnkc.real;
+        tmp.imag = fk.imag - fnkc.imag;
+        w = st->super_twiddles[k-1];
+        fok.real = tmp.real*w.real - tmp.imag*w.imag;
+        fok.imag = tmp.real*w.imag + tmp.imag*w.real;
+
+        st->tmpbuf[k].real = fek.real + fok.real;
+        st->tmpbuf[k].imag = fek.imag + fok.imag;
+        st->tmpbuf[ncfft-k].real = fek.real - fok.real;
+        st->tmpbuf[ncfft-k].imag = -(fek.imag - fok.imag);
+    }
+
+    simd_fft(st->sub, st->tmpbuf, (COMP*)timedata);
+}
+
+#ifdef SIMD_FFT_UNITTEST
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "kiss_fftr.h"
+
+#define MAX_NFFT  4096
+#define TOLERANCE 1E-5      /* largest error relative to the largest output */
+
+static double now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1E9 + t.tv_nsec;
+}
+
+/* largest difference relative to the largest reference value */
+
+static float rel_error(const float *a, const float *ref, int n) {
+    float e = 0.0, peak = 0.0;
+    int   i;
+
+    for(i=0; i<n; i++) {
+        if (fabsf(a[i] - ref[i]) > e) e = fabsf(a[i] - ref[i]);
+        if (fabsf(ref[i]) > peak) peak = fabsf(ref[i]);
+    }
+    return e/peak;
+}
+
+/* ns per call, over enough calls to take a few ms */
+
+#define TIME_CALLS(ns, call) do {                                     \
+        int _c, _calls = 1 + 20000000/(nfft*8);                       \
+        double _t0 = now_ns();                                        \
+        for(_c=0; _c<_calls; _c++) { call; }                          \
+        ns = (now_ns() - _t0)/_calls;                                 \
+    } while(0)
+
+int main() {
+    static COMP  in[MAX_NFFT], out[MAX_NFFT], ref[MAX_NFFT], inplace[MAX_NFFT];
+    static float rin[MAX_NFFT], rout[MAX_NFFT], rref[MAX_NFFT];
+    float        e, worst = 0.0;
+    double       t_kiss, t_simd;
+    int          nfft, inv, i;
+
+    for(i=0; i<MAX_NFFT; i++) {
+        in[i].real = (float)rand()/RAND_MAX - 0.5;
+        in[i].imag = (float)rand()/RAND_MAX - 0.5;
+        rin[i] = (float)rand()/RAND_MAX - 0.5;
+    }
+
+    printf("                 rel error   kiss ns   simd ns  speedup\n");
+    for(nfft=8; nfft<=MAX_NFFT; nfft*=2) {
+        for(inv=0; inv<2; inv++) {
+            kiss_fft_cfg  kc = kiss_fft_alloc(nfft, inv, NULL, NULL);
+            simd_fft_cfg  sc = simd_fft_alloc(nfft, inv);
+            kiss_fftr_cfg kr = kiss_fftr_alloc(nfft, inv, NULL, NULL);
+            simd_fftr_cfg sr = simd_fftr_alloc(nfft, inv);
+            assert((kc != NULL) && (sc != NULL) && (kr != NULL) && (sr != NULL));
+
+            /* complex, out of place and in place */
+
+            kiss_fft(kc, (kiss_fft_cpx*)in, (kiss_fft_cpx*)ref);
+            simd_fft(sc, in, out);
+            e = rel_error((float*)out, (float*)ref, 2*nfft);
+            memcpy(inplace, in, nfft*sizeof(COMP));
+            simd_fft(sc, inplace, inplace);
+            if (rel_error((float*)inplace, (float*)ref, 2*nfft) > e)
+                e = rel_error((float*)inplace, (float*)ref, 2*nfft);
+            if (e > worst) worst = e;
+            TIME_CALLS(t_kiss, kiss_fft(kc, (kiss_fft_cpx*)in, (kiss_fft_cpx*)ref));
+            TIME_CALLS(t_simd, simd_fft(sc, in, out));
+            printf("cfft%c %5d    %9.2e %9.0f %9.0f %7.2fx\n", inv ? 'i' : ' ', nfft, e, t_kiss, t_simd, t_kiss/t_simd);
+
+            /* real, forward from rin and inverse from the first nfft/2+1 bins of in */
+
+            if (inv == 0) {
+                kiss_fftr(kr, rin, (kiss_fft_cpx*)ref);
+                simd_fftr(sr, rin, out);
+                e = rel_error((float*)out, (float*)ref, 2*(nfft/2+1));
+                TIME_CALLS(t_kiss, kiss_fftr(kr, rin, (kiss_fft_cpx*)ref));
+                TIME_CALLS(t_simd, simd_fftr(sr, rin, out));
+            }
+            else {
+                kiss_fftri(kr, (kiss_fft_cpx*)in, rref);
+                simd_fftri(sr, in, rout);
+                e = rel_error(rout, rref, nfft);
+                TIME_CALLS(t_kiss, kiss_fftri(kr, (kiss_fft_cpx*)in, rref));
+                TIME_CALLS(t_simd, simd_fftri(sr, in, rout));
+            }
+            if (e > worst) worst = e;
+            printf("rfft%c %5d    %9.2e %9.0f %9.0f %7.2fx\n", inv ? 'i' : ' ', nfft, e, t_kiss, t_simd, t_kiss/t_simd);
+
+            KISS_FFT_FREE(kc);
+            KISS_FFT_FREE(kr);
+            simd_fft_free(sc);
+            simd_fftr_free(sr);
+        }
+    }
+
+    printf("worst relative error %g\n", worst);
+    if (worst > TOLERANCE) {
+        printf("Bad!\n");
+        exit(1);
+    }
+    printf("Everything checks out\n");
+    return 0;
+}
+#endif
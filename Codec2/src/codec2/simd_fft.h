@@ -0,0 +1,50 @@
+/*---------------------------------------------------------------------------*\
+
+  FILE........: simd_fft.h
+  DATE CREATED: Oct 2026
+
+  Planned power of two FFTs with SSE2 and NEON butterflies, the
+  USE_SIMD_FFT backend of codec2_fft.h.  Same conventions as KISS FFT:
+  unscaled transforms, and real FFTs of nfft points take or give
+  nfft/2+1 complex bins.
+
+\*---------------------------------------------------------------------------*/
+
+/*
+  All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 2.1, as
+  published by the Free Software Foundation.  This program is
+  distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+  License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SIMD_FFT__
+#define __SIMD_FFT__
+
+#include "comp.h"
+
+typedef struct simd_fft_state  *simd_fft_cfg;
+typedef struct simd_fftr_state *simd_fftr_cfg;
+
+/* nfft that is not a power of two, or is below 8, falls back to KISS
+   FFT, in and out may be the same buffer */
+
+simd_fft_cfg  simd_fft_alloc(int nfft, int inverse_fft);
+void          simd_fft(simd_fft_cfg cfg, const COMP *in, COMP *out);
+void          simd_fft_free(simd_fft_cfg cfg);
+
+/* nfft must be even */
+
+simd_fftr_cfg simd_fftr_alloc(int nfft, int inverse_fft);
+void          simd_fftr(simd_fftr_cfg cfg, const float *timedata, COMP *freqdata);
+void          simd_fftri(simd_fftr_cfg cfg, const COMP *freqdata, float *timedata);
+void          simd_fftr_free(simd_fftr_cfg cfg);
+
+#endif
@@ -35,9 +35,13 @@
 #include <stdio.h>
 #include <math.h>
 
+#include "codec2_math.h"
 #include "defines.h"
 #include "sine.h"
 #include "kiss_fft.h"
+#ifdef CODEC2_FIXED_POINT
+#include "nco.h"
+#endif
 
 #define HPF_BETA 0.125
 
@@ -62,10 +66,10 @@ C2CONST c2const_create(int Fs) {
     assert((Fs == 8000) || (Fs = 16000));
     c2const.Fs = Fs;
     c2const.n_samp = Fs*N_S;
-    c2const.max_amp = floor(Fs*P_MIN_S/2);
-    c2const.p_min = floor(Fs*P_MIN_S);
-    c2const.p_max = floor(Fs*P_MAX_S);
-    c2const.m_pitch = floor(Fs*M_PITCH_S);
+    c2const.max_amp = c2_floor(Fs*P_MIN_S/2);
+    c2const.p_min = c2_floor(Fs*P_MIN_S);
+    c2const.p_max = c2_floor(Fs*P_MAX_S);
+    c2const.m_pitch = c2_floor(Fs*M_PITCH_S);
     c2const.Wo_min = TWO_PI/c2const.p_max;
     c2const.Wo_max = TWO_PI/c2const.p_min;
 
@@ -648,8 +652,15 @@ void synthesise(
         if (b > ((FFT_DEC/2)-1)) {
             b = (FFT_DEC/2)-1;
         }
+#ifdef CODEC2_FIXED_POINT
+        /* phase in Q31 turns, the NCO table replaces cosf()/sinf() */
+        COMP p = nco_phasor((uint32_t)(int64_t)(model->phi[l]*(4294967296.0f/TWO_PI)));
+        Sw_[b].real = model->A[l]*p.real;
+        Sw_[b].imag = model->A[l]*p.imag;
+#else
         Sw_[b].real = model->A[l]*cosf(model->phi[l]);
         Sw_[b].imag = model->A[l]*sinf(model->phi[l]);
+#endif
     }
 
     /* Perform inverse DFT */
@@ -658,7 +669,7 @@ void synthesise(
 
     /* Overlap add to previous samples */
 
-    #ifdef USE_KISS_FFT
+    #if defined(USE_KISS_FFT) || defined(USE_SIMD_FFT)
     #define    FFTI_FACTOR ((float)1.0)
     #else
     #define    FFTI_FACTOR ((float32_t)FFT_DEC)
@@ -677,11 +688,23 @@ void synthesise(
 }
 
 
-/* todo: this should probably be in some states rather than a static */
+/* codec2_decode() swaps its own state in and out around each frame,
+   batch worker threads get a generator each to swap it into */
+#ifdef CODEC2_BATCH_THREADS
+static __thread unsigned long next = 1;
+#else
 static unsigned long next = 1;
+#endif
 
 int codec2_rand(void) {
     next = next * 1103515245 + 12345;
     return((unsigned)(next/65536) % 32768);
 }
 
+void codec2_rand_swap(unsigned long *state) {
+    unsigned long t = next;
+
+    next = *state;
+    *state = t;
+}
+
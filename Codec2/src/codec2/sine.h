@@ -45,5 +45,6 @@ void synthesise(int n_samp, codec2_fftr_cfg fftr_inv_cfg, float Sn_[], MODEL *mo
 
 #define CODEC2_RAND_MAX 32767
 int codec2_rand(void);
+void codec2_rand_swap(unsigned long *state);
 
 #endif
@@ -0,0 +1,506 @@
+/*---------------------------------------------------------------------------*\
+
+  FILE........: vq_search.c
+  DATE CREATED: Oct 2026
+
+  Codebook search kernels shared by the VQ quantisers.  On x86 (SSE2 or
+  AVX2) and ARM NEON builds vq_search_init() makes a transposed copy of
+  each codebook, so VQ_SEARCH_LANES entries are scored at once with one
+  vector load per dimension.  Other builds (e.g. the Cortex M4) use the
+  portable C loops on the codebooks in place, with no extra memory.
+
+  Each lane accumulates its error in the same order as the scalar
+  loops, so the SIMD and C kernels give bit exact results, as long as
+  the compiler is not allowed to contract mul/add into FMA.
+
+  To check against the original search loops and time them:
+
+     src$ gcc -O2 -DVQ_SEARCH_UNITTEST -I. -Icodec2 $(find codec2 -name '*.c') \
+              -o vq_search -lm && ./vq_search
+
+  This also times codec2_encode() per frame in each mode with the
+  original loops and with vq_nearest().
+
+\*---------------------------------------------------------------------------*/
+
+/*
+  All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 2.1, as
+  published by the Free Software Foundation.  This program is
+  distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+  License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "defines.h"
+#include "vq_search.h"
+
+#if defined(VQ_SEARCH_AVX2)
+#include <immintrin.h>
+typedef __m256 vq_vec;
+#define VQ_LOAD(p)     _mm256_loadu_ps(p)
+#define VQ_STORE(p,a)  _mm256_storeu_ps(p,a)
+#define VQ_SET1(x)     _mm256_set1_ps(x)
+#define VQ_ZERO()      _mm256_setzero_ps()
+#define VQ_ADD(a,b)    _mm256_add_ps(a,b)
+#define VQ_SUB(a,b)    _mm256_sub_ps(a,b)
+#define VQ_MUL(a,b)    _mm256_mul_ps(a,b)
+#elif defined(VQ_SEARCH_SSE)
+#include <emmintrin.h>
+typedef __m128 vq_vec;
+#define VQ_LOAD(p)     _mm_loadu_ps(p)
+#define VQ_STORE(p,a)  _mm_storeu_ps(p,a)
+#define VQ_SET1(x)     _mm_set1_ps(x)
+#define VQ_ZERO()      _mm_setzero_ps()
+#define VQ_ADD(a,b)    _mm_add_ps(a,b)
+#define VQ_SUB(a,b)    _mm_sub_ps(a,b)
+#define VQ_MUL(a,b)    _mm_mul_ps(a,b)
+#elif defined(VQ_SEARCH_NEON)
+#include <arm_neon.h>
+typedef float32x4_t vq_vec;
+#define VQ_LOAD(p)     vld1q_f32(p)
+#define VQ_STORE(p,a)  vst1q_f32(p,a)
+#define VQ_SET1(x)     vdupq_n_f32(x)
+#define VQ_ZERO()      vdupq_n_f32(0.0f)
+#define VQ_ADD(a,b)    vaddq_f32(a,b)
+#define VQ_SUB(a,b)    vsubq_f32(a,b)
+#define VQ_MUL(a,b)    vmulq_f32(a,b)
+#endif
+
+#if VQ_SEARCH_LANES > 1
+
+/* transposed codebook, entry j dimension i at cbt[i*mpad+j], m rounded
+   up to whole VQ_BLOCKs so vector loads never run off the end */
+
+struct VQ_LAYOUT {
+    const float *cb;
+    int          k;
+    int          m;
+    int          mpad;
+    float       *cbt;
+};
+
+#define VQ_MAX_LAYOUTS 32
+#define VQ_MIN_ENTRIES 64  /* smaller codebooks search faster in place */
+
+/* encoders may be created on several threads at once (codec2_batch,
+   freedv_pipeline), so the layouts are only used once vq_state says
+   they are complete */
+
+#define VQ_EMPTY    0
+#define VQ_BUILDING 1
+#define VQ_READY    2
+
+static struct VQ_LAYOUT vq_layouts[VQ_MAX_LAYOUTS];
+static int              vq_nlayouts;
+static int              vq_state;
+
+static void vq_layout_add(const struct lsp_codebook *cbs) {
+    int i, j;
+
+    for(; cbs->cb != NULL && vq_nlayouts < VQ_MAX_LAYOUTS; cbs++) {
+	struct VQ_LAYOUT *l = &vq_layouts[vq_nlayouts];
+	if (cbs->m < VQ_MIN_ENTRIES)
+	    continue;
+	l->cb = cbs->cb;
+	l->k = cbs->k;
+	l->m = cbs->m;
+	l->mpad = ((cbs->m + VQ_BLOCK - 1)/VQ_BLOCK)*VQ_BLOCK;
+	l->cbt = (float*)calloc(l->k*l->mpad, sizeof(float));
+	if (l->cbt == NULL)
+	    return;
+	for(j=0; j<l->m; j++)
+	    for(i=0; i<l->k; i++)
+		l->cbt[i*l->mpad+j] = l->cb[j*l->k+i];
+	vq_nlayouts++;
+    }
+}
+
+static const struct VQ_LAYOUT *vq_layout(const float *cb, int k, int m) {
+    int i;
+
+    if (__atomic_load_n(&vq_state, __ATOMIC_ACQUIRE) != VQ_READY)
+	return NULL;
+    for(i=0; i<vq_nlayouts; i++)
+	if (vq_layouts[i].cb == cb && vq_layouts[i].k == k && vq_layouts[i].m >= m)
+	    return &vq_layouts[i];
+    return NULL;
+}
+
+static void vq_errors_simd(const struct VQ_LAYOUT *l, int start, int n, const float vec[], const float w[], int form, float e[]) {
+    float  tail[VQ_SEARCH_LANES];
+    int    i, j;
+
+    for(j=0; j<n; j+=VQ_SEARCH_LANES) {
+	const float *c = &l->cbt[start+j];
+	vq_vec acc = VQ_ZERO();
+	vq_vec d;
+	if (form == VQ_WEIGHT_SQ) {
+	    for(i=0; i<l->k; i++, c+=l->mpad) {
+		d = VQ_SUB(VQ_SET1(vec[i]), VQ_LOAD(c));
+		acc = VQ_ADD(acc, VQ_MUL(VQ_MUL(VQ_SET1(w[i]), d), d));
+	    }
+	}
+	else if (w != NULL) {
+	    for(i=0; i<l->k; i++, c+=l->mpad) {
+		d = VQ_MUL(VQ_SUB(VQ_LOAD(c), VQ_SET1(vec[i])), VQ_SET1(w[i]));
+		acc = VQ_ADD(acc, VQ_MUL(d, d));
+	    }
+	}
+	else {
+	    for(i=0; i<l->k; i++, c+=l->mpad) {
+		d = VQ_SUB(VQ_LOAD(c), VQ_SET1(vec[i]));
+		acc = VQ_ADD(acc, VQ_MUL(d, d));
+	    }
+	}
+	if (j + VQ_SEARCH_LANES <= n)
+	    VQ_STORE(&e[j], acc);
+	else {
+	    VQ_STORE(tail, acc);
+	    memcpy(&e[j], tail, (n-j)*sizeof(float));
+	}
+    }
+}
+
+#endif
+
+/*---------------------------------------------------------------------------*\
+
+  vq_search_init
+
+  Builds the transposed codebooks used by the SIMD kernels, does
+  nothing on builds without them.  Called by quantise_init(), only the
+  first call does any work, calls made on other threads meanwhile wait
+  for it to finish.
+
+\*---------------------------------------------------------------------------*/
+
+void vq_search_init(void) {
+#if VQ_SEARCH_LANES > 1
+    int state = VQ_EMPTY;
+
+    if (!__atomic_compare_exchange_n(&vq_state, &state, VQ_BUILDING, 0,
+				     __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+	while (state != VQ_READY)
+	    state = __atomic_load_n(&vq_state, __ATOMIC_ACQUIRE);
+	return;
+    }
+    vq_layout_add(lsp_cb);
+    vq_layout_add(lsp_cbd);
+    vq_layout_add(lsp_cbjvm);
+    vq_layout_add(ge_cb);
+#ifndef CORTEX_M4
+    vq_layout_add(mel_cb);
+    vq_layout_add(lspmelvq_cb);
+#endif
+    __atomic_store_n(&vq_state, VQ_READY, __ATOMIC_RELEASE);
+#endif
+}
+
+/*---------------------------------------------------------------------------*\
+
+  vq_errors
+
+  Writes the error of codebook entries start..start+n-1 against vec[]
+  to e[0..n-1], n <= VQ_BLOCK.  w may be NULL for unit weights in the
+  VQ_WEIGHTED form.
+
+\*---------------------------------------------------------------------------*/
+
+void vq_errors(const float *cb, int k, int m, int start, int n, const float vec[], const float w[], int form, float e[]) {
+    int    i, j;
+    float  s, d;
+
+    assert(n <= VQ_BLOCK && start + n <= m);
+
+#if VQ_SEARCH_LANES > 1
+    const struct VQ_LAYOUT *l = (m < VQ_MIN_ENTRIES) ? NULL : vq_layout(cb, k, m);
+    if (l != NULL) {
+	vq_errors_simd(l, start, n, vec, w, form, e);
+	return;
+    }
+#endif
+
+    for(j=0; j<n; j++) {
+	const float *c = &cb[(start+j)*k];
+	s = 0.0;
+	if (form == VQ_WEIGHT_SQ) {
+	    for(i=0; i<k; i++) {
+		d = vec[i] - c[i];
+		s += w[i]*d*d;
+	    }
+	}
+	else if (w != NULL) {
+	    for(i=0; i<k; i++) {
+		d = (c[i] - vec[i])*w[i];
+		s += d*d;
+	    }
+	}
+	else {
+	    for(i=0; i<k; i++) {
+		d = c[i] - vec[i];
+		s += d*d;
+	    }
+	}
+	e[j] = s;
+    }
+}
+
+/*---------------------------------------------------------------------------*\
+
+  vq_nearest
+
+  Returns the index of the first codebook entry with the smallest
+  error below *beste, and updates *beste to its error.  Returns 0 and
+  leaves *beste alone if there is none.  Codebooks with a transposed
+  copy are scored VQ_BLOCK entries at a time, the rest (including the
+  small k=1 scalar LSP ones) in a single pass with no error buffer.
+
+\*---------------------------------------------------------------------------*/
+
+#ifdef VQ_SEARCH_UNITTEST
+static int  vq_reference;
+static long ref_nearest(const float *cb, int k, int m, const float vec[], const float w[], int form, float *beste);
+#endif
+
+long vq_nearest(const float *cb, int k, int m, const float vec[], const float w[], int form, float *beste) {
+    float  best = *beste;
+    long   besti = 0;
+    float  s, d;
+    int    i, j;
+
+#ifdef VQ_SEARCH_UNITTEST
+    if (vq_reference)
+	return ref_nearest(cb, k, m, vec, w, form, beste);
+#endif
+
+#if VQ_SEARCH_LANES > 1
+    const struct VQ_LAYOUT *l = (m < VQ_MIN_ENTRIES) ? NULL : vq_layout(cb, k, m);
+    if (l != NULL) {
+	float e[VQ_BLOCK];
+	int   start, n;
+
+	for(start=0; start<m; start+=VQ_BLOCK) {
+	    n = (m - start < VQ_BLOCK) ? m - start : VQ_BLOCK;
+	    vq_errors_simd(l, start, n, vec, w, form, e);
+	    for(j=0; j<n; j++)
+		if (e[j] < best) {
+		    best = e[j];
+		    besti = start + j;
+		}
+	}
+
+	*beste = best;
+	return besti;
+    }
+#endif
+
+    /* the form is tested once per search, not per entry */
+
+    if (form == VQ_WEIGHT_SQ) {
+	for(j=0; j<m; j++, cb+=k) {
+	    for(i=0, s=0.0; i<k; i++) {
+		d = vec[i] - cb[i];
+		s += w[i]*d*d;
+	    }
+	    if (s < best) {
+		best = s;
+		besti = j;
+	    }
+	}
+    }
+    else if (w != NULL) {
+	for(j=0; j<m; j++, cb+=k) {
+	    for(i=0, s=0.0; i<k; i++) {
+		d = (cb[i] - vec[i])*w[i];
+		s += d*d;
+	    }
+	    if (s < best) {
+		best = s;
+		besti = j;
+	    }
+	}
+    }
+    else {
+	for(j=0; j<m; j++, cb+=k) {
+	    for(i=0, s=0.0; i<k; i++) {
+		d = cb[i] - vec[i];
+		s += d*d;
+	    }
+	    if (s < best) {
+		best = s;
+		besti = j;
+	    }
+	}
+    }
+
+    *beste = best;
+    return besti;
+}
+
+#ifdef VQ_SEARCH_UNITTEST
+#include <stdio.h>
+#include <time.h>
+#include "codec2.h"
+
+#define ENC_FRAMES 200
+
+/* the loops vq_nearest() replaced, from quantise(), find_nearest()
+   and find_nearest_weighted().  Each was the body of its own function,
+   so it isn't inlined into the benchmark either. */
+
+static __attribute__((noinline)) long ref_nearest(const float *cb, int k, int m, const float vec[], const float w[], int form, float *beste) {
+    float  e, d, best = *beste;
+    long   besti = 0;
+    int    i, j;
+
+    for(j=0; j<m; j++) {
+	e = 0.0;
+	for(i=0; i<k; i++) {
+	    if (form == VQ_WEIGHT_SQ)
+		e += w[i]*(vec[i]-cb[j*k+i])*(vec[i]-cb[j*k+i]);
+	    else if (w != NULL) {
+		d = cb[j*k+i]-vec[i];
+		e += powf(d*w[i],2.0);
+	    }
+	    else
+		e += (vec[i]-cb[j*k+i])*(vec[i]-cb[j*k+i]);
+	}
+	if (e < best) {
+	    best = e;
+	    besti = j;
+	}
+    }
+    *beste = best;
+    return besti;
+}
+
+static double now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1E9 + t.tv_nsec;
+}
+
+static float uniform(void) {
+    return (float)rand()/RAND_MAX;
+}
+
+int main() {
+    const struct lsp_codebook *sets[] = {lsp_cb, lsp_cbd, lsp_cbjvm, ge_cb, mel_cb, lspmelvq_cb};
+    const char *names[] = {"lsp_cb", "lsp_cbd", "lsp_cbjvm", "ge_cb", "mel_cb", "lspmelvq_cb"};
+    const int   calls = 20000;
+    float       vec[32], w[32], e1, e2;
+    long        i1, i2, sink = 0;
+    double      t0, t1, t_ref, t_vq;
+    int         s, c, form, trial, rep, i, bad = 0;
+
+    vq_search_init();
+    printf("%d lanes\n", VQ_SEARCH_LANES);
+    for(s=0; s<(int)(sizeof(sets)/sizeof(sets[0])); s++) {
+	for(c=0; sets[s][c].cb != NULL; c++) {
+	    const struct lsp_codebook *cb = &sets[s][c];
+	    assert(cb->k <= 32);
+
+	    /* vectors near a random entry, so the nearest is not always the same */
+
+	    for(form=0; form<3; form++) {
+		for(trial=0; trial<1000; trial++) {
+		    int j = rand() % cb->m;
+		    for(i=0; i<cb->k; i++) {
+			vec[i] = cb->cb[j*cb->k+i] + (uniform() - 0.5)*(fabsf(cb->cb[j*cb->k+i]) + 1.0);
+			w[i] = 0.1 + uniform();
+		    }
+		    e1 = e2 = 1E32;
+		    i1 = vq_nearest(cb->cb, cb->k, cb->m, vec, form == 2 ? NULL : w, form == 1 ? VQ_WEIGHT_SQ : VQ_WEIGHTED, &e1);
+		    i2 = ref_nearest(cb->cb, cb->k, cb->m, vec, form == 2 ? NULL : w, form == 1 ? VQ_WEIGHT_SQ : VQ_WEIGHTED, &e2);
+		    if ((i1 != i2) || memcmp(&e1, &e2, sizeof(float)))
+			bad++;
+		}
+	    }
+
+	    /* time the weighted form, as used by quantise(), best of 5 */
+
+	    t_ref = t_vq = 1E32;
+	    for(rep=0; rep<5; rep++) {
+		t0 = now_ns();
+		for(trial=0; trial<calls; trial++) {
+		    e2 = 1E32;
+		    vec[0] += 1E-6;
+		    sink += ref_nearest(cb->cb, cb->k, cb->m, vec, w, VQ_WEIGHTED, &e2);
+		}
+		t1 = (now_ns() - t0)/calls;
+		if (t1 < t_ref)
+		    t_ref = t1;
+		t0 = now_ns();
+		for(trial=0; trial<calls; trial++) {
+		    e1 = 1E32;
+		    vec[0] += 1E-6;
+		    sink += vq_nearest(cb->cb, cb->k, cb->m, vec, w, VQ_WEIGHTED, &e1);
+		}
+		t1 = (now_ns() - t0)/calls;
+		if (t1 < t_vq)
+		    t_vq = t1;
+	    }
+	    printf("%-11s %d k %2d m %5d: loops %8.1f ns vq_nearest %8.1f ns %5.2fx\n",
+		   names[s], c, cb->k, cb->m, t_ref, t_vq, t_ref/t_vq);
+	}
+    }
+    printf("(%ld)\n", sink & 1);
+
+    /* whole encoder per frame, with the original loops and with vq_nearest() */
+
+    for(c=CODEC2_MODE_3200; c<=CODEC2_MODE_700B; c++) {
+	struct CODEC2 *c2 = codec2_create(c);
+	int            nsam = codec2_samples_per_frame(c2);
+	short          speech[ENC_FRAMES*320];
+	unsigned char  bits[8], bits_ref[8];
+	double         t[2] = {1E32, 1E32};
+
+	assert((c2 != NULL) && (nsam <= 320));
+	codec2_destroy(c2);
+
+	/* a vowel with a slowly moving pitch, plus noise */
+
+	for(i=0; i<ENC_FRAMES*nsam; i++)
+	    speech[i] = 3000.0*sinf(2.0*M_PI*(120.0 + 20.0*sinf(i*1E-3))*i/8000.0)
+		      + 1500.0*sinf(2.0*M_PI*700.0*i/8000.0) + 500.0*(uniform() - 0.5);
+
+	for(rep=0; rep<10; rep++) {
+	    vq_reference = rep & 1;
+	    c2 = codec2_create(c);
+	    t0 = now_ns();
+	    for(trial=0; trial<ENC_FRAMES; trial++)
+		codec2_encode(c2, vq_reference ? bits_ref : bits, &speech[trial*nsam]);
+	    t1 = (now_ns() - t0)/ENC_FRAMES/1E3;
+	    if (t1 < t[vq_reference])
+		t[vq_reference] = t1;
+	    codec2_destroy(c2);
+	}
+	vq_reference = 0;
+	if (memcmp(bits, bits_ref, (codec2_bits_per_frame(c2 = codec2_create(c)) + 7)/8))
+	    bad++;
+	codec2_destroy(c2);
+
+	printf("codec2_encode mode %d: loops %7.1f us/frame vq_nearest %7.1f us/frame %5.2fx\n",
+	       c, t[1], t[0], t[1]/t[0]);
+    }
+
+    if (bad) {
+	printf("Bad! %d searches differ\n", bad);
+	exit(1);
+    }
+    printf("Everything checks out\n");
+    return 0;
+}
+#endif
@@ -0,0 +1,56 @@
+/*---------------------------------------------------------------------------*\
+
+  FILE........: vq_search.h
+  DATE CREATED: Oct 2026
+
+  Codebook search kernels shared by the VQ quantisers, with SSE/AVX2 and
+  NEON versions that work on transposed copies of the codebooks.
+
+\*---------------------------------------------------------------------------*/
+
+/*
+  All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 2.1, as
+  published by the Free Software Foundation.  This program is
+  distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+  License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __VQ_SEARCH__
+#define __VQ_SEARCH__
+
+/* define VQ_SEARCH_SCALAR to force the portable C kernels */
+
+#if !defined(VQ_SEARCH_SCALAR) && defined(__AVX2__)
+#define VQ_SEARCH_AVX2
+#define VQ_SEARCH_LANES 8
+#elif !defined(VQ_SEARCH_SCALAR) && defined(__SSE2__)
+#define VQ_SEARCH_SSE
+#define VQ_SEARCH_LANES 4
+#elif !defined(VQ_SEARCH_SCALAR) && defined(__ARM_NEON)
+#define VQ_SEARCH_NEON
+#define VQ_SEARCH_LANES 4
+#else
+#define VQ_SEARCH_LANES 1
+#endif
+
+#define VQ_BLOCK 64          /* entries scored per call of vq_errors() */
+
+/* error forms, each matches the float operation order of the scalar
+   loops they replace so results are bit exact */
+
+#define VQ_WEIGHTED   0      /* sum ((cb-vec)*w)^2, quantise() and mbest_search() */
+#define VQ_WEIGHT_SQ  1      /* sum w*(vec-cb)^2, find_nearest_weighted()         */
+
+void vq_search_init(void);
+void vq_errors(const float *cb, int k, int m, int start, int n, const float vec[], const float w[], int form, float e[]);
+long vq_nearest(const float *cb, int k, int m, const float vec[], const float w[], int form, float *beste);
+
+#endif
@@ -14,6 +14,12 @@
 #include "float_cast.h"
 #include "common.h"
 
+#if defined (__SSE2__)
+#include <emmintrin.h>
+#elif defined (__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #define	SINC_MAGIC_MARKER	MAKE_MAGIC (' ', 's', 'i', 'n', 'c', ' ')
 
 /*========================================================================================
@@ -25,6 +31,9 @@
 #define	FP_ONE					((double) (((increment_t) 1) << SHIFT_BITS))
 #define	INV_FP_ONE				(1.0 / FP_ONE)
 
+/* Most filter phases for the fixed ratio polyphase path. */
+#define	SINC_POLY_MAX_PHASES	256
+
 /*========================================================================================
 */
 
@@ -33,7 +42,13 @@ typedef float	coeff_t ;
 
 #include "fastest_coeffs.h"
 #include "mid_qual_coeffs.h"
+/* The best quality table is large and not always shipped with the
+** library. Define DISABLE_SINC_BEST_CONVERTER to build without it, in
+** which case SRC_SINC_BEST_QUALITY fails with SRC_ERR_BAD_CONVERTER.
+*/
+#ifndef DISABLE_SINC_BEST_CONVERTER
 #include "high_qual_coeffs.h"
+#endif
 
 typedef struct
 {	int		sinc_magic_marker ;
@@ -53,6 +68,12 @@ typedef struct
 	/* Sure hope noone does more than 128 channels at once. */
 	double left_calc [128], right_calc [128] ;
 
+	/* Fixed ratio polyphase path, set up by sinc_poly_prepare (). One
+	** row of coefficients per phase, stored after the buffer.
+	*/
+	double	poly_ratio ;
+	int		poly_phases, poly_step, poly_left, poly_taps, poly_stride, poly_offset ;
+
 	/* C99 struct flexible array. */
 	float	buffer [] ;
 } SINC_FILTER ;
@@ -62,6 +83,7 @@ static int sinc_hex_vari_process (SRC_PRIVATE *psrc, SRC_DATA *data) ;
 static int sinc_quad_vari_process (SRC_PRIVATE *psrc, SRC_DATA *data) ;
 static int sinc_stereo_vari_process (SRC_PRIVATE *psrc, SRC_DATA *data) ;
 static int sinc_mono_vari_process (SRC_PRIVATE *psrc, SRC_DATA *data) ;
+static int sinc_mono_poly_process (SRC_PRIVATE *psrc, SRC_DATA *data) ;
 
 static int prepare_data (SINC_FILTER *filter, SRC_DATA *data, int half_filter_chan_len) WARN_UNUSED ;
 
@@ -158,7 +180,7 @@ sinc_set_converter (SRC_PRIVATE *psrc, int src_enum)
 	if (psrc->channels > ARRAY_LEN (temp_filter.left_calc))
 		return SRC_ERR_BAD_CHANNEL_COUNT ;
 	else if (psrc->channels == 1)
-	{	psrc->const_process = sinc_mono_vari_process ;
+	{	psrc->const_process = sinc_mono_poly_process ;
 		psrc->vari_process = sinc_mono_vari_process ;
 		}
 	else
@@ -195,11 +217,13 @@ sinc_set_converter (SRC_PRIVATE *psrc, int src_enum)
 				temp_filter.index_inc = slow_mid_qual_coeffs.increment ;
 				break ;
 
+#ifndef DISABLE_SINC_BEST_CONVERTER
 		case SRC_SINC_BEST_QUALITY :
 				temp_filter.coeffs = slow_high_qual_coeffs.coeffs ;
 				temp_filter.coeff_half_len = ARRAY_LEN (slow_high_qual_coeffs.coeffs) - 2 ;
 				temp_filter.index_inc = slow_high_qual_coeffs.increment ;
 				break ;
+#endif
 
 		default :
 				return SRC_ERR_BAD_CONVERTER ;
@@ -403,6 +427,246 @@ sinc_mono_vari_process (SRC_PRIVATE *psrc, SRC_DATA *data)
 	return SRC_ERR_NO_ERROR ;
 } /* sinc_mono_vari_process */
 
+/*========================================================================================
+**	Fixed ratio polyphase path. When the ratio is L/M with a small L the
+**	input position only ever takes L fractional values, so the
+**	interpolated filter for each can be worked out once, and each output
+**	is then one dot product.
+*/
+
+static inline void
+calc_coeffs_single (SINC_FILTER *filter, increment_t increment, increment_t start_filter_index, double scale, float * centre)
+{	double		fraction, icoeff ;
+	increment_t	filter_index, max_filter_index ;
+	int			data_index, coeff_count, indx ;
+
+	/* As calc_output_single (), but writing each coefficient at its
+	** offset from the centre sample instead of summing.
+	*/
+	max_filter_index = int_to_fp (filter->coeff_half_len) ;
+
+	filter_index = start_filter_index ;
+	coeff_count = (max_filter_index - filter_index) / increment ;
+	filter_index = filter_index + coeff_count * increment ;
+	data_index = - coeff_count ;
+
+	do
+	{	fraction = fp_to_double (filter_index) ;
+		indx = fp_to_int (filter_index) ;
+
+		icoeff = filter->coeffs [indx] + fraction * (filter->coeffs [indx + 1] - filter->coeffs [indx]) ;
+		centre [data_index] += scale * icoeff ;
+
+		filter_index -= increment ;
+		data_index = data_index + 1 ;
+		}
+	while (filter_index >= MAKE_INCREMENT_T (0)) ;
+
+	filter_index = increment - start_filter_index ;
+	coeff_count = (max_filter_index - filter_index) / increment ;
+	filter_index = filter_index + coeff_count * increment ;
+	data_index = 1 + coeff_count ;
+
+	do
+	{	fraction = fp_to_double (filter_index) ;
+		indx = fp_to_int (filter_index) ;
+
+		icoeff = filter->coeffs [indx] + fraction * (filter->coeffs [indx + 1] - filter->coeffs [indx]) ;
+		centre [data_index] += scale * icoeff ;
+
+		filter_index -= increment ;
+		data_index = data_index - 1 ;
+		}
+	while (filter_index > MAKE_INCREMENT_T (0)) ;
+} /* calc_coeffs_single */
+
+static inline float
+poly_dot (const float * coeffs, const float * data, int len)
+{	float	sum ;
+	int		k = 0 ;
+
+#if defined (__SSE2__)
+	__m128	acc0 = _mm_setzero_ps (), acc1 = _mm_setzero_ps () ;
+
+	for ( ; k + 8 <= len ; k += 8)
+	{	acc0 = _mm_add_ps (acc0, _mm_mul_ps (_mm_loadu_ps (coeffs + k), _mm_loadu_ps (data + k))) ;
+		acc1 = _mm_add_ps (acc1, _mm_mul_ps (_mm_loadu_ps (coeffs + k + 4), _mm_loadu_ps (data + k + 4))) ;
+		} ;
+	acc0 = _mm_add_ps (acc0, acc1) ;
+	acc0 = _mm_add_ps (acc0, _mm_movehl_ps (acc0, acc0)) ;
+	acc0 = _mm_add_ss (acc0, _mm_shuffle_ps (acc0, acc0, 1)) ;
+	sum = _mm_cvtss_f32 (acc0) ;
+#elif defined (__ARM_NEON)
+	float32x4_t	acc0 = vdupq_n_f32 (0.0f), acc1 = vdupq_n_f32 (0.0f) ;
+	float32x2_t	acc ;
+
+	for ( ; k + 8 <= len ; k += 8)
+	{	acc0 = vmlaq_f32 (acc0, vld1q_f32 (coeffs + k), vld1q_f32 (data + k)) ;
+		acc1 = vmlaq_f32 (acc1, vld1q_f32 (coeffs + k + 4), vld1q_f32 (data + k + 4)) ;
+		} ;
+	acc0 = vaddq_f32 (acc0, acc1) ;
+	acc = vadd_f32 (vget_low_f32 (acc0), vget_high_f32 (acc0)) ;
+	sum = vget_lane_f32 (vpadd_f32 (acc, acc), 0) ;
+#else
+	sum = 0.0f ;
+#endif
+
+	for ( ; k < len ; k++)
+		sum += coeffs [k] * data [k] ;
+
+	return sum ;
+} /* poly_dot */
+
+/* Builds the coefficient rows for src_ratio, growing the filter's
+** allocation to hold them, and returns the filter. Leaves poly_phases
+** at zero if the ratio has no short phase cycle.
+*/
+static SINC_FILTER *
+sinc_poly_prepare (SRC_PRIVATE *psrc, double src_ratio)
+{	SINC_FILTER *filter, *temp ;
+	double		step, float_increment, scale ;
+	increment_t	increment, start_filter_index, max_filter_index ;
+	int			phases, p, left, right, count, stride, offset ;
+
+	filter = (SINC_FILTER*) psrc->private_data ;
+	filter->poly_ratio = src_ratio ;
+	filter->poly_phases = 0 ;
+
+	/* Smallest number of outputs that steps a whole number of inputs. */
+	step = 1.0 / src_ratio ;
+	for (phases = 1 ; phases <= SINC_POLY_MAX_PHASES ; phases++)
+		if (fabs (step * phases - lrint (step * phases)) < 1e-9 * phases)
+			break ;
+
+	if (phases > SINC_POLY_MAX_PHASES)
+		return filter ;
+
+	float_increment = filter->index_inc * (src_ratio < 1.0 ? src_ratio : 1.0) ;
+	increment = double_to_fp (float_increment) ;
+	max_filter_index = int_to_fp (filter->coeff_half_len) ;
+	scale = float_increment / filter->index_inc ;
+
+	/* Widest reach either side of the centre sample over all phases. */
+	left = right = 0 ;
+	for (p = 0 ; p < phases ; p++)
+	{	start_filter_index = double_to_fp ((p / (double) phases) * float_increment) ;
+		count = (max_filter_index - start_filter_index) / increment ;
+		left = MAX (left, count) ;
+		count = (max_filter_index - (increment - start_filter_index)) / increment ;
+		right = MAX (right, count + 1) ;
+		} ;
+
+	/* Tables bigger than the buffer stop paying for themselves. */
+	stride = (left + 1 + right + 3) & ~3 ;
+	if (phases * stride > filter->b_len)
+		return filter ;
+
+	offset = (filter->b_len + filter->channels + 3) & ~3 ;
+	temp = realloc (filter, sizeof (SINC_FILTER) + sizeof (filter->buffer [0]) * (offset + phases * stride)) ;
+	if (temp == NULL)
+		return filter ;
+	psrc->private_data = filter = temp ;
+
+	memset (filter->buffer + offset, 0, phases * stride * sizeof (filter->buffer [0])) ;
+	for (p = 0 ; p < phases ; p++)
+	{	start_filter_index = double_to_fp ((p / (double) phases) * float_increment) ;
+		calc_coeffs_single (filter, increment, start_filter_index, scale, filter->buffer + offset + p * stride + left) ;
+		} ;
+
+	filter->poly_phases = phases ;
+	filter->poly_step = lrint (step * phases) ;
+	filter->poly_left = left ;
+	filter->poly_taps = left + 1 + right ;
+	filter->poly_stride = stride ;
+	filter->poly_offset = offset ;
+
+	return filter ;
+} /* sinc_poly_prepare */
+
+static int
+sinc_mono_poly_process (SRC_PRIVATE *psrc, SRC_DATA *data)
+{	SINC_FILTER *filter ;
+	double		src_ratio, count, terminate ;
+	int			half_filter_chan_len, samples_in_hand, phase ;
+
+	if (psrc->private_data == NULL)
+		return SRC_ERR_NO_PRIVATE ;
+
+	filter = (SINC_FILTER*) psrc->private_data ;
+
+	/* If there is not a problem, this will be optimised out. */
+	if (sizeof (filter->buffer [0]) != sizeof (data->data_in [0]))
+		return SRC_ERR_SIZE_INCOMPATIBILITY ;
+
+	src_ratio = psrc->last_ratio ;
+
+	if (is_bad_src_ratio (src_ratio))
+		return SRC_ERR_BAD_INTERNAL_STATE ;
+
+	if (filter->poly_ratio != src_ratio)
+		filter = sinc_poly_prepare (psrc, src_ratio) ;
+
+	/* Use the general path for ratios with no short phase cycle, or when
+	** a ratio change has left us between phases.
+	*/
+	phase = lrint (psrc->last_position * filter->poly_phases) ;
+	if (filter->poly_phases == 0 || fabs (psrc->last_position * filter->poly_phases - phase) > 1e-6)
+		return sinc_mono_vari_process (psrc, data) ;
+
+	filter->in_count = data->input_frames * filter->channels ;
+	filter->out_count = data->output_frames * filter->channels ;
+	filter->in_used = filter->out_gen = 0 ;
+
+	/* Maximum coefficients on either side of center point. */
+	count = (filter->coeff_half_len + 2.0) / filter->index_inc ;
+	if (src_ratio < 1.0)
+		count /= src_ratio ;
+	half_filter_chan_len = filter->channels * (lrint (count) + 1) ;
+
+	filter->b_current = (filter->b_current + phase / filter->poly_phases) % filter->b_len ;
+	phase %= filter->poly_phases ;
+
+	terminate = 1.0 / src_ratio + 1e-20 ;
+
+	/* Main processing loop. */
+	while (filter->out_gen < filter->out_count)
+	{
+		/* Need to reload buffer? */
+		samples_in_hand = (filter->b_end - filter->b_current + filter->b_len) % filter->b_len ;
+
+		if (samples_in_hand <= half_filter_chan_len)
+		{	if ((psrc->error = prepare_data (filter, data, half_filter_chan_len)) != 0)
+				return psrc->error ;
+
+			samples_in_hand = (filter->b_end - filter->b_current + filter->b_len) % filter->b_len ;
+			if (samples_in_hand <= half_filter_chan_len)
+				break ;
+			} ;
+
+		/* This is the termination condition. */
+		if (filter->b_real_end >= 0)
+		{	if (filter->b_current + phase / (double) filter->poly_phases + terminate > filter->b_real_end)
+				break ;
+			} ;
+
+		data->data_out [filter->out_gen] = poly_dot (filter->buffer + filter->poly_offset + phase * filter->poly_stride,
+										filter->buffer + filter->b_current - filter->poly_left, filter->poly_taps) ;
+		filter->out_gen ++ ;
+
+		/* Figure out the next index. */
+		phase += filter->poly_step ;
+		filter->b_current = (filter->b_current + phase / filter->poly_phases) % filter->b_len ;
+		phase %= filter->poly_phases ;
+		} ;
+
+	psrc->last_position = phase / (double) filter->poly_phases ;
+
+	data->input_frames_used = filter->in_used / filter->channels ;
+	data->output_frames_gen = filter->out_gen / filter->channels ;
+
+	return SRC_ERR_NO_ERROR ;
+} /* sinc_mono_poly_process */
+
 static inline void
 calc_output_stereo (SINC_FILTER *filter, increment_t increment, increment_t start_filter_index, double scale, float * output)
 {	double		fraction, left [2], right [2], icoeff ;
@@ -1189,3 +1453,148 @@ prepare_data (SINC_FILTER *filter, SRC_DATA *data, int half_filter_chan_len)
 } /* prepare_data */
 
 
+
+/*========================================================================================
+**	Benchmark of the polyphase path against the general path it replaced
+**	for mono constant ratio streams. Both converters are fed the same
+**	noise in 160 frame blocks, the output lengths must match and the
+**	samples agree to within SRC_SINC_BENCH_TOL. Build and run from src/
+**	(high_qual_coeffs.h is not in this tree) :
+**
+**		gcc -O2 -DSRC_SINC_BENCH -DDISABLE_SINC_BEST_CONVERTER \
+**			libsamplerate/samplerate.c libsamplerate/src_sinc.c \
+**			libsamplerate/src_linear.c libsamplerate/src_zoh.c -o src_sinc_bench -lm
+**		./src_sinc_bench
+*/
+
+#ifdef SRC_SINC_BENCH
+
+#include <time.h>
+
+#define	SRC_SINC_BENCH_FRAMES	480000
+#define	SRC_SINC_BENCH_BLOCK	160
+#define	SRC_SINC_BENCH_TOL		1e-6
+
+static double
+bench_now_ms (void)
+{	struct timespec ts ;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts) ;
+	return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6 ;
+} /* bench_now_ms */
+
+/* Converts all of in, returning the number of frames written to out or
+** -1 on error. If general is set the polyphase path is bypassed.
+*/
+static long
+bench_convert (int converter, int general, double src_ratio, const float * in, float * out, long out_len, double * ms)
+{	SRC_STATE	*state ;
+	SRC_DATA	data ;
+	long		in_pos = 0, out_pos = 0 ;
+	double		start ;
+	int			error ;
+
+	if ((state = src_new (converter, 1, &error)) == NULL)
+		return -1 ;
+	if (general)
+		((SRC_PRIVATE*) state)->const_process = sinc_mono_vari_process ;
+
+	memset (&data, 0, sizeof (data)) ;
+	data.src_ratio = src_ratio ;
+
+	start = bench_now_ms () ;
+	do
+	{	data.data_in = in + in_pos ;
+		data.input_frames = MIN (SRC_SINC_BENCH_BLOCK, SRC_SINC_BENCH_FRAMES - in_pos) ;
+		data.end_of_input = (in_pos + data.input_frames == SRC_SINC_BENCH_FRAMES) ;
+		data.data_out = out + out_pos ;
+		data.output_frames = out_len - out_pos ;
+
+		if ((error = src_process (state, &data)) != 0)
+		{	printf ("%s\n", src_strerror (error)) ;
+			src_delete (state) ;
+			return -1 ;
+			} ;
+
+		in_pos += data.input_frames_used ;
+		out_pos += data.output_frames_gen ;
+		}
+	while (! data.end_of_input || data.output_frames_gen > 0) ;
+	*ms = bench_now_ms () - start ;
+
+	src_delete (state) ;
+
+	return out_pos ;
+} /* bench_convert */
+
+int
+main (void)
+{	static const struct
+	{	const char	*name ;
+		double		src_ratio ;
+	} ratios [] =
+	{	{	"48k->8k", 8000.0 / 48000.0 },
+		{	"8k->48k", 48000.0 / 8000.0 },
+		{	"16k->8k", 8000.0 / 16000.0 },
+		{	"8k->16k", 16000.0 / 8000.0 },
+		{	"44.1k->48k", 48000.0 / 44100.0 },
+		} ;
+	static const int converters [] = { SRC_SINC_FASTEST, SRC_SINC_MEDIUM_QUALITY } ;
+
+	float		*in, *out_general, *out_poly ;
+	long		out_len, len_general, len_poly, k ;
+	double		ms_general, ms_poly, diff, worst = 0.0 ;
+	unsigned	seed = 1 ;
+	int			r, c, fails = 0 ;
+
+	out_len = 7 * SRC_SINC_BENCH_FRAMES ;
+	in = malloc (SRC_SINC_BENCH_FRAMES * sizeof (float)) ;
+	out_general = malloc (out_len * sizeof (float)) ;
+	out_poly = malloc (out_len * sizeof (float)) ;
+	if (in == NULL || out_general == NULL || out_poly == NULL)
+		return 1 ;
+
+	for (k = 0 ; k < SRC_SINC_BENCH_FRAMES ; k++)
+	{	seed = seed * 1664525 + 1013904223 ;
+		in [k] = 0.5 * ((seed >> 8) / (double) (1 << 24) - 0.5) ;
+		} ;
+
+	printf ("%-12s %-24s %10s %10s %10s\n", "ratio", "converter", "general ms", "poly ms", "max diff") ;
+	for (r = 0 ; r < ARRAY_LEN (ratios) ; r++)
+		for (c = 0 ; c < ARRAY_LEN (converters) ; c++)
+		{	len_general = bench_convert (converters [c], 1, ratios [r].src_ratio, in, out_general, out_len, &ms_general) ;
+			len_poly = bench_convert (converters [c], 0, ratios [r].src_ratio, in, out_poly, out_len, &ms_poly) ;
+
+			if (len_general < 0 || len_poly != len_general)
+			{	printf ("%-12s %-24s output length %ld, expected %ld\n", ratios [r].name,
+							src_get_name (converters [c]), len_poly, len_general) ;
+				fails ++ ;
+				continue ;
+				} ;
+
+			diff = 0.0 ;
+			for (k = 0 ; k < len_poly ; k++)
+				diff = MAX (diff, fabs (out_poly [k] - out_general [k])) ;
+			worst = MAX (worst, diff) ;
+			if (diff > SRC_SINC_BENCH_TOL)
+				fails ++ ;
+
+			printf ("%-12s %-24s %10.1f %10.1f %10.2e\n", ratios [r].name,
+						src_get_name (converters [c]), ms_general, ms_poly, diff) ;
+			} ;
+
+	free (in) ;
+	free (out_general) ;
+	free (out_poly) ;
+
+	printf ("worst difference %.2e\n", worst) ;
+	if (fails)
+	{	printf ("Bad!\n") ;
+		return 1 ;
+		} ;
+
+	printf ("Everything checks out\n") ;
+	return 0 ;
+} /* main */
+
+#endif
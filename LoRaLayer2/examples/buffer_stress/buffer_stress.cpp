@@ -0,0 +1,137 @@
+// Host-side stress test of packetBuffer, one producer and one consumer thread.
+// Build and run from the library root on Linux,
+//   g++ -O2 -DSIM -Isrc src/*.cpp examples/buffer_stress/buffer_stress.cpp -lpthread -o buffer_stress
+//   ./buffer_stress [packets]
+// The producer alternates write() and reserve()/commit(), the consumer
+// alternates read() and peek()/release(). Every packet carries its sequence
+// number and a fill pattern derived from it, so a torn, lost, repeated or
+// reordered entry is reported. Exits non-zero on any error.
+#include <LoRaLayer2.h>
+#include <thread>
+#include <chrono>
+
+static packetBuffer buffer;
+
+static size_t packetLength(uint32_t sequence)
+{
+    return sizeof(sequence) + sequence % (MAX_PACKET_SIZE - sizeof(sequence) + 1);
+}
+
+static void fillPacket(BufferEntry *entry, uint32_t sequence)
+{
+    entry->length = packetLength(sequence);
+    memcpy(entry->data, &sequence, sizeof(sequence));
+    for (size_t i = sizeof(sequence); i < entry->length; i++)
+    {
+        entry->data[i] = (char)(sequence * 31 + i);
+    }
+}
+
+// returns 0 if the entry holds packet sequence, intact
+static int checkPacket(const BufferEntry *entry, uint32_t sequence)
+{
+    uint32_t received;
+    if (entry->length != packetLength(sequence))
+    {
+        return -1;
+    }
+    memcpy(&received, entry->data, sizeof(received));
+    if (received != sequence)
+    {
+        return -1;
+    }
+    for (size_t i = sizeof(sequence); i < entry->length; i++)
+    {
+        if (entry->data[i] != (char)(sequence * 31 + i))
+        {
+            return -1;
+        }
+    }
+    // reserve() must hand out a cleared slot, nothing may be left past length
+    for (size_t i = entry->length; i < MAX_PACKET_SIZE; i++)
+    {
+        if (entry->data[i] != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void producer(uint32_t packets)
+{
+    for (uint32_t sequence = 0; sequence < packets; sequence++)
+    {
+        if (sequence & 1)
+        {
+            BufferEntry *entry;
+            while ((entry = buffer.reserve()) == NULL)
+            {
+                std::this_thread::yield();
+            }
+            fillPacket(entry, sequence);
+            buffer.commit();
+        }
+        else
+        {
+            BufferEntry entry;
+            fillPacket(&entry, sequence);
+            while (buffer.write(entry) == BUFFERSIZE)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+}
+
+static uint32_t consumer(uint32_t packets)
+{
+    uint32_t errors = 0;
+    for (uint32_t sequence = 0; sequence < packets; sequence++)
+    {
+        if (sequence & 2)
+        {
+            BufferEntry *entry;
+            while ((entry = buffer.peek()) == NULL)
+            {
+                std::this_thread::yield();
+            }
+            if (checkPacket(entry, sequence) != 0)
+            {
+                errors++;
+            }
+            buffer.release();
+        }
+        else
+        {
+            while (buffer.size() == 0)
+            {
+                std::this_thread::yield();
+            }
+            BufferEntry entry = buffer.read();
+            if (checkPacket(&entry, sequence) != 0)
+            {
+                errors++;
+            }
+        }
+    }
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t packets = (argc > 1) ? atol(argv[1]) : 1000000;
+    uint32_t errors = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumerThread([&]() { errors = consumer(packets); });
+    std::thread producerThread(producer, packets);
+    producerThread.join();
+    consumerThread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("packets: %u, errors: %u, left in buffer: %u\n", packets, errors, (unsigned)buffer.size());
+    printf("full waits: %u, high water: %u of %u\n", buffer.overflows(), (unsigned)buffer.highWater(), (unsigned)buffer.capacity());
+    printf("%.0f packets/s\n", packets / seconds);
+    return (errors == 0 && buffer.size() == 0) ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+// Host-side mesh simulation, runs many LL2 nodes in one process.
+// Build and run from the library root on Linux,
+//   g++ -DSIM -Isrc src/*.cpp examples/mesh_sim/mesh_sim.cpp -o mesh_sim
+//   ./mesh_sim [nodes] [seconds] [seed]
+#include <LoRaLayer2.h>
+#include <MeshSim.h>
+
+int main(int argc, char **argv)
+{
+    int nodes = (argc > 1) ? atoi(argv[1]) : 20;
+    long seconds = (argc > 2) ? atol(argv[2]) : 600;
+    uint32_t seed = (argc > 3) ? atoi(argv[3]) : 1;
+
+    MeshSimClass sim(nodes, seed);
+    for (int i = 0; i < nodes; i++)
+    {
+        char address[9];
+        sprintf(address, "%08x", 0xc0d30000 + i);
+        int n = sim.addNode(address);
+        // SF7 frames keep the channel load of the routing packets low enough to converge
+        sim.radio(n)->setSpreadingFactor(7);
+        sim.node(n)->setInterval(20000);
+        sim.node(n)->setDutyCycle(0.1);
+        sim.node(n)->setDeltaRouting(true);
+    }
+    // nodes scattered over a 4 x 4 km area with 2 km radio range and 5% frame loss,
+    // a few hops across; much denser or larger meshes lose too many routing packets
+    // to collisions to converge in a few minutes
+    sim.connectRandom(4000, 4000, 2000, 0.05);
+    sim.setTraffic(10000, 32);
+    sim.run(seconds * 1000);
+    sim.report(stdout);
+    return 0;
+}
@@ -0,0 +1,118 @@
+// Host-side benchmark of neighbor and routing table lookups.
+// Build and run from the library root on Linux,
+//   g++ -O2 -DSIM -Isrc src/*.cpp examples/table_bench/table_bench.cpp -o table_bench
+//   ./table_bench [rounds]
+// For 20, 100 and 255 nodes a hub node hears every other node in a star,
+// simulated with MeshSim over Layer1_Sim, with beacons staggered so its
+// tables fill with a route to each of them. It then times routeDistance() for every known address and
+// for as many unknown ones, next to a linear memcmp scan of the same
+// addresses, which is what each lookup cost before the tables were hashed.
+#include <LoRaLayer2.h>
+#include <MeshSim.h>
+#include <chrono>
+
+#define BEACON_SLOT 500 // ms between the first beacons of successive nodes
+
+static double elapsedNs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void bench(int nodes, long rounds)
+{
+    MeshSimClass sim(nodes, 1);
+    sim.setStartJitter(0);
+    uint32_t mac = 0xc0d3f00d;
+    for (int i = 0; i < nodes; i++)
+    {
+        // scattered addresses, like ones taken from wifi mac addresses
+        char address[9];
+        mac = mac * 1664525u + 1013904223u;
+        sprintf(address, "%08x", mac);
+        int n = sim.addNode(address);
+        // beacons one slot apart so the leaves do not collide at the hub
+        sim.node(n)->setInterval((nodes + 1) * BEACON_SLOT);
+        if (n > 0)
+        {
+            sim.setLinks(0, n, 0.0);
+        }
+        sim.run(BEACON_SLOT);
+    }
+    sim.run(3 * (nodes + 1) * BEACON_SLOT);
+
+    LL2Class *hub = sim.node(0);
+    // zero past the known addresses, as the unused slots of the old tables were
+    uint8_t *known = new uint8_t[MAX_TABLE_ENTRIES * ADDR_LENGTH]();
+    uint8_t *unknown = new uint8_t[nodes * ADDR_LENGTH];
+    int routes = 0;
+    for (int i = 1; i < nodes; i++)
+    {
+        memcpy(&known[routes * ADDR_LENGTH], sim.node(i)->localAddress(), ADDR_LENGTH);
+        if (hub->routeDistance(&known[routes * ADDR_LENGTH]) != 255)
+        {
+            routes++;
+        }
+    }
+    for (int i = 0; i < routes; i++)
+    {
+        memcpy(&unknown[i * ADDR_LENGTH], &known[i * ADDR_LENGTH], ADDR_LENGTH);
+        unknown[i * ADDR_LENGTH] ^= 0x5a;
+    }
+
+    // volatile sinks keep the lookups from being optimised away
+    volatile uint32_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < routes; i++)
+        {
+            sink += hub->routeDistance(&known[i * ADDR_LENGTH]);
+        }
+    }
+    double hit = elapsedNs(start) / ((double)rounds * routes);
+
+    start = std::chrono::steady_clock::now();
+    for (long r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < routes; i++)
+        {
+            sink += hub->routeDistance(&unknown[i * ADDR_LENGTH]);
+        }
+    }
+    double miss = elapsedNs(start) / ((double)rounds * routes);
+
+    // a lookup that misses walked every one of the MAX_TABLE_ENTRIES slots
+    start = std::chrono::steady_clock::now();
+    for (long r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < routes; i++)
+        {
+            int entry = -1;
+            for (int j = 0; j < MAX_TABLE_ENTRIES; j++)
+            {
+                if (memcmp(&unknown[i * ADDR_LENGTH], &known[j * ADDR_LENGTH], ADDR_LENGTH) == 0)
+                {
+                    entry = j;
+                }
+            }
+            sink += entry;
+        }
+    }
+    double linear = elapsedNs(start) / ((double)rounds * routes);
+
+    printf("nodes %3d: routes %3d, hashed hit %6.1f ns, hashed miss %6.1f ns, linear scan %7.1f ns\n",
+           nodes, routes, hit, miss, linear);
+    delete[] known;
+    delete[] unknown;
+}
+
+int main(int argc, char **argv)
+{
+    long rounds = (argc > 1) ? atol(argv[1]) : 20000;
+    const int sizes[] = { 20, 100, 255 };
+    for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        bench(sizes[i], rounds);
+    }
+    return 0;
+}
@@ -141,11 +141,17 @@ int Layer1Class::init(){
 
 // Transmit polling function
 int Layer1Class::transmit(){
-    BufferEntry entry = txBuffer->read();
-    if(entry.length != 0){
-        sendPacket(entry.data, entry.length);
+    // send straight out of the tx slot, no copy of the entry
+    BufferEntry *entry = txBuffer->peek();
+    if(entry == NULL){
+        return 0;
+    }
+    int length = entry->length;
+    if(length != 0){
+        sendPacket(entry->data, length);
     }
-    return entry.length;
+    txBuffer->release();
+    return length;
 }
 
 // Receive polling function
@@ -156,16 +162,19 @@ int Layer1Class::receive(){
         _enableInterrupt = false;
         _dioFlag = false;
         if (_packetSize > 0){
-            char data[MAX_PACKET_SIZE];
+            // read straight into a free rx slot, drop packet if buffer is full
+            BufferEntry *entry = rxBuffer->reserve();
+            char discard[MAX_PACKET_SIZE];
+            char *data = (entry != NULL) ? entry->data : discard;
             int len = 0;
-            while (LoRa.available()) {
+            while (LoRa.available() && len < MAX_PACKET_SIZE) {
                 data[len] = (char)LoRa.read();
                 len++;
             }
-            BufferEntry entry;
-            memcpy(&entry.data[0], &data[0], len);
-            entry.length = len;
-            rxBuffer->write(entry);
+            if (entry != NULL) {
+                entry->length = len;
+                rxBuffer->commit();
+            }
 
             #ifdef LL2_DEBUG
             Serial.printf("Layer1::receive(): data = ");
@@ -20,6 +20,12 @@ public:
     int resetPin();
     int DIOPin();
     int spreadingFactor();
+    float getBW(void){
+        return 125.0; // arduino-LoRa default bandwidth in kHz
+    }
+    uint8_t getCR(void){
+        return 5; // arduino-LoRa default coding rate 4/5
+    }
 
     // User configurable settings
     void setPins(int cs, int reset, int dio);
@@ -1,4 +1,6 @@
+#if !defined(ARDUINO_LORA) && !defined(SIM) && !defined(RL_SX1276)
 #define RL_SX1276
+#endif
 #ifdef RL_SX1276
 #include <Layer1_SX1276.h>
 Layer1Class::Layer1Class(SX1276 *lora, int mode, int cs, int reset, int dio, uint8_t sf, uint32_t frequency, int power, int loraInitialized, uint32_t spiFrequency, float bandwidth, uint8_t codingRate, uint8_t syncWord, uint8_t currentLimit, uint8_t preambleLength, uint8_t gain)
@@ -17,15 +19,16 @@ Layer1Class::Layer1Class(SX1276 *lora, int mode, int cs, int reset, int dio, uin
       _syncWord(syncWord),
       _currentLimit(currentLimit),
       _preambleLength(preambleLength),
-      _gain(gain)
+      _gain(gain),
+      _dioFlag(false),
+      _transmitFlag(false),
+      _enableInterrupt(true)
 {
   txBuffer = new packetBuffer();
   rxBuffer = new packetBuffer();
 };
 
-bool _dioFlag = false;
-bool _transmitFlag = false;
-bool _enableInterrupt = true;
+Layer1Class *Layer1Class::_instances[2] = {NULL, NULL};
 
 /* Public access to local variables
  */
@@ -80,7 +83,23 @@ int Layer1Class::sendPacket(char *data, size_t len)
   return ret;
 }
 
-// Receive packet callback
+// Receive packet callbacks
+void Layer1Class::setFlag0(void)
+{
+  if (_instances[0] != NULL)
+  {
+    _instances[0]->setFlag();
+  }
+}
+
+void Layer1Class::setFlag1(void)
+{
+  if (_instances[1] != NULL)
+  {
+    _instances[1]->setFlag();
+  }
+}
+
 void Layer1Class::setFlag(void)
 {
   // check if the interrupt is enabled
@@ -107,7 +126,14 @@ int Layer1Class::init()
     return _loraInitialized;
   }
 
-  _LoRa->setDio0Action(Layer1Class::setFlag);
+  // claim an interrupt handler, the first radio initialized gets setFlag0
+  int slot = (_instances[0] == NULL || _instances[0] == this) ? 0 : 1;
+  if (_instances[slot] != NULL && _instances[slot] != this)
+  {
+    return _loraInitialized;
+  }
+  _instances[slot] = this;
+  _LoRa->setDio0Action(slot == 0 ? Layer1Class::setFlag0 : Layer1Class::setFlag1);
 
   state = _LoRa->startReceive();
   if (state != RADIOLIB_ERR_NONE)
@@ -130,7 +156,13 @@ int Layer1Class::init()
 // Transmit polling function
 int Layer1Class::transmit()
 {
-  BufferEntry entry = txBuffer->read();
+  // send straight out of the tx slot, no copy of the entry
+  BufferEntry *slot = txBuffer->peek();
+  if (slot == NULL)
+  {
+    return 0;
+  }
+  BufferEntry &entry = *slot;
 
   if (entry.length > 0)
   {
@@ -150,7 +182,9 @@ int Layer1Class::transmit()
     // Serial.printf("Layer1::transmit(): entry.length: %d\r\n", entry.length);
     sendPacket(entry.data, entry.length);
   }
-  return entry.length;
+  int length = entry.length;
+  txBuffer->release();
+  return length;
 }
 
 // Receive polling function
@@ -175,19 +209,27 @@ int Layer1Class::receive()
       _enableInterrupt = false;
       _dioFlag = false;
       size_t len = _LoRa->getPacketLength();
-      byte data[len];
-      int state = _LoRa->readData(data, len);
+      // read straight into a free rx slot, no intermediate copy
+      BufferEntry *entry = rxBuffer->reserve();
+      int state = RADIOLIB_ERR_NONE;
+      if (entry == NULL || len > MAX_PACKET_SIZE)
+      {
+        // rx buffer full or packet too long, drop packet
+        state = RADIOLIB_ERR_PACKET_TOO_LONG;
+      }
+      else
+      {
+        state = _LoRa->readData((uint8_t *)entry->data, len);
+      }
       if (state == RADIOLIB_ERR_NONE)
       {
-        BufferEntry entry;
-        memcpy(&entry.data[0], &data[0], len); // copy data to buffer, excluding null terminator
-        entry.length = len;
-        rxBuffer->write(entry);
+        entry->length = len;
+        rxBuffer->commit();
 #ifdef LL2_DEBUG
         Serial.printf("Layer1::receive(): data = ");
         for (int i = 0; i < len; i++)
         {
-          Serial.printf("%c", data[i]);
+          Serial.printf("%c", entry->data[i]);
         }
         Serial.printf("\r\n");
 #endif
@@ -41,7 +41,11 @@ Layer1Class(SX1276 *lora, int mode, int cs, int reset, int dio, uint8_t sf, uint
 private:
     SX1276 *_LoRa;
     // Main private functions
-    static void setFlag(void);
+    // one DIO0 interrupt handler per radio, RadioLib takes plain function pointers
+    static void setFlag0(void);
+    static void setFlag1(void);
+    static Layer1Class *_instances[2];
+    void setFlag(void);
     int sendPacket(char *data, size_t len);
 
     // Local variables
@@ -60,6 +64,9 @@ private:
     uint8_t _currentLimit;
     uint8_t _preambleLength;
     uint8_t _gain;
+    volatile bool _dioFlag;
+    volatile bool _transmitFlag;
+    volatile bool _enableInterrupt;
 };
 
 #endif
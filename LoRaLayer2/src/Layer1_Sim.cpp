@@ -1,6 +1,7 @@
 #ifdef SIM
 #include <Layer1_Sim.h>
 #include <LoRaLayer2.h>
+#include <MeshSim.h>
 
 long _millis = 0;
 
@@ -10,6 +11,7 @@ Layer1Class::Layer1Class()
     _transmitting = 0;
     _timeDistortion = 1;
     _spreadingFactor = 9;
+    _sim = NULL;
     txBuffer = new packetBuffer();
     rxBuffer = new packetBuffer();
 }
@@ -49,6 +51,14 @@ int Layer1Class::nodeID(){
     return _nodeID;
 }
 
+void Layer1Class::setSpreadingFactor(uint8_t spreadingFactor){
+    _spreadingFactor = spreadingFactor;
+}
+
+void Layer1Class::attach(MeshSimClass *sim){
+    _sim = sim;
+}
+
 int Layer1Class::begin_packet(){
     if(_transmitting == 1){
         // transmission in progress, do not begin packet
@@ -89,6 +99,11 @@ int Layer1Class::sendPacket(char* data, uint8_t len) {
         fprintf(stderr, "Attempted to send packet larger than 256 bytes\n");
         return -1;
     }
+    if(_sim != NULL) {
+        // in-process simulation, the simulator delivers it to the other nodes
+        _sim->transmit(this, data, len);
+        return 0;
+    }
     packet[0] = len;
     memcpy(packet+1, data, len);
     while(written < len) {
@@ -111,11 +126,17 @@ int Layer1Class::sendPacket(char* data, uint8_t len) {
 }
 
 int Layer1Class::transmit(){
-    BufferEntry entry = txBuffer->read();
-    if(entry.length > 0){
-        sendPacket(entry.data, entry.length);
+    // send straight out of the tx slot, no copy of the entry
+    BufferEntry *entry = txBuffer->peek();
+    if(entry == NULL){
+        return 0;
+    }
+    int length = entry->length;
+    if(length > 0){
+        sendPacket(entry->data, length);
     }
-    return entry.length;
+    txBuffer->release();
+    return length;
 }
 
 int Layer1Class::receive(){
@@ -14,6 +14,8 @@
 
 extern long _millis; // this is a work around to replace arduino's millis() function
 
+class MeshSimClass;
+
 class Layer1Class {
 public:
     Layer1Class();
@@ -22,8 +24,17 @@ public:
     static int getTime();
     static void setTime(int millis);
     int spreadingFactor();
+    float getBW(void){
+        return 125.0; // simulated radio bandwidth in kHz
+    }
+    uint8_t getCR(void){
+        return 5; // simulated coding rate 4/5
+    }
     int setNodeID(int newID);
     int nodeID();
+    void setSpreadingFactor(uint8_t spreadingFactor);
+    // hand transmissions to an in-process MeshSimClass instead of stdout
+    void attach(MeshSimClass *sim);
 
     // Fifo buffers
     packetBuffer *txBuffer;
@@ -42,6 +53,7 @@ private:
     int _nodeID;
     float _timeDistortion;
     uint8_t _spreadingFactor;
+    MeshSimClass *_sim;
 
 };
 
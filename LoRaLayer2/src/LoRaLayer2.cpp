@@ -3,6 +3,7 @@
 uint8_t BROADCAST[ADDR_LENGTH] = {0xff, 0xff, 0xff, 0xff};
 uint8_t LOOPBACK[ADDR_LENGTH] = {0x00, 0x00, 0x00, 0x00};
 uint8_t ROUTING[ADDR_LENGTH] = {0xaf, 0xff, 0xff, 0xff};
+uint8_t ROUTING_COMPACT[ADDR_LENGTH] = {0xaf, 0xff, 0xff, 0xfe};
 
 /* LoRaLayer2 Class
  */
@@ -15,14 +16,43 @@ LL2Class::LL2Class(Layer1Class *lora_1, Layer1Class *lora_2)
       _routeEntry(0),
       _routingInterval(15000),
       _disableRoutingPackets(0),
-      _dutyInterval(0),
+      _deltaRouting(false),
+      _fullDumpInterval(DEFAULT_FULL_DUMP_INTERVAL),
+      _lastFullDumpTime(0),
+      _fullDumpEntry(-1),
       _dutyCycle(1),
+      _dutyWindow(DEFAULT_DUTY_WINDOW),
+      _radioCount(lora_2 == NULL ? 1 : 2),
+      _radioPolicy(RADIO_POLICY_LOAD),
+      _seenEntry(0),
+      _suppressedCount(0),
+      _fragmentMessageId(0),
+      _fragmentNack(false),
+      _compactRouting(false),
+      _compactActive(false),
       _lTime(0),
       _timestamp(0),
       _setTime(false),
       _setTimestamp(false)
 {
     rxBuffer = new packetBuffer;
+    routingBuffer = new packetBuffer;
+    memset(_neighborIndex, 0xff, sizeof(_neighborIndex));
+    memset(_routeIndex, 0xff, sizeof(_routeIndex));
+    memset(_routeChanged, 0, sizeof(_routeChanged));
+    memset(_seenTable, 0, sizeof(_seenTable));
+    memset(_neighborTable, 0, sizeof(_neighborTable));
+    memset(_routeAnnounced, 0, sizeof(_routeAnnounced));
+    memset(_routeDictionaries, 0, sizeof(_routeDictionaries));
+    memset(_radios, 0, sizeof(_radios));
+    _radios[0].layer1 = lora_1;
+    _radios[1].layer1 = lora_2;
+    for (int r = 0; r < MAX_RADIOS; r++)
+    {
+        _radios[r].dutyBudget = _dutyCycle * _dutyWindow;
+    }
+    _fragmentTx = NULL;
+    _fragmentRx = NULL;
 };
 
 /* Public access to local variables
@@ -42,6 +72,52 @@ int LL2Class::getRouteEntry()
     return _routeEntry;
 }
 
+// hops to destination, 255 if there is no usable route
+uint8_t LL2Class::routeDistance(const uint8_t destination[ADDR_LENGTH])
+{
+    int entry = findRoute(destination);
+    if (entry < 0)
+    {
+        return 255;
+    }
+    return _routeTable[entry].distance;
+}
+
+int LL2Class::txQueueDepth()
+{
+    int depth = routingBuffer->size();
+    for (int r = 0; r < _radioCount; r++)
+    {
+        depth += _radios[r].layer1->txBuffer->size();
+    }
+    return depth;
+}
+
+double LL2Class::txBudget(int radio)
+{
+    return _radios[radio].dutyBudget;
+}
+
+double LL2Class::airtimeUsed()
+{
+    double airtime = 0;
+    for (int r = 0; r < _radioCount; r++)
+    {
+        airtime += _radios[r].airtimeUsed;
+    }
+    return airtime;
+}
+
+int LL2Class::radioCount()
+{
+    return _radioCount;
+}
+
+uint32_t LL2Class::suppressedCount()
+{
+    return _suppressedCount;
+}
+
 /* General purpose utility functions
  */
 uint8_t LL2Class::hexDigit(char ch)
@@ -121,30 +197,125 @@ long LL2Class::setInterval(long interval)
 
 void LL2Class::setDutyCycle(double dutyCycle)
 {
+    // fraction of time the radio may transmit, e.g. 0.01 for 1%
     _dutyCycle = dutyCycle;
+    for (int r = 0; r < MAX_RADIOS; r++)
+    {
+        if (_radios[r].dutyBudget > _dutyCycle * _dutyWindow)
+        {
+            _radios[r].dutyBudget = _dutyCycle * _dutyWindow;
+        }
+    }
+}
+
+long LL2Class::setDutyWindow(long window)
+{
+    // longest period of unused airtime the scheduler may bank and burst out
+    _dutyWindow = window;
+    for (int r = 0; r < MAX_RADIOS; r++)
+    {
+        if (_radios[r].dutyBudget > _dutyCycle * _dutyWindow)
+        {
+            _radios[r].dutyBudget = _dutyCycle * _dutyWindow;
+        }
+    }
+    return _dutyWindow;
+}
+
+void LL2Class::setRadioPolicy(int policy)
+{
+    // only used when a second radio was given to the constructor
+    _radioPolicy = policy;
+}
+
+void LL2Class::setDeltaRouting(bool enable)
+{
+    // when enabled only changed routes are advertised every routing interval,
+    // the rest of the table follows in a full dump every _fullDumpInterval
+    _deltaRouting = enable;
+}
+
+long LL2Class::setFullDumpInterval(long interval)
+{
+    _fullDumpInterval = interval;
+    return _fullDumpInterval;
+}
+
+void LL2Class::setCompactRouting(bool enable)
+{
+    // older nodes see ROUTING_COMPACT packets as data for someone else, so
+    // they are only sent while every neighbor has said it understands them
+    _compactRouting = enable;
+}
+
+void LL2Class::setFragmentNack(bool enable)
+{
+    // when enabled receivers ask for missing fragments of unicast messages,
+    // and sent messages are kept FRAGMENT_HOLD_TIME to resend them
+    _fragmentNack = enable;
 }
 
 /* private wrappers for packetBuffers
  */
-int LL2Class::writeToBuffer(packetBuffer *buffer, Packet packet)
+int LL2Class::writeToBuffer(packetBuffer *buffer, const Packet &packet)
 {
-    BufferEntry entry;
-    memcpy(&entry, &packet, packet.totalLength);
-    entry.length = packet.totalLength;
-    return buffer->write(entry);
+    BufferEntry *entry = buffer->reserve();
+    if (entry == NULL)
+    {
+        // if full, return the size of the buffer
+        return BUFFERSIZE;
+    }
+    memcpy(entry->data, &packet, packet.totalLength);
+    entry->length = packet.totalLength;
+    return buffer->commit();
 }
 
 Packet LL2Class::readFromBuffer(packetBuffer *buffer)
 {
     Packet packet;
-    BufferEntry entry = buffer->read();
-    memcpy(&packet, &entry.data[0], sizeof(packet));
+    Packet *slot = peekBuffer(buffer);
+    if (slot == NULL)
+    {
+        // if buffer empty, return empty packet
+        buffer->release();
+        memset(&packet, 0, sizeof(packet));
+        return packet;
+    }
+    memcpy(&packet, slot, sizeof(packet));
+    buffer->release();
     return packet;
 }
 
+// borrow the packet at the front of a buffer, parsed in place over the slot
+Packet *LL2Class::peekBuffer(packetBuffer *buffer)
+{
+    BufferEntry *entry = buffer->peek();
+    if (entry == NULL || entry->length == 0)
+    {
+        return NULL;
+    }
+    return (Packet *)entry->data;
+}
+
+// build a packet directly into a free buffer slot, avoids a Packet temporary
+int LL2Class::buildToBuffer(packetBuffer *buffer, uint8_t ttl, const uint8_t nextHop[ADDR_LENGTH], const uint8_t source[ADDR_LENGTH], uint8_t hopCount, uint8_t metric, const Datagram &datagram, size_t length)
+{
+    BufferEntry *entry = buffer->reserve();
+    if (entry == NULL)
+    {
+        // if full, return the size of the buffer
+        return BUFFERSIZE;
+    }
+    buildPacket((Packet *)entry->data, ttl, nextHop, source, hopCount, metric, datagram, length);
+    entry->length = HEADER_LENGTH + length;
+    // the sequence is used up once the packet is queued
+    _messageCount++;
+    return buffer->commit();
+}
+
 /* Layer 3 tx/rx wrappers
  */
-int LL2Class::writeData(Datagram datagram, size_t length)
+int LL2Class::writeData(const Datagram &datagram, size_t length)
 {
 #ifdef LL2_DEBUG
     Serial.printf("LoRaLayer2::writeData(): datagram.message = ");
@@ -176,6 +347,128 @@ Packet LL2Class::readData()
     return packet;
 }
 
+Packet *LL2Class::peekData()
+{
+    return peekBuffer(rxBuffer);
+}
+
+void LL2Class::releaseData()
+{
+    rxBuffer->release();
+}
+
+// flood a broadcast read from readData() or peekData() on to my neighbors,
+// keeping its source and sequence so nodes that already have it drop the copy
+int LL2Class::relayData(const Packet &packet)
+{
+    if (memcmp(packet.receiver, BROADCAST, ADDR_LENGTH) != 0 || packet.ttl <= 1 ||
+        memcmp(packet.source, _localAddress, ADDR_LENGTH) == 0)
+    {
+        return -1;
+    }
+    uint8_t metric = 0;
+    int src_entry = selectRoute(packet.source);
+    if (src_entry >= 0)
+    {
+        metric = _routeTable[src_entry].metric;
+    }
+    packetBuffer *buffer = _radios[selectRadio(false)].layer1->txBuffer;
+    BufferEntry *entry = buffer->reserve();
+    if (entry == NULL)
+    {
+        // if full, return the size of the buffer
+        return BUFFERSIZE;
+    }
+    Packet *relay = (Packet *)entry->data;
+    buildPacket(relay, packet.ttl - 1, BROADCAST, packet.source, packet.hopCount + 1, metric, packet.datagram, packet.totalLength - HEADER_LENGTH);
+    relay->sequence = packet.sequence;
+    entry->length = packet.totalLength;
+    return buffer->commit();
+}
+
+// queue a message to be sent as fragments by the daemon,
+// returns the number of fragments or -1 if it is too long, another message is still being sent
+// or there is no memory for the send buffer
+int LL2Class::writeMessage(const uint8_t destination[ADDR_LENGTH], uint8_t type, const uint8_t *data, size_t length)
+{
+    if (length == 0 || length > MAX_MESSAGE_LENGTH || fragmentsPending() > 0)
+    {
+        return -1;
+    }
+    if (_fragmentTx == NULL)
+    {
+        _fragmentTx = (FragmentTxEntry *)malloc(sizeof(FragmentTxEntry));
+        if (_fragmentTx == NULL)
+        {
+            return -1;
+        }
+    }
+    // a message held only to answer NACKs is replaced
+    memcpy(_fragmentTx->destination, destination, ADDR_LENGTH);
+    _fragmentTx->messageId = _fragmentMessageId++;
+    _fragmentTx->count = (length + FRAGMENT_PAYLOAD - 1) / FRAGMENT_PAYLOAD;
+    _fragmentTx->type = type;
+    _fragmentTx->length = length;
+    _fragmentTx->lastActivity = Layer1Class::getTime();
+    _fragmentTx->lastSent = 0;
+    memset(_fragmentTx->pending, 0, sizeof(_fragmentTx->pending));
+    for (int i = 0; i < _fragmentTx->count; i++)
+    {
+        _fragmentTx->pending[i / 8] |= 1 << (i % 8);
+    }
+    memcpy(_fragmentTx->data, data, length);
+    _fragmentTx->active = true;
+    return _fragmentTx->count;
+}
+
+// copy out the next reassembled message, returns its length,
+// 0 if there is none or -1 if it does not fit in data
+int LL2Class::readMessage(uint8_t *data, size_t length, uint8_t source[ADDR_LENGTH], uint8_t *type)
+{
+    if (_fragmentRx == NULL)
+    {
+        return 0;
+    }
+    for (int i = 0; i < REASSEMBLY_SLOTS; i++)
+    {
+        FragmentRxEntry *entry = &_fragmentRx[i];
+        if (!entry->active || !entry->complete)
+        {
+            continue;
+        }
+        if (entry->length > length)
+        {
+            return -1;
+        }
+        memcpy(data, entry->data, entry->length);
+        if (source != NULL)
+        {
+            memcpy(source, entry->source, ADDR_LENGTH);
+        }
+        if (type != NULL)
+        {
+            *type = entry->type;
+        }
+        entry->active = false;
+        return entry->length;
+    }
+    return 0;
+}
+
+// number of fragments of the current message still to be sent
+int LL2Class::fragmentsPending()
+{
+    int pending = 0;
+    if (_fragmentTx != NULL && _fragmentTx->active)
+    {
+        for (int i = 0; i < _fragmentTx->count; i++)
+        {
+            pending += (_fragmentTx->pending[i / 8] >> (i % 8)) & 1;
+        }
+    }
+    return pending;
+}
+
 /* Print out functions, for convenience
  */
 void LL2Class::getNeighborTable(char *out)
@@ -243,18 +536,20 @@ void LL2Class::printPacketInfo(Packet packet)
 /* Routing utility functions
  */
 
-Packet LL2Class::buildPacket(uint8_t ttl, uint8_t nextHop[ADDR_LENGTH], uint8_t source[ADDR_LENGTH], uint8_t hopCount, uint8_t metric, Datagram datagram, size_t length)
+void LL2Class::buildPacket(Packet *packet, uint8_t ttl, const uint8_t nextHop[ADDR_LENGTH], const uint8_t source[ADDR_LENGTH], uint8_t hopCount, uint8_t metric, const Datagram &datagram, size_t length)
 {
-    uint8_t totalLength = HEADER_LENGTH + length;
-    Packet packet = {ttl, totalLength};
-    memcpy(packet.sender, _localAddress, ADDR_LENGTH);
-    memcpy(packet.receiver, nextHop, ADDR_LENGTH);
-    packet.sequence = messageCount();
-    memcpy(packet.source, source, ADDR_LENGTH);
-    packet.hopCount = hopCount;
-    packet.metric = metric;
-    memcpy(&packet.datagram, &datagram, length);
-    return packet;
+    packet->ttl = ttl;
+    packet->totalLength = HEADER_LENGTH + length;
+    memcpy(packet->sender, _localAddress, ADDR_LENGTH);
+    memcpy(packet->receiver, nextHop, ADDR_LENGTH);
+    packet->sequence = messageCount();
+    memmove(packet->source, source, ADDR_LENGTH);
+    packet->hopCount = hopCount;
+    packet->metric = metric;
+    if (&packet->datagram != &datagram)
+    {
+        memcpy(&packet->datagram, &datagram, length);
+    }
 }
 
 void LL2Class::setTimeFlag(bool flag){
@@ -284,61 +579,98 @@ uint64_t LL2Class::getTimestamp(uint32_t cTime)
     return 0;
 }
 
-Packet LL2Class::buildRoutingPacket()
+Packet LL2Class::buildRoutingPacket(bool fullDump)
 {
     uint8_t data[DATA_LENGTH];
     int dataLength = 0;
     if (_setTimestamp)
     {
         dataLength = 8;
-        time_stamp.time_ = getTimestamp(millis());
+        time_stamp.time_ = getTimestamp(Layer1Class::getTime());
         //  Add time stamp to every routing Packet
         memcpy(data, time_stamp.timeArr, 8);
     }
-    int routesPerPacket = _routeEntry;
-    //TODO add the entire routing table into N routing packets
-    if (_routeEntry >= MAX_ROUTES_PER_PACKET - 1)
+    bool compact = compactRoutingActive();
+    if (compact && !_compactActive)
     {
-        routesPerPacket = MAX_ROUTES_PER_PACKET - 1;
+        // neighbors may not have learned short ids while full packets were sent
+        memset(_routeAnnounced, 0, sizeof(_routeAnnounced));
     }
-    for (int i = 0; i < routesPerPacket; i++)
+    _compactActive = compact;
+    // compact packets may mix 5 and 11 byte routes, stop short of wrapping totalLength
+    int maxLength = compact ? DATA_LENGTH - 1 : DATA_LENGTH;
+    long now = Layer1Class::getTime();
+    // next slice of a full dump in progress goes first, then changed routes
+    for (int pass = 0; pass < 2; pass++)
     {
-        for (int j = 0; j < ADDR_LENGTH; j++)
+        int i = 0;
+        if (pass == 0)
         {
-            data[dataLength] = _routeTable[i].destination[j];
-            dataLength++;
+            if (!fullDump || _fullDumpEntry < 0)
+            {
+                continue;
+            }
+            i = _fullDumpEntry;
         }
-        data[dataLength] = _routeTable[i].distance;
-        dataLength++;
-        data[dataLength] = _routeTable[i].metric;
-        dataLength++;
-        for (int j = 0; j < ADDR_LENGTH; j++)
+        for (; i < _routeEntry; i++)
         {
-            data[dataLength] = _routeTable[i].nextHop[j];
-            dataLength++;
+            if (pass == 1 && !_routeChanged[i])
+            {
+                continue;
+            }
+            uint8_t route[COMPACT_FULL_ROUTE_LENGTH];
+            int length = encodeRoute(route, i, now, compact);
+            if (dataLength + length > maxLength)
+            {
+                break;
+            }
+            memcpy(data + dataLength, route, length);
+            dataLength += length;
+            if (compact && length == COMPACT_FULL_ROUTE_LENGTH)
+            {
+                _routeAnnounced[i] = (now != 0) ? now : 1;
+            }
+            _routeChanged[i] = false;
+        }
+        if (pass == 0)
+        {
+            // full dump is done once it reaches the end of the table
+            _fullDumpEntry = (i < _routeEntry) ? i : -1;
         }
     }
-    uint8_t nextHop[ADDR_LENGTH] = {0xaf, 0xff, 0xff, 0xff};
     // copy raw data into datagram to create packet
     Datagram datagram; //= { 0xaf, 0xff, 0xff, 0xff, 'r' };
     memcpy(&datagram, &data, dataLength);
 
-    Packet packet = buildPacket(1, nextHop, localAddress(), 0, 0, datagram, dataLength);
+    Packet packet = {};
+    // the metric of a routing packet is unused, it carries the capability bits
+    buildPacket(&packet, 1, compact ? ROUTING_COMPACT : ROUTING, localAddress(), 0, ROUTING_CAP_COMPACT, datagram, dataLength);
     return packet;
 }
 
 Packet LL2Class::buildRoutingWithServiceGradePacket()
+{
+    int nextEntry = 0;
+    return buildRoutingWithServiceGradePacket(nextEntry);
+}
+
+// builds the grades of up to MAX_GRADES_PER_PACKET routes starting at nextEntry,
+// nextEntry is advanced to the first route left out, or wraps to 0 when done
+Packet LL2Class::buildRoutingWithServiceGradePacket(int &nextEntry)
 {
     uint8_t data[DATA_LENGTH];
     int dataLength = 0;
-    
-    int routesPerPacket = _routeEntry;
-    //TODO add the entire routing table into N routing packets
-    if (_routeEntry > 46)
+
+    if (nextEntry < 0 || nextEntry >= _routeEntry)
+    {
+        nextEntry = 0;
+    }
+    int routesPerPacket = _routeEntry - nextEntry;
+    if (routesPerPacket > MAX_GRADES_PER_PACKET)
     {
-        routesPerPacket = 46;
+        routesPerPacket = MAX_GRADES_PER_PACKET;
     }
-    for (int i = 0; i < routesPerPacket; i++)
+    for (int i = nextEntry; i < nextEntry + routesPerPacket; i++)
     {
         for (int j = 0; j < ADDR_LENGTH; j++)
         {
@@ -369,7 +701,9 @@ Packet LL2Class::buildRoutingWithServiceGradePacket()
     memcpy(&datagram.message, &data, dataLength);
     memcpy(&datagram.destination, &nextHop, ADDR_LENGTH);
 
-    Packet packet = buildPacket(1, nextHop, localAddress(), 0, 0, datagram, dataLength + 5);
+    Packet packet = {};
+    buildPacket(&packet, 1, nextHop, localAddress(), 0, 0, datagram, dataLength + 5);
+    nextEntry = (nextEntry + routesPerPacket < _routeEntry) ? nextEntry + routesPerPacket : 0;
     
     // Serial.println("data[i]");
     // for (int i = 0; i< dataLength ; i++) {
@@ -397,6 +731,103 @@ double calculateAirtime(double length, double spreadingFactor, double explicitHe
     return timePerPayload;
 }
 
+/* Transmit scheduler
+ */
+// airtime in ms of a frame of the given length with the current radio settings
+double LL2Class::packetAirtime(Layer1Class *layer1, size_t length)
+{
+    double spreadingFactor = (double)layer1->spreadingFactor();
+    double bandwidth = (double)layer1->getBW();
+    // low data rate optimization is on when a symbol lasts longer than 16ms
+    double lowDR = (pow(2, spreadingFactor) / bandwidth > 16) ? 1 : 0;
+    return calculateAirtime((double)length, spreadingFactor, 1, lowDR, layer1->getCR(), bandwidth);
+}
+
+// pick the radio an outgoing packet is queued on
+int LL2Class::selectRadio(bool routing)
+{
+    if (_radioCount < 2)
+    {
+        return 0;
+    }
+    if (_radioPolicy == RADIO_POLICY_CLASS)
+    {
+        return routing ? 1 : 0;
+    }
+    // least loaded radio, fewest queued packets then most airtime budget left
+    int depth0 = _radios[0].layer1->txBuffer->size();
+    int depth1 = _radios[1].layer1->txBuffer->size();
+    if (depth0 != depth1)
+    {
+        return (depth0 < depth1) ? 0 : 1;
+    }
+    return (_radios[0].dutyBudget >= _radios[1].dutyBudget) ? 0 : 1;
+}
+
+// token bucket, every frame is charged its airtime against a budget that
+// refills at _dutyCycle ms per ms up to _dutyWindow worth of airtime,
+// each radio has its own budget so one transmitting never holds up the other
+int LL2Class::transmit(int radio)
+{
+    RadioState *state = &_radios[radio];
+    Layer1Class *layer1 = state->layer1;
+    long now = Layer1Class::getTime();
+    double capacity = _dutyCycle * _dutyWindow;
+    state->dutyBudget += (now - state->lastBudgetTime) * _dutyCycle;
+    if (state->dutyBudget > capacity)
+    {
+        state->dutyBudget = capacity;
+    }
+    state->lastBudgetTime = now;
+
+    if (now - state->lastTransmitTime <= state->dutyInterval)
+    {
+        // radio is still sending the last frame
+        return 0;
+    }
+
+    // data packets waiting in Layer1 go first, routing packets only when there are none
+    BufferEntry *entry = layer1->txBuffer->peek();
+    packetBuffer *queue = layer1->txBuffer;
+    if (entry == NULL && (_radioCount < 2 || _radioPolicy != RADIO_POLICY_CLASS || radio == 1))
+    {
+        entry = routingBuffer->peek();
+        queue = routingBuffer;
+    }
+    if (entry == NULL)
+    {
+        return 0;
+    }
+    double airtime = packetAirtime(layer1, entry->length);
+    // a full bucket may always send, even a frame longer than the whole budget
+    if (airtime > state->dutyBudget && state->dutyBudget < capacity)
+    {
+        return 0;
+    }
+    if (queue == routingBuffer)
+    {
+        layer1->txBuffer->write(*entry);
+        routingBuffer->release();
+    }
+
+    int length = layer1->transmit();
+    if (length > 0)
+    {
+#ifdef LL2_DEBUG
+        Serial.printf("LL2::transmit(): transmitted packet of length: %d on radio %d\r\n", length, radio);
+#endif
+        airtime = packetAirtime(layer1, length);
+        state->lastTransmitTime = now;
+        state->dutyInterval = (int)ceil(airtime);
+        state->dutyBudget -= airtime;
+        state->airtimeUsed += airtime;
+#ifdef LL2_DEBUG
+        Serial.printf("airtime = %f\n dutyBudget = %f\n", airtime, state->dutyBudget);
+#endif
+    }
+    return length;
+}
+
 uint8_t LL2Class::calculatePacketLoss(int entry, uint8_t sequence)
 {
     uint8_t packet_loss = 0xFF;
@@ -418,6 +849,12 @@ uint8_t LL2Class::calculatePacketLoss(int entry, uint8_t sequence)
         // decrease packet success rate by difference
         packet_loss = 0x10 * sequence_diff;
     }
+    else if (sequence_diff > 0xf0)
+    {
+        // queued before the last packet heard but sent after it,
+        // e.g. a routing packet that waited for data to go first
+        packet_loss = 0x00;
+    }
     // no packet received recently
     // assume complete packet loss
     return packet_loss;
@@ -431,70 +868,108 @@ uint8_t LL2Class::calculateMetric(int entry)
     return metric;
 }
 
-int LL2Class::checkNeighborTable(NeighborTableEntry neighbor)
+/* Hash index utility functions
+ * Table entries never move once added, so each index slot holds the position
+ * of an entry in _neighborTable or _routeTable, probed linearly on collision.
+ */
+uint16_t LL2Class::hashAddress(const uint8_t address[ADDR_LENGTH])
 {
-    int entry = _neighborEntry;
-    for (int i = 0; i < _neighborEntry; i++)
+    uint32_t key = ((uint32_t)address[0] << 24) | ((uint32_t)address[1] << 16) | ((uint32_t)address[2] << 8) | (uint32_t)address[3];
+    // multiplicative hash, keep the top bits
+    return (uint16_t)((key * 2654435761u) >> (32 - TABLE_INDEX_BITS));
+}
+
+int LL2Class::findNeighbor(const uint8_t address[ADDR_LENGTH])
+{
+    uint16_t slot = hashAddress(address);
+    while (_neighborIndex[slot] >= 0)
     {
-        // had to use memcmp instead of strcmp?
-        if (memcmp(neighbor.address, _neighborTable[i].address, sizeof(neighbor.address)) == 0)
+        if (memcmp(address, _neighborTable[_neighborIndex[slot]].address, ADDR_LENGTH) == 0)
         {
-            entry = i;
+            return _neighborIndex[slot];
         }
+        slot = (slot + 1) & (TABLE_INDEX_SIZE - 1);
     }
-    return entry;
+    return -1;
 }
 
-int LL2Class::checkRoutingTable(RoutingTableEntry route)
+int LL2Class::findRoute(const uint8_t destination[ADDR_LENGTH])
 {
-    int entry = _routeEntry; // assume this is a new route
-    for (int i = 0; i < _routeEntry; i++)
+    uint16_t slot = hashAddress(destination);
+    while (_routeIndex[slot] >= 0)
     {
-        if (memcmp(route.destination, localAddress(), sizeof(route.destination)) == 0)
+        if (memcmp(destination, _routeTable[_routeIndex[slot]].destination, ADDR_LENGTH) == 0)
         {
-            // this is me don't add to routing table
-            entry = -1;
-            return entry;
-        }
-        else if (memcmp(route.destination, _routeTable[i].destination, sizeof(route.destination)) == 0)
-        {
-            if (memcmp(route.nextHop, _routeTable[i].nextHop, sizeof(route.nextHop)) == 0)
-            {
-                // already have this exact route, update metric
-                entry = i;
-                return entry;
-            }
-            else
-            {
-                // already have this destination, but via a different neighbor
-                if (route.distance < _routeTable[i].distance)
-                { // TODO: this assumes shortest route is best, which may not be true.
-                    // replace route if distance is better
-                    entry = i;
-                }
-                else if (route.distance == _routeTable[i].distance)
-                {
-                    if (route.metric > _routeTable[i].metric)
-                    {
-                        // replace route if distance is equal and metric is better
-                        entry = i;
-                    }
-                    else
-                    {
-                        entry = -1;
-                    }
-                }
-                else
-                {
-                    // ignore route if distance and metric are worse
-                    entry = -1;
-                }
-                return entry;
-            }
+            return _routeIndex[slot];
         }
+        slot = (slot + 1) & (TABLE_INDEX_SIZE - 1);
+    }
+    return -1;
+}
+
+void LL2Class::indexNeighbor(int entry)
+{
+    uint16_t slot = hashAddress(_neighborTable[entry].address);
+    while (_neighborIndex[slot] >= 0)
+    {
+        slot = (slot + 1) & (TABLE_INDEX_SIZE - 1);
+    }
+    _neighborIndex[slot] = entry;
+}
+
+void LL2Class::indexRoute(int entry)
+{
+    uint16_t slot = hashAddress(_routeTable[entry].destination);
+    while (_routeIndex[slot] >= 0)
+    {
+        slot = (slot + 1) & (TABLE_INDEX_SIZE - 1);
+    }
+    _routeIndex[slot] = entry;
+}
+
+int LL2Class::checkNeighborTable(NeighborTableEntry neighbor)
+{
+    int entry = findNeighbor(neighbor.address);
+    if (entry < 0)
+    {
+        // this is a new neighbor
+        entry = _neighborEntry;
     }
     return entry;
 }
+
+int LL2Class::checkRoutingTable(RoutingTableEntry route)
+{
+    if (memcmp(route.destination, localAddress(), sizeof(route.destination)) == 0)
+    {
+        // this is me don't add to routing table
+        return -1;
+    }
+    int entry = findRoute(route.destination);
+    if (entry < 0)
+    {
+        // this is a new route
+        return _routeEntry;
+    }
+    if (memcmp(route.nextHop, _routeTable[entry].nextHop, sizeof(route.nextHop)) == 0)
+    {
+        // already have this exact route, update metric
+        return entry;
+    }
+    // already have this destination, but via a different neighbor
+    if (route.distance < _routeTable[entry].distance)
+    { // TODO: this assumes shortest route is best, which may not be true.
+        // replace route if distance is better
+        return entry;
+    }
+    else if (route.distance == _routeTable[entry].distance && route.metric > _routeTable[entry].metric)
+    {
+        // replace route if distance is equal and metric is better
+        return entry;
+    }
+    // ignore route if distance and metric are worse
+    return -1;
+}
 void LL2Class::clearNeigbourRoutingTables(void)
 {
     // // NeighborTableEntry _neighborTable1[255];
@@ -518,6 +993,7 @@ void LL2Class::clearNeigbourRoutingTables(void)
         _routeTable[i].distance = 255;
         _routeTable[i].metric = 0;
         _routeTable[i].lastReceived = 0;
+        _routeChanged[i] = true;
     }
 
     //TODO update 
@@ -535,12 +1011,18 @@ void LL2Class::clearNeigbourRoutingTables(void)
 }
 int LL2Class::updateNeighborTable(NeighborTableEntry neighbor, int entry)
 {
+    if (entry < 0 || entry >= MAX_TABLE_ENTRIES)
+    {
+        // neighbor table is full
+        return -1;
+    }
     // copy neighbor into specified entry in neighbor table
     memcpy(&_neighborTable[entry], &neighbor, sizeof(_neighborTable[entry]));
     if (entry == _neighborEntry)
     {
         // if specified entry is the same as current count of neighbors
-        // this is a new neighbor, increment neighbor count
+        // this is a new neighbor, index it and increment neighbor count
+        indexNeighbor(entry);
         _neighborEntry++;
     }
     // else neighbor is just updated
@@ -549,43 +1031,70 @@ int LL2Class::updateNeighborTable(NeighborTableEntry neighbor, int entry)
 
 int LL2Class::updateRouteTable(RoutingTableEntry route, int entry)
 {
+    if (entry < 0 || entry >= MAX_TABLE_ENTRIES)
+    {
+        // routing table is full
+        return -1;
+    }
+    if (entry == _routeEntry ||
+        route.distance != _routeTable[entry].distance ||
+        route.metric != _routeTable[entry].metric ||
+        memcmp(route.nextHop, _routeTable[entry].nextHop, ADDR_LENGTH) != 0)
+    {
+        // advertise this route in the next delta routing packet
+        _routeChanged[entry] = true;
+    }
     // copy route into specified entry in routing table
     memcpy(&_routeTable[entry], &route, sizeof(_routeTable[entry]));
     if (entry == _routeEntry)
     {
         // if specified entry is the same as current count of routes
-        // this is a new route, increment route count
+        // this is a new route, index it and increment route count
+        indexRoute(entry);
         _routeEntry++;
     }
     // else route is just updated
     return entry;
 }
 
-int LL2Class::selectRoute(uint8_t destination[ADDR_LENGTH])
+int LL2Class::selectRoute(const uint8_t destination[ADDR_LENGTH])
 {
-    int entry = -1;
-    for (int i = 0; i < _routeEntry; i++)
-    {
-        if (memcmp(destination, _routeTable[i].destination, ADDR_LENGTH) == 0)
-        {
-            entry = i;
-        }
-    }
-    return entry;
+    return findRoute(destination);
 }
 
-int LL2Class::parseNeighbor(Packet packet)
+int LL2Class::parseNeighbor(const Packet &packet)
 {
     // Create neighbor table entry with sender address
     NeighborTableEntry neighbor;
     memcpy(neighbor.address, packet.sender, sizeof(neighbor.address));
     // Find neighbor table entry for sender
     int n_entry = checkNeighborTable(neighbor);
-    // Calculate packet loss to find metric of link
-    uint8_t packet_loss = calculatePacketLoss(n_entry, packet.sequence);
+    // a relayed broadcast carries the sequence of its source, not of the sender
+    bool relayed = memcmp(packet.receiver, BROADCAST, ADDR_LENGTH) == 0 &&
+                   memcmp(packet.sender, packet.source, ADDR_LENGTH) != 0;
+    uint8_t packet_loss = 0;
+    neighbor.lastReceived = _neighborTable[n_entry].lastReceived;
+    if (!relayed || n_entry == _neighborEntry)
+    {
+        // Calculate packet loss to find metric of link
+        packet_loss = calculatePacketLoss(n_entry, packet.sequence);
+        if ((uint8_t)(packet.sequence - _neighborTable[n_entry].lastReceived) <= 0xf0)
+        {
+            neighbor.lastReceived = packet.sequence;
+        }
+    }
     neighbor.packet_success = _neighborTable[n_entry].packet_success - packet_loss;
-    neighbor.lastReceived = packet.sequence;
     neighbor.metric = calculateMetric(n_entry);
+    neighbor.capabilities = _neighborTable[n_entry].capabilities;
+    if (memcmp(packet.receiver, ROUTING, ADDR_LENGTH) == 0)
+    {
+        // older nodes send 0
+        neighbor.capabilities = packet.metric;
+    }
+    else if (memcmp(packet.receiver, ROUTING_COMPACT, ADDR_LENGTH) == 0)
+    {
+        neighbor.capabilities |= ROUTING_CAP_COMPACT;
+    }
     // update neighbor table with neighbor entry
     updateNeighborTable(neighbor, n_entry);
     // update routing table with neighbor entry also
@@ -602,86 +1111,510 @@ int LL2Class::parseNeighbor(Packet packet)
     return n_entry;
 }
 
-int LL2Class::parseRoutingTable(Packet packet, int n_entry)
+int LL2Class::parseRoutingTable(const Packet &packet, int n_entry)
 {
-    int entry = -1;
     int numberOfRoutes = (packet.totalLength - HEADER_LENGTH) / (2 * ADDR_LENGTH + 2);
-    uint8_t data[packet.totalLength - HEADER_LENGTH];
-    memcpy(data, &packet.datagram, sizeof(data));
+    // routes are read in place from the datagram
+    const uint8_t *data = (const uint8_t *)&packet.datagram;
     if (_setTimestamp)
     {
         numberOfRoutes = (packet.totalLength - HEADER_LENGTH - 8) / (2 * ADDR_LENGTH + 2);
-        memcpy(data, 8 + &packet.datagram,sizeof(data) - 8);
+        data += 8;
     }
     
     for (int i = 0; i < numberOfRoutes; i++)
     {
-        RoutingTableEntry route;
-        NeighborTableEntry neighbor;
+        const uint8_t *route = data + (2 * ADDR_LENGTH + 2) * i;
+        bool viaMe = memcmp(_localAddress, route + ADDR_LENGTH + 2, ADDR_LENGTH) == 0;
+        parseRoute(packet, n_entry, route, route[ADDR_LENGTH], route[ADDR_LENGTH + 1], viaMe);
+    }
+    return numberOfRoutes;
+}
+
+// update the routing table with one route advertised by a neighbor,
+// viaMe is set when the neighbor's next hop for it is this node
+void LL2Class::parseRoute(const Packet &packet, int n_entry, const uint8_t destination[ADDR_LENGTH], uint8_t distance, uint8_t advertisedMetric, bool viaMe)
+{
+    RoutingTableEntry route;
+    NeighborTableEntry neighbor;
+
+    memcpy(route.destination, destination, ADDR_LENGTH);
+    memcpy(route.nextHop, packet.source, ADDR_LENGTH);
+    route.distance = distance;
+    route.distance++; // add a hop to distance
+    float metric = (float)advertisedMetric;
+    float hopRatio = 1 / ((float)route.distance);
+    // average neighbor metric with rest of route metric
+    route.metric = (uint8_t)(((float)_neighborTable[n_entry].metric) * (hopRatio) + ((float)metric) * (1 - hopRatio));
+    
+    memcpy(neighbor.address, route.destination, sizeof(neighbor.address));
+    int known = findRoute(route.destination);
+
+    if ( metric == 0 && route.distance == 0)
+    {
+        /* if routing packet contains faraway dropped node route; 
+        update routing table for this by metric = 0 and distance = 255 */
+        route.metric = 0;
+        route.distance = 255;
+    }
+    else if (viaMe && findNeighbor(neighbor.address) >= 0)
+    {
+        /* if routing packet contains my neighbor dropped node route; 
+        update table for this by metric = 0 and distance = 255 */
+        memcpy(route.nextHop, _localAddress, ADDR_LENGTH);
+        route.metric = 0;
+        route.distance = 255;
+    }
+    else if (known >= 0 && memcmp(_routeTable[known].nextHop, route.nextHop, ADDR_LENGTH) == 0 && _routeTable[known].metric == 0 && _routeTable[known].distance == 255)
+    {
+        route.metric = 0;
+        route.distance = 255;
+    }
+    int entry = checkRoutingTable(route);
+    if (entry > 0)
+    {
+        // table size is bounded by updateRouteTable, not by what fits in one packet
+        updateRouteTable(route, entry);
+    }
+}
 
-        memcpy(route.destination, data + (2 * ADDR_LENGTH + 2) * i, ADDR_LENGTH);
-        memcpy(route.nextHop, packet.source, ADDR_LENGTH);
-        route.distance = data[(2 * ADDR_LENGTH + 2) * i + ADDR_LENGTH];
-        route.distance++; // add a hop to distance
-        float metric = (float)data[(2 * ADDR_LENGTH + 2) * i + ADDR_LENGTH + 1];
-        float hopRatio = 1 / ((float)route.distance);
-        // average neighbor metric with rest of route metric
-        route.metric = (uint8_t)(((float)_neighborTable[n_entry].metric) * (hopRatio) + ((float)metric) * (1 - hopRatio));
-        
-        memcpy(neighbor.address, route.destination, sizeof(neighbor.address));
+/* Compact routing packets
+ * Sent to ROUTING_COMPACT instead of ROUTING, only while every neighbor has
+ * set ROUTING_CAP_COMPACT in the metric of its ROUTING packets or has sent
+ * compact ones itself. Each route starts with a 16 bit
+ * word, the full form flag, a 5 bit distance (31 for unreachable) and the
+ * metric, followed by the sender's short id for the route, its routing table
+ * entry. The full form then carries the destination and next hop addresses,
+ * and teaches receivers the short id. The short form carries the short id of
+ * the next hop (SHORT_ID_SENDER for the sender itself) and a check byte of
+ * the destination, 5 bytes instead of the 10 of a ROUTING packet route.
+ */
+bool LL2Class::compactRoutingActive()
+{
+    if (!_compactRouting || _neighborEntry == 0)
+    {
+        return false;
+    }
+    for (int i = 0; i < _neighborEntry; i++)
+    {
+        if (!(_neighborTable[i].capabilities & ROUTING_CAP_COMPACT))
+        {
+            // an older node would install routes to ROUTING_COMPACT
+            return false;
+        }
+    }
+    return true;
+}
+
+uint8_t LL2Class::addressCheck(const uint8_t address[ADDR_LENGTH])
+{
+    uint8_t check = 0;
+    for (int i = 0; i < ADDR_LENGTH; i++)
+    {
+        check ^= address[i];
+    }
+    return check;
+}
+
+// encode a route into data, returns its length
+int LL2Class::encodeRoute(uint8_t *data, int entry, long now, bool compact)
+{
+    RoutingTableEntry *route = &_routeTable[entry];
+    if (!compact)
+    {
+        memcpy(data, route->destination, ADDR_LENGTH);
+        data[ADDR_LENGTH] = route->distance;
+        data[ADDR_LENGTH + 1] = route->metric;
+        memcpy(data + ADDR_LENGTH + 2, route->nextHop, ADDR_LENGTH);
+        return ROUTE_LENGTH;
+    }
+    int nextHop = SHORT_ID_SENDER;
+    if (memcmp(route->nextHop, _localAddress, ADDR_LENGTH) != 0)
+    {
+        nextHop = findRoute(route->nextHop);
+    }
+    // the full form teaches receivers the short id, resent every full dump interval
+    bool full = nextHop < 0 || _routeAnnounced[entry] == 0 || now - _routeAnnounced[entry] > _fullDumpInterval;
+    uint8_t distance = (route->distance == 255) ? 31 : (route->distance > 30 ? 30 : route->distance);
+    uint16_t word = (full ? 0x8000 : 0) | (distance << 10) | (route->metric << 2);
+    data[0] = word >> 8;
+    data[1] = word & 0xff;
+    data[2] = entry;
+    if (full)
+    {
+        memcpy(data + 3, route->destination, ADDR_LENGTH);
+        memcpy(data + 3 + ADDR_LENGTH, route->nextHop, ADDR_LENGTH);
+        return COMPACT_FULL_ROUTE_LENGTH;
+    }
+    data[3] = nextHop;
+    data[4] = addressCheck(route->destination);
+    return COMPACT_ROUTE_LENGTH;
+}
 
-        if ( metric == 0 && route.distance == 0)
+// short ids learned from a neighbor, the least recently used dictionary is replaced if it has none
+RouteDictionary *LL2Class::routeDictionary(const uint8_t neighbor[ADDR_LENGTH])
+{
+    long now = Layer1Class::getTime();
+    RouteDictionary *oldest = &_routeDictionaries[0];
+    for (int i = 0; i < ROUTE_DICTIONARY_SLOTS; i++)
+    {
+        RouteDictionary *dictionary = &_routeDictionaries[i];
+        if (dictionary->lastUsed != 0 && memcmp(dictionary->neighbor, neighbor, ADDR_LENGTH) == 0)
         {
-            /* if routing packet contains faraway dropped node route; 
-            update routing table for this by metric = 0 and distance = 255 */
-            route.metric = 0;
-            route.distance = 255;
+            dictionary->lastUsed = (now != 0) ? now : 1;
+            return dictionary;
         }
-        else if (memcmp(_localAddress, data + (2 * ADDR_LENGTH + 2) * i + ADDR_LENGTH + 2, ADDR_LENGTH) == 0 && checkNeighborTable(neighbor) != _neighborEntry)
+        if (dictionary->lastUsed < oldest->lastUsed)
+        {
+            oldest = dictionary;
+        }
+    }
+    memcpy(oldest->neighbor, neighbor, ADDR_LENGTH);
+    memset(oldest->entries, SHORT_ID_UNKNOWN, sizeof(oldest->entries));
+    oldest->selfId = -1;
+    oldest->lastUsed = (now != 0) ? now : 1;
+    return oldest;
+}
+
+int LL2Class::parseCompactRoutingTable(const Packet &packet, int n_entry)
+{
+    int length = packet.totalLength - HEADER_LENGTH;
+    const uint8_t *data = (const uint8_t *)&packet.datagram;
+    if (_setTimestamp)
+    {
+        length -= 8;
+        data += 8;
+    }
+    RouteDictionary *dictionary = routeDictionary(packet.sender);
+    int numberOfRoutes = 0;
+    int offset = 0;
+    while (offset + COMPACT_ROUTE_LENGTH <= length)
+    {
+        const uint8_t *route = data + offset;
+        bool full = (route[0] & 0x80) != 0;
+        if (full && offset + COMPACT_FULL_ROUTE_LENGTH > length)
         {
-            /* if routing packet contains my neighbor dropped node route; 
-            update table for this by metric = 0 and distance = 255 */
-            memcpy(route.nextHop, _localAddress, ADDR_LENGTH);
-            route.metric = 0;
-            route.distance = 255;
+            break;
         }
-        else if(memcmp(_routeTable[checkRoutingTable(route)].nextHop,route.nextHop,4) == 0 && _routeTable[checkRoutingTable(route)].metric == 0 && _routeTable[checkRoutingTable(route)].distance == 255)
+        uint16_t word = (route[0] << 8) | route[1];
+        uint8_t distance = (word >> 10) & 0x1f;
+        distance = (distance == 31) ? 255 : distance;
+        uint8_t metric = (word >> 2) & 0xff;
+        uint8_t id = route[2];
+        if (full)
         {
-            route.metric = 0;
-            route.distance = 255;
+            offset += COMPACT_FULL_ROUTE_LENGTH;
+            const uint8_t *destination = route + 3;
+            bool viaMe = memcmp(_localAddress, route + 3 + ADDR_LENGTH, ADDR_LENGTH) == 0;
+            parseRoute(packet, n_entry, destination, distance, metric, viaMe);
+            if (id == SHORT_ID_SENDER)
+            {
+                continue;
+            }
+            // learn the short id, or which one the neighbor uses for me
+            if (memcmp(destination, _localAddress, ADDR_LENGTH) == 0)
+            {
+                dictionary->selfId = id;
+                dictionary->entries[id] = SHORT_ID_UNKNOWN;
+                continue;
+            }
+            if (dictionary->selfId == id)
+            {
+                dictionary->selfId = -1;
+            }
+            int entry = findRoute(destination);
+            dictionary->entries[id] = (entry >= 0) ? entry : SHORT_ID_UNKNOWN;
         }
-        entry = checkRoutingTable(route);
-        if (entry > 0)
+        else
         {
-            if (getRouteEntry() <= MAX_ROUTES_PER_PACKET-1)
+            offset += COMPACT_ROUTE_LENGTH;
+            if (id == SHORT_ID_SENDER || dictionary->entries[id] == SHORT_ID_UNKNOWN)
+            {
+                // not learned yet, wait for the neighbor's next full form
+                continue;
+            }
+            const uint8_t *destination = _routeTable[dictionary->entries[id]].destination;
+            if (addressCheck(destination) != route[4])
             {
-                updateRouteTable(route, entry);
+                // the neighbor's ids changed, e.g. it rebooted
+                dictionary->entries[id] = SHORT_ID_UNKNOWN;
+                continue;
             }
+            bool viaMe = dictionary->selfId >= 0 && route[3] == dictionary->selfId;
+            parseRoute(packet, n_entry, destination, distance, metric, viaMe);
         }
+        numberOfRoutes++;
     }
     return numberOfRoutes;
 }
 
+/* Duplicate suppression
+ * Remembers the (source, sequence) of recently heard broadcasts so copies of
+ * a flooded packet relayed by other nodes are only handled once. A source
+ * gives every packet it queues its own sequence, and relayData() keeps the
+ * source and sequence of the original, so the pair names one broadcast.
+ */
+bool LL2Class::checkSeenTable(const uint8_t source[ADDR_LENGTH], uint8_t sequence)
+{
+    long now = Layer1Class::getTime();
+    for (int i = 0; i < SEEN_CACHE_SIZE; i++)
+    {
+        if (_seenTable[i].lastSeen != 0 &&
+            now - _seenTable[i].lastSeen < SEEN_CACHE_TIMEOUT &&
+            _seenTable[i].sequence == sequence &&
+            memcmp(_seenTable[i].source, source, ADDR_LENGTH) == 0)
+        {
+            // already seen this broadcast
+            return true;
+        }
+    }
+    // new broadcast, replace the oldest entry
+    memcpy(_seenTable[_seenEntry].source, source, ADDR_LENGTH);
+    _seenTable[_seenEntry].sequence = sequence;
+    _seenTable[_seenEntry].lastSeen = (now != 0) ? now : 1;
+    _seenEntry = (_seenEntry + 1) % SEEN_CACHE_SIZE;
+    return false;
+}
+
+/* Fragmentation and reassembly
+ * Messages longer than a datagram are split into FRAGMENT_PAYLOAD byte
+ * fragments, each a FRAGMENT_TYPE datagram led by a FragmentHeader. Every
+ * fragment carries the fragment count, so a receiver knows what is missing
+ * and, with NACKs enabled, asks the source for only those fragments.
+ */
+// gap between fragments, sending them back to back makes every relay
+// transmit while the next fragment arrives and lose it
+long LL2Class::fragmentSpacing()
+{
+    return FRAGMENT_SPACING * (long)ceil(packetAirtime(_radios[0].layer1, PACKET_LENGTH - 1));
+}
+
+// queue the next pending fragment once the spacing has passed, one tx slot is always left for writeData
+int LL2Class::sendFragments()
+{
+    if (_fragmentTx == NULL || !_fragmentTx->active)
+    {
+        return 0;
+    }
+    long now = Layer1Class::getTime();
+    int sent = 0;
+    for (int i = 0; i < _fragmentTx->count && sent == 0; i++)
+    {
+        if (((_fragmentTx->pending[i / 8] >> (i % 8)) & 1) == 0)
+        {
+            continue;
+        }
+        packetBuffer *txBuffer = _radios[selectRadio(false)].layer1->txBuffer;
+        if (txBuffer->size() + 1 >= txBuffer->capacity() ||
+            (_fragmentTx->lastSent != 0 && now - _fragmentTx->lastSent < fragmentSpacing()))
+        {
+            break;
+        }
+        size_t offset = i * FRAGMENT_PAYLOAD;
+        size_t length = _fragmentTx->length - offset;
+        if (length > FRAGMENT_PAYLOAD)
+        {
+            length = FRAGMENT_PAYLOAD;
+        }
+        Datagram datagram;
+        memcpy(datagram.destination, _fragmentTx->destination, ADDR_LENGTH);
+        datagram.type = FRAGMENT_TYPE;
+        FragmentHeader *header = (FragmentHeader *)datagram.message;
+        header->messageId = _fragmentTx->messageId;
+        header->index = i;
+        header->count = _fragmentTx->count;
+        header->type = _fragmentTx->type;
+        memcpy(datagram.message + FRAGMENT_HEADER, _fragmentTx->data + offset, length);
+        int ret = route(DEFAULT_TTL, _localAddress, 0, datagram, DATAGRAM_HEADER + FRAGMENT_HEADER + length, 1);
+        if (ret < 0 || ret == BUFFERSIZE)
+        {
+            // no route yet or no room, try again next time
+            break;
+        }
+        _fragmentTx->pending[i / 8] &= ~(1 << (i % 8));
+        _fragmentTx->lastActivity = now;
+        _fragmentTx->lastSent = (now != 0) ? now : 1;
+        sent++;
+    }
+    if (fragmentsPending() == 0 && (!_fragmentNack || now - _fragmentTx->lastActivity > FRAGMENT_HOLD_TIME + 2 * fragmentSpacing()))
+    {
+        _fragmentTx->active = false;
+    }
+    return sent;
+}
+
+// store a fragment in its reassembly buffer, the oldest partial message is dropped if none is free
+void LL2Class::receiveFragment(const Packet &packet)
+{
+    const FragmentHeader *header = (const FragmentHeader *)packet.datagram.message;
+    int length = packet.totalLength - HEADER_LENGTH - DATAGRAM_HEADER - FRAGMENT_HEADER;
+    if (length <= 0 || header->count == 0 || header->count > MAX_FRAGMENTS || header->index >= header->count ||
+        (header->index < header->count - 1 && length != FRAGMENT_PAYLOAD))
+    {
+        return;
+    }
+    if (_fragmentRx == NULL)
+    {
+        _fragmentRx = (FragmentRxEntry *)calloc(REASSEMBLY_SLOTS, sizeof(FragmentRxEntry));
+        if (_fragmentRx == NULL)
+        {
+            return;
+        }
+    }
+    long now = Layer1Class::getTime();
+    FragmentRxEntry *entry = NULL;
+    FragmentRxEntry *oldest = NULL;
+    for (int i = 0; i < REASSEMBLY_SLOTS; i++)
+    {
+        FragmentRxEntry *slot = &_fragmentRx[i];
+        if (slot->active && slot->messageId == header->messageId &&
+            memcmp(slot->source, packet.source, ADDR_LENGTH) == 0)
+        {
+            entry = slot;
+            break;
+        }
+        if (!slot->active)
+        {
+            if (oldest == NULL || oldest->active)
+            {
+                oldest = slot;
+            }
+        }
+        else if (!slot->complete && (oldest == NULL || (oldest->active && slot->lastFragment < oldest->lastFragment)))
+        {
+            oldest = slot;
+        }
+    }
+    if (entry == NULL)
+    {
+        if (oldest == NULL)
+        {
+            // every buffer holds a complete message that has not been read yet
+            return;
+        }
+        entry = oldest;
+        entry->active = true;
+        entry->complete = false;
+        memcpy(entry->source, packet.source, ADDR_LENGTH);
+        memcpy(entry->destination, packet.datagram.destination, ADDR_LENGTH);
+        entry->messageId = header->messageId;
+        entry->count = header->count;
+        entry->type = header->type;
+        memset(entry->received, 0, sizeof(entry->received));
+        entry->receivedCount = 0;
+        entry->length = 0;
+        entry->lastNack = now;
+    }
+    if (entry->complete || header->count != entry->count ||
+        ((entry->received[header->index / 8] >> (header->index % 8)) & 1))
+    {
+        // duplicate, or a fragment of another message reusing the id
+        return;
+    }
+    memcpy(entry->data + header->index * FRAGMENT_PAYLOAD, packet.datagram.message + FRAGMENT_HEADER, length);
+    entry->received[header->index / 8] |= 1 << (header->index % 8);
+    entry->receivedCount++;
+    entry->lastFragment = now;
+    if (header->index == header->count - 1)
+    {
+        entry->length = header->index * FRAGMENT_PAYLOAD + length;
+    }
+    entry->complete = entry->receivedCount == entry->count;
+}
+
+// requeue the fragments a receiver reported missing
+void LL2Class::receiveFragmentNack(const Packet &packet)
+{
+    const uint8_t *message = packet.datagram.message;
+    int length = packet.totalLength - HEADER_LENGTH - DATAGRAM_HEADER;
+    if (_fragmentTx == NULL || !_fragmentTx->active || length < 2 + FRAGMENT_BITMAP_LENGTH ||
+        message[0] != _fragmentTx->messageId || message[1] != _fragmentTx->count ||
+        memcmp(packet.source, _fragmentTx->destination, ADDR_LENGTH) != 0)
+    {
+        return;
+    }
+    for (int i = 0; i < _fragmentTx->count; i++)
+    {
+        _fragmentTx->pending[i / 8] |= message[2 + i / 8] & (1 << (i % 8));
+    }
+    _fragmentTx->lastActivity = Layer1Class::getTime();
+}
+
+// ask the source of a partial message for its missing fragments
+int LL2Class::sendFragmentNack(FragmentRxEntry *entry)
+{
+    Datagram datagram;
+    memcpy(datagram.destination, entry->source, ADDR_LENGTH);
+    datagram.type = FRAGMENT_NACK_TYPE;
+    datagram.message[0] = entry->messageId;
+    datagram.message[1] = entry->count;
+    for (int i = 0; i < FRAGMENT_BITMAP_LENGTH; i++)
+    {
+        datagram.message[2 + i] = ~entry->received[i];
+    }
+    return route(DEFAULT_TTL, _localAddress, 0, datagram, DATAGRAM_HEADER + 2 + FRAGMENT_BITMAP_LENGTH, 0);
+}
+
+// drop stale messages and request missing fragments of stalled ones,
+// both timeouts are stretched by the fragment spacing for slow radio settings
+void LL2Class::checkReassembly()
+{
+    if (_fragmentRx == NULL)
+    {
+        return;
+    }
+    long now = Layer1Class::getTime();
+    long spacing = fragmentSpacing();
+    for (int i = 0; i < REASSEMBLY_SLOTS; i++)
+    {
+        FragmentRxEntry *entry = &_fragmentRx[i];
+        if (!entry->active)
+        {
+            continue;
+        }
+        if (now - entry->lastFragment > REASSEMBLY_TIMEOUT + 2 * spacing)
+        {
+            entry->active = false;
+        }
+        else if (_fragmentNack && !entry->complete &&
+                 memcmp(entry->destination, _localAddress, ADDR_LENGTH) == 0 &&
+                 now - entry->lastFragment > FRAGMENT_NACK_INTERVAL + 2 * spacing &&
+                 now - entry->lastNack > FRAGMENT_NACK_INTERVAL + 2 * spacing)
+        {
+            sendFragmentNack(entry);
+            entry->lastNack = now;
+        }
+    }
+}
+
 /* Entry point to build routing table
  */
-void LL2Class::parseForRoutes(Packet packet)
+void LL2Class::parseForRoutes(const Packet &packet)
 {
     // Parse for sender address (i.e. your neighbor)
     int n_entry = parseNeighbor(packet);
     int r_entry = -1;
 
     //if incomming packet is routing packet
-    if (memcmp(packet.receiver, ROUTING, ADDR_LENGTH) == 0)
+    bool compact = memcmp(packet.receiver, ROUTING_COMPACT, ADDR_LENGTH) == 0;
+    if (compact || memcmp(packet.receiver, ROUTING, ADDR_LENGTH) == 0)
     {
         // get timestampe from the routing packet
         if (_setTimestamp)
         {
             memcpy(time_stamp.timeArr, &packet.datagram, sizeof(time_stamp.timeArr));
-            setTimestamp(time_stamp.time_, millis());
+            setTimestamp(time_stamp.time_, Layer1Class::getTime());
         }
         
         // packet contains routing table info, parse for routes in datagram only
-        parseRoutingTable(packet, n_entry);
+        if (compact)
+        {
+            parseCompactRoutingTable(packet, n_entry);
+        }
+        else
+        {
+            parseRoutingTable(packet, n_entry);
+        }
         return;
     }
 
@@ -749,7 +1682,7 @@ void LL2Class::parseForRoutes(Packet packet)
 
 /* Entry point to route data
  */
-int LL2Class::route(uint8_t ttl, uint8_t source[ADDR_LENGTH], uint8_t hopCount, Datagram datagram, size_t length, int broadcast)
+int LL2Class::route(uint8_t ttl, const uint8_t source[ADDR_LENGTH], uint8_t hopCount, const Datagram &datagram, size_t length, int broadcast)
 {
     int ret = -1;
     uint8_t metric = 0;
@@ -776,8 +1709,7 @@ int LL2Class::route(uint8_t ttl, uint8_t source[ADDR_LENGTH], uint8_t hopCount,
             // Broadcast packet, only forward if explicity told to
             if (broadcast == 1)
             {
-                Packet packet = buildPacket(ttl, BROADCAST, source, hopCount, metric, datagram, length);
-                ret = writeToBuffer(LoRa1->txBuffer, packet);
+                ret = buildToBuffer(_radios[selectRadio(false)].layer1->txBuffer, ttl, BROADCAST, source, hopCount, metric, datagram, length);
             }
         }
         else
@@ -787,9 +1719,8 @@ int LL2Class::route(uint8_t ttl, uint8_t source[ADDR_LENGTH], uint8_t hopCount,
             {
                 // Route found
                 // build packet with new ttl, nextHop, and route metric
-                Packet packet = buildPacket(ttl, _routeTable[dst_entry].nextHop, source, hopCount, metric, datagram, length);
-                // return packet's position in buffer
-                ret = writeToBuffer(LoRa1->txBuffer, packet);
+                // directly in the tx slot, return packet's position in buffer
+                ret = buildToBuffer(_radios[selectRadio(false)].layer1->txBuffer, ttl, _routeTable[dst_entry].nextHop, source, hopCount, metric, datagram, length);
             }
         }
     }
@@ -798,11 +1729,18 @@ int LL2Class::route(uint8_t ttl, uint8_t source[ADDR_LENGTH], uint8_t hopCount,
 
 /* Receive and decide function
  */
-void LL2Class::receive()
+void LL2Class::receive(int radio)
 {
-    Packet packet = readFromBuffer(LoRa1->rxBuffer);
-    // BufferEntry entry = LoRa1->rxBuffer.read();
-    // memcpy(&packet, entry.data, entry.length);
+    packetBuffer *buffer = _radios[radio].layer1->rxBuffer;
+    // parse the packet in place over the Layer1 rx slot, released once handled
+    Packet *slot = peekBuffer(buffer);
+    if (slot == NULL)
+    {
+        // buffer is empty, drop any zero length entry and do nothing
+        buffer->release();
+        return;
+    }
+    Packet &packet = *slot;
 
 #ifdef LL2_DEBUG
     Serial.printf("LoRaLayer2::receive(): packet.datagram.message = ");
@@ -817,16 +1755,37 @@ void LL2Class::receive()
     if ((packet.totalLength > 0) && (memcmp(packet.sender, _localAddress, ADDR_LENGTH) != 0))
     {
         parseForRoutes(packet);
-        if (memcmp(packet.receiver, ROUTING, ADDR_LENGTH) == 0)
+        if (memcmp(packet.receiver, ROUTING, ADDR_LENGTH) == 0 ||
+            memcmp(packet.receiver, ROUTING_COMPACT, ADDR_LENGTH) == 0)
         {
             // packet contains routing table info, do nothing besides parse
+            buffer->release();
             return;
         }
+        else if (memcmp(packet.receiver, BROADCAST, ADDR_LENGTH) == 0 &&
+                 (memcmp(packet.source, _localAddress, ADDR_LENGTH) == 0 ||
+                  checkSeenTable(packet.source, packet.sequence)))
+        {
+            // copy of a broadcast already handled, or my own flood echoed back,
+            // drop it before it is delivered or transmitted again
+            _suppressedCount++;
+        }
         else if (memcmp(packet.datagram.destination, _localAddress, ADDR_LENGTH) == 0 ||
                  memcmp(packet.receiver, BROADCAST, ADDR_LENGTH) == 0)
         {
             // packet is meant for me (or everyone)
-            writeToBuffer(rxBuffer, packet);
+            if (packet.datagram.type == FRAGMENT_TYPE)
+            {
+                receiveFragment(packet);
+            }
+            else if (packet.datagram.type == FRAGMENT_NACK_TYPE)
+            {
+                receiveFragmentNack(packet);
+            }
+            else
+            {
+                writeToBuffer(rxBuffer, packet);
+            }
         }
         else if (memcmp(packet.receiver, _localAddress, ADDR_LENGTH) == 0)
         {
@@ -838,17 +1797,62 @@ void LL2Class::receive()
             route(packet.ttl, packet.source, packet.hopCount, packet.datagram, packet.totalLength - HEADER_LENGTH, 0);
         }
     }
-    // else buffer is empty, do nothing;
+    buffer->release();
     return;
 }
 
+/* Queue this routing interval's routing packets, returns the position of the
+ * last one in the tx buffer. Without delta routing the whole table is sent in
+ * as many packets as it takes; with it, changed routes are sent every interval
+ * and the full table is spread one packet per interval every _fullDumpInterval.
+ */
+int LL2Class::writeRoutingPackets()
+{
+    long now = Layer1Class::getTime();
+    if (!_deltaRouting || (_fullDumpEntry < 0 && now - _lastFullDumpTime > _fullDumpInterval))
+    {
+        // start a new full dump, in delta mode only once the last one is done
+        _fullDumpEntry = 0;
+        _lastFullDumpTime = now;
+    }
+    int ret = BUFFERSIZE;
+    int packets = 0;
+    // only build a packet when there is room for it, routes are marked as sent once built
+    while (routingBuffer->size() < routingBuffer->capacity())
+    {
+        // always send at least one, possibly empty, routing packet so neighbors hear us
+        bool pending = packets == 0;
+        if (!_deltaRouting)
+        {
+            pending = pending || _fullDumpEntry >= 0;
+        }
+        for (int i = 0; i < _routeEntry && !pending; i++)
+        {
+            pending = _routeChanged[i];
+        }
+        if (!pending)
+        {
+            break;
+        }
+        Packet routingPacket = buildRoutingPacket(packets == 0 || !_deltaRouting);
+        ret = writeToBuffer(routingBuffer, routingPacket);
+        _messageCount++;
+        packets++;
+    }
+    return ret;
+}
+
 /* Initialization function
  */
 int LL2Class::init()
 {
     _startTime = Layer1Class::getTime();
     _lastRoutingTime = _startTime;
-    _lastTransmitTime = _startTime;
+    for (int r = 0; r < MAX_RADIOS; r++)
+    {
+        _radios[r].lastTransmitTime = _startTime;
+        _radios[r].lastBudgetTime = _startTime;
+    }
     return 0;
 }
 
@@ -860,43 +1864,31 @@ int LL2Class::daemon()
     // try adding a routing packet to L2toL1 buffer, if interval is up and routing is enabled
     if (Layer1Class::getTime() - _lastRoutingTime > _routingInterval && _disableRoutingPackets == 0)
     {
-        Packet routingPacket = buildRoutingPacket();
-        // need to init with broadcast addr and then loop through routing table to build routing table
-        ret = writeToBuffer(LoRa1->txBuffer, routingPacket);
+        ret = writeRoutingPackets();
         _lastRoutingTime = Layer1Class::getTime();
     }
 
-    // try transmitting a packet
-    if (Layer1Class::getTime() - _lastTransmitTime > _dutyInterval)
+    // queue fragments of the message being sent, and look after partial ones
+    sendFragments();
+    checkReassembly();
+
+    for (int r = 0; r < _radioCount; r++)
     {
-        int length = LoRa1->transmit();
-        if (length > 0)
+        // try transmitting a packet, if the duty cycle budget of this radio allows
+        transmit(r);
+
+        // see if there are any packets to be received
+        // first check if any interrupts have been set,
+        // then check if any packets have been added to Layer1 rxbuffer
+        if (_radios[r].layer1->receive() > 0)
         {
 #ifdef LL2_DEBUG
-            Serial.printf("LL2::daemon(): transmitted packet of length: %d\r\n", length);
+            Serial.printf("LL2Class::daemon: received packet on radio %d\r\n", r);
 #endif
-            _lastTransmitTime = Layer1Class::getTime();
-            // double airtime = LoRa1->getLoRa()->getTimeOnAir(length)/1000;
-            double airtime = calculateAirtime((double)length, (double)LoRa1->spreadingFactor(), 1, 0, LoRa1->getCR(), LoRa1->getBW());
-            _dutyInterval = (int)ceil(airtime / _dutyCycle);
-#ifdef LL2_DEBUG
-            Serial.printf("airtime = %f\n _dutyInterval = %d\n", airtime, _dutyInterval);
-#endif
-            _messageCount = (_messageCount + 1) % 256;
+            receive(r);
         }
     }
 
-    // see if there are any packets to be received
-    // first check if any interrupts have been set,
-    // then check if any packets have been added to Layer1 rxbuffer
-    if (LoRa1->receive() > 0)
-    {
-#ifdef LL2_DEBUG
-        Serial.printf("LL2Class::daemon: received packet\r\n");
-#endif
-        receive();
-    }
-
     // returns sequence number of transmitted packet,
     // if no packet transmitted, will return -1
     return ret;
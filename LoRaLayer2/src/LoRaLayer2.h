@@ -1,8 +1,12 @@
 #ifndef LORALAYER2_H
 #define LORALAYER2_H
+// RadioLib SX1276 is the default Layer1, unless another one is selected
+#if !defined(ARDUINO_LORA) && !defined(SIM) && !defined(RL_SX1276)
 #define RL_SX1276
+#endif
 #include <unistd.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <stdarg.h>
 
 #ifdef ARDUINO_LORA
@@ -42,13 +46,52 @@
 #define SHA1_LENGTH 40
 #define ADDR_LENGTH 4
 #define MAX_ROUTES_PER_PACKET (int) (DATA_LENGTH / (2 * ADDR_LENGTH + 2)) //23 
+#define ROUTE_LENGTH (2 * ADDR_LENGTH + 2) // route in a ROUTING packet
+#define COMPACT_ROUTE_LENGTH 5 // route with a learned short id in a ROUTING_COMPACT packet
+#define COMPACT_FULL_ROUTE_LENGTH (3 + 2 * ADDR_LENGTH) // route with full addresses in a ROUTING_COMPACT packet
+#define SHORT_ID_SENDER 0xff // short id of the sender of a compact routing packet
+#define SHORT_ID_UNKNOWN 0xff
+#define ROUTING_CAP_COMPACT 0x01 // metric field bit of a ROUTING packet, sender understands ROUTING_COMPACT
+#define ROUTE_DICTIONARY_SLOTS 8 // neighbors whose short ids are remembered
+#define MAX_GRADES_PER_PACKET (int) (MESSAGE_LENGTH / (ADDR_LENGTH + 1)) //46
+#define DEFAULT_FULL_DUMP_INTERVAL 60000 // ms between full routing table dumps in delta mode
+#define SEEN_CACHE_SIZE 32 // recently seen broadcasts remembered for duplicate suppression
+#define SEEN_CACHE_TIMEOUT 30000 // ms a seen broadcast is remembered
+#define MAX_TABLE_ENTRIES 255 // size of neighbor and routing tables
+#define TABLE_INDEX_BITS 9
+#define TABLE_INDEX_SIZE (1 << TABLE_INDEX_BITS) // hash index slots, keeps load factor below 0.5
 
 #define ASYNC_TX 1
 #define DEFAULT_TTL 30
+#define DEFAULT_DUTY_WINDOW 60000 // ms of duty cycle budget the transmit scheduler can bank
+#define MAX_RADIOS 2
+#define RADIO_POLICY_LOAD 0 // dual radio, send on the least loaded radio
+#define RADIO_POLICY_CLASS 1 // dual radio, data on lora_1 and routing packets on lora_2
+
+#define FRAGMENT_TYPE 0xf0 // datagram type of a message fragment
+#define FRAGMENT_NACK_TYPE 0xf1 // datagram type of a request for missing fragments
+#define FRAGMENT_HEADER 4 // message id, fragment index, fragment count, message type
+#define FRAGMENT_PAYLOAD (MESSAGE_LENGTH - FRAGMENT_HEADER - 1) // 229, keeps totalLength within a uint8_t
+#ifndef MAX_FRAGMENTS
+#define MAX_FRAGMENTS 16 // fragments per message, at most 255
+#endif
+#define MAX_MESSAGE_LENGTH (MAX_FRAGMENTS * FRAGMENT_PAYLOAD) // 3664
+#define FRAGMENT_BITMAP_LENGTH ((MAX_FRAGMENTS + 7) / 8)
+#ifndef REASSEMBLY_SLOTS
+#define REASSEMBLY_SLOTS 2 // messages reassembled at the same time
+#endif
+#define REASSEMBLY_TIMEOUT 60000 // ms a message is kept after its last fragment
+#define FRAGMENT_NACK_INTERVAL 5000 // ms without fragments before the missing ones are requested
+#define FRAGMENT_SPACING 3 // full length frame airtimes between fragments, lets relays forward one before the next
+#define FRAGMENT_HOLD_TIME 70000 // ms a sent message is kept to answer requests for missing fragments, outlasts REASSEMBLY_TIMEOUT
 
 extern uint8_t BROADCAST[ADDR_LENGTH];
 extern uint8_t LOOPBACK[ADDR_LENGTH];
 extern uint8_t ROUTING[ADDR_LENGTH];
+extern uint8_t ROUTING_COMPACT[ADDR_LENGTH];
+
+// airtime in ms of a LoRa frame, bandwidth in kHz, codingRate as 5..8 for 4/5..4/8
+double calculateAirtime(double length, double spreadingFactor, double explicitHeader, double lowDR, double codingRate, double bandwidth);
 
 struct Datagram {
     uint8_t destination[ADDR_LENGTH];
@@ -61,7 +104,7 @@ struct Packet {
     uint8_t totalLength;
     uint8_t sender[ADDR_LENGTH];
     uint8_t receiver[ADDR_LENGTH];
-    uint8_t sequence; // message count of packets tx by sender
+    uint8_t sequence; // message count of packets queued by sender, kept by relayData()
     uint8_t source[ADDR_LENGTH];
     uint8_t hopCount; // start 0, incremented with each retransmit
     uint8_t metric; // of source-receiver link
@@ -73,6 +116,69 @@ struct NeighborTableEntry{
     uint8_t lastReceived;
     uint8_t packet_success;
     uint8_t metric;
+    uint8_t capabilities; // ROUTING_CAP_ bits, 0 until its routing packets are heard
+};
+
+struct SeenTableEntry{
+    uint8_t source[ADDR_LENGTH];
+    uint8_t sequence;
+    long lastSeen; // 0 if unused
+};
+
+struct FragmentHeader{
+    uint8_t messageId;
+    uint8_t index;
+    uint8_t count;
+    uint8_t type; // datagram type of the whole message
+};
+
+// a message being sent as fragments
+struct FragmentTxEntry{
+    bool active;
+    uint8_t destination[ADDR_LENGTH];
+    uint8_t messageId;
+    uint8_t count;
+    uint8_t type;
+    uint8_t pending[FRAGMENT_BITMAP_LENGTH]; // fragments still to be (re)sent
+    size_t length;
+    long lastActivity;
+    long lastSent; // 0 until the first fragment is queued
+    uint8_t data[MAX_MESSAGE_LENGTH];
+};
+
+// a message being put back together from its fragments
+struct FragmentRxEntry{
+    bool active;
+    bool complete;
+    uint8_t source[ADDR_LENGTH];
+    uint8_t destination[ADDR_LENGTH];
+    uint8_t messageId;
+    uint8_t count;
+    uint8_t type;
+    uint8_t received[FRAGMENT_BITMAP_LENGTH];
+    uint8_t receivedCount;
+    size_t length; // known once the last fragment has arrived
+    long lastFragment;
+    long lastNack;
+    uint8_t data[MAX_MESSAGE_LENGTH];
+};
+
+// short ids a neighbor uses for routes in its compact routing packets
+struct RouteDictionary{
+    uint8_t neighbor[ADDR_LENGTH];
+    long lastUsed; // 0 if unused
+    int16_t selfId; // short id the neighbor uses for me, -1 if unknown
+    uint8_t entries[MAX_TABLE_ENTRIES]; // short id to routing table entry, SHORT_ID_UNKNOWN if not learned
+};
+
+// per radio transmit scheduler state
+struct RadioState{
+    Layer1Class *layer1;
+    long lastTransmitTime;
+    int dutyInterval; // airtime of the last frame, radio is busy until it has passed
+    double dutyBudget; // ms of airtime the scheduler may still spend
+    double airtimeUsed;
+    long lastBudgetTime;
 };
 
 struct RoutingTableEntry{
@@ -93,19 +199,39 @@ public:
 
     uint8_t* localAddress();
     int getRouteEntry();
+    uint8_t routeDistance(const uint8_t destination[ADDR_LENGTH]);
+    int txQueueDepth();
+    double txBudget(int radio = 0);
+    double airtimeUsed();
+    int radioCount();
+    uint32_t suppressedCount();
 
     // User configurable settings
     void setLocalAddress(const char* macString);
     long setInterval(long interval);
     void setDutyCycle(double dutyCycle);
+    long setDutyWindow(long window);
+    void setRadioPolicy(int policy);
+    void setDeltaRouting(bool enable);
+    long setFullDumpInterval(long interval);
     void setTimestamp(uint64_t timestamp, uint32_t cTime);
     uint64_t getTimestamp(uint32_t cTime);
     void setTimeFlag(bool flag);
     void setTimestampFlag(bool flag);
+    void setCompactRouting(bool enable);
+    void setFragmentNack(bool enable);
 
     // Layer 3 tx/rx wrappers
-    int writeData(Datagram datagram, size_t length);
+    int writeData(const Datagram &datagram, size_t length);
     Packet readData();
+    // zero-copy receive, borrow the next packet in place until it is released
+    Packet* peekData();
+    void releaseData();
+    int relayData(const Packet &packet);
+    // messages up to MAX_MESSAGE_LENGTH bytes, sent and received as fragments
+    int writeMessage(const uint8_t destination[ADDR_LENGTH], uint8_t type, const uint8_t *data, size_t length);
+    int readMessage(uint8_t *data, size_t length, uint8_t source[ADDR_LENGTH], uint8_t *type);
+    int fragmentsPending();
 
     // Print out functions
     void getNeighborTable(char *out);
@@ -114,6 +240,7 @@ public:
     void clearNeigbourRoutingTables(void);
     
     Packet buildRoutingWithServiceGradePacket();
+    Packet buildRoutingWithServiceGradePacket(int &nextEntry);
 
     // Main init and loop functions
     int init();
@@ -121,34 +248,69 @@ public:
 
 private:
     // Wrappers for packetBuffers
-    int writeToBuffer(packetBuffer *buffer, Packet packet);
+    int writeToBuffer(packetBuffer *buffer, const Packet &packet);
     Packet readFromBuffer(packetBuffer *buffer);
+    Packet* peekBuffer(packetBuffer *buffer);
+    int buildToBuffer(packetBuffer *buffer, uint8_t ttl, const uint8_t nextHop[ADDR_LENGTH], const uint8_t source[ADDR_LENGTH], uint8_t hopCount, uint8_t metric, const Datagram &datagram, size_t length);
 
     // General purpose utility functions
     uint8_t hexDigit(char ch);
     void setAddress(uint8_t* addr, const char* macString);
     void console_printf(const char* format, ...);
 
+    // Transmit scheduler functions
+    double packetAirtime(Layer1Class *layer1, size_t length);
+    int selectRadio(bool routing);
+    int transmit(int radio);
+
     // Routing utility functions
-    Packet buildPacket(uint8_t ttl, uint8_t nextHop[ADDR_LENGTH], uint8_t source[ADDR_LENGTH], uint8_t hopCount, uint8_t metric, Datagram datagram, size_t length);
-    Packet buildRoutingPacket();
+    void buildPacket(Packet *packet, uint8_t ttl, const uint8_t nextHop[ADDR_LENGTH], const uint8_t source[ADDR_LENGTH], uint8_t hopCount, uint8_t metric, const Datagram &datagram, size_t length);
+    Packet buildRoutingPacket(bool fullDump);
+    int writeRoutingPackets();
     uint8_t calculatePacketLoss(int entry, uint8_t sequence);
     uint8_t calculateMetric(int entry);
     int checkNeighborTable(NeighborTableEntry neighbor);
     int checkRoutingTable(RoutingTableEntry route);
     int updateNeighborTable(NeighborTableEntry neighbor, int entry);
     int updateRouteTable(RoutingTableEntry route, int entry);
-    int selectRoute(uint8_t destination[ADDR_LENGTH]);
-    int parseNeighbor(Packet packet);
-    int parseRoutingTable(Packet packet, int n_entry);
+    int selectRoute(const uint8_t destination[ADDR_LENGTH]);
+
+    // Hash index utility functions, map an address to its table entry
+    uint16_t hashAddress(const uint8_t address[ADDR_LENGTH]);
+    int findNeighbor(const uint8_t address[ADDR_LENGTH]);
+    int findRoute(const uint8_t destination[ADDR_LENGTH]);
+    void indexNeighbor(int entry);
+    void indexRoute(int entry);
+    int parseNeighbor(const Packet &packet);
+    int parseRoutingTable(const Packet &packet, int n_entry);
+    void parseRoute(const Packet &packet, int n_entry, const uint8_t destination[ADDR_LENGTH], uint8_t distance, uint8_t advertisedMetric, bool viaMe);
+
+    // Compact routing packet functions
+    bool compactRoutingActive();
+    uint8_t addressCheck(const uint8_t address[ADDR_LENGTH]);
+    int encodeRoute(uint8_t *data, int entry, long now, bool compact);
+    RouteDictionary *routeDictionary(const uint8_t neighbor[ADDR_LENGTH]);
+    int parseCompactRoutingTable(const Packet &packet, int n_entry);
+
+    // Duplicate suppression functions
+    bool checkSeenTable(const uint8_t source[ADDR_LENGTH], uint8_t sequence);
+
+    // Fragmentation and reassembly functions
+    long fragmentSpacing();
+    int sendFragments();
+    void receiveFragment(const Packet &packet);
+    void receiveFragmentNack(const Packet &packet);
+    void checkReassembly();
+    int sendFragmentNack(FragmentRxEntry *entry);
 
     // Main entry point functions
-    void parseForRoutes(Packet packet);
-    int route(uint8_t ttl, uint8_t source[ADDR_LENGTH], uint8_t hopCount, Datagram datagram, size_t length, int broadcast);
-    void receive();
+    void parseForRoutes(const Packet &packet);
+    int route(uint8_t ttl, const uint8_t source[ADDR_LENGTH], uint8_t hopCount, const Datagram &datagram, size_t length, int broadcast);
+    void receive(int radio);
 
     // Fifo buffer objects
     packetBuffer *rxBuffer; // L2 sending to L3
+    packetBuffer *routingBuffer; // routing packets, only sent when Layer1 has no data waiting
     // NOTE: there is no L2 txBuffer (i.e. L3 sending to L2 a packet to be transmitted) because I have not found a need for one yet
 
     // Local members, variables and tables
@@ -166,14 +328,36 @@ private:
     bool _setTimestamp;
     bool _setTime;
     int _disableRoutingPackets;
-    int _dutyInterval;
+    bool _deltaRouting;
+    long _fullDumpInterval;
+    long _lastFullDumpTime;
+    int _fullDumpEntry; // next entry of a full dump in progress, -1 if idle
     double _dutyCycle;
+    long _dutyWindow;
+    RadioState _radios[MAX_RADIOS];
+    int _radioCount;
+    int _radioPolicy;
 
     long _startTime;
     long _lastRoutingTime;
-    long _lastTransmitTime;
-    NeighborTableEntry _neighborTable[255];
-    RoutingTableEntry _routeTable[255];
+    NeighborTableEntry _neighborTable[MAX_TABLE_ENTRIES];
+    RoutingTableEntry _routeTable[MAX_TABLE_ENTRIES];
+    bool _routeChanged[MAX_TABLE_ENTRIES]; // not advertised since last change
+    long _routeAnnounced[MAX_TABLE_ENTRIES]; // last sent in compact full form, 0 if never
+    RouteDictionary _routeDictionaries[ROUTE_DICTIONARY_SLOTS];
+    SeenTableEntry _seenTable[SEEN_CACHE_SIZE];
+    int _seenEntry; // next seen table entry to replace, the oldest one
+    uint32_t _suppressedCount;
+    // about MAX_MESSAGE_LENGTH bytes each, so only allocated once fragmentation is used
+    FragmentTxEntry *_fragmentTx; // by the first writeMessage()
+    FragmentRxEntry *_fragmentRx; // REASSEMBLY_SLOTS entries, by the first fragment received
+    uint8_t _fragmentMessageId;
+    bool _fragmentNack;
+    bool _compactRouting;
+    bool _compactActive; // last routing packet was sent compact
+    // open-addressing indexes into the tables above, -1 marks an empty slot
+    int16_t _neighborIndex[TABLE_INDEX_SIZE];
+    int16_t _routeIndex[TABLE_INDEX_SIZE];
     union timestamp_
     {
         uint64_t time_;
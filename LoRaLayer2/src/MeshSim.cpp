@@ -0,0 +1,581 @@
+#ifdef SIM
+#include <MeshSim.h>
+
+/* MeshSim Class
+ */
+MeshSimClass::MeshSimClass(int maxNodes, uint32_t seed)
+    : _maxNodes(maxNodes),
+      _nodeCount(0),
+      _seed(seed ? seed : 1),
+      _tick(SIM_DEFAULT_TICK),
+      _startJitter(SIM_DEFAULT_JITTER),
+      _trafficInterval(0),
+      _trafficLength(0),
+      _lastTraffic(0),
+      _airCount(0),
+      _airCapacity(0),
+      _received(NULL),
+      _messageCount(0),
+      _messageCapacity(0),
+      _dataSent(0),
+      _dataDelivered(0),
+      _dataUnrouted(0),
+      _convergedSent(0),
+      _convergedDelivered(0),
+      _convergenceTime(-1)
+{
+    _radios = new Layer1Class *[maxNodes];
+    _nodes = new LL2Class *[maxNodes];
+    _startTimes = new long[maxNodes];
+    _started = new bool[maxNodes];
+    _component = new int[maxNodes];
+    _loss = new float[maxNodes * maxNodes];
+    _stats = new SimNodeStats[maxNodes];
+    for (int i = 0; i < maxNodes * maxNodes; i++)
+    {
+        _loss[i] = 1;
+    }
+    memset(_stats, 0, sizeof(SimNodeStats) * maxNodes);
+    _air = NULL;
+    growAir();
+};
+
+MeshSimClass::~MeshSimClass()
+{
+    for (int i = 0; i < _nodeCount; i++)
+    {
+        delete _nodes[i];
+        delete _radios[i];
+    }
+    delete[] _radios;
+    delete[] _nodes;
+    delete[] _startTimes;
+    delete[] _started;
+    delete[] _component;
+    delete[] _loss;
+    delete[] _stats;
+    free(_air);
+    free(_received);
+}
+
+/* Nodes
+ */
+int MeshSimClass::addNode(const char *macString)
+{
+    if (_nodeCount >= _maxNodes)
+    {
+        return -1;
+    }
+    int index = _nodeCount;
+    _radios[index] = new Layer1Class();
+    _radios[index]->setNodeID(index);
+    _radios[index]->attach(this);
+    _nodes[index] = new LL2Class(_radios[index]);
+    _nodes[index]->setLocalAddress(macString);
+    // start time is picked when the simulation first runs
+    _startTimes[index] = -1;
+    _started[index] = false;
+    _nodeCount++;
+    return index;
+}
+
+int MeshSimClass::nodeCount()
+{
+    return _nodeCount;
+}
+
+LL2Class *MeshSimClass::node(int index)
+{
+    return _nodes[index];
+}
+
+Layer1Class *MeshSimClass::radio(int index)
+{
+    return _radios[index];
+}
+
+SimNodeStats *MeshSimClass::stats(int index)
+{
+    return &_stats[index];
+}
+
+/* Topology and link-loss model
+ */
+void MeshSimClass::setLink(int from, int to, float loss)
+{
+    _loss[from * _maxNodes + to] = loss;
+}
+
+void MeshSimClass::setLinks(int a, int b, float loss)
+{
+    setLink(a, b, loss);
+    setLink(b, a, loss);
+}
+
+void MeshSimClass::connectLine(float loss)
+{
+    for (int i = 0; i + 1 < _nodeCount; i++)
+    {
+        setLinks(i, i + 1, loss);
+    }
+}
+
+void MeshSimClass::connectGrid(int width, float loss)
+{
+    for (int i = 0; i < _nodeCount; i++)
+    {
+        if ((i % width) + 1 < width && i + 1 < _nodeCount)
+        {
+            setLinks(i, i + 1, loss);
+        }
+        if (i + width < _nodeCount)
+        {
+            setLinks(i, i + width, loss);
+        }
+    }
+}
+
+// scatter nodes uniformly over an area, link every pair within range
+void MeshSimClass::connectRandom(double width, double height, double range, float loss)
+{
+    double *x = new double[_nodeCount];
+    double *y = new double[_nodeCount];
+    for (int i = 0; i < _nodeCount; i++)
+    {
+        x[i] = uniform() * width;
+        y[i] = uniform() * height;
+    }
+    for (int i = 0; i < _nodeCount; i++)
+    {
+        for (int j = i + 1; j < _nodeCount; j++)
+        {
+            double dx = x[i] - x[j];
+            double dy = y[i] - y[j];
+            if (dx * dx + dy * dy <= range * range)
+            {
+                setLinks(i, j, loss);
+            }
+        }
+    }
+    delete[] x;
+    delete[] y;
+}
+
+/* Simulation settings
+ */
+void MeshSimClass::setTick(long tick)
+{
+    _tick = (tick > 0) ? tick : 1;
+}
+
+void MeshSimClass::setStartJitter(long jitter)
+{
+    _startJitter = jitter;
+}
+
+// every interval ms a random node sends length bytes to a random node it can reach
+void MeshSimClass::setTraffic(long interval, size_t length)
+{
+    _trafficInterval = interval;
+    _trafficLength = length;
+}
+
+/* Private utility functions
+ */
+uint32_t MeshSimClass::nextRandom()
+{
+    // xorshift32, reproducible for a given seed
+    _seed ^= _seed << 13;
+    _seed ^= _seed >> 17;
+    _seed ^= _seed << 5;
+    return _seed;
+}
+
+double MeshSimClass::uniform()
+{
+    return (double)nextRandom() / 4294967296.0;
+}
+
+long MeshSimClass::airtime(int index, uint8_t length)
+{
+    Layer1Class *radio = _radios[index];
+    double spreadingFactor = (double)radio->spreadingFactor();
+    double bandwidth = (double)radio->getBW();
+    double lowDR = (pow(2, spreadingFactor) / bandwidth > 16) ? 1 : 0;
+    return (long)ceil(calculateAirtime((double)length, spreadingFactor, 1, lowDR, radio->getCR(), bandwidth));
+}
+
+void MeshSimClass::growAir()
+{
+    int capacity = (_airCapacity > 0) ? 2 * _airCapacity : 2 * _maxNodes + 8;
+    _air = (SimTransmission *)realloc(_air, sizeof(SimTransmission) * capacity);
+    _airCapacity = capacity;
+}
+
+// label each node with its connected component, used to judge convergence
+void MeshSimClass::labelComponents()
+{
+    int *stack = new int[_nodeCount];
+    for (int i = 0; i < _nodeCount; i++)
+    {
+        _component[i] = -1;
+    }
+    for (int i = 0; i < _nodeCount; i++)
+    {
+        if (_component[i] >= 0)
+        {
+            continue;
+        }
+        int top = 0;
+        stack[top++] = i;
+        _component[i] = i;
+        while (top > 0)
+        {
+            int n = stack[--top];
+            for (int j = 0; j < _nodeCount; j++)
+            {
+                if (_component[j] < 0 && _loss[n * _maxNodes + j] < 1 && _loss[j * _maxNodes + n] < 1)
+                {
+                    _component[j] = i;
+                    stack[top++] = j;
+                }
+            }
+        }
+    }
+    delete[] stack;
+}
+
+// every node has a usable route to every other node it can reach
+bool MeshSimClass::converged()
+{
+    for (int i = 0; i < _nodeCount; i++)
+    {
+        if (!_started[i])
+        {
+            return false;
+        }
+    }
+    for (int i = 0; i < _nodeCount; i++)
+    {
+        for (int j = 0; j < _nodeCount; j++)
+        {
+            if (j != i && _component[j] == _component[i] &&
+                _nodes[i]->routeDistance(_nodes[j]->localAddress()) == 255)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Radio channel
+ */
+void MeshSimClass::transmit(Layer1Class *radio, const char *data, uint8_t len)
+{
+    int index = radio->nodeID();
+    if (_airCount >= _airCapacity)
+    {
+        growAir();
+    }
+    SimTransmission *tx = &_air[_airCount++];
+    tx->sender = index;
+    tx->start = Layer1Class::getTime();
+    tx->end = tx->start + airtime(index, len);
+    tx->done = false;
+    tx->length = len;
+    memcpy(tx->data, data, len);
+    _stats[index].txFrames++;
+}
+
+// hand an ended frame to every node that could hear it
+void MeshSimClass::deliver(SimTransmission *tx)
+{
+    for (int r = 0; r < _nodeCount; r++)
+    {
+        float loss = _loss[tx->sender * _maxNodes + r];
+        if (r == tx->sender || !_started[r] || loss >= 1)
+        {
+            continue;
+        }
+        bool halfDuplex = false;
+        bool collision = false;
+        for (int k = 0; k < _airCount; k++)
+        {
+            SimTransmission *other = &_air[k];
+            if (other == tx || other->start >= tx->end || tx->start >= other->end)
+            {
+                // does not overlap in time
+                continue;
+            }
+            if (other->sender == r)
+            {
+                halfDuplex = true;
+            }
+            else if (_loss[other->sender * _maxNodes + r] < 1)
+            {
+                collision = true;
+            }
+        }
+        if (halfDuplex)
+        {
+            _stats[r].halfDuplex++;
+        }
+        else if (collision)
+        {
+            _stats[r].collisions++;
+        }
+        else if (uniform() < loss)
+        {
+            _stats[r].linkLosses++;
+        }
+        else
+        {
+            BufferEntry *entry = _radios[r]->rxBuffer->reserve();
+            if (entry == NULL)
+            {
+                _stats[r].overflows++;
+                continue;
+            }
+            memcpy(entry->data, tx->data, tx->length);
+            entry->length = tx->length;
+            _radios[r]->rxBuffer->commit();
+            _stats[r].rxFrames++;
+        }
+    }
+    tx->done = true;
+}
+
+// drop delivered frames that can no longer overlap anything still to be delivered
+void MeshSimClass::purge(long now)
+{
+    long horizon = now;
+    for (int k = 0; k < _airCount; k++)
+    {
+        if (!_air[k].done && _air[k].start < horizon)
+        {
+            horizon = _air[k].start;
+        }
+    }
+    int kept = 0;
+    for (int k = 0; k < _airCount; k++)
+    {
+        if (_air[k].done && _air[k].end <= horizon)
+        {
+            continue;
+        }
+        if (kept != k)
+        {
+            _air[kept] = _air[k];
+        }
+        kept++;
+    }
+    _airCount = kept;
+}
+
+/* Generated data traffic
+ */
+int MeshSimClass::sendData(int from, int to, size_t length)
+{
+    if (length < SIM_MAGIC_LENGTH)
+    {
+        length = SIM_MAGIC_LENGTH;
+    }
+    if (length > MESSAGE_LENGTH)
+    {
+        length = MESSAGE_LENGTH;
+    }
+    if (_messageCount >= _messageCapacity)
+    {
+        _messageCapacity = (_messageCapacity > 0) ? 2 * _messageCapacity : 256;
+        _received = (uint8_t *)realloc(_received, _messageCapacity);
+    }
+    uint32_t id = _messageCount++;
+    // bit 1 marks messages sent once routing had converged
+    _received[id] = (_convergenceTime >= 0) ? 2 : 0;
+    _convergedSent += (_convergenceTime >= 0);
+
+    Datagram datagram;
+    memset(&datagram, 0, sizeof(datagram));
+    memcpy(datagram.destination, _nodes[to]->localAddress(), ADDR_LENGTH);
+    datagram.type = 'c';
+    memcpy(datagram.message, "SIM", 3);
+    memcpy(datagram.message + 3, &id, sizeof(id));
+    _dataSent++;
+    int ret = _nodes[from]->writeData(datagram, length + DATAGRAM_HEADER);
+    if (ret < 0)
+    {
+        // no route to destination yet
+        _dataUnrouted++;
+    }
+    return ret;
+}
+
+// drain Layer3 packets of a node, counting generated data that reached its destination
+void MeshSimClass::pollData(int index)
+{
+    Packet *packet;
+    while ((packet = _nodes[index]->peekData()) != NULL)
+    {
+        if (packet->totalLength >= HEADER_LENGTH + DATAGRAM_HEADER + SIM_MAGIC_LENGTH &&
+            memcmp(packet->datagram.message, "SIM", 3) == 0 &&
+            memcmp(packet->datagram.destination, _nodes[index]->localAddress(), ADDR_LENGTH) == 0)
+        {
+            uint32_t id;
+            memcpy(&id, packet->datagram.message + 3, sizeof(id));
+            if (id < (uint32_t)_messageCount && !(_received[id] & 1))
+            {
+                _received[id] |= 1;
+                _dataDelivered++;
+                _convergedDelivered += (_received[id] >> 1);
+            }
+        }
+        _nodes[index]->releaseData();
+    }
+}
+
+/* Main simulation loop
+ * Polls every started node each tick, and jumps the clock straight to the end
+ * of the next frame on the air so receptions are handled at their exact time.
+ */
+void MeshSimClass::run(long duration)
+{
+    long now = Layer1Class::getTime();
+    long end = now + duration;
+    labelComponents();
+    for (int i = 0; i < _nodeCount; i++)
+    {
+        if (_startTimes[i] < 0)
+        {
+            _startTimes[i] = now + (long)(uniform() * _startJitter);
+        }
+    }
+    while (now < end)
+    {
+        for (int i = 0; i < _nodeCount; i++)
+        {
+            if (!_started[i] && _startTimes[i] <= now)
+            {
+                _nodes[i]->init();
+                _started[i] = true;
+            }
+        }
+        for (int k = 0; k < _airCount; k++)
+        {
+            if (!_air[k].done && _air[k].end <= now)
+            {
+                deliver(&_air[k]);
+            }
+        }
+        purge(now);
+        for (int i = 0; i < _nodeCount; i++)
+        {
+            if (_started[i])
+            {
+                _nodes[i]->daemon();
+                pollData(i);
+            }
+        }
+        if (_trafficInterval > 0 && _nodeCount > 1 && now - _lastTraffic >= _trafficInterval)
+        {
+            // destination is another node of the sender's component, the
+            // delivery ratio only counts pairs the mesh can connect
+            int from = nextRandom() % _nodeCount;
+            int reachable = 0;
+            for (int j = 0; j < _nodeCount; j++)
+            {
+                reachable += (j != from && _component[j] == _component[from]);
+            }
+            if (reachable > 0)
+            {
+                int k = nextRandom() % reachable;
+                int to = 0;
+                for (; to < _nodeCount; to++)
+                {
+                    if (to != from && _component[to] == _component[from] && k-- == 0)
+                    {
+                        break;
+                    }
+                }
+                if (_started[from] && _started[to])
+                {
+                    sendData(from, to, _trafficLength);
+                }
+            }
+            _lastTraffic = now;
+        }
+        if (_convergenceTime < 0 && converged())
+        {
+            _convergenceTime = now;
+        }
+
+        long next = now + _tick;
+        for (int k = 0; k < _airCount; k++)
+        {
+            if (!_air[k].done && _air[k].end > now && _air[k].end < next)
+            {
+                next = _air[k].end;
+            }
+        }
+        now = next;
+        Layer1Class::setTime(now);
+    }
+}
+
+/* Results
+ */
+// virtual time at which every node first had a route to every node it can reach, -1 if never
+long MeshSimClass::convergenceTime()
+{
+    return _convergenceTime;
+}
+
+double MeshSimClass::deliveryRatio()
+{
+    if (_dataSent == 0)
+    {
+        return 0;
+    }
+    return (double)_dataDelivered / (double)_dataSent;
+}
+
+// delivery ratio of the data sent once routing had converged
+double MeshSimClass::convergedDeliveryRatio()
+{
+    if (_convergedSent == 0)
+    {
+        return 0;
+    }
+    return (double)_convergedDelivered / (double)_convergedSent;
+}
+
+void MeshSimClass::report(FILE *out)
+{
+    long now = Layer1Class::getTime();
+    fprintf(out, "nodes: %d, simulated time: %ld ms\r\n", _nodeCount, now);
+    if (_convergenceTime >= 0)
+    {
+        fprintf(out, "routing converged at: %ld ms\r\n", _convergenceTime);
+    }
+    else
+    {
+        fprintf(out, "routing converged at: never\r\n");
+    }
+    fprintf(out, "data sent: %u, delivered: %u, no route: %u, delivery ratio: %.3f\r\n",
+            _dataSent, _dataDelivered, _dataUnrouted, deliveryRatio());
+    fprintf(out, "after convergence sent: %u, delivered: %u, delivery ratio: %.3f\r\n",
+            _convergedSent, _convergedDelivered, convergedDeliveryRatio());
+    fprintf(out, "node     routes  tx      rx      collide halfdup lost    overflow airtime_ms duty\r\n");
+    for (int i = 0; i < _nodeCount; i++)
+    {
+        uint8_t *address = _nodes[i]->localAddress();
+        double airtime = _nodes[i]->airtimeUsed();
+        fprintf(out, "%02x%02x%02x%02x %-7d %-7u %-7u %-7u %-7u %-7u %-8u %-10.0f %.4f\r\n",
+                address[0], address[1], address[2], address[3],
+                _nodes[i]->getRouteEntry(),
+                _stats[i].txFrames, _stats[i].rxFrames, _stats[i].collisions,
+                _stats[i].halfDuplex, _stats[i].linkLosses, _stats[i].overflows,
+                airtime, (now > 0) ? airtime / now : 0);
+    }
+}
+#endif
@@ -0,0 +1,117 @@
+#ifndef MESHSIM_H
+#define MESHSIM_H
+
+#ifdef SIM
+#include <LoRaLayer2.h>
+
+#define SIM_DEFAULT_TICK 10 // ms between daemon() polls of every node
+#define SIM_DEFAULT_JITTER 15000 // ms over which node start times are spread
+#define SIM_MAGIC_LENGTH 8 // "SIM" + message id + padding at the head of generated data
+
+// one frame on the air
+struct SimTransmission {
+    int sender;
+    long start;
+    long end;
+    bool done; // frame has ended and been delivered
+    uint8_t length;
+    char data[MAX_PACKET_SIZE];
+};
+
+// per node counters
+struct SimNodeStats {
+    uint32_t txFrames;
+    uint32_t rxFrames;
+    uint32_t collisions; // frames lost to overlapping transmissions
+    uint32_t halfDuplex; // frames lost because the node was transmitting
+    uint32_t linkLosses; // frames lost to the link loss model
+    uint32_t overflows;  // frames lost because the rx buffer was full
+};
+
+/* MeshSimClass
+ * In-process discrete-event simulator for many LL2Class nodes on a Linux host.
+ * Every node gets its own Layer1Class attached to the simulator, all share the
+ * virtual clock behind Layer1Class::getTime(). Frames are on the air for their
+ * computed airtime, and are lost to the link loss model, to any other audible
+ * frame that overlaps them, or to the receiver transmitting at the same time.
+ */
+class MeshSimClass {
+public:
+    MeshSimClass(int maxNodes, uint32_t seed = 1);
+    ~MeshSimClass();
+
+    // Nodes
+    int addNode(const char *macString);
+    int nodeCount();
+    LL2Class *node(int index);
+    Layer1Class *radio(int index);
+    SimNodeStats *stats(int index);
+
+    // Topology and link-loss model, loss is the probability a frame is dropped
+    void setLink(int from, int to, float loss);
+    void setLinks(int a, int b, float loss);
+    void connectLine(float loss);
+    void connectGrid(int width, float loss);
+    void connectRandom(double width, double height, double range, float loss);
+
+    // Simulation settings
+    void setTick(long tick);
+    void setStartJitter(long jitter);
+    void setTraffic(long interval, size_t length);
+
+    // Run and report
+    int sendData(int from, int to, size_t length);
+    void run(long duration);
+    long convergenceTime();
+    double deliveryRatio();
+    double convergedDeliveryRatio();
+    void report(FILE *out);
+
+    // called by Layer1Class::sendPacket of attached radios
+    void transmit(Layer1Class *radio, const char *data, uint8_t len);
+
+private:
+    uint32_t nextRandom();
+    double uniform();
+    long airtime(int index, uint8_t length);
+    void deliver(SimTransmission *tx);
+    void purge(long now);
+    void pollData(int index);
+    bool converged();
+    void labelComponents();
+    void growAir();
+
+    int _maxNodes;
+    int _nodeCount;
+    uint32_t _seed;
+    long _tick;
+    long _startJitter;
+    long _trafficInterval;
+    size_t _trafficLength;
+    long _lastTraffic;
+
+    Layer1Class **_radios;
+    LL2Class **_nodes;
+    long *_startTimes;
+    bool *_started;
+    int *_component; // connected component of each node
+    float *_loss; // _maxNodes x _maxNodes, 1 means no link
+    SimNodeStats *_stats;
+
+    SimTransmission *_air; // frames on the air, or recently ended
+    int _airCount;
+    int _airCapacity;
+
+    uint8_t *_received; // per generated message, bit 0 delivered at destination, bit 1 sent after convergence
+    int _messageCount;
+    int _messageCapacity;
+    uint32_t _dataSent;
+    uint32_t _dataDelivered;
+    uint32_t _dataUnrouted;
+    uint32_t _convergedSent;
+    uint32_t _convergedDelivered;
+    long _convergenceTime;
+};
+
+#endif
+#endif
@@ -1,44 +1,53 @@
 #include <LoRaLayer2.h>
 
 /* Fifo Buffer Class
+ * Thin packet wrappers around spscRing, safe to share between the radio
+ * receive path (producer) and LL2Class::daemon (consumer) without locking.
 */
-packetBuffer::packetBuffer() :
-  head(0),
-  tail(0)
+packetBuffer::packetBuffer()
 {
 };
 
 // reads a packet from buffer
 BufferEntry packetBuffer::read(){
     BufferEntry entry;
-    if (head == tail){
-        // if buffer empty, return empty entry
-        BufferEntry entry;
-        memset(&entry, 0, sizeof(entry));
-        entry.length = 0;
-    }
-    else{
-        // otherwise return entry from tail
-        tail = (tail + 1) % BUFFERSIZE;
-        memcpy(&entry, &buffer[tail], sizeof(entry));
-        // clear data stored in tail of buffer
-        memset(&buffer[tail], 0, sizeof(buffer[tail]));
-    }
+    // if buffer empty, return empty entry
+    try_pop(entry);
     return entry;
 }
 
 // writes a packet to buffer
-int packetBuffer::write(BufferEntry entry) {
-    int ret = BUFFERSIZE;
-    // if full, return the size of the buffer
-    if (((head + 1) % BUFFERSIZE) != tail){
-        head = (head + 1) % BUFFERSIZE;
+int packetBuffer::write(const BufferEntry &entry) {
+    if (!try_push(entry)){
+        // if full, return the size of the buffer
+        return BUFFERSIZE;
+    }
+    // return the packet's place in line
+    return size();
+}
+
+// borrows the entry at the tail of the buffer without copying it
+BufferEntry* packetBuffer::peek(){
+    return front();
+}
+
+// returns the borrowed tail entry to the buffer
+void packetBuffer::release(){
+    pop();
+}
+
+// borrows the next free entry so it can be filled in place
+BufferEntry* packetBuffer::reserve(){
+    BufferEntry *slot = back();
+    if (slot != NULL){
         // clear any previous data stored in buffer
-        memset(&buffer[head], 0, sizeof(buffer[head]));
-        // copy new data into buffer
-        buffer[head] = entry;
-        ret = head-tail; // and return the packet's place in line
+        *slot = BufferEntry();
     }
-    // if full, return the size of the buffer
-    return ret;
+    return slot;
+}
+
+// queues the entry returned by reserve()
+int packetBuffer::commit(){
+    // return the packet's place in line
+    return push();
 }
@@ -5,23 +5,28 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <stdarg.h>
-#define BUFFERSIZE 8
-#define MAX_PACKET_SIZE 255
+#include <spscRing.h>
+#ifndef BUFFERSIZE
+#define BUFFERSIZE 8 // ring slots, holds BUFFERSIZE - 1 packets
+#endif
+#define MAX_PACKET_SIZE 256 // large enough to parse a whole Packet in place
 
 struct BufferEntry {
   char data[MAX_PACKET_SIZE] = { 0 };
   size_t length = 0;
 };
 
-class packetBuffer {
+// packet fifo between Layer1 and LL2, or LL2 and Layer3
+class packetBuffer : public spscRing<BufferEntry, BUFFERSIZE> {
   public:
-    // use pointer to char instead? and then copy that raw data into a packet
+    // copying access, kept as wrappers around the slot functions below
     BufferEntry read();
-    int write(BufferEntry entry);
+    int write(const BufferEntry &entry);
+    // zero-copy access, borrow a slot in place instead of copying it
+    BufferEntry* peek();    // oldest queued entry, NULL if empty
+    void release();         // drop the entry returned by peek()
+    BufferEntry* reserve(); // next free entry, cleared, NULL if full
+    int commit();           // queue the entry returned by reserve()
     packetBuffer();
-  private:
-    BufferEntry buffer[BUFFERSIZE];
-    int head;
-    int tail;
 };
 #endif
@@ -0,0 +1,115 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Single-producer/single-consumer lock-free ring
+ * One side (e.g. the Layer1 receive path) only ever pushes and the other
+ * (e.g. LL2Class::daemon) only ever pops. head is written by the producer
+ * only and tail by the consumer only, published with release stores and
+ * read with acquire loads, so no locks or disabled interrupts are needed.
+ * One slot is kept free to tell full from empty, so N slots hold N - 1 items.
+ */
+template <typename T, size_t N>
+class spscRing {
+    static_assert(N > 1, "spscRing needs at least two slots");
+  public:
+    spscRing() :
+      head(0),
+      tail(0),
+      _overflows(0),
+      _highWater(0)
+    {
+    };
+
+    // producer side
+    bool try_push(const T &item){
+        T *slot = back();
+        if (slot == NULL){
+            return false;
+        }
+        *slot = item;
+        push();
+        return true;
+    }
+
+    // borrows the next free slot, NULL (and counted as overflow) if full
+    T* back(){
+        size_t h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+        if (next(h) == __atomic_load_n(&tail, __ATOMIC_ACQUIRE)){
+            __atomic_store_n(&_overflows, _overflows + 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        return &buffer[h];
+    }
+
+    // publishes the slot returned by back(), returns the new queue depth
+    size_t push(){
+        size_t h = next(__atomic_load_n(&head, __ATOMIC_RELAXED));
+        __atomic_store_n(&head, h, __ATOMIC_RELEASE);
+        size_t depth = (h + N - __atomic_load_n(&tail, __ATOMIC_ACQUIRE)) % N;
+        if (depth > _highWater){
+            __atomic_store_n(&_highWater, depth, __ATOMIC_RELAXED);
+        }
+        return depth;
+    }
+
+    // consumer side
+    bool try_pop(T &item){
+        T *slot = front();
+        if (slot == NULL){
+            return false;
+        }
+        item = *slot;
+        pop();
+        return true;
+    }
+
+    // borrows the oldest queued slot, NULL if empty
+    T* front(){
+        size_t t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+        if (t == __atomic_load_n(&head, __ATOMIC_ACQUIRE)){
+            return NULL;
+        }
+        return &buffer[t];
+    }
+
+    // returns the slot borrowed by front() to the producer
+    void pop(){
+        size_t t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+        if (t != __atomic_load_n(&head, __ATOMIC_ACQUIRE)){
+            __atomic_store_n(&tail, next(t), __ATOMIC_RELEASE);
+        }
+    }
+
+    // statistics, safe to read from either side
+    size_t size(){
+        size_t h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+        size_t t = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+        return (h + N - t) % N;
+    }
+    size_t capacity(){
+        return N - 1;
+    }
+    uint32_t overflows(){
+        return __atomic_load_n(&_overflows, __ATOMIC_RELAXED);
+    }
+    size_t highWater(){
+        return __atomic_load_n(&_highWater, __ATOMIC_RELAXED);
+    }
+
+  protected:
+    T buffer[N];
+
+  private:
+    static size_t next(size_t index){
+        return (index + 1) % N;
+    }
+
+    size_t head;        // next slot to write, owned by producer
+    size_t tail;        // next slot to read, owned by consumer
+    uint32_t _overflows; // pushes dropped because the ring was full
+    size_t _highWater;  // deepest queue depth seen
+};
+#endif